@@ -0,0 +1,72 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<size_t> allocationCount = 0;
+}
+
+size_t d3d11renderer::get_allocation_count()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+#ifdef _DEBUG
+
+namespace
+{
+	void* counted_allocate(size_t size)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size > 0 ? size : 1);
+	}
+
+	void* counted_allocate(size_t size, std::align_val_t alignment)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		return _aligned_malloc(size > 0 ? size : 1, static_cast<size_t>(alignment));
+	}
+
+	void* throwing_allocate(size_t size)
+	{
+		void* memory = counted_allocate(size);
+		if (!memory)
+			throw std::bad_alloc();
+		return memory;
+	}
+
+	void* throwing_allocate(size_t size, std::align_val_t alignment)
+	{
+		void* memory = counted_allocate(size, alignment);
+		if (!memory)
+			throw std::bad_alloc();
+		return memory;
+	}
+}
+
+void* operator new(size_t size) { return throwing_allocate(size); }
+void* operator new[](size_t size) { return throwing_allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return throwing_allocate(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return throwing_allocate(size, alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return counted_allocate(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return counted_allocate(size, alignment); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { _aligned_free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { _aligned_free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { _aligned_free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { _aligned_free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { _aligned_free(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { _aligned_free(memory); }
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+namespace d3d11renderer
+{
+	// Debug builds replace the global operator new and count every call, from any thread. Release builds keep the
+	// standard allocator and always report 0. Memory the CRT, D3D or ImGui take through malloc or HeapAlloc is not seen.
+	constexpr bool ALLOCATION_COUNTING =
+#ifdef _DEBUG
+		true;
+#else
+		false;
+#endif
+
+	size_t get_allocation_count();
+}
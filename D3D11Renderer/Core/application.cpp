@@ -2,33 +2,116 @@
 #include "../imgui/imgui.h"
 #include "../imgui/imgui_impl_win32.h"
 #include "../imgui/imgui_impl_dx11.h"
+#include "shader_compiler.h"
+#include "allocation_counter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+static_assert(model::Material::TEXTURE_COUNT == light_shader::MATERIAL_TEXTURES, "Materials hold exactly the maps the light shader binds");
+
+namespace
+{
+	// Largest axis scale of the scene node, which grows model-space bounds and errors into world space
+	float world_scale(const DirectX::XMMATRIX& worldMatrix)
+	{
+		return std::sqrt(std::max({
+			DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(worldMatrix.r[0])),
+			DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(worldMatrix.r[1])),
+			DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(worldMatrix.r[2])) }));
+	}
+}
 
 d3d11renderer::application::application(int screenWidth, int screenHeight, HWND hwnd, std::shared_ptr<d3d11renderer::input> input)
 {
 	try 
 	{
 		m_d3d = std::make_shared<d3d11renderer::d3dclass>(screenWidth, screenHeight, VSYNC_ENABLED, hwnd, FULL_SCREEN, SCREEN_DEPTH, SCREEN_NEAR);
+		m_shaderCache = std::make_shared<shader_cache>("ShaderCache", shader_compiler::get_version(), shader_compiler::compile);
 		m_camera = std::make_shared<camera>(input);
 		m_camera->set_position(0.0f, 0.0f, 10.0f);
 		m_camera->set_rotation(0.0f, DirectX::XM_PIDIV2, 0.0f);
 
-		m_lightShader = std::make_shared<light_shader>(m_d3d->get_device(), hwnd);
+		m_lightShader = std::make_shared<light_shader>(m_d3d->get_device(), hwnd, *m_shaderCache);
 		m_light = std::make_shared<light>();
 		m_light->set_ambient_color(0.15f, 0.15f, 0.15f, 1.0f);
 		m_light->set_diffuse_color(1.0f, 1.0f, 1.0f, 1.0f);
-		m_light->set_direction(0.0f, 0.0f, 1.0f);
+		m_light->set_direction(0.3f, -1.0f, 0.4f);
 		m_light->set_specular_color(1.0f, 1.0f, 1.0f, 1.0f);
 		m_light->set_specular_power(256.0f);
-		m_skybox = std::make_shared<skybox>(m_d3d->get_device(), m_d3d->get_device_context(), L"Skyboxes/kloppenheim_06_puresky_4k.hdr");
-		m_reinhardShader = std::make_shared<reinhard_shader>(m_d3d->get_device(), hwnd);
+		m_lightClusters = std::make_shared<light_clusters>(cluster_settings());
+		m_punctualLightCount = 1000;
+		m_shadowCascades = std::make_shared<shadow_cascades>(cascade_settings());
+		m_shadowMap = std::make_shared<shadow_map>(m_d3d->get_device(), *m_shaderCache);
+		m_depthPrepass = std::make_shared<depth_prepass>(m_d3d->get_device(), *m_shaderCache);
+		m_depthPrepassEnabled = true;
+		m_lodEnabled = true;
+		m_fpsHistoryCount = 0;
+		m_fpsHistoryOffset = 0;
+		m_frameArena = std::make_shared<frame_arena>(256 * 1024);
+		m_frameIndex = 0;
+		m_frameAllocations = 0;
+		m_rebuildFrame = 0;
+		m_lodTriangles = 0;
+		std::fill(std::begin(m_lodDraws), std::end(m_lodDraws), size_t(0));
+		m_skybox = std::make_shared<skybox>(m_d3d->get_device(), m_d3d->get_device_context(), L"Skyboxes/kloppenheim_06_puresky_4k.hdr", *m_shaderCache);
+		m_postProcess = std::make_shared<post_process>(m_d3d->get_device(), *m_shaderCache);
+		m_autoExposure = std::make_shared<auto_exposure>(m_d3d->get_device(), *m_shaderCache);
 		m_scene_values[0] = false;
 		m_scene_values[1] = false;
 		m_scene_values[2] = false;
 
-		m_sponza = std::make_shared<model>(m_d3d->get_device(), m_d3d->get_device_context(), "Models/Sponza/Sponza.gltf", "Models/Sponza");
-		m_damagedHelmet = std::make_shared<model>(m_d3d->get_device(), m_d3d->get_device_context(), "Models/DamagedHelmet/DamagedHelmet.gltf", "Models/DamagedHelmet");
-		m_scifiHelmet = std::make_shared<model>(m_d3d->get_device(), m_d3d->get_device_context(), "Models/SciFiHelmet/SciFiHelmet.gltf", "Models/SciFiHelmet");
-		m_sphere = std::make_shared<model>(m_d3d->get_device(), m_d3d->get_device_context(), "Models/sphere.gltf", "Models/");
+		// Sponza is many small static pieces; batching merges them by material while keeping batches small enough to cull
+		d3d11renderer::batch_settings sponzaBatching;
+		sponzaBatching.enabled = true;
+		m_sponza = std::make_shared<model>(m_d3d->get_device(), m_d3d->get_device_context(), "Models/Sponza/Sponza.gltf", "Models/Sponza", sponzaBatching,
+			model::Importer::Gltf, TEXTURE_QUALITY);
+		m_damagedHelmet = std::make_shared<model>(m_d3d->get_device(), m_d3d->get_device_context(), "Models/DamagedHelmet/DamagedHelmet.gltf", "Models/DamagedHelmet",
+			d3d11renderer::batch_settings(), model::Importer::Gltf, TEXTURE_QUALITY);
+		m_scifiHelmet = std::make_shared<model>(m_d3d->get_device(), m_d3d->get_device_context(), "Models/SciFiHelmet/SciFiHelmet.gltf", "Models/SciFiHelmet",
+			d3d11renderer::batch_settings(), model::Importer::Gltf, TEXTURE_QUALITY);
+
+		// One node per scene under the root, placing the model, with the model's own nodes below it as its file arranges
+		// them. The instance stream holds their model-space transforms as import computed them
+		m_sceneGraph = std::make_shared<scene_graph>();
+		const model* sceneModels[3] = { m_sponza.get(), m_damagedHelmet.get(), m_scifiHelmet.get() };
+		for (int scene = 0; scene < 3; scene++)
+		{
+			m_sceneNodes[scene] = m_sceneGraph->add_node();
+			std::vector<uint32_t> nodeIds;
+			for (const model::Node& modelNode : sceneModels[scene]->get_nodes())
+			{
+				uint32_t node = m_sceneGraph->add_node(modelNode.parent < 0 ? m_sceneNodes[scene] : nodeIds[modelNode.parent]);
+				m_sceneGraph->set_translation(node, modelNode.translation.x, modelNode.translation.y, modelNode.translation.z);
+				m_sceneGraph->set_rotation(node, modelNode.rotation.x, modelNode.rotation.y, modelNode.rotation.z, modelNode.rotation.w);
+				m_sceneGraph->set_scale(node, modelNode.scale.x, modelNode.scale.y, modelNode.scale.z);
+				nodeIds.push_back(node);
+			}
+		}
+
+		// Compile every light shader permutation the scenes use before the first frame
+		std::vector<uint32_t> subMeshFeatures;
+		for (const model* sceneModel : { m_sponza.get(), m_damagedHelmet.get(), m_scifiHelmet.get() })
+		{
+			for (const auto& subMesh : sceneModel->get_sub_meshes())
+			{
+				subMeshFeatures.push_back(sceneModel->get_materials()[subMesh.materialId].features);
+			}
+		}
+		if (!m_lightShader->prepare_permutations(m_d3d->get_device(), hwnd, subMeshFeatures, *m_shaderCache))
+		{
+			throw std::runtime_error("Failed to compile the light shader permutations.");
+		}
+
+		generate_punctual_lights(*m_sponza, m_punctualLightCount);
+
+		m_textureStreamer = std::make_shared<texture_streamer>(streaming_settings());
+		register_streamed_textures(*m_sponza);
+		register_streamed_textures(*m_damagedHelmet);
+		register_streamed_textures(*m_scifiHelmet);
 		ImGui_ImplDX11_Init(m_d3d->get_device(), m_d3d->get_device_context());
 	}
 	catch (std::exception e) 
@@ -50,6 +133,10 @@ bool d3d11renderer::application::frame(float deltaTime)
 {
 	bool result;
 
+	// Whatever the last frame put in frame memory goes at once
+	m_frameArena->reset();
+	size_t allocations = get_allocation_count();
+
 	// Render the graphics scene.
 	update_fps_plot(deltaTime);
 	result = render(deltaTime);
@@ -57,6 +144,8 @@ bool d3d11renderer::application::frame(float deltaTime)
 	{
 		return false;
 	}
+
+	check_frame_allocations(get_allocation_count() - allocations);
 	return true;
 }
 
@@ -80,23 +169,34 @@ bool d3d11renderer::application::render(float deltaTime)
 	m_camera->frame(deltaTime);
 	m_camera->render();
 
-	// Get the world, view, and projection matrices from the camera and d3d objects.
-	m_d3d->get_world_matrix(worldMatrix);
+	// Get the world matrix from the scene graph, and the view and projection matrices from the camera and d3d objects.
+	m_sceneGraph->update();
+	DirectX::XMFLOAT4X4 world;
+	m_sceneGraph->get_world(m_sceneNodes[static_cast<int>(m_current_scene)], world.m);
+	worldMatrix = DirectX::XMLoadFloat4x4(&world);
 	m_camera->get_view_matrix(viewMatrix);
 	m_d3d->get_projection_matrix(projectionMatrix);
 
-	m_d3d->set_culling(false);
-	m_d3d->set_depth(false);
+	stream_textures(*get_current_model(), worldMatrix, projectionMatrix);
+	frame_vector<draw_item> draws(*m_frameArena, get_current_model()->get_sub_meshes().size());
+	select_lods(*get_current_model(), worldMatrix, projectionMatrix, draws);
+	render_shadows(*get_current_model(), worldMatrix, viewMatrix, projectionMatrix);
 
-	m_sphere->render(m_d3d->get_device_context());
+	m_lightShader->reset_draw_counts();
 
-	for (const auto& subMesh : m_sphere->get_sub_meshes()) // Assuming get_sub_meshes() returns a collection of sub-mesh data
+	// Environment lighting is the same for every draw this frame
+	const auto& ibl = m_skybox->get_ibl();
+	m_lightShader->set_environment(m_d3d->get_device_context(), m_skybox->get_specular_srv(), m_skybox->get_brdf_lut_srv(),
+		ibl.irradiance, static_cast<float>(ibl.specularMips));
+	update_light_clusters(viewMatrix, projectionMatrix);
+	m_lightShader->set_shadows(m_d3d->get_device_context(), *m_shadowCascades, m_shadowMap->get_srv());
+
+	if (m_depthPrepassEnabled)
 	{
-		m_skybox->render(m_d3d->get_device_context(), subMesh.indexCount, viewMatrix, projectionMatrix);
+		render_depth_prepass(*get_current_model(), draws, worldMatrix, viewMatrix, projectionMatrix);
 	}
-
-	m_d3d->set_culling(true);
-	m_d3d->set_depth(true);
+	m_d3d->set_depth_equal(m_depthPrepassEnabled);
+	m_depthPrepass->begin_statistics(m_d3d->get_device_context());
 
 	static float rotation = 0.0f;
 	// Update the rotation variable each frame.
@@ -112,93 +212,48 @@ bool d3d11renderer::application::render(float deltaTime)
 	//worldMatrix = DirectX::XMMatrixMultiply(DirectX::XMMatrixScaling(0.1f,0.1f,0.1f), worldMatrix);
 
 
-	switch (m_current_scene) {
-	case scene_state::DamagedHelmet:
-		m_damagedHelmet->render(m_d3d->get_device_context());
-
-		for (const auto& subMesh : m_damagedHelmet->get_sub_meshes()) // Assuming get_sub_meshes() returns a collection of sub-mesh data
-		{
-			// Retrieve the texture associated with the current sub-mesh
-			ID3D11ShaderResourceView* diffuse = subMesh.diffuseTexture ? subMesh.diffuseTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* normal = subMesh.normalTexture ? subMesh.normalTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* specular = subMesh.specularTexture ? subMesh.specularTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* ao = subMesh.aoTexture ? subMesh.aoTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* emissive = subMesh.emissiveTexture ? subMesh.emissiveTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* metal = subMesh.metalRoughnessTexture ? subMesh.metalRoughnessTexture->get_texture() : nullptr;
-
-			// Set shader parameters, including the texture
-			result = m_lightShader->render(m_d3d->get_device_context(), subMesh.indexCount, subMesh.startIndex, worldMatrix, viewMatrix, projectionMatrix,
-				diffuse, normal, specular, ao, emissive, metal,
-				m_light->get_direction(), m_light->get_diffuse_color(), m_light->get_ambient_color(),
-				m_camera->get_position(), m_light->get_specular_color(), m_light->get_specular_power());
-
-			// Optionally, check the result for errors
-			if (!result) {
-				// Handle any rendering errors
-			}
-		}
-		break;
-	case scene_state::ScifiHelmet:
-		m_scifiHelmet->render(m_d3d->get_device_context());
-
-		for (const auto& subMesh : m_scifiHelmet->get_sub_meshes()) // Assuming get_sub_meshes() returns a collection of sub-mesh data
-		{
-			// Retrieve the texture associated with the current sub-mesh
-			ID3D11ShaderResourceView* diffuse = subMesh.diffuseTexture ? subMesh.diffuseTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* normal = subMesh.normalTexture ? subMesh.normalTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* specular = subMesh.specularTexture ? subMesh.specularTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* ao = subMesh.aoTexture ? subMesh.aoTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* emissive = subMesh.emissiveTexture ? subMesh.emissiveTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* metal = subMesh.metalRoughnessTexture ? subMesh.metalRoughnessTexture->get_texture() : nullptr;
-
-			// Set shader parameters, including the texture
-			result = m_lightShader->render(m_d3d->get_device_context(), subMesh.indexCount, subMesh.startIndex, worldMatrix, viewMatrix, projectionMatrix,
-				diffuse, normal, specular, ao, emissive, metal,
-				m_light->get_direction(), m_light->get_diffuse_color(), m_light->get_ambient_color(),
-				m_camera->get_position(), m_light->get_specular_color(), m_light->get_specular_power());
-
-			// Optionally, check the result for errors
-			if (!result) {
-				// Handle any rendering errors
-			}
-		}
-		break;
-	case scene_state::Sponza:
-		m_sponza->render(m_d3d->get_device_context());
-
-		for (const auto& subMesh : m_sponza->get_sub_meshes()) // Assuming get_sub_meshes() returns a collection of sub-mesh data
+	model* currentModel = get_current_model();
+	currentModel->render(m_d3d->get_device_context());
+	result = m_lightShader->begin(m_d3d->get_device_context(), worldMatrix, viewMatrix, projectionMatrix,
+		m_light->get_direction(), m_light->get_diffuse_color(), m_light->get_ambient_color(),
+		m_camera->get_position(), m_light->get_specular_color(), m_light->get_specular_power());
+	if (result)
+	{
+		// Submeshes come sorted by material, so each material is bound once for its run of draws
+		const auto& materials = currentModel->get_materials();
+		int boundMaterial = -1;
+		for (const draw_item& draw : draws)
 		{
-			// Retrieve the texture associated with the current sub-mesh
-			ID3D11ShaderResourceView* diffuse = subMesh.diffuseTexture ? subMesh.diffuseTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* normal = subMesh.normalTexture ? subMesh.normalTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* specular = subMesh.specularTexture ? subMesh.specularTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* ao = subMesh.aoTexture ? subMesh.aoTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* emissive = subMesh.emissiveTexture ? subMesh.emissiveTexture->get_texture() : nullptr;
-			ID3D11ShaderResourceView* metal = subMesh.metalRoughnessTexture ? subMesh.metalRoughnessTexture->get_texture() : nullptr;
-
-			// Set shader parameters, including the texture
-			result = m_lightShader->render(m_d3d->get_device_context(), subMesh.indexCount, subMesh.startIndex, worldMatrix, viewMatrix, projectionMatrix,
-				diffuse, normal, specular, ao, emissive, metal,
-				m_light->get_direction(), m_light->get_diffuse_color(), m_light->get_ambient_color(),
-				m_camera->get_position(), m_light->get_specular_color(), m_light->get_specular_power());
-
-			// Optionally, check the result for errors
-			if (!result) {
-				// Handle any rendering errors
+			if (draw.materialId != boundMaterial)
+			{
+				const auto& material = materials[draw.materialId];
+				m_lightShader->set_material(m_d3d->get_device_context(), material.views, material.features, material.factors);
+				boundMaterial = draw.materialId;
 			}
+			m_lightShader->render(m_d3d->get_device_context(), draw.indexCount, draw.startIndex, draw.instanceCount, draw.startInstance);
 		}
-		break;
 	}
 
+	m_depthPrepass->end_statistics(m_d3d->get_device_context(), m_depthPrepassEnabled);
+	m_d3d->set_depth_equal(false);
 
-	m_d3d->end_scene();
+	// Sky last, so the depth test rejects everything the scene covered before it is shaded
+	m_d3d->set_culling(false);
+	m_d3d->set_depth(false);
+	m_skybox->render(m_d3d->get_device_context(), viewMatrix, projectionMatrix);
+	m_d3d->set_culling(true);
+	m_d3d->set_depth(true);
 
-	static float exposure = 0.6f;         // Initial exposure
-	static float averageLuminance = 1.0f; // Average luminance
-	static float maxLuminance = 1.0f;     // Maximum luminance for clamping
-	static float burn = 1.0f;             // Burn threshold for tone mapping
+	m_d3d->end_scene();
 
-	m_reinhardShader->render(m_d3d->get_device_context(), m_d3d->get_tonemap_srv(), exposure, averageLuminance, maxLuminance, burn);
+	// One compute pass from the multisampled scene to the back buffer. It bins the histogram as it goes, and exposure
+	// adapts on the GPU afterwards for the next frame
+	const auto& viewport = m_d3d->get_viewport();
+	m_autoExposure->begin_frame(m_d3d->get_device_context(), deltaTime, m_exposureSettings);
+	m_postProcess->render(m_d3d->get_device_context(), m_d3d->get_tonemap_srv(), m_d3d->get_back_buffer_uav(),
+		static_cast<uint32_t>(viewport.Width), static_cast<uint32_t>(viewport.Height), *m_autoExposure, m_gradingSettings);
+	m_autoExposure->adapt(m_d3d->get_device_context());
+	m_d3d->set_back_buffer_render_target();
 
 	ImGui_ImplDX11_NewFrame();
 	ImGui_ImplWin32_NewFrame();
@@ -212,12 +267,232 @@ bool d3d11renderer::application::render(float deltaTime)
 				ImGui::Text("Fps:");
 				ImGui::SameLine();
 				ImGui::Text("%.2f", 1.0f / deltaTime);
-				ImGui::PlotLines("FPS", m_fpsHistory.data(), static_cast<int>(m_fpsHistory.size()), 0, nullptr, 0.0f, 100.0f, ImVec2(0, 80));
+				ImGui::PlotLines("FPS", m_fpsHistory, static_cast<int>(m_fpsHistoryCount), static_cast<int>(m_fpsHistoryOffset), nullptr, 0.0f, 100.0f, ImVec2(0, 80));
 
 
 				ImGui::Text("Video Card: %s", m_d3d->get_gpu_name().c_str());
 
 				ImGui::Text("Video Card Memory: %d MB", m_d3d->get_gpu_memory());
+
+				// Each mesh is stored once and drawn once per pass, however many nodes place it
+				const model* current = get_current_model();
+				ImGui::Text("Meshes: %zu, %zu instances, %.1f MB vertices", current->get_sub_meshes().size(), current->get_instance_count(),
+					static_cast<float>(current->get_vertex_bytes()) / (1024.0f * 1024.0f));
+
+				const char* importerNames[] = { "Assimp", "glTF" };
+				const auto& import = current->get_import_stats();
+				ImGui::Text("Mesh Import (%s): %zu meshes, %zu vertices, %zu indices (%.2f ms)", importerNames[static_cast<int>(import.importer)],
+					import.meshes, import.vertices, import.indices, import.milliseconds);
+				if (import.compressedBytes > 0)
+				{
+					ImGui::Text("Meshopt Decode: %.2f -> %.2f MB (%.2fx) in %.2f ms, %.2f GB/s", import.compressedBytes / 1048576.0,
+						import.decodedBytes / 1048576.0, static_cast<double>(import.decodedBytes) / import.compressedBytes, import.decodeMilliseconds,
+						import.decodeMilliseconds > 0.0 ? import.decodedBytes / (import.decodeMilliseconds * 1e6) : 0.0);
+				}
+
+				// Both importers read the current model's file again, geometry only
+				if (ImGui::Button("Compare Importers"))
+				{
+					m_importComparison = { current->time_import(model::Importer::Assimp), current->time_import(model::Importer::Gltf) };
+					m_rebuildFrame = m_frameIndex + 1;
+				}
+				for (const auto& run : m_importComparison)
+				{
+					ImGui::Text("%s: %zu vertices, %zu indices in %.2f ms", importerNames[static_cast<int>(run.importer)], run.vertices, run.indices, run.milliseconds);
+				}
+
+				const auto& batching = current->get_batch_stats();
+				ImGui::Text("Static Batching: %zu -> %zu draws, %zu submeshes merged (%.2f ms)", batching.drawsBefore, batching.drawsAfter,
+					batching.mergedSubMeshes, batching.milliseconds);
+
+				ImGui::Text("Frame Memory: %zu KB used, %zu KB peak, %zu KB reserved", m_frameArena->get_used() / 1024, m_frameArena->get_peak() / 1024,
+					m_frameArena->get_capacity() / 1024);
+				if (ALLOCATION_COUNTING)
+				{
+					ImGui::Text("Heap Allocations: %zu last frame", m_frameAllocations);
+				}
+				else
+				{
+					ImGui::Text("Heap Allocations: counted in debug builds");
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Textures"))
+			{
+				const model* current = get_current_model();
+				size_t sourceBytes = 0, compressedBytes = 0;
+
+				for (const auto& [name, tex] : current->get_textures())
+				{
+					const auto& report = tex->get_report();
+					sourceBytes += report.sourceBytes;
+					compressedBytes += report.compressedBytes;
+					// PSNR and encode time are only known on the run that cooked the texture
+					ImGui::Text("%s: %.2f dB, %.1f ms encode, %.1f ms load", name.c_str(), report.psnr, report.milliseconds, tex->get_load_milliseconds());
+				}
+
+				const auto& skyReport = m_skybox->get_report();
+				ImGui::Text("Skybox: %.2f dB, %.1f ms", skyReport.psnr, skyReport.milliseconds);
+				ImGui::Text("Scene Textures: %zu MB -> %zu MB", sourceBytes / (1024 * 1024), compressedBytes / (1024 * 1024));
+
+				// Same-size, same-format maps as Texture2DArray slices; draws whose materials then bind the same arrays could merge
+				const auto& packing = current->get_array_plan().get_report();
+				ImGui::Text("Texture Arrays: %zu for %zu textures, %zu with one slice (%.3f ms)", packing.arrayCount, packing.textureCount,
+					packing.singleSliceArrays, packing.milliseconds);
+				ImGui::Text("Materials: %zu -> %zu bindings", packing.materialCount, packing.bindingCount);
+				ImGui::Text("Draws: %zu, %zu material runs, %zu merged, %zu sorted by binding", packing.draws, packing.materialRuns,
+					packing.mergedDraws, packing.sortedMergedDraws);
+
+				const auto& streaming = m_textureStreamer->get_stats();
+				ImGui::Text("Streaming: %zu / %zu MB resident, %zu MB wanted", streaming.allocatedBytes / (1024 * 1024),
+					m_textureStreamer->get_settings().budgetBytes / (1024 * 1024), streaming.wantedBytes / (1024 * 1024));
+				ImGui::Text("Uploads: %zu KB this frame, %zu KB pending", streaming.uploadedBytes / 1024, streaming.pendingBytes / 1024);
+			}
+
+			if (ImGui::CollapsingHeader("Shaders"))
+			{
+				// Submeshes counts every loaded scene, draws only this frame's
+				for (uint32_t features = 0; features < material_features::PERMUTATION_COUNT; features++)
+				{
+					const auto& usage = m_lightShader->get_permutation_usage(features);
+					if (usage.subMeshes > 0 || usage.draws > 0)
+					{
+						ImGui::Text("%s: %u submeshes, %u material binds, %u draws", light_shader::get_permutation_name(features), usage.subMeshes,
+							usage.binds, usage.draws);
+					}
+				}
+
+				const auto cacheStats = m_shaderCache->get_stats();
+				ImGui::Text("Shader Cache: %zu compiled (%.0f ms), %zu from disk, %zu from memory", cacheStats.compiles, cacheStats.compileMilliseconds,
+					cacheStats.diskHits, cacheStats.memoryHits);
+			}
+
+			if (ImGui::CollapsingHeader("Lights"))
+			{
+				// Only Sponza has point and spot lights
+				int count = m_punctualLightCount;
+				for (int option : { 0, 1000, 10000, 50000 })
+				{
+					ImGui::RadioButton(m_frameArena->format("%d", option), &count, option);
+					ImGui::SameLine();
+				}
+				ImGui::NewLine();
+				if (count != m_punctualLightCount)
+				{
+					m_punctualLightCount = count;
+					generate_punctual_lights(*m_sponza, m_punctualLightCount);
+					m_rebuildFrame = m_frameIndex + 1;
+				}
+
+				const auto& clusterStats = m_lightClusters->get_stats();
+				const auto& clusterSettings = m_lightClusters->get_settings();
+				ImGui::Text("Clusters: %ux%ux%u", clusterSettings.tilesX, clusterSettings.tilesY, clusterSettings.slices);
+				ImGui::Text("Binning: %.3f ms for %zu lights", clusterStats.milliseconds, clusterStats.lightCount);
+				ImGui::Text("Light Indices: %zu, at most %u in one cluster, %zu over capacity", clusterStats.indexCount, clusterStats.maxLightsPerCluster,
+					clusterStats.droppedLights);
+			}
+
+			if (ImGui::CollapsingHeader("Shadows"))
+			{
+				cascade_settings settings = m_shadowCascades->get_settings();
+				int count = static_cast<int>(settings.count);
+				int resolution = static_cast<int>(settings.resolution);
+				bool changed = ImGui::SliderInt("Cascades", &count, 1, static_cast<int>(cascade_settings::MAX_CASCADES));
+				for (int option : { 512, 1024, 2048, 4096 })
+				{
+					changed |= ImGui::RadioButton(m_frameArena->format("%d", option), &resolution, option);
+					ImGui::SameLine();
+				}
+				ImGui::NewLine();
+				changed |= ImGui::SliderFloat("Split Lambda", &settings.splitLambda, 0.0f, 1.0f, "%.2f");
+				changed |= ImGui::SliderFloat("Shadow Distance", &settings.maxDistance, 10.0f, 1000.0f, "%.0f");
+				if (changed)
+				{
+					settings.count = static_cast<uint32_t>(count);
+					settings.resolution = static_cast<uint32_t>(resolution);
+					m_shadowCascades->set_settings(settings);
+					m_rebuildFrame = m_frameIndex + 1;
+				}
+
+				DirectX::XMFLOAT3 direction = m_light->get_direction();
+				if (ImGui::SliderFloat3("Sun Direction", &direction.x, -1.0f, 1.0f, "%.2f"))
+				{
+					m_light->set_direction(direction.x, direction.y, direction.z);
+				}
+
+				// What each cascade costs to render, to budget count and resolution against
+				const auto& subMeshes = get_current_model()->get_sub_meshes();
+				for (uint32_t i = 0; i < m_shadowCascades->get_cascade_count(); i++)
+				{
+					const auto& cascade = m_shadowCascades->get_cascade(i);
+					size_t triangles = 0;
+					for (uint32_t caster : cascade.casters)
+					{
+						triangles += static_cast<size_t>(subMeshes[caster].lods[subMeshes[caster].lod].indexCount / 3) * subMeshes[caster].instanceCount;
+					}
+					ImGui::Text("Cascade %u: to %.1f, %.3f per texel, %zu draws, %zu triangles", i, cascade.splitDepth, cascade.texelSize,
+						cascade.casters.size(), triangles);
+				}
+				ImGui::Text("Fit and Cull: %.3f ms", m_shadowCascades->get_milliseconds());
+			}
+
+			if (ImGui::CollapsingHeader("Depth Prepass"))
+			{
+				ImGui::Checkbox("Enabled", &m_depthPrepassEnabled);
+
+				// Lit pass pixel shader work in each mode, a few frames late; toggle to fill in the other one
+				ImGui::Text("PS Invocations with prepass: %llu", static_cast<unsigned long long>(m_depthPrepass->get_pixel_shader_invocations(true)));
+				ImGui::Text("PS Invocations without: %llu", static_cast<unsigned long long>(m_depthPrepass->get_pixel_shader_invocations(false)));
+			}
+
+			if (ImGui::CollapsingHeader("LOD"))
+			{
+				ImGui::Checkbox("Automatic LOD", &m_lodEnabled);
+				ImGui::SliderFloat("Pixel Error", &m_lodSettings.pixelError, 0.25f, 16.0f, "%.2f");
+				ImGui::SliderFloat("Hysteresis", &m_lodSettings.hysteresis, 0.0f, 0.9f, "%.2f");
+
+				const model* current = get_current_model();
+				ImGui::Text("Triangles Drawn: %zu of %zu", m_lodTriangles, current->get_lod_triangles(0));
+				for (int i = 0; i < model::MAX_LODS; i++)
+				{
+					ImGui::Text("LOD %d: %zu triangles, drawn for %zu submeshes", i, current->get_lod_triangles(i), m_lodDraws[i]);
+				}
+				ImGui::Text("Simplification: %.2f ms", current->get_lod_milliseconds());
+			}
+
+			if (ImGui::CollapsingHeader("Scene Graph"))
+			{
+				int scene = static_cast<int>(m_current_scene);
+				auto& controls = m_nodeControls[scene];
+				bool changed = ImGui::DragFloat3("Translation", &controls.translation.x, 0.1f);
+				changed |= ImGui::DragFloat3("Rotation", &controls.rotation.x, 1.0f, -180.0f, 180.0f, "%.0f");
+				changed |= ImGui::DragFloat("Scale", &controls.scale, 0.01f, 0.01f, 100.0f, "%.2f");
+				if (changed)
+				{
+					DirectX::XMFLOAT4 rotation;
+					DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationRollPitchYaw(DirectX::XMConvertToRadians(controls.rotation.x),
+						DirectX::XMConvertToRadians(controls.rotation.y), DirectX::XMConvertToRadians(controls.rotation.z)));
+					m_sceneGraph->set_translation(m_sceneNodes[scene], controls.translation.x, controls.translation.y, controls.translation.z);
+					m_sceneGraph->set_rotation(m_sceneNodes[scene], rotation.x, rotation.y, rotation.z, rotation.w);
+					m_sceneGraph->set_scale(m_sceneNodes[scene], controls.scale, controls.scale, controls.scale);
+				}
+
+				const auto& graphStats = m_sceneGraph->get_stats();
+				ImGui::Text("Nodes: %zu in %zu levels, %zu updated in %.3f ms", graphStats.nodeCount, graphStats.levelCount,
+					graphStats.updatedNodes, graphStats.milliseconds);
+
+				// A separate random graph, so the scene's own stays small
+				if (ImGui::Button("Benchmark 100k Nodes"))
+				{
+					run_scene_graph_benchmark();
+					m_rebuildFrame = m_frameIndex + 1;
+				}
+				const char* dirtyLabels[] = { "1%", "10%", "100%" };
+				for (size_t i = 0; i < m_sceneGraphBenchmark.size(); i++)
+				{
+					const auto& run = m_sceneGraphBenchmark[i];
+					ImGui::Text("%s dirty: %zu updated in %.3f ms, %zu levels", dirtyLabels[i], run.updatedNodes, run.milliseconds, run.levelCount);
+				}
 			}
 
 			if (ImGui::CollapsingHeader("Camera"))
@@ -243,25 +518,53 @@ bool d3d11renderer::application::render(float deltaTime)
 
 			if (ImGui::CollapsingHeader("Tone Map"))
 			{
-				ImGui::SliderFloat("Exposure", &exposure, 0.1f, 10.0f, "%.2f");
-
-				// Slider for Average Luminance
-				ImGui::SliderFloat("Average Luminance", &averageLuminance, 0.0f, 2.0f, "%.2f");
+				ImGui::SliderFloat("Exposure", &m_gradingSettings.exposure, 0.1f, 10.0f, "%.2f");
+
+				// Automatic exposure; the values shown reach the CPU a few frames late
+				ImGui::SliderFloat("Key Value", &m_exposureSettings.keyValue, 0.02f, 0.5f, "%.2f");
+				ImGui::DragFloatRange2("Log Luminance", &m_exposureSettings.minLogLuminance, &m_exposureSettings.maxLogLuminance, 0.1f, -16.0f, 16.0f, "%.1f");
+				ImGui::DragFloatRange2("Percentiles", &m_exposureSettings.lowPercentile, &m_exposureSettings.highPercentile, 0.005f, 0.0f, 1.0f, "%.3f");
+				ImGui::SliderFloat("Adapt Up", &m_exposureSettings.speedUp, 0.1f, 10.0f, "%.1f");
+				ImGui::SliderFloat("Adapt Down", &m_exposureSettings.speedDown, 0.1f, 10.0f, "%.1f");
+
+				const auto& exposureState = m_autoExposure->get_state();
+				ImGui::Text("Luminance: %.3f adapted, %.3f target, exposure %.3f", exposureState.adaptedLuminance, exposureState.targetLuminance, exposureState.exposure);
+
+				const auto& histogram = m_autoExposure->get_histogram();
+				float binCounts[luminance_histogram::BIN_COUNT];
+				for (uint32_t i = 0; i < luminance_histogram::BIN_COUNT; i++)
+				{
+					binCounts[i] = static_cast<float>(histogram[i]);
+				}
+				ImGui::PlotHistogram("Histogram", binCounts, luminance_histogram::BIN_COUNT, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 80));
 
-				// Slider for Max Luminance
-				ImGui::SliderFloat("Max Luminance", &maxLuminance, 0.1f, 10.0f, "%.2f");
+				// Grading after tone mapping, in the same pass
+				ImGui::SliderFloat("Saturation", &m_gradingSettings.saturation, 0.0f, 2.0f, "%.2f");
+				ImGui::SliderFloat("Contrast", &m_gradingSettings.contrast, 0.5f, 2.0f, "%.2f");
+				ImGui::ColorEdit3("Tint", m_gradingSettings.tint);
+				ImGui::SliderFloat("Gamma", &m_gradingSettings.gamma, 1.0f, 3.0f, "%.2f");
 
-				// Slider for Burn
-				ImGui::SliderFloat("Burn", &burn, 0.1f, 5.0f, "%.2f");
+				// Format of the multisampled scene target
+				int format = static_cast<int>(m_d3d->get_hdr_format());
+				ImGui::RadioButton("R11G11B10", &format, DXGI_FORMAT_R11G11B10_FLOAT);
+				ImGui::SameLine();
+				ImGui::RadioButton("R16G16B16A16", &format, DXGI_FORMAT_R16G16B16A16_FLOAT);
+				if (format != static_cast<int>(m_d3d->get_hdr_format()))
+				{
+					m_d3d->set_hdr_format(static_cast<DXGI_FORMAT>(format));
+					m_rebuildFrame = m_frameIndex + 1;
+				}
+				ImGui::Text("HDR Target: %.1f MB (MSAA, no resolve)", m_d3d->get_hdr_target_bytes() / (1024.0 * 1024.0));
 			}
 
 			if (ImGui::CollapsingHeader("Scene"))
 			{
 				for (int i = 0; i < 3; ++i) {
-					if (ImGui::Checkbox(("Scene " + std::to_string(i + 1)).c_str(), &m_scene_values[i])) {
+					if (ImGui::Checkbox(m_frameArena->format("Scene %d", i + 1), &m_scene_values[i])) {
 						// If this checkbox is checked, set it as the current scene
 						if (m_scene_values[i]) {
 							m_current_scene = static_cast<scene_state>(i);
+							m_rebuildFrame = m_frameIndex + 1;
 							// Uncheck all other checkboxes
 							for (int j = 0; j < 3; ++j) {
 								if (j != i) {
@@ -284,13 +587,310 @@ bool d3d11renderer::application::render(float deltaTime)
 	return true;
 }
 
+model* d3d11renderer::application::get_current_model() const
+{
+	switch (m_current_scene) {
+	case scene_state::DamagedHelmet:
+		return m_damagedHelmet.get();
+	case scene_state::ScifiHelmet:
+		return m_scifiHelmet.get();
+	case scene_state::Sponza:
+	default:
+		return m_sponza.get();
+	}
+}
+
+void d3d11renderer::application::register_streamed_textures(const model& sceneModel)
+{
+	for (const auto& [name, tex] : sceneModel.get_textures())
+	{
+		if (!tex)
+			continue;
+
+		tex->set_stream_id(m_textureStreamer->register_texture(tex->get_stream_desc()));
+		m_streamedTextures.push_back(tex);
+	}
+}
+
+void d3d11renderer::application::stream_textures(const model& current, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& projectionMatrix)
+{
+	DirectX::XMFLOAT4X4 projection;
+	DirectX::XMStoreFloat4x4(&projection, projectionMatrix);
+
+	// Pixels covered by one model unit facing the camera at distance 1; UV density is per model unit
+	float worldScale = world_scale(worldMatrix);
+	float pixelsPerUnit = projection._22 * m_d3d->get_viewport().Height * 0.5f * worldScale;
+	DirectX::XMFLOAT3 cameraPosition = m_camera->get_position();
+	DirectX::XMVECTOR eye = DirectX::XMLoadFloat3(&cameraPosition);
+
+	for (const auto& subMesh : current.get_sub_meshes())
+	{
+		// Distance to the nearest point of the bounding sphere
+		DirectX::XMVECTOR center = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&subMesh.boundsCenter), worldMatrix);
+		float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(center, eye)));
+		distance = std::max(distance - subMesh.boundsRadius * worldScale, SCREEN_NEAR);
+
+		for (const texture* tex : current.get_materials()[subMesh.materialId].textures)
+		{
+			if (tex)
+				m_textureStreamer->request(tex->get_stream_id(), subMesh.uvDensity, pixelsPerUnit / distance);
+		}
+	}
+
+	m_textureStreamer->update(m_streamingChanges);
+	for (const auto& change : m_streamingChanges)
+	{
+		m_streamedTextures[change.textureId]->apply_streaming(m_d3d->get_device(), m_d3d->get_device_context(), change);
+	}
+
+	// Changed textures have new views; any scene may own them, as the streamer evicts from all of them
+	if (!m_streamingChanges.empty())
+	{
+		m_sponza->refresh_materials();
+		m_damagedHelmet->refresh_materials();
+		m_scifiHelmet->refresh_materials();
+	}
+}
+
+void d3d11renderer::application::select_lods(model& current, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& projectionMatrix, frame_vector<draw_item>& draws)
+{
+	DirectX::XMFLOAT4X4 projection;
+	DirectX::XMStoreFloat4x4(&projection, projectionMatrix);
+
+	// Pixels covered by one model unit facing the camera at distance 1, grown by the scene node's scale
+	float worldScale = world_scale(worldMatrix);
+	float pixelsPerUnit = projection._22 * m_d3d->get_viewport().Height * 0.5f * worldScale;
+	DirectX::XMFLOAT3 cameraPosition = m_camera->get_position();
+	DirectX::XMVECTOR eye = DirectX::XMLoadFloat3(&cameraPosition);
+
+	std::fill(std::begin(m_lodDraws), std::end(m_lodDraws), size_t(0));
+	m_lodTriangles = 0;
+
+	const auto& subMeshes = current.get_sub_meshes();
+	for (size_t i = 0; i < subMeshes.size(); i++)
+	{
+		const auto& subMesh = subMeshes[i];
+		int lod = 0;
+		if (m_lodEnabled)
+		{
+			// Distance to the nearest point of the bounding sphere
+			DirectX::XMVECTOR center = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&subMesh.boundsCenter), worldMatrix);
+			float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(center, eye)));
+			distance = std::max(distance - subMesh.boundsRadius * worldScale, SCREEN_NEAR);
+
+			float errors[model::MAX_LODS];
+			for (int j = 0; j < subMesh.lodCount; j++)
+			{
+				errors[j] = subMesh.lods[j].error;
+			}
+			lod = static_cast<int>(mesh_simplifier::select_lod(errors, subMesh.lodCount, pixelsPerUnit / distance, subMesh.lod, m_lodSettings));
+		}
+		current.set_lod(i, lod);
+
+		const auto& range = subMesh.lods[subMesh.lod];
+		draws.push_back({ range.indexCount, range.startIndex, subMesh.instanceCount, subMesh.startInstance, subMesh.materialId });
+		m_lodDraws[subMesh.lod]++;
+		m_lodTriangles += static_cast<size_t>(range.indexCount / 3) * subMesh.instanceCount;
+	}
+}
+
+void d3d11renderer::application::generate_punctual_lights(const model& sceneModel, size_t count)
+{
+	// Box around every submesh of the scene
+	DirectX::XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const auto& subMesh : sceneModel.get_sub_meshes())
+	{
+		boundsMin.x = std::min(boundsMin.x, subMesh.boundsCenter.x - subMesh.boundsRadius);
+		boundsMin.y = std::min(boundsMin.y, subMesh.boundsCenter.y - subMesh.boundsRadius);
+		boundsMin.z = std::min(boundsMin.z, subMesh.boundsCenter.z - subMesh.boundsRadius);
+		boundsMax.x = std::max(boundsMax.x, subMesh.boundsCenter.x + subMesh.boundsRadius);
+		boundsMax.y = std::max(boundsMax.y, subMesh.boundsCenter.y + subMesh.boundsRadius);
+		boundsMax.z = std::max(boundsMax.z, subMesh.boundsCenter.z + subMesh.boundsRadius);
+	}
+
+	m_punctualLights.clear();
+	if (count == 0 || boundsMin.x > boundsMax.x)
+		return;
+
+	// Ranges follow the spacing between lights so each pixel sees about the same number whatever the count.
+	// The seed is fixed so benchmark runs compare the same layout.
+	float volume = (boundsMax.x - boundsMin.x) * (boundsMax.y - boundsMin.y) * (boundsMax.z - boundsMin.z);
+	float spacing = std::cbrt(volume / static_cast<float>(count));
+	std::mt19937 generator(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float x = boundsMin.x + unit(generator) * (boundsMax.x - boundsMin.x);
+		float y = boundsMin.y + unit(generator) * (boundsMax.y - boundsMin.y);
+		float z = boundsMin.z + unit(generator) * (boundsMax.z - boundsMin.z);
+		float range = spacing * (1.0f + unit(generator));
+		float r = 0.2f + unit(generator), g = 0.2f + unit(generator), b = 0.2f + unit(generator);
+
+		// One in four is a spot pointing down
+		if (i % 4 == 3)
+		{
+			m_punctualLights.add_spot(x, y, z, 0.0f, -1.0f, 0.0f, range * 2.0f, 0.3f, 0.6f, r * 2.0f, g * 2.0f, b * 2.0f);
+		}
+		else
+		{
+			m_punctualLights.add_point(x, y, z, range, r, g, b);
+		}
+	}
+}
+
+void d3d11renderer::application::update_light_clusters(const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix)
+{
+	DirectX::XMFLOAT4X4 view, projection;
+	DirectX::XMStoreFloat4x4(&view, viewMatrix);
+	DirectX::XMStoreFloat4x4(&projection, projectionMatrix);
+
+	static const punctual_lights noLights;
+	m_lightClusters->build(m_current_scene == scene_state::Sponza ? m_punctualLights : noLights, view.m, projection.m);
+
+	const auto& viewport = m_d3d->get_viewport();
+	m_lightShader->set_light_clusters(m_d3d->get_device(), m_d3d->get_device_context(), *m_lightClusters, viewport.Width, viewport.Height);
+}
+
+void d3d11renderer::application::render_shadows(model& current, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix)
+{
+	// Every submesh may cast; each cascade keeps the ones overlapping it
+	frame_vector<shadow_caster> casters(*m_frameArena, current.get_sub_meshes().size());
+	float worldScale = world_scale(worldMatrix);
+	for (const auto& subMesh : current.get_sub_meshes())
+	{
+		DirectX::XMFLOAT3 center;
+		DirectX::XMStoreFloat3(&center, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&subMesh.boundsCenter), worldMatrix));
+		casters.push_back({ { center.x, center.y, center.z }, subMesh.boundsRadius * worldScale });
+	}
+
+	DirectX::XMFLOAT4X4 view, projection;
+	DirectX::XMStoreFloat4x4(&view, viewMatrix);
+	DirectX::XMStoreFloat4x4(&projection, projectionMatrix);
+	DirectX::XMFLOAT3 direction = m_light->get_direction();
+	m_shadowCascades->update(view.m, projection.m, &direction.x, casters.data(), casters.size());
+
+	const auto& settings = m_shadowCascades->get_settings();
+	if (!m_shadowMap->resize(m_d3d->get_device(), settings.count, settings.resolution))
+		return;
+
+	ID3D11DeviceContext* deviceContext = m_d3d->get_device_context();
+	current.render_positions(deviceContext);
+	const auto& subMeshes = current.get_sub_meshes();
+	for (uint32_t i = 0; i < m_shadowCascades->get_cascade_count(); i++)
+	{
+		const auto& cascade = m_shadowCascades->get_cascade(i);
+		if (!m_shadowMap->begin_cascade(deviceContext, i, cascade, worldMatrix))
+			continue;
+
+		for (uint32_t caster : cascade.casters)
+		{
+			const auto& lod = subMeshes[caster].lods[subMeshes[caster].lod];
+			m_shadowMap->render(deviceContext, lod.indexCount, lod.startIndex, subMeshes[caster].instanceCount, subMeshes[caster].startInstance);
+		}
+	}
+
+	// Back to the scene's targets
+	m_d3d->set_depth(true);
+	m_d3d->reset_viewport();
+}
+
+void d3d11renderer::application::render_depth_prepass(model& current, const frame_vector<draw_item>& draws, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix)
+{
+	ID3D11DeviceContext* deviceContext = m_d3d->get_device_context();
+	if (!m_depthPrepass->begin(deviceContext, worldMatrix, viewMatrix, projectionMatrix))
+		return;
+
+	// Everything the renderer draws is opaque, so every submesh goes in
+	current.render_positions(deviceContext);
+	// The lit pass draws the same list, so the equal depth test sees the same LODs
+	for (const draw_item& draw : draws)
+	{
+		m_depthPrepass->render(deviceContext, draw.indexCount, draw.startIndex, draw.instanceCount, draw.startInstance);
+	}
+}
+
+void d3d11renderer::application::run_scene_graph_benchmark()
+{
+	constexpr size_t NODE_COUNT = 100000;
+	constexpr int ITERATIONS = 10;
+
+	// Each node hangs off a random earlier one, which gives a wide tree a few dozen levels deep
+	std::mt19937 generator(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	scene_graph graph;
+	graph.reserve(NODE_COUNT);
+	for (size_t i = 1; i < NODE_COUNT; i++)
+	{
+		graph.add_node(std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(i - 1))(generator));
+	}
+
+	auto randomize = [&](uint32_t node)
+	{
+		DirectX::XMFLOAT4 rotation;
+		DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationRollPitchYaw(unit(generator), unit(generator), unit(generator)));
+		graph.set_translation(node, unit(generator), unit(generator), unit(generator));
+		graph.set_rotation(node, rotation.x, rotation.y, rotation.z, rotation.w);
+		graph.set_scale(node, 1.0f, 1.0f, 1.0f);
+	};
+	for (uint32_t node = 0; node < NODE_COUNT; node++)
+	{
+		randomize(node);
+	}
+	// The first update also sorts the levels, which the timed runs shouldn't pay for
+	graph.update();
+
+	m_sceneGraphBenchmark.clear();
+	std::uniform_int_distribution<uint32_t> anyNode(0, static_cast<uint32_t>(NODE_COUNT - 1));
+	for (double fraction : { 0.01, 0.1, 1.0 })
+	{
+		scene_graph_stats average;
+		for (int iteration = 0; iteration < ITERATIONS; iteration++)
+		{
+			size_t dirtyCount = static_cast<size_t>(fraction * NODE_COUNT);
+			for (size_t i = 0; i < dirtyCount; i++)
+			{
+				randomize(dirtyCount == NODE_COUNT ? static_cast<uint32_t>(i) : anyNode(generator));
+			}
+			graph.update();
+			average.updatedNodes += graph.get_stats().updatedNodes;
+			average.milliseconds += graph.get_stats().milliseconds;
+		}
+		average.nodeCount = graph.get_stats().nodeCount;
+		average.levelCount = graph.get_stats().levelCount;
+		average.updatedNodes /= ITERATIONS;
+		average.milliseconds /= ITERATIONS;
+		m_sceneGraphBenchmark.push_back(average);
+	}
+}
+
 void d3d11renderer::application::update_fps_plot(float deltaTime)
 {
 	float fps = (deltaTime > 0.0f) ? (1.0f / deltaTime) : 0.0f;
 
-	// Store FPS in history
-	m_fpsHistory.push_back(fps);
-	if (m_fpsHistory.size() > 100) {
-		m_fpsHistory.erase(m_fpsHistory.begin()); // Maintain the last 100 FPS values
+	// Store FPS in history; once full, the newest overwrites the oldest and the plot starts after it
+	if (m_fpsHistoryCount < FPS_HISTORY) {
+		m_fpsHistory[m_fpsHistoryCount++] = fps;
+	}
+	else {
+		m_fpsHistory[m_fpsHistoryOffset] = fps;
+		m_fpsHistoryOffset = (m_fpsHistoryOffset + 1) % FPS_HISTORY;
+	}
+}
+
+void d3d11renderer::application::check_frame_allocations(size_t allocations)
+{
+	// Kept containers reach their size during warm-up; after that any frame that allocates is a bug, except when a UI
+	// action rebuilt lights, shadow maps or targets. The UI runs after the scene, so the next frame uses what it rebuilt.
+	// Streaming reuses storage sized when the textures were registered
+	constexpr uint64_t WARMUP_FRAMES = 120;
+
+	m_frameIndex++;
+	m_frameAllocations = allocations;
+	bool steady = m_frameIndex > WARMUP_FRAMES && m_frameIndex > m_rebuildFrame + 1;
+	if (ALLOCATION_COUNTING && steady && allocations > 0)
+	{
+		OutputDebugStringA(m_frameArena->format("Frame %llu made %zu heap allocations\n", static_cast<unsigned long long>(m_frameIndex), allocations));
+		assert(!"Steady-state frames should not allocate");
 	}
 }
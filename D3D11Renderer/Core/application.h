@@ -10,12 +10,23 @@
 #include "light_shader.h"
 #include "light.h"
 #include "skybox.h"
-#include "reinhard_shader.h"
+#include "auto_exposure.h"
+#include "post_process.h"
+#include "texture_streamer.h"
+#include "shader_cache.h"
+#include "light_clusters.h"
+#include "shadow_map.h"
+#include "depth_prepass.h"
+#include "scene_graph.h"
+#include "mesh_simplifier.h"
+#include "frame_arena.h"
 
 constexpr bool FULL_SCREEN = false;
 constexpr bool VSYNC_ENABLED = true;
 constexpr float SCREEN_DEPTH = 1000.0f;
 constexpr float SCREEN_NEAR = 0.3f;
+// Encoder tier for cooked material textures; Normal and Slow search harder and take longer on the first run
+constexpr d3d11renderer::compression_quality TEXTURE_QUALITY = d3d11renderer::compression_quality::Fast;
 
 namespace d3d11renderer 
 {
@@ -26,6 +37,20 @@ namespace d3d11renderer
 			DamagedHelmet,
 			ScifiHelmet
 		};
+		// What the Scene Graph panel edits for each scene's node; rotation in degrees
+		struct node_controls {
+			DirectX::XMFLOAT3 translation = { 0.0f, 0.0f, 0.0f };
+			DirectX::XMFLOAT3 rotation = { 0.0f, 0.0f, 0.0f };
+			float scale = 1.0f;
+		};
+		// One submesh at the LOD picked for it this frame; the depth prepass and the lit pass draw the same list
+		struct draw_item {
+			int indexCount;
+			int startIndex;
+			int instanceCount;
+			int startInstance;
+			uint16_t materialId;
+		};
 	public:
 		application(int, int, HWND, std::shared_ptr<d3d11renderer::input>);
 		~application();
@@ -37,18 +62,59 @@ namespace d3d11renderer
 	private:
 		bool render(float);
 		void update_fps_plot(float deltaTime);
+		model* get_current_model() const;
+		void register_streamed_textures(const model& sceneModel);
+		void stream_textures(const model& current, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& projectionMatrix);
+		// Picks each submesh's LOD from how many pixels its error covers; every pass draws the one picked
+		void select_lods(model& current, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& projectionMatrix, frame_vector<draw_item>& draws);
+		void generate_punctual_lights(const model& sceneModel, size_t count);
+		void update_light_clusters(const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix);
+		void render_shadows(model& current, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix);
+		void render_depth_prepass(model& current, const frame_vector<draw_item>& draws, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix);
+		// Debug builds check that a frame, once warmed up, makes no heap allocations
+		void check_frame_allocations(size_t allocations);
+		void run_scene_graph_benchmark();
 	private:
 		std::shared_ptr<d3d11renderer::d3dclass> m_d3d;
+		std::shared_ptr<shader_cache> m_shaderCache;
 		std::shared_ptr<camera> m_camera;
 		std::shared_ptr<model> m_sponza;
 		std::shared_ptr<model> m_damagedHelmet;
 		std::shared_ptr<model> m_scifiHelmet;
-		std::shared_ptr<model> m_sphere;
 		std::shared_ptr<light> m_light;
 		std::shared_ptr<light_shader> m_lightShader;
+		std::shared_ptr<light_clusters> m_lightClusters;
+		punctual_lights m_punctualLights;  // Scattered through Sponza
+		int m_punctualLightCount;
+		std::shared_ptr<shadow_cascades> m_shadowCascades;
+		std::shared_ptr<shadow_map> m_shadowMap;
+		std::shared_ptr<depth_prepass> m_depthPrepass;
+		bool m_depthPrepassEnabled;
+		bool m_lodEnabled;
+		lod_settings m_lodSettings;
+		size_t m_lodDraws[model::MAX_LODS];  // Submeshes drawn at each LOD last frame
+		size_t m_lodTriangles;
+		std::vector<model::ImportStats> m_importComparison;  // Assimp, then glTF, on the current model
 		std::shared_ptr<skybox> m_skybox;
-		std::shared_ptr<reinhard_shader> m_reinhardShader;
-		std::vector<float> m_fpsHistory;
+		std::shared_ptr<auto_exposure> m_autoExposure;
+		exposure_settings m_exposureSettings;
+		std::shared_ptr<post_process> m_postProcess;
+		post_process::GradingSettings m_gradingSettings;
+		std::shared_ptr<texture_streamer> m_textureStreamer;
+		std::vector<std::shared_ptr<texture>> m_streamedTextures;  // Indexed by stream id
+		std::vector<streaming_change> m_streamingChanges;
+		static constexpr size_t FPS_HISTORY = 100;
+		float m_fpsHistory[FPS_HISTORY];  // Ring buffer; m_fpsHistoryOffset is the oldest value once it is full
+		size_t m_fpsHistoryCount;
+		size_t m_fpsHistoryOffset;
+		std::shared_ptr<frame_arena> m_frameArena;  // Reset at the start of every frame
+		uint64_t m_frameIndex;
+		size_t m_frameAllocations;                  // Heap allocations made by the last frame
+		uint64_t m_rebuildFrame;                    // Last frame a UI action rebuilt something on
+		std::shared_ptr<scene_graph> m_sceneGraph;
+		uint32_t m_sceneNodes[3];  // Indexed by scene_state
+		node_controls m_nodeControls[3];
+		std::vector<scene_graph_stats> m_sceneGraphBenchmark;  // 1%, 10% and 100% of the nodes dirty
 		scene_state m_current_scene;
 		bool m_scene_values[3];
 	};
@@ -0,0 +1,213 @@
+#include "auto_exposure.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+using d3d11renderer::luminance_histogram;
+
+auto_exposure::auto_exposure(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache)
+	: m_frame(0), m_histogram(), m_state()
+{
+	create_resources(device, shaderCache);
+}
+
+auto_exposure::~auto_exposure()
+{
+}
+
+bool auto_exposure::begin_frame(ID3D11DeviceContext* deviceContext, float deltaTime, const d3d11renderer::exposure_settings& settings)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result = deviceContext->Map(m_paramsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	ExposureParamsType* dataPtr = (ExposureParamsType*)mappedResource.pData;
+	dataPtr->minLogLuminance = settings.minLogLuminance;
+	dataPtr->logLuminanceRange = settings.maxLogLuminance - settings.minLogLuminance;
+	dataPtr->lowPercentile = settings.lowPercentile;
+	dataPtr->highPercentile = settings.highPercentile;
+	dataPtr->speedUp = settings.speedUp;
+	dataPtr->speedDown = settings.speedDown;
+	dataPtr->deltaTime = deltaTime;
+	dataPtr->keyValue = settings.keyValue;
+	deviceContext->Unmap(m_paramsBuffer.Get(), 0);
+
+	const UINT zeros[4] = { 0, 0, 0, 0 };
+	deviceContext->ClearUnorderedAccessViewUint(m_histogramUAV.Get(), zeros);
+	return true;
+}
+
+void auto_exposure::adapt(ID3D11DeviceContext* deviceContext)
+{
+	ID3D11ShaderResourceView* nullSRV = nullptr;
+	ID3D11UnorderedAccessView* nullUAV = nullptr;
+
+	// Average and adaptation in a single group
+	deviceContext->CSSetShader(m_exposureShader.Get(), nullptr, 0);
+	deviceContext->CSSetConstantBuffers(2, 1, m_paramsBuffer.GetAddressOf());
+	deviceContext->CSSetShaderResources(0, 1, m_histogramSRV.GetAddressOf());
+	deviceContext->CSSetUnorderedAccessViews(0, 1, m_stateUAV.GetAddressOf(), nullptr);
+	deviceContext->Dispatch(1, 1, 1);
+	deviceContext->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+	deviceContext->CSSetShaderResources(0, 1, &nullSRV);
+	deviceContext->CSSetShader(nullptr, nullptr, 0);
+
+	// GPU to GPU, so next frame's post constants are ready without the CPU seeing them
+	deviceContext->CopyResource(m_exposureBuffer.Get(), m_stateBuffer.Get());
+
+	read_back(deviceContext);
+}
+
+ID3D11Buffer* auto_exposure::get_exposure_buffer() const
+{
+	return m_exposureBuffer.Get();
+}
+
+ID3D11Buffer* auto_exposure::get_params_buffer() const
+{
+	return m_paramsBuffer.Get();
+}
+
+ID3D11UnorderedAccessView* auto_exposure::get_histogram_uav() const
+{
+	return m_histogramUAV.Get();
+}
+
+const luminance_histogram::bins& auto_exposure::get_histogram() const
+{
+	return m_histogram;
+}
+
+const d3d11renderer::exposure_state& auto_exposure::get_state() const
+{
+	return m_state;
+}
+
+void auto_exposure::read_back(ID3D11DeviceContext* deviceContext)
+{
+	size_t slot = m_frame % READBACK_LATENCY;
+	deviceContext->CopyResource(m_histogramReadback[slot].Get(), m_histogramBuffer.Get());
+	deviceContext->CopyResource(m_stateReadback[slot].Get(), m_stateBuffer.Get());
+	m_frame++;
+
+	if (m_frame < READBACK_LATENCY)
+	{
+		return;
+	}
+
+	// The oldest copy should have landed by now; if not, try again next frame rather than wait
+	size_t oldest = m_frame % READBACK_LATENCY;
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (SUCCEEDED(deviceContext->Map(m_histogramReadback[oldest].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedResource)))
+	{
+		memcpy(m_histogram.data(), mappedResource.pData, sizeof(m_histogram));
+		deviceContext->Unmap(m_histogramReadback[oldest].Get(), 0);
+	}
+	if (SUCCEEDED(deviceContext->Map(m_stateReadback[oldest].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedResource)))
+	{
+		memcpy(&m_state, mappedResource.pData, sizeof(m_state));
+		deviceContext->Unmap(m_stateReadback[oldest].Get(), 0);
+	}
+}
+
+void auto_exposure::create_resources(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache)
+{
+	std::vector<uint8_t> csBlob;
+	std::string errors;
+	HRESULT result;
+
+	if (!shaderCache.get({ L"Shaders/exposurecs.hlsl", "main", "cs_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS }, csBlob, errors)) {
+		throw std::runtime_error("Failed to compile the exposure shader. " + errors);
+	}
+	result = device->CreateComputeShader(csBlob.data(), csBlob.size(), nullptr, m_exposureShader.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the exposure shader.");
+	}
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.ByteWidth = sizeof(ExposureParamsType);
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	result = device->CreateBuffer(&bufferDesc, nullptr, m_paramsBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the exposure parameter buffer.");
+	}
+
+	// Raw buffers so the histogram is bound as a UAV for counting and an SRV for reducing
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.ByteWidth = sizeof(luminance_histogram::bins);
+	bufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.CPUAccessFlags = 0;
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	result = device->CreateBuffer(&bufferDesc, nullptr, m_histogramBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the histogram buffer.");
+	}
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.NumElements = luminance_histogram::BIN_COUNT;
+	uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+	result = device->CreateUnorderedAccessView(m_histogramBuffer.Get(), &uavDesc, m_histogramUAV.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the histogram UAV.");
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+	srvDesc.BufferEx.NumElements = luminance_histogram::BIN_COUNT;
+	srvDesc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+	result = device->CreateShaderResourceView(m_histogramBuffer.Get(), &srvDesc, m_histogramSRV.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the histogram SRV.");
+	}
+
+	// Starts zeroed, which the exposure pass reads as "no previous frame"
+	d3d11renderer::exposure_state initialState;
+	D3D11_SUBRESOURCE_DATA initialData = { &initialState, 0, 0 };
+	bufferDesc.ByteWidth = sizeof(d3d11renderer::exposure_state);
+	bufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	result = device->CreateBuffer(&bufferDesc, &initialData, m_stateBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the exposure state buffer.");
+	}
+
+	uavDesc.Buffer.NumElements = sizeof(d3d11renderer::exposure_state) / 4;
+	result = device->CreateUnorderedAccessView(m_stateBuffer.Get(), &uavDesc, m_stateUAV.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the exposure state UAV.");
+	}
+
+	// Same bytes as a constant buffer, the copy destination
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.MiscFlags = 0;
+	result = device->CreateBuffer(&bufferDesc, &initialData, m_exposureBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the exposure constant buffer.");
+	}
+
+	bufferDesc.Usage = D3D11_USAGE_STAGING;
+	bufferDesc.BindFlags = 0;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	for (size_t i = 0; i < READBACK_LATENCY; i++)
+	{
+		bufferDesc.ByteWidth = sizeof(luminance_histogram::bins);
+		result = device->CreateBuffer(&bufferDesc, nullptr, m_histogramReadback[i].GetAddressOf());
+		if (FAILED(result)) {
+			throw std::runtime_error("Failed to create the histogram readback buffer.");
+		}
+
+		bufferDesc.ByteWidth = sizeof(d3d11renderer::exposure_state);
+		result = device->CreateBuffer(&bufferDesc, nullptr, m_stateReadback[i].GetAddressOf());
+		if (FAILED(result)) {
+			throw std::runtime_error("Failed to create the exposure readback buffer.");
+		}
+	}
+}
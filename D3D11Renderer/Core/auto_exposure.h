@@ -0,0 +1,70 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <array>
+#include "shader_cache.h"
+#include "luminance_histogram.h"
+
+// Histogram auto exposure, entirely on the GPU.
+// The post pass bins the log luminance of the HDR scene at half resolution into a small UAV while it tone maps, then a
+// single group reduces it to a percentile-clamped average and adapts the exposure towards it. The result is copied into
+// a constant buffer the post pass binds directly, so the CPU never waits on it, and the frame is exposed with the
+// previous frame's value. The readback below is a few frames late and only for display.
+class auto_exposure
+{
+private:
+	struct ExposureParamsType
+	{
+		float minLogLuminance;
+		float logLuminanceRange;
+		float lowPercentile;
+		float highPercentile;
+		float speedUp;
+		float speedDown;
+		float deltaTime;
+		float keyValue;
+	};
+
+	// Frames between a copy to a staging buffer and mapping it
+	static constexpr size_t READBACK_LATENCY = 3;
+
+public:
+	auto_exposure(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache);
+	~auto_exposure();
+
+	// Uploads this frame's parameters and clears the histogram, before the post pass fills it
+	bool begin_frame(ID3D11DeviceContext* deviceContext, float deltaTime, const d3d11renderer::exposure_settings& settings);
+	// Reduces the histogram and adapts, after the post pass
+	void adapt(ID3D11DeviceContext* deviceContext);
+
+	// d3d11renderer::exposure_state as a constant buffer
+	ID3D11Buffer* get_exposure_buffer() const;
+	ID3D11Buffer* get_params_buffer() const;
+	ID3D11UnorderedAccessView* get_histogram_uav() const;
+
+	// Latest results that reached the CPU without stalling
+	const d3d11renderer::luminance_histogram::bins& get_histogram() const;
+	const d3d11renderer::exposure_state& get_state() const;
+
+private:
+	void create_resources(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache);
+	void read_back(ID3D11DeviceContext* deviceContext);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader> m_exposureShader;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_paramsBuffer;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_histogramBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_histogramUAV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_histogramSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_stateBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_stateUAV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_exposureBuffer;
+
+	std::array<Microsoft::WRL::ComPtr<ID3D11Buffer>, READBACK_LATENCY> m_histogramReadback;
+	std::array<Microsoft::WRL::ComPtr<ID3D11Buffer>, READBACK_LATENCY> m_stateReadback;
+	size_t m_frame;
+	d3d11renderer::luminance_histogram::bins m_histogram;
+	d3d11renderer::exposure_state m_state;
+};
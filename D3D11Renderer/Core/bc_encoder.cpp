@@ -0,0 +1,232 @@
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+	// Pulls one 8-bit channel out of 4 RGBA8 pixels as floats.
+	inline __m128 extract_channel(__m128i pixels, int channel)
+	{
+		__m128i shifted = _mm_srl_epi32(pixels, _mm_cvtsi32_si128(channel * 8));
+		return _mm_cvtepi32_ps(_mm_and_si128(shifted, _mm_set1_epi32(0xFF)));
+	}
+
+	inline float horizontal_min(__m128 v)
+	{
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+
+	inline float horizontal_max(__m128 v)
+	{
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+
+	inline float horizontal_sum(__m128 v)
+	{
+		v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+
+	// One channel of a block, a row of 4 texels per register.
+	struct block_channel
+	{
+		__m128 rows[4];
+
+		float min() const
+		{
+			return horizontal_min(_mm_min_ps(_mm_min_ps(rows[0], rows[1]), _mm_min_ps(rows[2], rows[3])));
+		}
+
+		float max() const
+		{
+			return horizontal_max(_mm_max_ps(_mm_max_ps(rows[0], rows[1]), _mm_max_ps(rows[2], rows[3])));
+		}
+
+		float sum() const
+		{
+			return horizontal_sum(_mm_add_ps(_mm_add_ps(rows[0], rows[1]), _mm_add_ps(rows[2], rows[3])));
+		}
+	};
+
+	block_channel load_channel(const uint8_t* pixels, int channel)
+	{
+		block_channel result;
+		for (int row = 0; row < 4; row++)
+		{
+			__m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + row * 16));
+			result.rows[row] = extract_channel(texels, channel);
+		}
+		return result;
+	}
+
+	// Rounds each lane of (value - base) * scale to an integer in [0, maxStep].
+	inline __m128i quantize(__m128 value, __m128 base, __m128 scale, float maxStep)
+	{
+		__m128 steps = _mm_mul_ps(_mm_sub_ps(value, base), scale);
+		steps = _mm_min_ps(_mm_max_ps(steps, _mm_setzero_ps()), _mm_set1_ps(maxStep));
+		return _mm_cvtps_epi32(steps);
+	}
+
+	uint64_t encode_bc4(const block_channel& channel)
+	{
+		// Step 0 is the low endpoint (index 1), step 7 the high endpoint (index 0).
+		static const uint64_t stepToIndex[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+		float low = channel.min();
+		float high = channel.max();
+
+		uint64_t block = static_cast<uint64_t>(high) | (static_cast<uint64_t>(low) << 8);
+
+		// A flat block decodes every index-0 texel to the first endpoint.
+		if (high == low)
+		{
+			return block;
+		}
+
+		__m128 base = _mm_set1_ps(low);
+		__m128 scale = _mm_set1_ps(7.0f / (high - low));
+
+		alignas(16) int steps[16];
+		for (int row = 0; row < 4; row++)
+		{
+			_mm_store_si128(reinterpret_cast<__m128i*>(steps + row * 4), quantize(channel.rows[row], base, scale, 7.0f));
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			block |= stepToIndex[steps[i]] << (16 + 3 * i);
+		}
+
+		return block;
+	}
+
+	inline uint16_t pack_565(float r, float g, float b)
+	{
+		int r5 = static_cast<int>(r * (31.0f / 255.0f) + 0.5f);
+		int g6 = static_cast<int>(g * (63.0f / 255.0f) + 0.5f);
+		int b5 = static_cast<int>(b * (31.0f / 255.0f) + 0.5f);
+		return static_cast<uint16_t>((r5 << 11) | (g6 << 5) | b5);
+	}
+
+	inline void unpack_565(uint16_t color, float* rgb)
+	{
+		int r5 = (color >> 11) & 31;
+		int g6 = (color >> 5) & 63;
+		int b5 = color & 31;
+		rgb[0] = static_cast<float>((r5 << 3) | (r5 >> 2));
+		rgb[1] = static_cast<float>((g6 << 2) | (g6 >> 4));
+		rgb[2] = static_cast<float>((b5 << 3) | (b5 >> 2));
+	}
+}
+
+void d3d11renderer::encode_bc1_block(const uint8_t* pixels, uint8_t* block)
+{
+	// Step 0 is the second endpoint (index 1), step 3 the first endpoint (index 0).
+	static const uint32_t stepToIndex[4] = { 1, 3, 2, 0 };
+
+	block_channel channels[3] = { load_channel(pixels, 0), load_channel(pixels, 1), load_channel(pixels, 2) };
+
+	float low[3], high[3], mean[3];
+	int primary = 0;
+	for (int c = 0; c < 3; c++)
+	{
+		low[c] = channels[c].min();
+		high[c] = channels[c].max();
+		mean[c] = channels[c].sum() / 16.0f;
+		if (high[c] - low[c] > high[primary] - low[primary])
+			primary = c;
+	}
+
+	// Pick the bounding-box diagonal that follows the colors: flip any channel
+	// that is anti-correlated with the channel of largest extent.
+	float start[3], end[3];
+	__m128 primaryMean = _mm_set1_ps(mean[primary]);
+	for (int c = 0; c < 3; c++)
+	{
+		start[c] = high[c];
+		end[c] = low[c];
+
+		if (c == primary)
+			continue;
+
+		__m128 channelMean = _mm_set1_ps(mean[c]);
+		__m128 covariance = _mm_setzero_ps();
+		for (int row = 0; row < 4; row++)
+		{
+			covariance = _mm_add_ps(covariance, _mm_mul_ps(_mm_sub_ps(channels[c].rows[row], channelMean), _mm_sub_ps(channels[primary].rows[row], primaryMean)));
+		}
+
+		if (horizontal_sum(covariance) < 0.0f)
+			std::swap(start[c], end[c]);
+	}
+
+	// Inset the endpoints by 1/16 of the range; the extremes are rarely worth spending a palette entry on.
+	for (int c = 0; c < 3; c++)
+	{
+		float inset = (start[c] - end[c]) / 16.0f;
+		start[c] -= inset;
+		end[c] += inset;
+	}
+
+	uint16_t color0 = pack_565(start[0], start[1], start[2]);
+	uint16_t color1 = pack_565(end[0], end[1], end[2]);
+	uint32_t indices = 0;
+
+	// color0 > color1 selects the opaque 4-color palette.
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	if (color0 != color1)
+	{
+		float endpoint0[3], endpoint1[3];
+		unpack_565(color0, endpoint0);
+		unpack_565(color1, endpoint1);
+
+		float axis[3] = { endpoint0[0] - endpoint1[0], endpoint0[1] - endpoint1[1], endpoint0[2] - endpoint1[2] };
+		float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+		// Project every texel onto the endpoint axis and round to the nearest of the 4 palette steps.
+		__m128 scale = _mm_set1_ps(3.0f / lengthSq);
+		__m128 base = _mm_set1_ps(axis[0] * endpoint1[0] + axis[1] * endpoint1[1] + axis[2] * endpoint1[2]);
+
+		alignas(16) int steps[16];
+		for (int row = 0; row < 4; row++)
+		{
+			__m128 projection = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(channels[0].rows[row], _mm_set1_ps(axis[0])),
+				_mm_mul_ps(channels[1].rows[row], _mm_set1_ps(axis[1]))),
+				_mm_mul_ps(channels[2].rows[row], _mm_set1_ps(axis[2])));
+			_mm_store_si128(reinterpret_cast<__m128i*>(steps + row * 4), quantize(projection, base, scale, 3.0f));
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			indices |= stepToIndex[steps[i]] << (2 * i);
+		}
+	}
+
+	std::memcpy(block, &color0, 2);
+	std::memcpy(block + 2, &color1, 2);
+	std::memcpy(block + 4, &indices, 4);
+}
+
+void d3d11renderer::encode_bc4_block(const uint8_t* pixels, int channel, uint8_t* block)
+{
+	uint64_t encoded = encode_bc4(load_channel(pixels, channel));
+	std::memcpy(block, &encoded, 8);
+}
+
+void d3d11renderer::encode_bc5_block(const uint8_t* pixels, uint8_t* block)
+{
+	encode_bc4_block(pixels, 0, block);
+	encode_bc4_block(pixels, 1, block + 8);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace d3d11renderer
+{
+	// SSE2 encoders for the block formats where a bounding-box endpoint fit is good enough.
+	// Each one reads a single 4x4 block of RGBA8 pixels stored as 4 rows of 16 bytes.
+
+	// 8 bytes, RGB565 endpoints and 2-bit indices. Always uses the opaque 4-color mode.
+	void encode_bc1_block(const uint8_t* pixels, uint8_t* block);
+
+	// 8 bytes, one channel (0 = R ... 3 = A) with 8-bit endpoints and 3-bit indices.
+	void encode_bc4_block(const uint8_t* pixels, int channel, uint8_t* block);
+
+	// 16 bytes, a BC4 block for red followed by one for green.
+	void encode_bc5_block(const uint8_t* pixels, uint8_t* block);
+}
@@ -4,7 +4,9 @@
 #include <d3dcompiler.h>
 #include <directxmath.h>
 #include <fstream>
+#include <string>
 #include <wrl/client.h>
+#include "shader_cache.h"
 
 class color_shader
 {
@@ -24,12 +26,12 @@ public:
 	bool render(ID3D11DeviceContext* deviceContext, int indexCount, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix,
 		DirectX::XMMATRIX projectionMatrix);
 private:
-	void output_shader_error_message(ID3D10Blob*, HWND, WCHAR*);
+	void output_shader_error_message(const std::string&, HWND, WCHAR*);
 
 	bool set_shader_parameters(ID3D11DeviceContext* deviceContext, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix,
 		DirectX::XMMATRIX projectionMatrix);
 	void render_shader(ID3D11DeviceContext* deviceContext, int indexCount);
-	bool initialize_shader(ID3D11Device*, HWND, WCHAR*, WCHAR*);
+	bool initialize_shader(ID3D11Device*, HWND, WCHAR*, WCHAR*, d3d11renderer::shader_cache&);
 
 
 private:
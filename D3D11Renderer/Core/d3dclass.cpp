@@ -112,10 +112,11 @@ d3d11renderer::d3dclass::d3dclass(int screenWidth, int screenHeight, bool vsync,
 		swapChainDesc.BufferDesc.RefreshRate.Denominator = 1;
 	}
 
-	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	// Single sample and UAV-capable: the post pass resolves the scene itself and writes the back buffer from a compute shader
+	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT | DXGI_USAGE_UNORDERED_ACCESS;
 	swapChainDesc.OutputWindow = hwnd;
-	swapChainDesc.SampleDesc.Count = 4;
-	swapChainDesc.SampleDesc.Quality = 1;
+	swapChainDesc.SampleDesc.Count = 1;
+	swapChainDesc.SampleDesc.Quality = 0;
 	swapChainDesc.Windowed = !fullscreen;
 	swapChainDesc.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
 	swapChainDesc.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
@@ -139,6 +140,10 @@ d3d11renderer::d3dclass::d3dclass(int screenWidth, int screenHeight, bool vsync,
 	result = m_device->CreateRenderTargetView(backBufferPtr.Get(), nullptr, m_renderTargetView.GetAddressOf());
 	if (FAILED(result))
 		throw std::runtime_error("Failed to create render target view");
+
+	result = m_device->CreateUnorderedAccessView(backBufferPtr.Get(), nullptr, m_backBufferUAV.GetAddressOf());
+	if (FAILED(result))
+		throw std::runtime_error("Failed to create back buffer UAV");
 	ZeroMemory(&depthBufferDesc, sizeof(depthBufferDesc));
 
 	// Set up the description of the depth buffer.
@@ -148,7 +153,7 @@ d3d11renderer::d3dclass::d3dclass(int screenWidth, int screenHeight, bool vsync,
 	depthBufferDesc.ArraySize = 1;
 	depthBufferDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	depthBufferDesc.SampleDesc.Count = 4;
-	depthBufferDesc.SampleDesc.Quality = 1;
+	depthBufferDesc.SampleDesc.Quality = 0;
 	depthBufferDesc.Usage = D3D11_USAGE_DEFAULT;
 	depthBufferDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
 	depthBufferDesc.CPUAccessFlags = 0;
@@ -183,9 +188,10 @@ d3d11renderer::d3dclass::d3dclass(int screenWidth, int screenHeight, bool vsync,
 	if (FAILED(result))
 		throw std::runtime_error("Failed to create depth stencil state");
 
-	depthStencilDesc.DepthEnable = false;
+	// The sky is drawn last at the far plane: it shows only where nothing else wrote depth, and writes none itself
+	depthStencilDesc.DepthEnable = true;
 	depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
-	depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS;
+	depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
 
 	depthStencilDesc.StencilEnable = false;
 	depthStencilDesc.StencilReadMask = 0xFF;
@@ -195,6 +201,13 @@ d3d11renderer::d3dclass::d3dclass(int screenWidth, int screenHeight, bool vsync,
 	if (FAILED(result))
 		throw std::runtime_error("Failed to create sky depth stencil state");
 
+	// Lit pass after a depth prepass: only the surface the prepass kept passes, and depth is already final
+	depthStencilDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+
+	result = m_device->CreateDepthStencilState(&depthStencilDesc, m_depthEqualStencilState.GetAddressOf());
+	if (FAILED(result))
+		throw std::runtime_error("Failed to create depth equal stencil state");
+
 	m_deviceContext->OMSetDepthStencilState(m_depthStencilState.Get(), 1);
 
 	// Create depth stencil view
@@ -206,34 +219,12 @@ d3d11renderer::d3dclass::d3dclass(int screenWidth, int screenHeight, bool vsync,
 	if (FAILED(result))
 		throw std::runtime_error("Failed to create depth stencil view");
 
-	result = m_device->CreateDepthStencilView(m_depthStencilBuffer.Get(), &depthStencilViewDesc, m_skyboxDepthStencilView.GetAddressOf());
-	if (FAILED(result))
-		throw std::runtime_error("Failed to create sky depth stencil view");
-
-	m_deviceContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), m_depthStencilView.Get());
-
-
-	// In your d3dclass constructor or initialization method
-	D3D11_TEXTURE2D_DESC toneMapTextureDesc = {};
-	toneMapTextureDesc.Width = renderWidth;
-	toneMapTextureDesc.Height = renderHeight;
-	toneMapTextureDesc.MipLevels = 1;
-	toneMapTextureDesc.ArraySize = 1;
-	toneMapTextureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; // High dynamic range
-	toneMapTextureDesc.SampleDesc.Count = 4;
-	toneMapTextureDesc.SampleDesc.Quality = 1;
-	toneMapTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-	toneMapTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-
-	result = m_device->CreateTexture2D(&toneMapTextureDesc, nullptr, m_toneMapTexture.GetAddressOf());
-	if (FAILED(result))
-		throw std::runtime_error("Failed to create tone map texture");
+	m_deviceContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), nullptr);
 
-	result = m_device->CreateRenderTargetView(m_toneMapTexture.Get(), nullptr, m_toneMapRTV.GetAddressOf());
-	if (FAILED(result))
-		throw std::runtime_error("Failed to create tone map render target view");
 
-	m_device->CreateShaderResourceView(m_toneMapTexture.Get(), nullptr, m_toneMapSRV.GetAddressOf());
+	// The scene renders into a compact float target; R11G11B10 is 4 bytes a sample against 16 for R32G32B32A32
+	m_hdrFormat = DXGI_FORMAT_R11G11B10_FLOAT;
+	create_hdr_targets(renderWidth, renderHeight);
 
 	// Initialize rasterizer state
 	rasterDesc.AntialiasedLineEnable = false;
@@ -321,13 +312,12 @@ void d3d11renderer::d3dclass::begin_scene(float red, float green, float blue, fl
 	color[3] = alpha;
 
 
+	// The back buffer isn't cleared; the post pass writes every pixel of it
 	m_deviceContext->ClearRenderTargetView(m_toneMapRTV.Get(), color);
-	m_deviceContext->ClearRenderTargetView(m_renderTargetView.Get(), color);
 	m_deviceContext->OMSetRenderTargets(1, m_toneMapRTV.GetAddressOf(), m_depthStencilView.Get());
 
 	// Clear the depth buffer.
 	m_deviceContext->ClearDepthStencilView(m_depthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-	m_deviceContext->ClearDepthStencilView(m_skyboxDepthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 
 	m_deviceContext->OMSetBlendState(m_blendState.Get(), nullptr, 0xffffffff); // Set blend state with no specific blend factor
 
@@ -337,7 +327,8 @@ void d3d11renderer::d3dclass::begin_scene(float red, float green, float blue, fl
 
 void d3d11renderer::d3dclass::end_scene()
 {
-	m_deviceContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), m_depthStencilView.Get());
+	// The post pass reads the scene and writes the back buffer from a compute shader, so neither may stay bound here
+	m_deviceContext->OMSetRenderTargets(0, nullptr, nullptr);
 }
 
 void d3d11renderer::d3dclass::present()
@@ -389,14 +380,15 @@ int d3d11renderer::d3dclass::get_gpu_memory()
 	return m_videoCardMemory;
 }
 
-std::string d3d11renderer::d3dclass::get_gpu_name()
+const std::string& d3d11renderer::d3dclass::get_gpu_name() const
 {
 	return m_videoCardDescription;
 }
 
 void d3d11renderer::d3dclass::set_back_buffer_render_target()
 {
-	m_deviceContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), m_depthStencilView.Get());
+	// No depth: the depth buffer is multisampled and the back buffer isn't
+	m_deviceContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), nullptr);
 }
 
 void d3d11renderer::d3dclass::reset_viewport()
@@ -414,12 +406,12 @@ void d3d11renderer::d3dclass::resize(int width, int height)
 
 	// Ensure any views or buffers are released before resizing
 	m_renderTargetView.Reset();
+	m_backBufferUAV.Reset();
 	m_depthStencilView.Reset();
 	m_depthStencilBuffer.Reset();
-	m_skyboxDepthStencilView.Reset();
 	m_toneMapTexture.Reset();
 	m_toneMapRTV.Reset();
-
+	m_toneMapSRV.Reset();
 
 
 	// Resize the swap chain
@@ -428,27 +420,7 @@ void d3d11renderer::d3dclass::resize(int width, int height)
 		throw std::runtime_error("Failed to resize swapChain");
 
 
-	// In your d3dclass constructor or initialization method
-	D3D11_TEXTURE2D_DESC toneMapTextureDesc = {};
-	toneMapTextureDesc.Width = width;
-	toneMapTextureDesc.Height = height;
-	toneMapTextureDesc.MipLevels = 1;
-	toneMapTextureDesc.ArraySize = 1;
-	toneMapTextureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; // High dynamic range
-	toneMapTextureDesc.SampleDesc.Count = 4;
-	toneMapTextureDesc.SampleDesc.Quality = 1;
-	toneMapTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-	toneMapTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-
-	hr = m_device->CreateTexture2D(&toneMapTextureDesc, nullptr, m_toneMapTexture.GetAddressOf());
-	if (FAILED(hr))
-		throw std::runtime_error("Failed to create tone map texture");
-
-	hr = m_device->CreateRenderTargetView(m_toneMapTexture.Get(), nullptr, m_toneMapRTV.GetAddressOf());
-	if (FAILED(hr))
-		throw std::runtime_error("Failed to create tone map render target view");
-
-	m_device->CreateShaderResourceView(m_toneMapTexture.Get(), nullptr, m_toneMapSRV.GetAddressOf());
+	create_hdr_targets(width, height);
 
 	// Recreate the render target view with the resized back buffer
 	ComPtr<ID3D11Texture2D> backBuffer;
@@ -460,6 +432,10 @@ void d3d11renderer::d3dclass::resize(int width, int height)
 	if (FAILED(hr))
 		throw std::runtime_error("Failed to create render target view");
 
+	hr = m_device->CreateUnorderedAccessView(backBuffer.Get(), nullptr, m_backBufferUAV.GetAddressOf());
+	if (FAILED(hr))
+		throw std::runtime_error("Failed to create back buffer UAV");
+
 	// Resize the depth/stencil buffer and create a new depth stencil view
 	D3D11_TEXTURE2D_DESC depthDesc = {};
 	depthDesc.Width = width;
@@ -468,7 +444,7 @@ void d3d11renderer::d3dclass::resize(int width, int height)
 	depthDesc.ArraySize = 1;
 	depthDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	depthDesc.SampleDesc.Count = 4;
-	depthDesc.SampleDesc.Quality = 1;
+	depthDesc.SampleDesc.Quality = 0;
 	depthDesc.Usage = D3D11_USAGE_DEFAULT;
 	depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
 
@@ -484,30 +460,23 @@ void d3d11renderer::d3dclass::resize(int width, int height)
 		return;
 	}
 
-	hr = m_device->CreateDepthStencilView(m_depthStencilBuffer.Get(), nullptr, m_skyboxDepthStencilView.GetAddressOf());
-	if (FAILED(hr)) {
-		// Handle error
-		return;
-	}
-
 
-	// Bind the render target view and depth stencil view to the output-merger stage
-	m_deviceContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), m_depthStencilView.Get());
+	// Bind the render target view to the output-merger stage
+	m_deviceContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), nullptr);
 
 	auto fieldOfView = DirectX::XM_PIDIV4; // 45 degrees
 	auto screenAspect = static_cast<float>(width) / static_cast<float>(height);
 	m_projectionMatrix = DirectX::XMMatrixPerspectiveFovLH(fieldOfView, screenAspect, 1, 1000);
 
-	// Set the new viewport
-	D3D11_VIEWPORT viewport = {};
-	viewport.Width = static_cast<FLOAT>(width);
-	viewport.Height = static_cast<FLOAT>(height);
-	viewport.MinDepth = 0.0f;
-	viewport.MaxDepth = 1.0f;
-	viewport.TopLeftX = 0;
-	viewport.TopLeftY = 0;
+	// Set the new viewport; kept so reset_viewport restores it after passes with their own
+	m_viewport.Width = static_cast<FLOAT>(width);
+	m_viewport.Height = static_cast<FLOAT>(height);
+	m_viewport.MinDepth = 0.0f;
+	m_viewport.MaxDepth = 1.0f;
+	m_viewport.TopLeftX = 0;
+	m_viewport.TopLeftY = 0;
 
-	m_deviceContext->RSSetViewports(1, &viewport);
+	m_deviceContext->RSSetViewports(1, &m_viewport);
 }
 
 bool d3d11renderer::d3dclass::is_initialized() const
@@ -525,13 +494,97 @@ void d3d11renderer::d3dclass::set_culling(bool isOpen)
 
 void d3d11renderer::d3dclass::set_depth(bool isOpen)
 {
+	m_deviceContext->OMSetRenderTargets(1, m_toneMapRTV.GetAddressOf(), m_depthStencilView.Get());
 	if(isOpen)
-		m_deviceContext->OMSetRenderTargets(1, m_toneMapRTV.GetAddressOf(), m_depthStencilView.Get());
+		m_deviceContext->OMSetDepthStencilState(m_depthStencilState.Get(), 1);
 	else
-		m_deviceContext->OMSetRenderTargets(1, m_toneMapRTV.GetAddressOf(), m_skyboxDepthStencilView.Get());
+		m_deviceContext->OMSetDepthStencilState(m_skyboxDepthStencilState.Get(), 1);
+}
+
+void d3d11renderer::d3dclass::set_depth_equal(bool isEqual)
+{
+	if (isEqual)
+		m_deviceContext->OMSetDepthStencilState(m_depthEqualStencilState.Get(), 1);
+	else
+		m_deviceContext->OMSetDepthStencilState(m_depthStencilState.Get(), 1);
 }
 
 ID3D11ShaderResourceView* d3d11renderer::d3dclass::get_tonemap_srv()
 {
 	return m_toneMapSRV.Get();
 }
+
+ID3D11UnorderedAccessView* d3d11renderer::d3dclass::get_back_buffer_uav()
+{
+	return m_backBufferUAV.Get();
+}
+
+void d3d11renderer::d3dclass::set_hdr_format(DXGI_FORMAT format)
+{
+	if (format == m_hdrFormat)
+		return;
+
+	m_hdrFormat = format;
+	create_hdr_targets(static_cast<int>(m_viewport.Width), static_cast<int>(m_viewport.Height));
+}
+
+DXGI_FORMAT d3d11renderer::d3dclass::get_hdr_format() const
+{
+	return m_hdrFormat;
+}
+
+size_t d3d11renderer::d3dclass::get_hdr_target_bytes() const
+{
+	D3D11_TEXTURE2D_DESC desc;
+	m_toneMapTexture->GetDesc(&desc);
+	size_t bytesPerSample = m_hdrFormat == DXGI_FORMAT_R11G11B10_FLOAT ? 4 : 8;
+
+	return static_cast<size_t>(desc.Width) * desc.Height * bytesPerSample * desc.SampleDesc.Count;
+}
+
+void d3d11renderer::d3dclass::create_hdr_targets(int width, int height)
+{
+	HRESULT result;
+	UINT support = 0, qualityLevels = 0;
+
+
+	// Fall back to 16-bit float where the compact format can't be multisampled 4x or its samples loaded. FL11 devices
+	// must support 4x for R16G16B16A16_FLOAT
+	m_device->CheckFormatSupport(m_hdrFormat, &support);
+	m_device->CheckMultisampleQualityLevels(m_hdrFormat, 4, &qualityLevels);
+	if (!(support & D3D11_FORMAT_SUPPORT_MULTISAMPLE_RENDERTARGET) || !(support & D3D11_FORMAT_SUPPORT_MULTISAMPLE_LOAD) || qualityLevels == 0)
+		m_hdrFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+	m_toneMapSRV.Reset();
+	m_toneMapRTV.Reset();
+	m_toneMapTexture.Reset();
+
+	// Multisampled target the scene is drawn into; the post pass reads its samples directly
+	D3D11_TEXTURE2D_DESC toneMapTextureDesc = {};
+	toneMapTextureDesc.Width = width;
+	toneMapTextureDesc.Height = height;
+	toneMapTextureDesc.MipLevels = 1;
+	toneMapTextureDesc.ArraySize = 1;
+	toneMapTextureDesc.Format = m_hdrFormat; // High dynamic range
+	toneMapTextureDesc.SampleDesc.Count = 4;
+	toneMapTextureDesc.SampleDesc.Quality = 0; // The one level every supported count has; the depth buffers match it
+	toneMapTextureDesc.Usage = D3D11_USAGE_DEFAULT;
+	toneMapTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+	result = m_device->CreateTexture2D(&toneMapTextureDesc, nullptr, m_toneMapTexture.GetAddressOf());
+	if (FAILED(result))
+		throw std::runtime_error("Failed to create tone map texture");
+
+	result = m_device->CreateRenderTargetView(m_toneMapTexture.Get(), nullptr, m_toneMapRTV.GetAddressOf());
+	if (FAILED(result))
+		throw std::runtime_error("Failed to create tone map render target view");
+
+	result = m_device->CreateShaderResourceView(m_toneMapTexture.Get(), nullptr, m_toneMapSRV.GetAddressOf());
+	if (FAILED(result))
+		throw std::runtime_error("Failed to create tone map shader resource view");
+}
+
+const D3D11_VIEWPORT& d3d11renderer::d3dclass::get_viewport() const
+{
+	return m_viewport;
+}
@@ -25,7 +25,7 @@ namespace d3d11renderer
 		void get_ortho_matrix(DirectX::XMMATRIX& orthoMatrix);
 
 		int get_gpu_memory();
-		std::string get_gpu_name();
+		const std::string& get_gpu_name() const;
 		std::string  get_monitor_name();
 
 		void set_back_buffer_render_target();
@@ -34,9 +34,22 @@ namespace d3d11renderer
 		bool is_initialized() const;
 
 		void set_culling(bool isOpen);
+		// Binds the scene targets; closed tests depth without writing it, for the sky
 		void set_depth(bool isOpen);
+		// EQUAL with writes off, for drawing over a depth prepass
+		void set_depth_equal(bool isEqual);
 
+		// Multisampled HDR scene; readable after end_scene
 		ID3D11ShaderResourceView* get_tonemap_srv();
+		ID3D11UnorderedAccessView* get_back_buffer_uav();
+		// DXGI_FORMAT_R11G11B10_FLOAT or DXGI_FORMAT_R16G16B16A16_FLOAT
+		void set_hdr_format(DXGI_FORMAT format);
+		DXGI_FORMAT get_hdr_format() const;
+		size_t get_hdr_target_bytes() const;
+		const D3D11_VIEWPORT& get_viewport() const;
+
+	private:
+		void create_hdr_targets(int width, int height);
 
 	private:
 		bool m_isInitialized;
@@ -47,17 +60,19 @@ namespace d3d11renderer
 		Microsoft::WRL::ComPtr<ID3D11Device> m_device;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_deviceContext;
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_renderTargetView;
+		Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_backBufferUAV;
 		Microsoft::WRL::ComPtr<ID3D11Texture2D> m_depthStencilBuffer;
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_depthStencilState;
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> m_depthStencilView;
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_skyboxDepthStencilState;
-		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> m_skyboxDepthStencilView;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_depthEqualStencilState;
 		Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_rasterState;
 		Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_skyRasterState;
 		Microsoft::WRL::ComPtr<ID3D11BlendState> m_blendState;
 		Microsoft::WRL::ComPtr<ID3D11Texture2D> m_toneMapTexture;
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_toneMapRTV;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_toneMapSRV;
+		DXGI_FORMAT m_hdrFormat;
 		DirectX::XMMATRIX m_projectionMatrix;
 		DirectX::XMMATRIX m_worldMatrix;
 		DirectX::XMMATRIX m_orthoMatrix;
@@ -0,0 +1,106 @@
+#include "dds_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace DirectX;
+
+// "DDS " followed by the 124 byte DDS_HEADER
+constexpr size_t DDS_HEADER_OFFSET = 4;
+constexpr size_t DDS_HEADER_SIZE = 124;
+constexpr size_t DDS_FOURCC_OFFSET = DDS_HEADER_OFFSET + 80;
+constexpr size_t DDS_DX10_HEADER_SIZE = 20;
+// First two of the header's eleven reserved DWORDs, which readers ignore
+constexpr size_t DDS_COOK_KEY_OFFSET = DDS_HEADER_OFFSET + 28;
+
+bool d3d11renderer::dds_file::open(const wchar_t* filename, uint64_t cookKey)
+{
+	m_images.clear();
+
+	if (!m_file.open(filename))
+	{
+		return false;
+	}
+
+	const uint8_t* data = m_file.get_data();
+	size_t size = m_file.get_size();
+
+	// Validates the header and fills in the format and mip count
+	HRESULT result = GetMetadataFromDDSMemory(data, size, DDS_FLAGS_NONE, m_metadata);
+	if (FAILED(result) || m_metadata.dimension != TEX_DIMENSION_TEXTURE2D || m_metadata.arraySize != 1 || m_metadata.depth != 1)
+	{
+		m_file.close();
+		return false;
+	}
+
+	uint64_t fileKey;
+	std::memcpy(&fileKey, data + DDS_COOK_KEY_OFFSET, sizeof(fileKey));
+	if (fileKey != cookKey)
+	{
+		m_file.close();
+		return false;
+	}
+
+	size_t offset = DDS_HEADER_OFFSET + DDS_HEADER_SIZE;
+	if (std::memcmp(data + DDS_FOURCC_OFFSET, "DX10", 4) == 0)
+	{
+		offset += DDS_DX10_HEADER_SIZE;
+	}
+
+	// Mips are stored back to back, finest first
+	for (size_t mip = 0; mip < m_metadata.mipLevels; mip++)
+	{
+		Image image = {};
+		image.width = std::max<size_t>(1, m_metadata.width >> mip);
+		image.height = std::max<size_t>(1, m_metadata.height >> mip);
+		image.format = m_metadata.format;
+
+		result = ComputePitch(image.format, image.width, image.height, image.rowPitch, image.slicePitch);
+		if (FAILED(result) || offset + image.slicePitch > size)
+		{
+			m_images.clear();
+			m_file.close();
+			return false;
+		}
+
+		// The mapping is read-only; nothing writes through this pointer.
+		image.pixels = const_cast<uint8_t*>(data + offset);
+		offset += image.slicePitch;
+
+		m_images.push_back(image);
+	}
+
+	return true;
+}
+
+const TexMetadata& d3d11renderer::dds_file::get_metadata() const
+{
+	return m_metadata;
+}
+
+const std::vector<Image>& d3d11renderer::dds_file::get_images() const
+{
+	return m_images;
+}
+
+size_t d3d11renderer::dds_file::get_size() const
+{
+	return m_file.get_size();
+}
+
+bool d3d11renderer::dds_file::save(const wchar_t* filename, const ScratchImage& mipChain, uint64_t cookKey)
+{
+	Blob blob;
+	HRESULT result = SaveToDDSMemory(mipChain.GetImages(), mipChain.GetImageCount(), mipChain.GetMetadata(), DDS_FLAGS_FORCE_DX10_EXT, blob);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	std::memcpy(static_cast<uint8_t*>(blob.GetBufferPointer()) + DDS_COOK_KEY_OFFSET, &cookKey, sizeof(cookKey));
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	file.write(static_cast<const char*>(blob.GetBufferPointer()), static_cast<std::streamsize>(blob.GetBufferSize()));
+	return file.good();
+}
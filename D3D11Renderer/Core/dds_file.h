@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <DirectXTex.h>
+
+#include "mapped_file.h"
+
+namespace d3d11renderer
+{
+	// A cooked 2D texture: a DDS file holding the final GPU format and the whole mip chain.
+	// Loading maps the file and points one Image per mip into the mapping; nothing is decoded or copied.
+	// The header's reserved words carry a key for the settings the file was cooked with.
+	class dds_file
+	{
+	public:
+		// Fails when the file was cooked with a different key, so the caller cooks it again
+		bool open(const wchar_t* filename, uint64_t cookKey);
+
+		const DirectX::TexMetadata& get_metadata() const;
+		const std::vector<DirectX::Image>& get_images() const;
+		size_t get_size() const;
+
+		// Writes a mip chain with a DX10 header so every format reads back through the same path
+		static bool save(const wchar_t* filename, const DirectX::ScratchImage& mipChain, uint64_t cookKey);
+
+	private:
+		mapped_file m_file;
+		DirectX::TexMetadata m_metadata;
+		std::vector<DirectX::Image> m_images;
+	};
+}
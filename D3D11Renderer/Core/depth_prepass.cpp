@@ -0,0 +1,131 @@
+#include "depth_prepass.h"
+
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+
+depth_prepass::depth_prepass(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache)
+	: m_queryPrepass(), m_frame(0), m_pixelShaderInvocations()
+{
+	std::vector<uint8_t> vsBlob;
+	std::string errors;
+
+	if (!shaderCache.get({ L"Shaders/depthvs.hlsl", "main", "vs_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS }, vsBlob, errors)) {
+		throw std::runtime_error("Failed to compile the depth prepass vertex shader. " + errors);
+	}
+
+	HRESULT result = device->CreateVertexShader(vsBlob.data(), vsBlob.size(), nullptr, m_vertexShader.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the depth prepass vertex shader.");
+	}
+
+	// Matches model::render_positions: positions, then the node transform rows per instance
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[5] = {};
+	polygonLayout[0].SemanticName = "POSITION";
+	polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	polygonLayout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	for (UINT row = 0; row < 4; row++)
+	{
+		polygonLayout[1 + row].SemanticName = "INSTANCE_TRANSFORM";
+		polygonLayout[1 + row].SemanticIndex = row;
+		polygonLayout[1 + row].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		polygonLayout[1 + row].InputSlot = 1;
+		polygonLayout[1 + row].AlignedByteOffset = row * static_cast<UINT>(sizeof(DirectX::XMFLOAT4));
+		polygonLayout[1 + row].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		polygonLayout[1 + row].InstanceDataStepRate = 1;
+	}
+
+	result = device->CreateInputLayout(polygonLayout, 5, vsBlob.data(), vsBlob.size(), m_layout.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the depth prepass input layout.");
+	}
+
+	D3D11_BUFFER_DESC matrixBufferDesc = {};
+	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
+	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	result = device->CreateBuffer(&matrixBufferDesc, nullptr, m_matrixBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the depth prepass matrix buffer.");
+	}
+
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_PIPELINE_STATISTICS;
+	for (auto& query : m_queries)
+	{
+		result = device->CreateQuery(&queryDesc, query.GetAddressOf());
+		if (FAILED(result)) {
+			throw std::runtime_error("Failed to create the pipeline statistics query.");
+		}
+	}
+}
+
+depth_prepass::~depth_prepass()
+{
+}
+
+bool depth_prepass::begin(ID3D11DeviceContext* deviceContext, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result = deviceContext->Map(m_matrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	MatrixBufferType* dataPtr = (MatrixBufferType*)mappedResource.pData;
+	dataPtr->world = DirectX::XMMatrixTranspose(worldMatrix);
+	dataPtr->view = DirectX::XMMatrixTranspose(viewMatrix);
+	dataPtr->projection = DirectX::XMMatrixTranspose(projectionMatrix);
+	deviceContext->Unmap(m_matrixBuffer.Get(), 0);
+
+	deviceContext->IASetInputLayout(m_layout.Get());
+	deviceContext->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+	deviceContext->VSSetConstantBuffers(0, 1, m_matrixBuffer.GetAddressOf());
+	deviceContext->PSSetShader(nullptr, nullptr, 0);
+
+	return true;
+}
+
+void depth_prepass::render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount, int startInstance)
+{
+	deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, 0, startInstance);
+}
+
+void depth_prepass::begin_statistics(ID3D11DeviceContext* deviceContext)
+{
+	deviceContext->Begin(m_queries[m_frame % QUERY_LATENCY].Get());
+}
+
+void depth_prepass::end_statistics(ID3D11DeviceContext* deviceContext, bool prepassEnabled)
+{
+	size_t slot = m_frame % QUERY_LATENCY;
+	deviceContext->End(m_queries[slot].Get());
+	m_queryPrepass[slot] = prepassEnabled;
+	m_frame++;
+
+	read_back(deviceContext);
+}
+
+uint64_t depth_prepass::get_pixel_shader_invocations(bool prepassEnabled) const
+{
+	return m_pixelShaderInvocations[prepassEnabled ? 1 : 0];
+}
+
+void depth_prepass::read_back(ID3D11DeviceContext* deviceContext)
+{
+	if (m_frame < QUERY_LATENCY)
+	{
+		return;
+	}
+
+	// The oldest query is reused next frame, so read it now if it's ready and skip it otherwise rather than wait
+	size_t oldest = m_frame % QUERY_LATENCY;
+	D3D11_QUERY_DATA_PIPELINE_STATISTICS statistics;
+	if (deviceContext->GetData(m_queries[oldest].Get(), &statistics, sizeof(statistics), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+	{
+		m_pixelShaderInvocations[m_queryPrepass[oldest] ? 1 : 0] = statistics.PSInvocations;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <d3d11.h>
+#include <directxmath.h>
+#include <wrl/client.h>
+#include <array>
+#include "shader_cache.h"
+
+// Optional depth-only pass ahead of the lit pass. Opaque geometry is drawn from the position-only vertex stream with
+// no pixel shader, then the lit pass tests EQUAL with depth writes off, so lightps runs once per visible sample
+// instead of once per overlapping surface.
+// Pipeline statistics queries around the lit pass report its pixel shader invocations with the prepass on and off.
+class depth_prepass
+{
+private:
+	struct MatrixBufferType
+	{
+		DirectX::XMMATRIX world;
+		DirectX::XMMATRIX view;
+		DirectX::XMMATRIX projection;
+	};
+
+	// Frames between ending a query and reading it
+	static constexpr size_t QUERY_LATENCY = 3;
+
+public:
+	depth_prepass(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache);
+	~depth_prepass();
+
+	// Binds the pass; geometry is then drawn with render() after the model's render_positions()
+	bool begin(ID3D11DeviceContext* deviceContext, const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewMatrix, const DirectX::XMMATRIX& projectionMatrix);
+	void render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount, int startInstance);
+
+	// Bracket the lit pass; prepassEnabled says which of the two counts the result belongs to
+	void begin_statistics(ID3D11DeviceContext* deviceContext);
+	void end_statistics(ID3D11DeviceContext* deviceContext, bool prepassEnabled);
+
+	// Latest lit pass pixel shader invocations that reached the CPU, zero until measured
+	uint64_t get_pixel_shader_invocations(bool prepassEnabled) const;
+
+private:
+	void read_back(ID3D11DeviceContext* deviceContext);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_layout;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_matrixBuffer;
+
+	std::array<Microsoft::WRL::ComPtr<ID3D11Query>, QUERY_LATENCY> m_queries;
+	std::array<bool, QUERY_LATENCY> m_queryPrepass;
+	size_t m_frame;
+	uint64_t m_pixelShaderInvocations[2];  // Without, with
+};
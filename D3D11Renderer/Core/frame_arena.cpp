@@ -0,0 +1,75 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+using namespace d3d11renderer;
+
+d3d11renderer::frame_arena::frame_arena(size_t capacity)
+	: m_block(std::make_unique<std::byte[]>(capacity)), m_capacity(capacity), m_offset(0), m_overflowBytes(0), m_peak(0)
+{
+}
+
+void* d3d11renderer::frame_arena::allocate(size_t bytes, size_t alignment)
+{
+	// The block comes from new[], so its base is aligned to max_align_t; offsets only need rounding up
+	size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+	if (offset + bytes <= m_capacity)
+	{
+		m_offset = offset + bytes;
+		m_peak = std::max(m_peak, m_offset + m_overflowBytes);
+		return m_block.get() + offset;
+	}
+
+	// Out of room until the next reset grows the block
+	m_overflowBytes += bytes + alignment;
+	m_peak = std::max(m_peak, m_offset + m_overflowBytes);
+	m_overflow.push_back(std::make_unique<std::byte[]>(bytes + alignment));
+	uintptr_t address = reinterpret_cast<uintptr_t>(m_overflow.back().get());
+	return reinterpret_cast<void*>((address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+}
+
+const char* d3d11renderer::frame_arena::format(const char* text, ...)
+{
+	va_list arguments;
+	va_start(arguments, text);
+	va_list measure;
+	va_copy(measure, arguments);
+	int length = std::vsnprintf(nullptr, 0, text, measure);
+	va_end(measure);
+
+	char* result = static_cast<char*>(allocate(static_cast<size_t>(std::max(length, 0)) + 1, 1));
+	std::vsnprintf(result, static_cast<size_t>(std::max(length, 0)) + 1, text, arguments);
+	va_end(arguments);
+	return result;
+}
+
+void d3d11renderer::frame_arena::reset()
+{
+	if (!m_overflow.empty())
+	{
+		// Room for the whole of the busiest frame in one block, with some to spare
+		m_overflow.clear();
+		m_capacity = m_peak + m_peak / 2;
+		m_block = std::make_unique<std::byte[]>(m_capacity);
+	}
+
+	m_offset = 0;
+	m_overflowBytes = 0;
+}
+
+size_t d3d11renderer::frame_arena::get_capacity() const
+{
+	return m_capacity;
+}
+
+size_t d3d11renderer::frame_arena::get_used() const
+{
+	return m_offset + m_overflowBytes;
+}
+
+size_t d3d11renderer::frame_arena::get_peak() const
+{
+	return m_peak;
+}
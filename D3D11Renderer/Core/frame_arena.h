@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace d3d11renderer
+{
+	// Linear allocator for memory that lives for one frame: render queues, cull results, UI strings. Allocating bumps
+	// an offset and reset() puts it back to zero, so nothing is freed one by one and nothing is destroyed. A frame that
+	// runs past the end takes extra blocks from the heap; the next reset frees them and grows the main block to the
+	// frame's peak, so the arena settles at the size a frame needs and stops touching the heap.
+	class frame_arena
+	{
+	public:
+		explicit frame_arena(size_t capacity);
+
+		frame_arena(const frame_arena&) = delete;
+		frame_arena& operator=(const frame_arena&) = delete;
+
+		void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+		template<typename T>
+		T* allocate_array(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "Frame memory is never destroyed");
+			return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		}
+
+		// printf into frame memory, for labels that change every frame
+		const char* format(const char* text, ...);
+
+		void reset();
+
+		size_t get_capacity() const;
+		size_t get_used() const;
+		size_t get_peak() const;  // Most used by any frame since the arena was created
+
+	private:
+		std::unique_ptr<std::byte[]> m_block;
+		size_t m_capacity;
+		size_t m_offset;
+		size_t m_overflowBytes;  // Taken from the heap this frame, on top of the block
+		size_t m_peak;
+		std::vector<std::unique_ptr<std::byte[]>> m_overflow;
+	};
+
+	// Growable array in frame memory. Growing copies into a bigger allocation and leaves the old one for reset, so T
+	// has to be trivially copyable; clear() and going out of scope cost nothing.
+	template<typename T>
+	class frame_vector
+	{
+		static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Frame vectors only hold plain data");
+
+	public:
+		explicit frame_vector(frame_arena& arena, size_t capacity = 0)
+			: m_arena(&arena), m_data(nullptr), m_size(0), m_capacity(0)
+		{
+			reserve(capacity);
+		}
+
+		void reserve(size_t capacity)
+		{
+			if (capacity <= m_capacity)
+				return;
+
+			T* data = m_arena->allocate_array<T>(capacity);
+			if (m_size > 0)
+			{
+				std::memcpy(data, m_data, sizeof(T) * m_size);
+			}
+			m_data = data;
+			m_capacity = capacity;
+		}
+
+		void push_back(const T& value)
+		{
+			if (m_size == m_capacity)
+			{
+				reserve(m_capacity > 0 ? m_capacity * 2 : 16);
+			}
+			m_data[m_size++] = value;
+		}
+
+		void clear() { m_size = 0; }
+
+		T& operator[](size_t index) { return m_data[index]; }
+		const T& operator[](size_t index) const { return m_data[index]; }
+		T* data() { return m_data; }
+		const T* data() const { return m_data; }
+		T* begin() { return m_data; }
+		T* end() { return m_data + m_size; }
+		const T* begin() const { return m_data; }
+		const T* end() const { return m_data + m_size; }
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+	private:
+		frame_arena* m_arena;
+		T* m_data;
+		size_t m_size;
+		size_t m_capacity;
+	};
+}
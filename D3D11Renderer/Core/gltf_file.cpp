@@ -0,0 +1,965 @@
+#include "gltf_file.h"
+#include "json.h"
+#include "meshopt_codec.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <emmintrin.h>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+	constexpr uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+	constexpr uint32_t COMPONENT_UNSIGNED_INT = 5125;
+	constexpr uint32_t COMPONENT_FLOAT = 5126;
+
+	constexpr uint32_t MODE_TRIANGLES = 4;
+	constexpr uint32_t MODE_TRIANGLE_STRIP = 5;
+	constexpr uint32_t MODE_TRIANGLE_FAN = 6;
+
+	// Vertices converted by one job; big primitives are split so a single-mesh file still uses every thread
+	constexpr size_t VERTICES_PER_JOB = 16384;
+
+	// URIs are percent-encoded; file names on disk are not
+	std::string decode_uri(const std::string& uri)
+	{
+		std::string result;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			uint32_t code = 0;
+			if (uri[i] == '%' && i + 2 < uri.size() && std::from_chars(uri.data() + i + 1, uri.data() + i + 3, code, 16).ptr == uri.data() + i + 3)
+			{
+				result += static_cast<char>(code);
+				i += 2;
+			}
+			else
+			{
+				result += uri[i];
+			}
+		}
+		return result;
+	}
+
+	uint32_t component_size(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case 5120: case COMPONENT_UNSIGNED_BYTE: return 1;
+		case 5122: case COMPONENT_UNSIGNED_SHORT: return 2;
+		case COMPONENT_UNSIGNED_INT: case COMPONENT_FLOAT: return 4;
+		default: return 0;
+		}
+	}
+
+	uint32_t component_count(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT2") return 4;
+		if (type == "MAT3") return 9;
+		if (type == "MAT4") return 16;
+		return 0;
+	}
+
+	// A buffer standing in for compressed views, for loaders without the extension; it has no data
+	bool fallback_buffer(const json_value& buffer)
+	{
+		const json_value* extensions = buffer.find("extensions");
+		const json_value* compression = extensions ? extensions->find("EXT_meshopt_compression") : nullptr;
+		const json_value* fallback = compression ? compression->find("fallback") : nullptr;
+		return fallback && fallback->boolean;
+	}
+
+	bool compression_mode(const json_value& compression, meshopt_mode& mode, meshopt_filter& filter)
+	{
+		const json_value* modeName = compression.find("mode");
+		const json_value* filterName = compression.find("filter");
+		if (!modeName)
+			return false;
+		if (modeName->string == "ATTRIBUTES")
+			mode = meshopt_mode::Attributes;
+		else if (modeName->string == "TRIANGLES")
+			mode = meshopt_mode::Triangles;
+		else if (modeName->string == "INDICES")
+			mode = meshopt_mode::Indices;
+		else
+			return false;
+
+		filter = meshopt_filter::None;
+		if (!filterName || filterName->string == "NONE")
+			return true;
+		if (filterName->string == "OCTAHEDRAL")
+			filter = meshopt_filter::Octahedral;
+		else if (filterName->string == "QUATERNION")
+			filter = meshopt_filter::Quaternion;
+		else if (filterName->string == "EXPONENTIAL")
+			filter = meshopt_filter::Exponential;
+		else
+			return false;
+		return true;
+	}
+
+	// Node to parent space as translation, rotation and scale
+	void read_transform(const json_value& node, gltf_node& result)
+	{
+		float t[3] = { 0.0f, 0.0f, 0.0f }, r[4] = { 0.0f, 0.0f, 0.0f, 1.0f }, s[3] = { 1.0f, 1.0f, 1.0f };
+		const auto& matrix = node.array("matrix");
+		if (matrix.size() == 16)
+		{
+			// Column-major for column vectors reads as row-major for row vectors: three scaled rotation rows, then the
+			// translation
+			float m[4][4];
+			for (int i = 0; i < 16; i++)
+			{
+				m[i / 4][i % 4] = static_cast<float>(matrix[i].number);
+			}
+			for (int row = 0; row < 3; row++)
+			{
+				s[row] = std::sqrt(m[row][0] * m[row][0] + m[row][1] * m[row][1] + m[row][2] * m[row][2]);
+				t[row] = m[3][row];
+			}
+
+			// A mirror goes into the X scale
+			float determinant = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+				m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+			if (determinant < 0.0f)
+			{
+				s[0] = -s[0];
+			}
+			for (int row = 0; row < 3; row++)
+			{
+				for (int column = 0; column < 3; column++)
+				{
+					m[row][column] = s[row] != 0.0f ? m[row][column] / s[row] : (row == column ? 1.0f : 0.0f);
+				}
+			}
+
+			// Rows are the transposed rotation matrix, so m[i][j] here is its [j][i]; the largest diagonal term keeps the
+			// division well away from zero
+			float trace = m[0][0] + m[1][1] + m[2][2];
+			if (trace > 0.0f)
+			{
+				float k = std::sqrt(trace + 1.0f) * 2.0f;
+				r[0] = (m[1][2] - m[2][1]) / k;
+				r[1] = (m[2][0] - m[0][2]) / k;
+				r[2] = (m[0][1] - m[1][0]) / k;
+				r[3] = 0.25f * k;
+			}
+			else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+			{
+				float k = std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f;
+				r[0] = 0.25f * k;
+				r[1] = (m[0][1] + m[1][0]) / k;
+				r[2] = (m[0][2] + m[2][0]) / k;
+				r[3] = (m[1][2] - m[2][1]) / k;
+			}
+			else if (m[1][1] > m[2][2])
+			{
+				float k = std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f;
+				r[0] = (m[0][1] + m[1][0]) / k;
+				r[1] = 0.25f * k;
+				r[2] = (m[1][2] + m[2][1]) / k;
+				r[3] = (m[2][0] - m[0][2]) / k;
+			}
+			else
+			{
+				float k = std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f;
+				r[0] = (m[0][2] + m[2][0]) / k;
+				r[1] = (m[1][2] + m[2][1]) / k;
+				r[2] = 0.25f * k;
+				r[3] = (m[0][1] - m[1][0]) / k;
+			}
+		}
+		else
+		{
+			const auto& translation = node.array("translation");
+			const auto& rotation = node.array("rotation");
+			const auto& scale = node.array("scale");
+			for (size_t i = 0; i < 3 && i < translation.size(); i++) t[i] = static_cast<float>(translation[i].number);
+			for (size_t i = 0; i < 4 && i < rotation.size(); i++) r[i] = static_cast<float>(rotation[i].number);
+			for (size_t i = 0; i < 3 && i < scale.size(); i++) s[i] = static_cast<float>(scale[i].number);
+		}
+
+		std::memcpy(result.translation, t, sizeof(t));
+		std::memcpy(result.rotation, r, sizeof(r));
+		std::memcpy(result.scale, s, sizeof(s));
+	}
+
+	// Three floats from a four-float load; the element after it has to exist, so the caller does the last one itself
+	inline void copy_float3(const uint8_t* source, uint8_t* destination)
+	{
+		__m128 value = _mm_loadu_ps(reinterpret_cast<const float*>(source));
+		_mm_storel_pi(reinterpret_cast<__m64*>(destination), value);
+		_mm_store_ss(reinterpret_cast<float*>(destination) + 2, _mm_movehl_ps(value, value));
+	}
+
+	inline void store_float3(uint8_t* destination, __m128 value)
+	{
+		_mm_storel_pi(reinterpret_cast<__m64*>(destination), value);
+		_mm_store_ss(reinterpret_cast<float*>(destination) + 2, _mm_movehl_ps(value, value));
+	}
+
+	inline __m128 load_float3(const uint8_t* source)
+	{
+		// movq takes any alignment; accessors only promise 4-byte aligned floats
+		__m128 xy = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source)));
+		return _mm_movelh_ps(xy, _mm_load_ss(reinterpret_cast<const float*>(source) + 2));
+	}
+
+	inline __m128 cross(__m128 a, __m128 b)
+	{
+		__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 result = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+		return _mm_shuffle_ps(result, result, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	struct float3
+	{
+		float x, y, z;
+	};
+
+	inline float3 operator-(float3 a, float3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline float3 operator+(float3 a, float3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline float3 operator*(float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	inline float dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline float3 cross(float3 a, float3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	inline float3 normalize(float3 a, float3 fallback)
+	{
+		float length = std::sqrt(dot(a, a));
+		return length > 1e-12f ? a * (1.0f / length) : fallback;
+	}
+
+	inline float3 read_float3(const uint8_t* source)
+	{
+		float3 value;
+		std::memcpy(&value, source, sizeof(value));
+		return value;
+	}
+
+	inline void write_float3(uint8_t* destination, float3 value)
+	{
+		std::memcpy(destination, &value, sizeof(value));
+	}
+}
+
+d3d11renderer::gltf_file::gltf_file()
+	: m_meshCount(0), m_stats()
+{
+}
+
+d3d11renderer::gltf_file::~gltf_file()
+{
+}
+
+bool d3d11renderer::gltf_file::fail(const std::string& error)
+{
+	m_error = error;
+	return false;
+}
+
+bool d3d11renderer::gltf_file::open(const std::filesystem::path& filename)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	m_buffers.clear();
+	m_decoded.clear();
+	m_accessors.clear();
+	m_sources.clear();
+	m_primitives.clear();
+	m_materials.clear();
+	m_nodes.clear();
+	m_instances.clear();
+	m_meshCount = 0;
+	m_stats = gltf_stats();
+	m_error.clear();
+
+	json_value root;
+	{
+		mapped_file text;
+		if (!text.open(filename))
+			return fail("Can't open " + filename.string());
+		if (!parse_json(reinterpret_cast<const char*>(text.get_data()), text.get_size(), root, m_error))
+			return false;
+	}
+	if (root.type != json_value::kind::Object)
+		return fail("Not a glTF document");
+
+	const json_value* asset = root.find("asset");
+	const json_value* version = asset ? asset->find("version") : nullptr;
+	if (!version || version->type != json_value::kind::String || version->string.empty() || version->string[0] != '2')
+		return fail("Only glTF 2.0 is supported");
+
+	// Only the extensions read here may be required
+	for (const json_value& extension : root.array("extensionsRequired"))
+	{
+		if (extension.string != "EXT_meshopt_compression")
+			return fail("Unsupported required extension " + extension.string);
+	}
+
+	// Buffers are mapped, never read into memory. A fallback buffer of the compression extension has no data of
+	// its own; only compressed views, which decode from another buffer, may use it
+	for (const json_value& buffer : root.array("buffers"))
+	{
+		const json_value* uri = buffer.find("uri");
+		if (!uri && fallback_buffer(buffer))
+		{
+			m_buffers.push_back(nullptr);
+			continue;
+		}
+		if (!uri || uri->type != json_value::kind::String || uri->string.rfind("data:", 0) == 0)
+			return fail("Only external .bin buffers are supported");
+
+		auto file = std::make_unique<mapped_file>();
+		std::string name = decode_uri(uri->string);
+		std::filesystem::path path = filename.parent_path() / std::u8string(name.begin(), name.end());
+		if (!file->open(path))
+			return fail("Can't open buffer " + path.string());
+		if (file->get_size() < static_cast<size_t>(buffer.integer("byteLength", 0)))
+			return fail("Buffer " + path.string() + " is shorter than its byteLength");
+		m_buffers.push_back(std::move(file));
+	}
+
+	auto buffer_range = [&](int64_t buffer, int64_t offset, int64_t length) -> const uint8_t*
+	{
+		if (buffer < 0 || buffer >= static_cast<int64_t>(m_buffers.size()) || !m_buffers[buffer] || offset < 0 || length < 0 ||
+			static_cast<size_t>(offset + length) > m_buffers[buffer]->get_size())
+			return nullptr;
+		return m_buffers[buffer]->get_data() + offset;
+	};
+
+	struct buffer_view
+	{
+		const uint8_t* data;
+		size_t length;
+		size_t stride;
+	};
+	struct decode_job
+	{
+		size_t view;
+		size_t offset;  // Into m_decoded
+		const uint8_t* source;
+		size_t sourceSize;
+		size_t count;
+		size_t stride;
+		meshopt_mode mode;
+		meshopt_filter filter;
+	};
+	std::vector<buffer_view> views;
+	std::vector<decode_job> jobs;
+	size_t decodedSize = 0;
+	for (const json_value& view : root.array("bufferViews"))
+	{
+		const json_value* extensions = view.find("extensions");
+		const json_value* compression = extensions ? extensions->find("EXT_meshopt_compression") : nullptr;
+		if (!compression)
+		{
+			int64_t length = view.integer("byteLength", 0);
+			const uint8_t* data = buffer_range(view.integer("buffer", -1), view.integer("byteOffset", 0), length);
+			if (!data)
+				return fail("Buffer view out of range");
+			views.push_back({ data, static_cast<size_t>(length), static_cast<size_t>(view.integer("byteStride", 0)) });
+			continue;
+		}
+
+		decode_job job = {};
+		int64_t sourceSize = compression->integer("byteLength", 0);
+		int64_t count = compression->integer("count", 0);
+		int64_t stride = compression->integer("byteStride", 0);
+		job.source = buffer_range(compression->integer("buffer", -1), compression->integer("byteOffset", 0), sourceSize);
+		if (!job.source || count < 0 || stride <= 0 || stride > 256 || !compression_mode(*compression, job.mode, job.filter))
+			return fail("Unsupported compressed buffer view");
+
+		// The decoded view is count elements of the stride, however long the view claims to be
+		job.view = views.size();
+		job.offset = decodedSize;
+		job.sourceSize = static_cast<size_t>(sourceSize);
+		job.count = static_cast<size_t>(count);
+		job.stride = static_cast<size_t>(stride);
+		decodedSize = (decodedSize + job.count * job.stride + 15) & ~size_t(15);
+		jobs.push_back(job);
+		views.push_back({ nullptr, job.count * job.stride, job.mode == meshopt_mode::Attributes ? job.stride : 0 });
+	}
+
+	// Each view decodes on its own, so they spread over the threads whole
+	if (!jobs.empty())
+	{
+		auto decodeStart = std::chrono::steady_clock::now();
+		m_decoded.resize(decodedSize);
+		std::vector<uint8_t> decoded(jobs.size(), 0);
+		parallel_for(jobs.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const decode_job& job = jobs[i];
+				decoded[i] = decode_meshopt(m_decoded.data() + job.offset, job.count, job.stride, job.source, job.sourceSize, job.mode, job.filter);
+			}
+		});
+
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			if (!decoded[i])
+				return fail("Can't decode compressed buffer view " + std::to_string(jobs[i].view));
+			views[jobs[i].view].data = m_decoded.data() + jobs[i].offset;
+			m_stats.compressedBytes += jobs[i].sourceSize;
+			m_stats.decodedBytes += jobs[i].count * jobs[i].stride;
+		}
+		m_stats.decodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+	}
+
+	for (const json_value& source : root.array("accessors"))
+	{
+		accessor entry = {};
+		entry.componentType = static_cast<uint32_t>(source.integer("componentType", 0));
+		const json_value* type = source.find("type");
+		entry.components = type && type->type == json_value::kind::String ? component_count(type->string) : 0;
+		entry.count = static_cast<size_t>(std::max<int64_t>(source.integer("count", 0), 0));
+		const json_value* normalized = source.find("normalized");
+		entry.normalized = normalized && normalized->boolean;
+
+		size_t elementSize = static_cast<size_t>(component_size(entry.componentType)) * entry.components;
+		int64_t view = source.integer("bufferView", -1);
+		if (elementSize == 0 || source.find("sparse"))
+			return fail("Unsupported accessor");
+		if (view < 0 || view >= static_cast<int64_t>(views.size()))
+			return fail("Accessors without a buffer view are not supported");
+
+		size_t offset = static_cast<size_t>(std::max<int64_t>(source.integer("byteOffset", 0), 0));
+		entry.stride = views[view].stride ? views[view].stride : elementSize;
+		if (entry.count > 0 && offset + entry.stride * (entry.count - 1) + elementSize > views[view].length)
+			return fail("Accessor out of range");
+		entry.data = views[view].data + offset;
+		m_accessors.push_back(entry);
+	}
+
+	// Texture index to image URI
+	const auto& images = root.array("images");
+	const auto& textures = root.array("textures");
+	auto image_uri = [&](const json_value* textureInfo) -> std::string
+	{
+		int64_t textureIndex = textureInfo ? textureInfo->integer("index", -1) : -1;
+		if (textureIndex < 0 || textureIndex >= static_cast<int64_t>(textures.size()))
+			return std::string();
+		int64_t image = textures[textureIndex].integer("source", -1);
+		if (image < 0 || image >= static_cast<int64_t>(images.size()))
+			return std::string();
+		const json_value* uri = images[image].find("uri");
+		return uri && uri->type == json_value::kind::String ? decode_uri(uri->string) : std::string();
+	};
+
+	for (const json_value& source : root.array("materials"))
+	{
+		gltf_material material;
+		material_factors& factors = material.factors;
+		if (const json_value* pbr = source.find("pbrMetallicRoughness"))
+		{
+			material.baseColor = image_uri(pbr->find("baseColorTexture"));
+			material.metallicRoughness = image_uri(pbr->find("metallicRoughnessTexture"));
+
+			const auto& baseColor = pbr->array("baseColorFactor");
+			for (size_t i = 0; i < 4 && i < baseColor.size(); i++) factors.baseColor[i] = static_cast<float>(baseColor[i].number);
+			factors.metallic = static_cast<float>(pbr->number_or("metallicFactor", 1.0));
+			factors.roughness = static_cast<float>(pbr->number_or("roughnessFactor", 1.0));
+		}
+		material.normal = image_uri(source.find("normalTexture"));
+		material.occlusion = image_uri(source.find("occlusionTexture"));
+		material.emissive = image_uri(source.find("emissiveTexture"));
+
+		const auto& emissive = source.array("emissiveFactor");
+		for (size_t i = 0; i < 3 && i < emissive.size(); i++) factors.emissive[i] = static_cast<float>(emissive[i].number);
+
+		const json_value* alphaMode = source.find("alphaMode");
+		if (alphaMode && alphaMode->string == "MASK")
+		{
+			material.alphaCutoff = static_cast<float>(source.number_or("alphaCutoff", 0.5));
+		}
+		m_materials.push_back(material);
+	}
+
+	// Every triangle primitive gets the next vertex and index ranges
+	auto attribute = [&](const json_value& attributes, const char* name, uint32_t components, bool floatOnly) -> int32_t
+	{
+		int64_t index = attributes.integer(name, -1);
+		if (index < 0 || index >= static_cast<int64_t>(m_accessors.size()))
+			return -1;
+		const accessor& entry = m_accessors[index];
+		bool readable = entry.componentType == COMPONENT_FLOAT ||
+			(!floatOnly && entry.normalized && (entry.componentType == COMPONENT_UNSIGNED_BYTE || entry.componentType == COMPONENT_UNSIGNED_SHORT));
+		return entry.components == components && readable ? static_cast<int32_t>(index) : -2;
+	};
+
+	const auto& meshes = root.array("meshes");
+	m_meshCount = meshes.size();
+	size_t vertexCount = 0, indexCount = 0;
+	for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+	{
+		for (const json_value& primitive : meshes[mesh].array("primitives"))
+		{
+			uint32_t mode = static_cast<uint32_t>(primitive.integer("mode", MODE_TRIANGLES));
+			if (mode != MODE_TRIANGLES && mode != MODE_TRIANGLE_STRIP && mode != MODE_TRIANGLE_FAN)
+				continue;
+
+			const json_value* attributes = primitive.find("attributes");
+			if (!attributes)
+				return fail("Primitive without attributes");
+
+			primitive_source source = {};
+			source.mode = mode;
+			source.position = attribute(*attributes, "POSITION", 3, true);
+			source.normal = attribute(*attributes, "NORMAL", 3, true);
+			source.tangent = attribute(*attributes, "TANGENT", 4, true);
+			source.texcoord = attribute(*attributes, "TEXCOORD_0", 2, false);
+			if (source.position < 0 || source.normal == -2 || source.tangent == -2 || source.texcoord == -2)
+				return fail("Unsupported vertex attribute format");
+
+			size_t count = m_accessors[source.position].count;
+			for (int32_t other : { source.normal, source.tangent, source.texcoord })
+			{
+				if (other >= 0 && m_accessors[other].count != count)
+					return fail("Vertex attributes differ in length");
+			}
+
+			source.indices = static_cast<int32_t>(primitive.integer("indices", -1));
+			size_t elements = count;
+			if (source.indices >= 0)
+			{
+				if (source.indices >= static_cast<int32_t>(m_accessors.size()))
+					return fail("Index accessor out of range");
+				const accessor& indices = m_accessors[source.indices];
+				if (indices.components != 1 || (indices.componentType != COMPONENT_UNSIGNED_BYTE &&
+					indices.componentType != COMPONENT_UNSIGNED_SHORT && indices.componentType != COMPONENT_UNSIGNED_INT))
+					return fail("Unsupported index format");
+				elements = indices.count;
+			}
+
+			gltf_primitive entry = {};
+			entry.mesh = static_cast<uint32_t>(mesh);
+			int64_t material = primitive.integer("material", -1);
+			entry.material = material >= 0 && material < static_cast<int64_t>(m_materials.size()) ? static_cast<uint32_t>(material) : gltf_primitive::NO_MATERIAL;
+			entry.startVertex = vertexCount;
+			entry.vertexCount = count;
+			entry.startIndex = indexCount;
+			entry.indexCount = mode == MODE_TRIANGLES ? elements - elements % 3 : (elements >= 3 ? (elements - 2) * 3 : 0);
+			entry.hasTangents = source.tangent >= 0;
+
+			vertexCount += entry.vertexCount;
+			indexCount += entry.indexCount;
+			m_primitives.push_back(entry);
+			m_sources.push_back(source);
+		}
+	}
+	if (vertexCount > UINT32_MAX)
+		return fail("Too many vertices for 32-bit indices");
+
+	// Node hierarchy of the default scene, walked with an explicit stack; a node is visited once however it is linked
+	const auto& nodes = root.array("nodes");
+	std::vector<int64_t> roots;
+	const auto& scenes = root.array("scenes");
+	int64_t scene = root.integer("scene", 0);
+	if (scene >= 0 && scene < static_cast<int64_t>(scenes.size()))
+	{
+		for (const json_value& node : scenes[scene].array("nodes"))
+			roots.push_back(static_cast<int64_t>(node.number));
+	}
+	else
+	{
+		std::vector<bool> isChild(nodes.size(), false);
+		for (const json_value& node : nodes)
+		{
+			for (const json_value& child : node.array("children"))
+			{
+				int64_t index = static_cast<int64_t>(child.number);
+				if (index >= 0 && index < static_cast<int64_t>(nodes.size()))
+					isChild[index] = true;
+			}
+		}
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			if (!isChild[i])
+				roots.push_back(static_cast<int64_t>(i));
+		}
+	}
+
+	struct pending_node
+	{
+		int64_t node;
+		uint32_t parent;
+	};
+	std::vector<pending_node> stack;
+	std::vector<bool> visited(nodes.size(), false);
+	for (auto it = roots.rbegin(); it != roots.rend(); ++it)
+	{
+		stack.push_back({ *it, gltf_node::NO_PARENT });
+	}
+	while (!stack.empty())
+	{
+		pending_node current = stack.back();
+		stack.pop_back();
+		if (current.node < 0 || current.node >= static_cast<int64_t>(nodes.size()) || visited[current.node])
+			continue;
+		visited[current.node] = true;
+
+		const json_value& node = nodes[current.node];
+		uint32_t index = static_cast<uint32_t>(m_nodes.size());
+		gltf_node entry;
+		entry.parent = current.parent;
+		read_transform(node, entry);
+		m_nodes.push_back(entry);
+
+		int64_t mesh = node.integer("mesh", -1);
+		if (mesh >= 0 && mesh < static_cast<int64_t>(m_meshCount))
+			m_instances.push_back({ static_cast<uint32_t>(mesh), index });
+
+		const auto& children = node.array("children");
+		for (auto it = children.rbegin(); it != children.rend(); ++it)
+			stack.push_back({ static_cast<int64_t>(it->number), index });
+	}
+
+	m_stats.vertexCount = vertexCount;
+	m_stats.indexCount = indexCount;
+	m_stats.parseMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void d3d11renderer::gltf_file::read(void* vertices, const gltf_vertex_layout& layout, uint32_t* indices)
+{
+	auto start = std::chrono::steady_clock::now();
+	uint8_t* vertexBytes = static_cast<uint8_t*>(vertices);
+
+	// Vertex chunks and whole index ranges, all independent
+	struct read_job
+	{
+		size_t primitive;
+		size_t begin;
+		size_t end;  // begin == end reads the indices
+	};
+	std::vector<read_job> jobs;
+	for (size_t i = 0; i < m_primitives.size(); i++)
+	{
+		for (size_t begin = 0; begin < m_primitives[i].vertexCount; begin += VERTICES_PER_JOB)
+		{
+			jobs.push_back({ i, begin, std::min(begin + VERTICES_PER_JOB, m_primitives[i].vertexCount) });
+		}
+		jobs.push_back({ i, 0, 0 });
+	}
+
+	parallel_for(jobs.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const read_job& job = jobs[i];
+			if (job.begin == job.end)
+				read_indices(job.primitive, indices);
+			else
+				read_vertices(job.primitive, job.begin, job.end, vertexBytes, layout);
+		}
+	});
+
+	// Tangents from the UVs need whole triangles, so they wait for every vertex and index
+	std::vector<size_t> missingTangents;
+	for (size_t i = 0; i < m_primitives.size(); i++)
+	{
+		if (!m_primitives[i].hasTangents)
+			missingTangents.push_back(i);
+	}
+	parallel_for(missingTangents.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			generate_tangents(missingTangents[i], vertexBytes, layout, indices);
+		}
+	});
+
+	m_stats.generatedTangents = missingTangents.size();
+	m_stats.readMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void d3d11renderer::gltf_file::read_vertices(size_t primitive, size_t begin, size_t end, uint8_t* vertices, const gltf_vertex_layout& layout) const
+{
+	const primitive_source& source = m_sources[primitive];
+	uint8_t* first = vertices + m_primitives[primitive].startVertex * layout.stride;
+
+	// One attribute at a time, so every source view streams through in order. Four-float loads stop one short of the
+	// accessor's last element, which is copied as it is instead
+	auto copy_vec3 = [&](int32_t index, size_t offset)
+	{
+		uint8_t* destination = first + begin * layout.stride + offset;
+		if (index < 0)
+		{
+			for (size_t i = begin; i < end; i++, destination += layout.stride)
+				std::memset(destination, 0, 3 * sizeof(float));
+			return;
+		}
+
+		const accessor& entry = m_accessors[index];
+		const uint8_t* element = entry.data + begin * entry.stride;
+		size_t simdEnd = std::min(end, entry.count - 1);
+		size_t i = begin;
+		for (; i < simdEnd; i++, element += entry.stride, destination += layout.stride)
+			copy_float3(element, destination);
+		for (; i < end; i++, element += entry.stride, destination += layout.stride)
+			std::memcpy(destination, element, 3 * sizeof(float));
+	};
+
+	copy_vec3(source.position, layout.position);
+	copy_vec3(source.normal, layout.normal);
+
+	uint8_t* texcoord = first + begin * layout.stride + layout.texcoord;
+	if (source.texcoord < 0)
+	{
+		for (size_t i = begin; i < end; i++, texcoord += layout.stride)
+			std::memset(texcoord, 0, 2 * sizeof(float));
+	}
+	else
+	{
+		const accessor& entry = m_accessors[source.texcoord];
+		const uint8_t* element = entry.data + begin * entry.stride;
+		if (entry.componentType == COMPONENT_FLOAT)
+		{
+			for (size_t i = begin; i < end; i++, element += entry.stride, texcoord += layout.stride)
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(texcoord), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(element)));
+		}
+		else
+		{
+			// Normalized integers, as some exporters quantize UVs
+			bool bytes = entry.componentType == COMPONENT_UNSIGNED_BYTE;
+			float scale = bytes ? 1.0f / 255.0f : 1.0f / 65535.0f;
+			for (size_t i = begin; i < end; i++, element += entry.stride, texcoord += layout.stride)
+			{
+				float uv[2];
+				for (int c = 0; c < 2; c++)
+				{
+					uint16_t value;
+					if (bytes)
+						value = element[c];
+					else
+						std::memcpy(&value, element + c * 2, sizeof(value));
+					uv[c] = value * scale;
+				}
+				std::memcpy(texcoord, uv, sizeof(uv));
+			}
+		}
+	}
+
+	uint8_t* vertex = first + begin * layout.stride;
+	if (source.tangent < 0)
+	{
+		// Filled in by generate_tangents once the whole primitive is read
+		for (size_t i = begin; i < end; i++, vertex += layout.stride)
+		{
+			std::memset(vertex + layout.tangent, 0, 3 * sizeof(float));
+			std::memset(vertex + layout.bitangent, 0, 3 * sizeof(float));
+		}
+		return;
+	}
+
+	// TANGENT is xyz plus the handedness in w; the bitangent is cross(normal, tangent) * w. The four floats are the
+	// whole element, so these loads never run past it
+	const accessor& entry = m_accessors[source.tangent];
+	const uint8_t* element = entry.data + begin * entry.stride;
+	for (size_t i = begin; i < end; i++, element += entry.stride, vertex += layout.stride)
+	{
+		__m128 tangent = _mm_loadu_ps(reinterpret_cast<const float*>(element));
+		__m128 normal = load_float3(vertex + layout.normal);
+		__m128 handedness = _mm_shuffle_ps(tangent, tangent, _MM_SHUFFLE(3, 3, 3, 3));
+		store_float3(vertex + layout.tangent, tangent);
+		store_float3(vertex + layout.bitangent, _mm_mul_ps(cross(normal, tangent), handedness));
+	}
+}
+
+void d3d11renderer::gltf_file::read_indices(size_t primitive, uint32_t* indices) const
+{
+	const primitive_source& source = m_sources[primitive];
+	const gltf_primitive& entry = m_primitives[primitive];
+	uint32_t* destination = indices + entry.startIndex;
+	uint32_t base = static_cast<uint32_t>(entry.startVertex);
+	uint32_t vertexCount = static_cast<uint32_t>(entry.vertexCount);
+
+	const accessor* accessorEntry = source.indices >= 0 ? &m_accessors[source.indices] : nullptr;
+	auto fetch = [&](size_t i) -> uint32_t
+	{
+		if (!accessorEntry)
+			return static_cast<uint32_t>(i);
+		const uint8_t* element = accessorEntry->data + i * accessorEntry->stride;
+		switch (accessorEntry->componentType)
+		{
+		case COMPONENT_UNSIGNED_BYTE:
+			return *element;
+		case COMPONENT_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+		default:
+		{
+			uint32_t value;
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+		}
+	};
+
+	// Indices past the end would make the CPU passes that follow read outside the vertices; they point at vertex 0
+	auto store = [&](size_t i, uint32_t index)
+	{
+		destination[i] = (index < vertexCount ? index : 0) + base;
+	};
+
+	if (source.mode == MODE_TRIANGLES)
+	{
+		// Widened eight at a time when they are 16-bit, which every asset here uses
+		size_t i = 0;
+		if (accessorEntry && accessorEntry->componentType == COMPONENT_UNSIGNED_SHORT && accessorEntry->stride == 2)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i offset = _mm_set1_epi32(static_cast<int>(base));
+			const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+			// Unsigned 16-bit compare through the signed one, shifted by 0x8000
+			const __m128i limit = _mm_set1_epi16(static_cast<short>(std::min<uint32_t>(vertexCount, 0x10000) - 1 - 0x8000));
+			for (; i + 8 <= entry.indexCount; i += 8)
+			{
+				__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accessorEntry->data + i * 2));
+				if (_mm_movemask_epi8(_mm_cmpgt_epi16(_mm_xor_si128(values, bias), limit)) != 0)
+					break;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_add_epi32(_mm_unpacklo_epi16(values, zero), offset));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(values, zero), offset));
+			}
+		}
+		for (; i < entry.indexCount; i++)
+			store(i, fetch(i));
+		return;
+	}
+
+	// Strips alternate winding every triangle; fans all share the first vertex
+	size_t triangles = entry.indexCount / 3;
+	for (size_t t = 0; t < triangles; t++)
+	{
+		uint32_t a, b, c;
+		if (source.mode == MODE_TRIANGLE_STRIP)
+		{
+			a = fetch(t + (t & 1));
+			b = fetch(t + 1 - (t & 1));
+			c = fetch(t + 2);
+		}
+		else
+		{
+			a = fetch(t + 1);
+			b = fetch(t + 2);
+			c = fetch(0);
+		}
+		store(t * 3, a);
+		store(t * 3 + 1, b);
+		store(t * 3 + 2, c);
+	}
+}
+
+void d3d11renderer::gltf_file::generate_tangents(size_t primitive, uint8_t* vertices, const gltf_vertex_layout& layout, const uint32_t* indices) const
+{
+	const primitive_source& source = m_sources[primitive];
+	const gltf_primitive& entry = m_primitives[primitive];
+	if (source.normal < 0 || source.texcoord < 0 || entry.vertexCount == 0)
+		return;
+
+	uint8_t* first = vertices + entry.startVertex * layout.stride;
+	auto position = [&](uint32_t v) { return read_float3(first + v * layout.stride + layout.position); };
+	auto uv = [&](uint32_t v)
+	{
+		float value[2];
+		std::memcpy(value, first + v * layout.stride + layout.texcoord, sizeof(value));
+		return std::make_pair(value[0], value[1]);
+	};
+
+	// Per-face directions of increasing u and v, each face weighted the same, summed at its corners
+	std::vector<float3> tangents(entry.vertexCount, float3{ 0.0f, 0.0f, 0.0f });
+	std::vector<float3> bitangents(entry.vertexCount, float3{ 0.0f, 0.0f, 0.0f });
+	const uint32_t* triangle = indices + entry.startIndex;
+	uint32_t base = static_cast<uint32_t>(entry.startVertex);
+	for (size_t i = 0; i + 2 < entry.indexCount; i += 3)
+	{
+		uint32_t v0 = triangle[i] - base, v1 = triangle[i + 1] - base, v2 = triangle[i + 2] - base;
+		float3 edge1 = position(v1) - position(v0), edge2 = position(v2) - position(v0);
+		auto [u0, w0] = uv(v0);
+		auto [u1, w1] = uv(v1);
+		auto [u2, w2] = uv(v2);
+		float du1 = u1 - u0, dv1 = w1 - w0, du2 = u2 - u0, dv2 = w2 - w0;
+		float determinant = du1 * dv2 - du2 * dv1;
+		if (std::fabs(determinant) < 1e-20f)
+			continue;
+
+		float sign = determinant < 0.0f ? -1.0f : 1.0f;
+		float3 tangent = normalize((edge1 * dv2 - edge2 * dv1) * sign, float3{ 0.0f, 0.0f, 0.0f });
+		float3 bitangent = normalize((edge2 * du1 - edge1 * du2) * sign, float3{ 0.0f, 0.0f, 0.0f });
+		for (uint32_t v : { v0, v1, v2 })
+		{
+			tangents[v] = tangents[v] + tangent;
+			bitangents[v] = bitangents[v] + bitangent;
+		}
+	}
+
+	// Both made perpendicular to the normal; vertices no face could orient get any perpendicular pair
+	for (size_t v = 0; v < entry.vertexCount; v++)
+	{
+		uint8_t* vertex = first + v * layout.stride;
+		float3 normal = read_float3(vertex + layout.normal);
+		float3 any = std::fabs(normal.x) < 0.9f ? float3{ 1.0f, 0.0f, 0.0f } : float3{ 0.0f, 1.0f, 0.0f };
+		float3 tangent = normalize(tangents[v] - normal * dot(normal, tangents[v]), normalize(cross(any, normal), any));
+		float3 bitangent = normalize(bitangents[v] - normal * dot(normal, bitangents[v]), cross(normal, tangent));
+		write_float3(vertex + layout.tangent, tangent);
+		write_float3(vertex + layout.bitangent, bitangent);
+	}
+}
+
+size_t d3d11renderer::gltf_file::get_vertex_count() const
+{
+	return m_stats.vertexCount;
+}
+
+size_t d3d11renderer::gltf_file::get_index_count() const
+{
+	return m_stats.indexCount;
+}
+
+size_t d3d11renderer::gltf_file::get_mesh_count() const
+{
+	return m_meshCount;
+}
+
+const std::vector<gltf_primitive>& d3d11renderer::gltf_file::get_primitives() const
+{
+	return m_primitives;
+}
+
+const std::vector<gltf_material>& d3d11renderer::gltf_file::get_materials() const
+{
+	return m_materials;
+}
+
+const std::vector<gltf_node>& d3d11renderer::gltf_file::get_nodes() const
+{
+	return m_nodes;
+}
+
+const std::vector<gltf_instance>& d3d11renderer::gltf_file::get_instances() const
+{
+	return m_instances;
+}
+
+const gltf_stats& d3d11renderer::gltf_file::get_stats() const
+{
+	return m_stats;
+}
+
+const std::string& d3d11renderer::gltf_file::get_error() const
+{
+	return m_error;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "material_features.h"
+
+namespace d3d11renderer
+{
+	// Byte offsets of each attribute in the caller's vertex
+	struct gltf_vertex_layout
+	{
+		size_t stride;
+		size_t position;   // float3
+		size_t texcoord;   // float2, top-left origin as glTF stores it
+		size_t normal;     // float3
+		size_t tangent;    // float3
+		size_t bitangent;  // float3
+	};
+
+	// Image URIs of a material's maps, empty where it has none, and the factors they are multiplied by
+	struct gltf_material
+	{
+		std::string baseColor;
+		std::string normal;
+		std::string occlusion;
+		std::string emissive;
+		std::string metallicRoughness;
+		float alphaCutoff = 0.0f;  // Above 0 for alphaMode MASK
+		material_factors factors;
+	};
+
+	struct gltf_primitive
+	{
+		static constexpr uint32_t NO_MATERIAL = UINT32_MAX;
+
+		uint32_t mesh;
+		uint32_t material;
+		size_t startVertex;  // Where read() puts it
+		size_t vertexCount;
+		size_t startIndex;
+		size_t indexCount;
+		bool hasTangents;    // TANGENT is in the file; otherwise read() generates them from the UVs
+	};
+
+	// A node of the default scene, relative to its parent. A matrix in the file is split into these, which glTF
+	// requires to be possible
+	struct gltf_node
+	{
+		static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+		uint32_t parent;      // Always listed before the node
+		float translation[3];
+		float rotation[4];    // Unit quaternion, x y z w
+		float scale[3];
+	};
+
+	// One node placing a mesh
+	struct gltf_instance
+	{
+		uint32_t mesh;
+		uint32_t node;
+	};
+
+	struct gltf_stats
+	{
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+		size_t generatedTangents = 0;  // Primitives without TANGENT
+		size_t compressedBytes = 0;    // EXT_meshopt_compression views, before and after decoding
+		size_t decodedBytes = 0;
+		double parseMilliseconds = 0.0;  // Includes decodeMilliseconds
+		double decodeMilliseconds = 0.0;
+		double readMilliseconds = 0.0;
+	};
+
+	// glTF 2.0 (.gltf with external buffers) read straight into the renderer's vertex layout. open() parses the JSON,
+	// maps the buffers and lays every primitive out in one vertex and one index range; read() then fills buffers the
+	// caller sized from that, converting chunks of every primitive in parallel with SSE copies from the mapped views.
+	// Triangle lists, strips and fans are read; points and lines are skipped. Buffer views compressed with
+	// EXT_meshopt_compression are decoded in parallel during open(). Nothing here touches the GPU.
+	class gltf_file
+	{
+	public:
+		gltf_file();
+		~gltf_file();
+
+		bool open(const std::filesystem::path& filename);
+		// vertices holds get_vertex_count() vertices of layout.stride bytes; indices come out offset by each
+		// primitive's startVertex
+		void read(void* vertices, const gltf_vertex_layout& layout, uint32_t* indices);
+
+		size_t get_vertex_count() const;
+		size_t get_index_count() const;
+		size_t get_mesh_count() const;
+		const std::vector<gltf_primitive>& get_primitives() const;
+		const std::vector<gltf_material>& get_materials() const;
+		const std::vector<gltf_node>& get_nodes() const;
+		const std::vector<gltf_instance>& get_instances() const;
+		const gltf_stats& get_stats() const;
+		const std::string& get_error() const;
+
+	private:
+		struct accessor
+		{
+			const uint8_t* data;  // First element, inside a mapped buffer or m_decoded
+			size_t stride;
+			size_t count;
+			uint32_t componentType;
+			uint32_t components;
+			bool normalized;
+		};
+
+		// Accessor indices of a primitive's attributes, -1 where absent
+		struct primitive_source
+		{
+			int32_t position;
+			int32_t texcoord;
+			int32_t normal;
+			int32_t tangent;
+			int32_t indices;
+			uint32_t mode;
+		};
+
+		bool fail(const std::string& error);
+		void read_vertices(size_t primitive, size_t begin, size_t end, uint8_t* vertices, const gltf_vertex_layout& layout) const;
+		void read_indices(size_t primitive, uint32_t* indices) const;
+		void generate_tangents(size_t primitive, uint8_t* vertices, const gltf_vertex_layout& layout, const uint32_t* indices) const;
+
+	private:
+		std::vector<std::unique_ptr<mapped_file>> m_buffers;  // Null for the fallback buffers of compressed views
+		std::vector<uint8_t> m_decoded;                       // Every compressed view, decoded, one after another
+		std::vector<accessor> m_accessors;
+		std::vector<primitive_source> m_sources;  // Parallel to m_primitives
+		std::vector<gltf_primitive> m_primitives;
+		std::vector<gltf_material> m_materials;
+		std::vector<gltf_node> m_nodes;
+		std::vector<gltf_instance> m_instances;
+		size_t m_meshCount;
+		gltf_stats m_stats;
+		std::string m_error;
+	};
+}
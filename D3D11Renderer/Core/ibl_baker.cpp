@@ -0,0 +1,528 @@
+#include "ibl_baker.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <xmmintrin.h>
+
+using namespace d3d11renderer;
+
+constexpr float PI = 3.14159265f;
+
+// Rows handed to a worker at once
+constexpr size_t ROWS_PER_JOB = 8;
+
+// Bump when the baked data changes meaning so old cache files get rebuilt
+constexpr uint32_t CACHE_VERSION = 1;
+
+namespace
+{
+	struct float3
+	{
+		float x, y, z;
+	};
+
+	struct cache_header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t specularSize;
+		uint32_t specularMips;
+		uint32_t lutSize;
+		uint32_t padding;
+	};
+
+	// One level of the box-filtered panorama pyramid the specular samples read from
+	struct pyramid_level
+	{
+		size_t width = 0;
+		size_t height = 0;
+		std::vector<float> texels;
+	};
+
+	// Incoming light direction tangent to the normal, with the weight and source mip it is sampled at
+	struct specular_sample
+	{
+		float3 direction;
+		float weight;
+		size_t level;
+	};
+
+	float3 normalize(float3 v)
+	{
+		float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+		return { v.x / length, v.y / length, v.z / length };
+	}
+
+	float3 cross(float3 a, float3 b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// Texel centers of a cube face, in the D3D face order +X -X +Y -Y +Z -Z
+	float3 cube_direction(uint32_t face, float s, float t)
+	{
+		switch (face)
+		{
+		case 0: return normalize({ 1.0f, -t, -s });
+		case 1: return normalize({ -1.0f, -t, s });
+		case 2: return normalize({ s, 1.0f, t });
+		case 3: return normalize({ s, -1.0f, -t });
+		case 4: return normalize({ s, -t, 1.0f });
+		default: return normalize({ -s, -t, -1.0f });
+		}
+	}
+
+	void direction_to_uv(float3 direction, float& u, float& v)
+	{
+		u = 0.5f - std::atan2(direction.z, direction.x) / (2.0f * PI);
+		v = std::acos(std::clamp(direction.y, -1.0f, 1.0f)) / PI;
+	}
+
+	std::vector<pyramid_level> build_pyramid(const environment_map& environment)
+	{
+		std::vector<pyramid_level> levels(1);
+		levels[0].width = environment.width;
+		levels[0].height = environment.height;
+		levels[0].texels.assign(environment.texels, environment.texels + environment.width * environment.height * 4);
+
+		while (levels.back().width > 1 || levels.back().height > 1)
+		{
+			const pyramid_level& source = levels.back();
+			pyramid_level level;
+			level.width = std::max<size_t>(1, source.width / 2);
+			level.height = std::max<size_t>(1, source.height / 2);
+			level.texels.resize(level.width * level.height * 4);
+
+			__m128 quarter = _mm_set1_ps(0.25f);
+			for (size_t y = 0; y < level.height; y++)
+			{
+				size_t y0 = std::min(y * 2, source.height - 1);
+				size_t y1 = std::min(y * 2 + 1, source.height - 1);
+				for (size_t x = 0; x < level.width; x++)
+				{
+					size_t x0 = std::min(x * 2, source.width - 1);
+					size_t x1 = std::min(x * 2 + 1, source.width - 1);
+					__m128 sum = _mm_add_ps(
+						_mm_add_ps(_mm_loadu_ps(&source.texels[(y0 * source.width + x0) * 4]), _mm_loadu_ps(&source.texels[(y0 * source.width + x1) * 4])),
+						_mm_add_ps(_mm_loadu_ps(&source.texels[(y1 * source.width + x0) * 4]), _mm_loadu_ps(&source.texels[(y1 * source.width + x1) * 4])));
+					_mm_storeu_ps(&level.texels[(y * level.width + x) * 4], _mm_mul_ps(sum, quarter));
+				}
+			}
+
+			levels.push_back(std::move(level));
+		}
+
+		return levels;
+	}
+
+	// Bilinear fetch; wraps around horizontally and clamps at the poles
+	__m128 sample_bilinear(const pyramid_level& level, float u, float v)
+	{
+		float x = u * static_cast<float>(level.width) - 0.5f;
+		float y = std::clamp(v * static_cast<float>(level.height) - 0.5f, 0.0f, static_cast<float>(level.height - 1));
+
+		float xFloor = std::floor(x);
+		float yFloor = std::floor(y);
+		float fx = x - xFloor;
+		float fy = y - yFloor;
+
+		long long width = static_cast<long long>(level.width);
+		long long x0 = static_cast<long long>(xFloor) % width;
+		if (x0 < 0)
+			x0 += width;
+		size_t x1 = static_cast<size_t>((x0 + 1) % width);
+		size_t y0 = static_cast<size_t>(yFloor);
+		size_t y1 = std::min(y0 + 1, level.height - 1);
+
+		const float* texels = level.texels.data();
+		__m128 top = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(texels + (y0 * level.width + x0) * 4), _mm_set1_ps(1.0f - fx)),
+			_mm_mul_ps(_mm_loadu_ps(texels + (y0 * level.width + x1) * 4), _mm_set1_ps(fx)));
+		__m128 bottom = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(texels + (y1 * level.width + x0) * 4), _mm_set1_ps(1.0f - fx)),
+			_mm_mul_ps(_mm_loadu_ps(texels + (y1 * level.width + x1) * 4), _mm_set1_ps(fx)));
+		return _mm_add_ps(_mm_mul_ps(top, _mm_set1_ps(1.0f - fy)), _mm_mul_ps(bottom, _mm_set1_ps(fy)));
+	}
+
+	// Van der Corput sequence, the second coordinate of the Hammersley set
+	float radical_inverse(uint32_t bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return static_cast<float>(bits) * 2.3283064365386963e-10f;
+	}
+
+	// GGX-distributed half vector around +Z
+	float3 sample_ggx(uint32_t index, uint32_t count, float alpha)
+	{
+		float phi = 2.0f * PI * (static_cast<float>(index) + 0.5f) / static_cast<float>(count);
+		float xi = radical_inverse(index);
+		float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (alpha * alpha - 1.0f) * xi));
+		float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+		return { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+	}
+
+	inline float horizontal_sum(__m128 v)
+	{
+		v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+}
+
+void d3d11renderer::ibl_baker::bake(const environment_map& environment, const ibl_settings& settings, ibl_data& result)
+{
+	project_irradiance(environment, result);
+	prefilter_specular(environment, settings, result);
+	integrate_brdf(settings, result);
+}
+
+size_t d3d11renderer::ibl_baker::get_specular_offset(const ibl_data& data, uint32_t face, uint32_t mip)
+{
+	size_t faceFloats = 0;
+	size_t mipOffset = 0;
+	for (uint32_t level = 0; level < data.specularMips; level++)
+	{
+		size_t size = std::max<size_t>(1, data.specularSize >> level);
+		if (level < mip)
+			mipOffset += size * size * 4;
+		faceFloats += size * size * 4;
+	}
+	return face * faceFloats + mipOffset;
+}
+
+void d3d11renderer::ibl_baker::project_irradiance(const environment_map& environment, ibl_data& result)
+{
+	size_t width = environment.width;
+	size_t paddedWidth = (width + 3) & ~size_t(3);
+
+	// Longitude only depends on the column
+	std::vector<float> cosPhi(paddedWidth, 0.0f), sinPhi(paddedWidth, 0.0f);
+	for (size_t x = 0; x < width; x++)
+	{
+		float phi = (0.5f - (static_cast<float>(x) + 0.5f) / static_cast<float>(width)) * 2.0f * PI;
+		cosPhi[x] = std::cos(phi);
+		sinPhi[x] = std::sin(phi);
+	}
+
+	double totals[9][3] = {};
+	std::mutex totalsMutex;
+
+	parallel_for(environment.height, ROWS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		// Four texels per register; 9 coefficients times RGB accumulators
+		__m128 sums[9][3];
+		for (auto& coefficient : sums)
+			for (auto& channel : coefficient)
+				channel = _mm_setzero_ps();
+
+		alignas(16) float texels[16];
+		for (size_t y = begin; y < end; y++)
+		{
+			float theta = (static_cast<float>(y) + 0.5f) / static_cast<float>(environment.height) * PI;
+			float sinTheta = std::sin(theta);
+
+			// Solid angle of a texel in this row
+			float solidAngle = (2.0f * PI / static_cast<float>(width)) * (PI / static_cast<float>(environment.height)) * sinTheta;
+			__m128 dirY = _mm_set1_ps(std::cos(theta));
+			__m128 sinThetaV = _mm_set1_ps(sinTheta);
+			const float* row = environment.texels + y * width * 4;
+
+			for (size_t x = 0; x < width; x += 4)
+			{
+				size_t count = std::min<size_t>(4, width - x);
+				std::fill(texels, texels + 16, 0.0f);
+				std::copy(row + x * 4, row + (x + count) * 4, texels);
+
+				__m128 r = _mm_load_ps(texels);
+				__m128 g = _mm_load_ps(texels + 4);
+				__m128 b = _mm_load_ps(texels + 8);
+				__m128 a = _mm_load_ps(texels + 12);
+				_MM_TRANSPOSE4_PS(r, g, b, a);
+
+				__m128 dirX = _mm_mul_ps(sinThetaV, _mm_loadu_ps(&cosPhi[x]));
+				__m128 dirZ = _mm_mul_ps(sinThetaV, _mm_loadu_ps(&sinPhi[x]));
+
+				__m128 basis[9];
+				basis[0] = _mm_set1_ps(0.282095f);
+				basis[1] = _mm_mul_ps(_mm_set1_ps(0.488603f), dirY);
+				basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), dirZ);
+				basis[3] = _mm_mul_ps(_mm_set1_ps(0.488603f), dirX);
+				basis[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dirX, dirY));
+				basis[5] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dirY, dirZ));
+				basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dirZ, dirZ)), _mm_set1_ps(1.0f)));
+				basis[7] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dirX, dirZ));
+				basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(dirX, dirX), _mm_mul_ps(dirY, dirY)));
+
+				// Padding lanes have zero color so they add nothing
+				r = _mm_mul_ps(r, _mm_set1_ps(solidAngle));
+				g = _mm_mul_ps(g, _mm_set1_ps(solidAngle));
+				b = _mm_mul_ps(b, _mm_set1_ps(solidAngle));
+
+				for (int k = 0; k < 9; k++)
+				{
+					sums[k][0] = _mm_add_ps(sums[k][0], _mm_mul_ps(basis[k], r));
+					sums[k][1] = _mm_add_ps(sums[k][1], _mm_mul_ps(basis[k], g));
+					sums[k][2] = _mm_add_ps(sums[k][2], _mm_mul_ps(basis[k], b));
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(totalsMutex);
+		for (int k = 0; k < 9; k++)
+			for (int c = 0; c < 3; c++)
+				totals[k][c] += horizontal_sum(sums[k][c]);
+	});
+
+	// Convolve with the clamped cosine lobe (pi, 2pi/3, pi/4 per band) and divide by pi for Lambert
+	const float bandScale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	for (int k = 0; k < 9; k++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			result.irradiance[k][c] = static_cast<float>(totals[k][c]) * bandScale[k];
+		}
+		result.irradiance[k][3] = 0.0f;
+	}
+}
+
+void d3d11renderer::ibl_baker::prefilter_specular(const environment_map& environment, const ibl_settings& settings, ibl_data& result)
+{
+	std::vector<pyramid_level> pyramid = build_pyramid(environment);
+
+	result.specularSize = settings.specularSize;
+	result.specularMips = settings.specularMips;
+	result.specular.resize(get_specular_offset(result, 6, 0));
+
+	// Average solid angle of a source texel
+	float texelSolidAngle = 4.0f * PI / static_cast<float>(environment.width * environment.height);
+	size_t coarsestLevel = pyramid.size() - 1;
+
+	for (uint32_t mip = 0; mip < settings.specularMips; mip++)
+	{
+		size_t size = std::max<size_t>(1, settings.specularSize >> mip);
+		float roughness = settings.specularMips > 1 ? static_cast<float>(mip) / static_cast<float>(settings.specularMips - 1) : 0.0f;
+		float alpha = roughness * roughness;
+
+		// Samples are the same for every texel in tangent space; N = V = R as in the split-sum approximation.
+		std::vector<specular_sample> samples;
+		if (mip == 0)
+		{
+			// A mirror: one sample from the source level that matches the cube texel size
+			float cubeSolidAngle = 4.0f * PI / (6.0f * static_cast<float>(size * size));
+			float lod = std::max(0.0f, 0.5f * std::log2(cubeSolidAngle / texelSolidAngle));
+			samples.push_back({ { 0.0f, 0.0f, 1.0f }, 1.0f, std::min(static_cast<size_t>(lod + 0.5f), coarsestLevel) });
+		}
+		else
+		{
+			for (uint32_t i = 0; i < settings.specularSamples; i++)
+			{
+				float3 h = sample_ggx(i, settings.specularSamples, alpha);
+				float3 l = { 2.0f * h.z * h.x, 2.0f * h.z * h.y, 2.0f * h.z * h.z - 1.0f };
+				if (l.z <= 0.0f)
+					continue;
+
+				// Pick the source level whose texels cover the solid angle of this sample
+				float denominator = h.z * h.z * (alpha * alpha - 1.0f) + 1.0f;
+				float pdf = alpha * alpha / (PI * denominator * denominator) * 0.25f;
+				float sampleSolidAngle = 1.0f / (static_cast<float>(settings.specularSamples) * pdf);
+				float lod = std::max(0.0f, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f);
+
+				samples.push_back({ l, l.z, std::min(static_cast<size_t>(lod + 0.5f), coarsestLevel) });
+			}
+		}
+
+		float totalWeight = 0.0f;
+		for (const specular_sample& sample : samples)
+			totalWeight += sample.weight;
+		__m128 normalization = _mm_set1_ps(1.0f / totalWeight);
+
+		parallel_for(6 * size, ROWS_PER_JOB, [&](size_t begin, size_t end)
+		{
+			for (size_t row = begin; row < end; row++)
+			{
+				uint32_t face = static_cast<uint32_t>(row / size);
+				size_t y = row % size;
+				float* out = result.specular.data() + get_specular_offset(result, face, mip) + y * size * 4;
+
+				for (size_t x = 0; x < size; x++, out += 4)
+				{
+					float s = 2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(size) - 1.0f;
+					float t = 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(size) - 1.0f;
+					float3 n = cube_direction(face, s, t);
+					float3 up = std::fabs(n.y) < 0.999f ? float3{ 0.0f, 1.0f, 0.0f } : float3{ 1.0f, 0.0f, 0.0f };
+					float3 tangent = normalize(cross(up, n));
+					float3 bitangent = cross(n, tangent);
+
+					__m128 sum = _mm_setzero_ps();
+					for (const specular_sample& sample : samples)
+					{
+						const float3& l = sample.direction;
+						float3 direction = {
+							tangent.x * l.x + bitangent.x * l.y + n.x * l.z,
+							tangent.y * l.x + bitangent.y * l.y + n.y * l.z,
+							tangent.z * l.x + bitangent.z * l.y + n.z * l.z };
+
+						float u, v;
+						direction_to_uv(direction, u, v);
+						sum = _mm_add_ps(sum, _mm_mul_ps(sample_bilinear(pyramid[sample.level], u, v), _mm_set1_ps(sample.weight)));
+					}
+
+					_mm_storeu_ps(out, _mm_mul_ps(sum, normalization));
+				}
+			}
+		});
+	}
+}
+
+void d3d11renderer::ibl_baker::integrate_brdf(const ibl_settings& settings, ibl_data& result)
+{
+	size_t size = settings.lutSize;
+	size_t sampleCount = (static_cast<size_t>(settings.lutSamples) + 3) & ~size_t(3);
+
+	result.lutSize = settings.lutSize;
+	result.brdfLut.resize(size * size * 2);
+
+	parallel_for(size, ROWS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		// Half vectors of one roughness, laid out four per register. Padding lanes stay at zero and fail the N.L test.
+		std::vector<float> hx(sampleCount, 0.0f), hy(sampleCount, 0.0f), hz(sampleCount, 0.0f);
+
+		for (size_t y = begin; y < end; y++)
+		{
+			float roughness = (static_cast<float>(y) + 0.5f) / static_cast<float>(size);
+			float alpha = roughness * roughness;
+			for (uint32_t i = 0; i < settings.lutSamples; i++)
+			{
+				float3 h = sample_ggx(i, settings.lutSamples, alpha);
+				hx[i] = h.x;
+				hy[i] = h.y;
+				hz[i] = h.z;
+			}
+
+			// Schlick-Smith visibility with k = alpha / 2 for image-based lighting
+			__m128 k = _mm_set1_ps(alpha * 0.5f);
+			__m128 oneMinusK = _mm_set1_ps(1.0f - alpha * 0.5f);
+			__m128 one = _mm_set1_ps(1.0f);
+			__m128 two = _mm_set1_ps(2.0f);
+
+			for (size_t x = 0; x < size; x++)
+			{
+				float nDotVScalar = (static_cast<float>(x) + 0.5f) / static_cast<float>(size);
+				__m128 nDotV = _mm_set1_ps(nDotVScalar);
+				__m128 viewX = _mm_set1_ps(std::sqrt(1.0f - nDotVScalar * nDotVScalar));
+				__m128 visibilityV = _mm_div_ps(nDotV, _mm_add_ps(_mm_mul_ps(nDotV, oneMinusK), k));
+
+				__m128 scale = _mm_setzero_ps();
+				__m128 bias = _mm_setzero_ps();
+				for (size_t i = 0; i < sampleCount; i += 4)
+				{
+					__m128 halfX = _mm_loadu_ps(&hx[i]);
+					__m128 nDotH = _mm_loadu_ps(&hz[i]);
+					__m128 vDotH = _mm_add_ps(_mm_mul_ps(viewX, halfX), _mm_mul_ps(nDotV, nDotH));
+					__m128 nDotL = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, vDotH), nDotH), nDotV);
+					__m128 valid = _mm_and_ps(_mm_cmpgt_ps(nDotL, _mm_setzero_ps()), _mm_cmpgt_ps(nDotH, _mm_setzero_ps()));
+
+					__m128 visibilityL = _mm_div_ps(nDotL, _mm_add_ps(_mm_mul_ps(nDotL, oneMinusK), k));
+					__m128 visibility = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(visibilityV, visibilityL), vDotH), _mm_mul_ps(nDotH, nDotV));
+					visibility = _mm_and_ps(valid, visibility);
+
+					// Schlick Fresnel weight (1 - V.H)^5
+					__m128 f = _mm_sub_ps(one, vDotH);
+					__m128 f2 = _mm_mul_ps(f, f);
+					__m128 fresnel = _mm_mul_ps(_mm_mul_ps(f2, f2), f);
+
+					scale = _mm_add_ps(scale, _mm_mul_ps(_mm_sub_ps(one, fresnel), visibility));
+					bias = _mm_add_ps(bias, _mm_mul_ps(fresnel, visibility));
+				}
+
+				float* out = &result.brdfLut[(y * size + x) * 2];
+				out[0] = horizontal_sum(scale) / static_cast<float>(settings.lutSamples);
+				out[1] = horizontal_sum(bias) / static_cast<float>(settings.lutSamples);
+			}
+		}
+	});
+}
+
+uint64_t d3d11renderer::ibl_baker::compute_key(const std::filesystem::path& sourcePath, const ibl_settings& settings)
+{
+	std::ifstream file(sourcePath, std::ios::binary);
+	if (!file)
+	{
+		return 0;
+	}
+
+	// FNV-1a over the file, then the version and settings
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const uint8_t* bytes, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	std::vector<char> buffer(1 << 20);
+	while (file)
+	{
+		file.read(buffer.data(), buffer.size());
+		mix(reinterpret_cast<const uint8_t*>(buffer.data()), static_cast<size_t>(file.gcount()));
+	}
+
+	const uint32_t parameters[] = { CACHE_VERSION, settings.specularSize, settings.specularMips, settings.specularSamples, settings.lutSize, settings.lutSamples };
+	mix(reinterpret_cast<const uint8_t*>(parameters), sizeof(parameters));
+
+	return hash;
+}
+
+bool d3d11renderer::ibl_baker::load_cache(const std::filesystem::path& path, uint64_t key, ibl_data& result)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	cache_header header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || std::string_view(header.magic, 4) != "IBL1" || header.version != CACHE_VERSION || header.key != key)
+	{
+		return false;
+	}
+
+	result.specularSize = header.specularSize;
+	result.specularMips = header.specularMips;
+	result.lutSize = header.lutSize;
+	result.specular.resize(get_specular_offset(result, 6, 0));
+	result.brdfLut.resize(static_cast<size_t>(header.lutSize) * header.lutSize * 2);
+
+	file.read(reinterpret_cast<char*>(result.irradiance), sizeof(result.irradiance));
+	file.read(reinterpret_cast<char*>(result.specular.data()), result.specular.size() * sizeof(float));
+	file.read(reinterpret_cast<char*>(result.brdfLut.data()), result.brdfLut.size() * sizeof(float));
+
+	return static_cast<bool>(file);
+}
+
+bool d3d11renderer::ibl_baker::save_cache(const std::filesystem::path& path, uint64_t key, const ibl_data& data)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	cache_header header = { { 'I', 'B', 'L', '1' }, CACHE_VERSION, key, data.specularSize, data.specularMips, data.lutSize, 0 };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(data.irradiance), sizeof(data.irradiance));
+	file.write(reinterpret_cast<const char*>(data.specular.data()), data.specular.size() * sizeof(float));
+	file.write(reinterpret_cast<const char*>(data.brdfLut.data()), data.brdfLut.size() * sizeof(float));
+
+	return static_cast<bool>(file);
+}
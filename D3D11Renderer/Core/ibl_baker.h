@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace d3d11renderer
+{
+	// Lat-long HDR environment with 4 floats per texel.
+	// Direction d maps to u = 0.5 - atan2(d.z, d.x) / 2pi and v = acos(d.y) / pi, the same as skyboxps.hlsl.
+	struct environment_map
+	{
+		size_t width = 0;
+		size_t height = 0;
+		const float* texels = nullptr;
+	};
+
+	struct ibl_settings
+	{
+		uint32_t specularSize = 128;     // Top mip of each prefiltered cube face
+		uint32_t specularMips = 6;       // Roughness goes from 0 on the top mip to 1 on the last one
+		uint32_t specularSamples = 128;  // GGX samples per texel
+		uint32_t lutSize = 128;
+		uint32_t lutSamples = 256;
+	};
+
+	struct ibl_data
+	{
+		float irradiance[9][4] = {};  // SH9 of the cosine-convolved environment over pi, RGB and a pad, as the shader reads it
+		uint32_t specularSize = 0;
+		uint32_t specularMips = 0;
+		std::vector<float> specular;  // RGBA, faces +X -X +Y -Y +Z -Z, each face's mips finest first
+		uint32_t lutSize = 0;
+		std::vector<float> brdfLut;   // RG, scale and bias on F0; x is N.V and y is roughness
+	};
+
+	// Precomputes image-based lighting from an HDR panorama:
+	// SH9 diffuse irradiance, a GGX-prefiltered specular cube mip chain and the split-sum BRDF LUT.
+	// Everything runs on the CPU with SSE, split across worker threads.
+	class ibl_baker
+	{
+	public:
+		static void bake(const environment_map& environment, const ibl_settings& settings, ibl_data& result);
+
+		// Offset in floats of one face mip inside ibl_data::specular
+		static size_t get_specular_offset(const ibl_data& data, uint32_t face, uint32_t mip);
+
+		// Cache files are keyed by a hash of the source file and the settings used to bake them
+		static uint64_t compute_key(const std::filesystem::path& sourcePath, const ibl_settings& settings);
+		static bool load_cache(const std::filesystem::path& path, uint64_t key, ibl_data& result);
+		static bool save_cache(const std::filesystem::path& path, uint64_t key, const ibl_data& data);
+
+	private:
+		static void project_irradiance(const environment_map& environment, ibl_data& result);
+		static void prefilter_specular(const environment_map& environment, const ibl_settings& settings, ibl_data& result);
+		static void integrate_brdf(const ibl_settings& settings, ibl_data& result);
+	};
+}
@@ -0,0 +1,409 @@
+#include "json.h"
+
+#include <charconv>
+#include <cstring>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	class json_parser
+	{
+	public:
+		json_parser(const char* text, size_t size)
+			: m_cursor(text), m_begin(text), m_end(text + size)
+		{
+		}
+
+		bool parse(json_value& value, std::string& error)
+		{
+			if (!parse_value(value, 0))
+			{
+				error = m_error.empty() ? "JSON error at byte " + std::to_string(m_cursor - m_begin) : m_error;
+				return false;
+			}
+			skip_whitespace();
+			if (m_cursor != m_end)
+			{
+				error = "JSON error: trailing data at byte " + std::to_string(m_cursor - m_begin);
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		static constexpr int MAX_DEPTH = 256;
+
+		void skip_whitespace()
+		{
+			while (m_cursor < m_end && (*m_cursor == ' ' || *m_cursor == '\t' || *m_cursor == '\n' || *m_cursor == '\r'))
+				m_cursor++;
+		}
+
+		bool match(const char* literal)
+		{
+			size_t length = std::strlen(literal);
+			if (static_cast<size_t>(m_end - m_cursor) < length || std::memcmp(m_cursor, literal, length) != 0)
+				return false;
+			m_cursor += length;
+			return true;
+		}
+
+		bool parse_value(json_value& value, int depth)
+		{
+			skip_whitespace();
+			if (m_cursor == m_end)
+				return false;
+			if (depth > MAX_DEPTH)
+			{
+				m_error = "JSON error: nested deeper than " + std::to_string(MAX_DEPTH) + " levels at byte " + std::to_string(m_cursor - m_begin);
+				return false;
+			}
+
+			switch (*m_cursor)
+			{
+			case '{':
+				value.type = json_value::kind::Object;
+				m_cursor++;
+				skip_whitespace();
+				if (m_cursor < m_end && *m_cursor == '}')
+				{
+					m_cursor++;
+					return true;
+				}
+				for (;;)
+				{
+					value.members.emplace_back();
+					skip_whitespace();
+					if (!parse_string(value.members.back().first))
+						return false;
+					skip_whitespace();
+					if (m_cursor == m_end || *m_cursor++ != ':')
+						return false;
+					if (!parse_value(value.members.back().second, depth + 1))
+						return false;
+					skip_whitespace();
+					if (m_cursor == m_end)
+						return false;
+					char next = *m_cursor++;
+					if (next == '}')
+						return true;
+					if (next != ',')
+						return false;
+				}
+			case '[':
+				value.type = json_value::kind::Array;
+				m_cursor++;
+				skip_whitespace();
+				if (m_cursor < m_end && *m_cursor == ']')
+				{
+					m_cursor++;
+					return true;
+				}
+				for (;;)
+				{
+					value.items.emplace_back();
+					if (!parse_value(value.items.back(), depth + 1))
+						return false;
+					skip_whitespace();
+					if (m_cursor == m_end)
+						return false;
+					char next = *m_cursor++;
+					if (next == ']')
+						return true;
+					if (next != ',')
+						return false;
+				}
+			case '"':
+				value.type = json_value::kind::String;
+				return parse_string(value.string);
+			case 't':
+				value.type = json_value::kind::Boolean;
+				value.boolean = true;
+				return match("true");
+			case 'f':
+				value.type = json_value::kind::Boolean;
+				return match("false");
+			case 'n':
+				return match("null");
+			default:
+			{
+				value.type = json_value::kind::Number;
+				auto result = std::from_chars(m_cursor, m_end, value.number);
+				if (result.ec != std::errc())
+					return false;
+				m_cursor = result.ptr;
+				return true;
+			}
+			}
+		}
+
+		bool parse_hex(uint32_t& code)
+		{
+			if (m_end - m_cursor < 4)
+				return false;
+			auto result = std::from_chars(m_cursor, m_cursor + 4, code, 16);
+			if (result.ptr != m_cursor + 4)
+				return false;
+			m_cursor += 4;
+			return true;
+		}
+
+		bool parse_string(std::string& text)
+		{
+			if (m_cursor == m_end || *m_cursor != '"')
+				return false;
+			m_cursor++;
+
+			for (;;)
+			{
+				const char* run = m_cursor;
+				while (m_cursor < m_end && *m_cursor != '"' && *m_cursor != '\\')
+					m_cursor++;
+				text.append(run, m_cursor);
+				if (m_cursor == m_end)
+					return false;
+				if (*m_cursor++ == '"')
+					return true;
+
+				if (m_cursor == m_end)
+					return false;
+				char escape = *m_cursor++;
+				switch (escape)
+				{
+				case '"': case '\\': case '/': text += escape; break;
+				case 'b': text += '\b'; break;
+				case 'f': text += '\f'; break;
+				case 'n': text += '\n'; break;
+				case 'r': text += '\r'; break;
+				case 't': text += '\t'; break;
+				case 'u':
+				{
+					uint32_t code = 0;
+					if (!parse_hex(code))
+						return false;
+					// A surrogate pair spells one code point above the basic plane
+					if (code >= 0xD800 && code < 0xDC00)
+					{
+						uint32_t low = 0;
+						if (!match("\\u") || !parse_hex(low) || low < 0xDC00 || low >= 0xE000)
+							return false;
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+
+					if (code < 0x80)
+					{
+						text += static_cast<char>(code);
+					}
+					else if (code < 0x800)
+					{
+						text += static_cast<char>(0xC0 | (code >> 6));
+						text += static_cast<char>(0x80 | (code & 0x3F));
+					}
+					else if (code < 0x10000)
+					{
+						text += static_cast<char>(0xE0 | (code >> 12));
+						text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+						text += static_cast<char>(0x80 | (code & 0x3F));
+					}
+					else
+					{
+						text += static_cast<char>(0xF0 | (code >> 18));
+						text += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+						text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+						text += static_cast<char>(0x80 | (code & 0x3F));
+					}
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+		}
+
+	private:
+		const char* m_cursor;
+		const char* m_begin;
+		const char* m_end;
+		std::string m_error;  // Set by failures that need more than the byte offset
+	};
+
+	void write_string(const std::string& value, std::string& text)
+	{
+		static const char hex[] = "0123456789abcdef";
+		text += '"';
+		for (char c : value)
+		{
+			switch (c)
+			{
+			case '"': text += "\\\""; break;
+			case '\\': text += "\\\\"; break;
+			case '\n': text += "\\n"; break;
+			case '\r': text += "\\r"; break;
+			case '\t': text += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					text += "\\u00";
+					text += hex[(c >> 4) & 15];
+					text += hex[c & 15];
+				}
+				else
+				{
+					text += c;
+				}
+			}
+		}
+		text += '"';
+	}
+
+	void write_value(const json_value& value, std::string& text)
+	{
+		switch (value.type)
+		{
+		case json_value::kind::Null:
+			text += "null";
+			break;
+		case json_value::kind::Boolean:
+			text += value.boolean ? "true" : "false";
+			break;
+		case json_value::kind::Number:
+		{
+			char buffer[32];
+			auto result = std::to_chars(buffer, buffer + sizeof(buffer), value.number);
+			text.append(buffer, result.ptr);
+			break;
+		}
+		case json_value::kind::String:
+			write_string(value.string, text);
+			break;
+		case json_value::kind::Array:
+			text += '[';
+			for (size_t i = 0; i < value.items.size(); i++)
+			{
+				if (i > 0)
+					text += ',';
+				write_value(value.items[i], text);
+			}
+			text += ']';
+			break;
+		case json_value::kind::Object:
+			text += '{';
+			for (size_t i = 0; i < value.members.size(); i++)
+			{
+				if (i > 0)
+					text += ',';
+				write_string(value.members[i].first, text);
+				text += ':';
+				write_value(value.members[i].second, text);
+			}
+			text += '}';
+			break;
+		}
+	}
+}
+
+json_value d3d11renderer::json_value::make_number(double value)
+{
+	json_value result;
+	result.type = kind::Number;
+	result.number = value;
+	return result;
+}
+
+json_value d3d11renderer::json_value::make_string(const std::string& value)
+{
+	json_value result;
+	result.type = kind::String;
+	result.string = value;
+	return result;
+}
+
+json_value d3d11renderer::json_value::make_boolean(bool value)
+{
+	json_value result;
+	result.type = kind::Boolean;
+	result.boolean = value;
+	return result;
+}
+
+json_value d3d11renderer::json_value::make_array()
+{
+	json_value result;
+	result.type = kind::Array;
+	return result;
+}
+
+json_value d3d11renderer::json_value::make_object()
+{
+	json_value result;
+	result.type = kind::Object;
+	return result;
+}
+
+const json_value* d3d11renderer::json_value::find(const char* key) const
+{
+	for (const auto& member : members)
+	{
+		if (member.first == key)
+			return &member.second;
+	}
+	return nullptr;
+}
+
+json_value* d3d11renderer::json_value::find(const char* key)
+{
+	return const_cast<json_value*>(static_cast<const json_value*>(this)->find(key));
+}
+
+json_value& d3d11renderer::json_value::member(const char* key)
+{
+	if (json_value* existing = find(key))
+		return *existing;
+
+	type = kind::Object;
+	members.emplace_back(key, json_value());
+	return members.back().second;
+}
+
+void d3d11renderer::json_value::erase(const char* key)
+{
+	for (auto it = members.begin(); it != members.end(); ++it)
+	{
+		if (it->first == key)
+		{
+			members.erase(it);
+			return;
+		}
+	}
+}
+
+int64_t d3d11renderer::json_value::integer(const char* key, int64_t fallback) const
+{
+	const json_value* value = find(key);
+	return value && value->type == kind::Number ? static_cast<int64_t>(value->number) : fallback;
+}
+
+double d3d11renderer::json_value::number_or(const char* key, double fallback) const
+{
+	const json_value* value = find(key);
+	return value && value->type == kind::Number ? value->number : fallback;
+}
+
+const std::vector<json_value>& d3d11renderer::json_value::array(const char* key) const
+{
+	static const std::vector<json_value> empty;
+	const json_value* value = find(key);
+	return value && value->type == kind::Array ? value->items : empty;
+}
+
+bool d3d11renderer::parse_json(const char* text, size_t size, json_value& value, std::string& error)
+{
+	value = json_value();
+	return json_parser(text, size).parse(value, error);
+}
+
+void d3d11renderer::write_json(const json_value& value, std::string& text)
+{
+	write_value(value, text);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace d3d11renderer
+{
+	// A parsed JSON document, small enough next to the binary data of the formats that use it that a plain tree is fine.
+	// Object members keep their file order, so a document written back out reads the same.
+	struct json_value
+	{
+		enum class kind : uint8_t { Null, Boolean, Number, String, Array, Object };
+
+		kind type = kind::Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<json_value> items;                             // Array elements
+		std::vector<std::pair<std::string, json_value>> members;  // Object members
+
+		static json_value make_number(double value);
+		static json_value make_string(const std::string& value);
+		static json_value make_boolean(bool value);
+		static json_value make_array();
+		static json_value make_object();
+
+		const json_value* find(const char* key) const;
+		json_value* find(const char* key);
+		// The member with this key, added as null if there is none
+		json_value& member(const char* key);
+		void erase(const char* key);
+
+		// Typed reads that fall back when the member is missing or of another type
+		int64_t integer(const char* key, int64_t fallback) const;
+		double number_or(const char* key, double fallback) const;
+		const std::vector<json_value>& array(const char* key) const;
+	};
+
+	// Recursive descent with a depth limit; error names the byte offset where parsing stopped
+	bool parse_json(const char* text, size_t size, json_value& value, std::string& error);
+	// Compact, numbers in their shortest form that reads back exactly
+	void write_json(const json_value& value, std::string& text);
+}
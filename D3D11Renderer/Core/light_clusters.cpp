@@ -0,0 +1,471 @@
+#include "light_clusters.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace d3d11renderer;
+
+// Lights per worker job when computing bounds; a multiple of 4
+constexpr size_t LIGHTS_PER_JOB = 1024;
+
+namespace
+{
+	// Four consecutive values, padded with the last one past the end
+	__m128 load4(const std::vector<float>& values, size_t index)
+	{
+		if (index + 4 <= values.size())
+		{
+			return _mm_loadu_ps(values.data() + index);
+		}
+
+		float lanes[4];
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			lanes[lane] = values[std::min(index + lane, values.size() - 1)];
+		}
+		return _mm_loadu_ps(lanes);
+	}
+
+	uint32_t to_tile(float ndc, uint32_t tiles)
+	{
+		float tile = std::floor((ndc * 0.5f + 0.5f) * static_cast<float>(tiles));
+		return static_cast<uint32_t>(std::clamp(tile, 0.0f, static_cast<float>(tiles - 1)));
+	}
+}
+
+size_t d3d11renderer::punctual_lights::size() const
+{
+	return positionX.size();
+}
+
+void d3d11renderer::punctual_lights::clear()
+{
+	for (auto* values : { &positionX, &positionY, &positionZ, &range, &colorR, &colorG, &colorB, &directionX, &directionY, &directionZ, &cosInner, &cosOuter })
+	{
+		values->clear();
+	}
+}
+
+void d3d11renderer::punctual_lights::add_point(float x, float y, float z, float lightRange, float r, float g, float b)
+{
+	add_spot(x, y, z, 0.0f, 0.0f, 1.0f, lightRange, 0.0f, 0.0f, r, g, b);
+	cosInner.back() = -1.0f;
+	cosOuter.back() = -1.0f;
+}
+
+void d3d11renderer::punctual_lights::add_spot(float x, float y, float z, float dx, float dy, float dz, float lightRange, float innerAngle, float outerAngle,
+	float r, float g, float b)
+{
+	float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+	length = length > 0.0f ? length : 1.0f;
+
+	positionX.push_back(x);
+	positionY.push_back(y);
+	positionZ.push_back(z);
+	range.push_back(lightRange);
+	colorR.push_back(r);
+	colorG.push_back(g);
+	colorB.push_back(b);
+	directionX.push_back(dx / length);
+	directionY.push_back(dy / length);
+	directionZ.push_back(dz / length);
+	cosInner.push_back(std::cos(innerAngle));
+	cosOuter.push_back(std::cos(outerAngle));
+}
+
+d3d11renderer::light_clusters::light_clusters(const cluster_settings& settings)
+	: m_settings(settings), m_rowStride((settings.tilesX + 3) & ~3u),
+	m_scaleX(0.0f), m_scaleY(0.0f), m_nearZ(0.0f), m_farZ(0.0f), m_sliceScale(0.0f), m_sliceBias(0.0f)
+{
+	size_t clusterCount = static_cast<size_t>(settings.tilesX) * settings.tilesY * settings.slices;
+	m_chunks.resize((settings.indexCapacity + light_chunk::SIZE - 1) / light_chunk::SIZE);
+	m_nextChunk = 0;
+	m_clusterCounts.resize(clusterCount);
+	m_clusterFirst.resize(clusterCount);
+	m_clusterLast.resize(clusterCount);
+	m_sliceDropped.resize(settings.slices);
+	m_ranges.resize(clusterCount);
+	m_indices.reserve(m_chunks.size() * light_chunk::SIZE);
+}
+
+void d3d11renderer::light_clusters::build(const punctual_lights& lights, const float view[4][4], const float projection[4][4])
+{
+	auto start = std::chrono::steady_clock::now();
+
+	build_cluster_bounds(projection);
+
+	size_t count = lights.size();
+	size_t paddedCount = (count + 3) & ~size_t(3);
+	for (auto* values : { &m_viewX, &m_viewY, &m_viewZ, &m_viewDirectionX, &m_viewDirectionY, &m_viewDirectionZ, &m_sinOuter })
+	{
+		values->resize(paddedCount);
+	}
+	m_bounds.resize(paddedCount);
+	m_lights.resize(count);
+
+	parallel_for(paddedCount, LIGHTS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		compute_light_bounds(lights, begin, end, view);
+	});
+
+	m_nextChunk = 0;
+	parallel_for(m_settings.slices, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t slice = begin; slice < end; slice++)
+		{
+			bin_slice(lights, static_cast<uint32_t>(slice));
+		}
+	});
+
+	// Flatten the per-cluster lists
+	uint32_t offset = 0;
+	m_stats.maxLightsPerCluster = 0;
+	for (size_t cluster = 0; cluster < m_clusterCounts.size(); cluster++)
+	{
+		uint32_t clusterCount = m_clusterCounts[cluster];
+		m_ranges[cluster] = { offset, clusterCount };
+		m_stats.maxLightsPerCluster = std::max(m_stats.maxLightsPerCluster, clusterCount);
+		offset += clusterCount;
+	}
+	m_indices.resize(offset);
+
+	parallel_for(m_clusterCounts.size(), 256, [&](size_t begin, size_t end)
+	{
+		for (size_t cluster = begin; cluster < end; cluster++)
+		{
+			uint32_t* destination = m_indices.data() + m_ranges[cluster].offset;
+			uint32_t chunk = m_clusterFirst[cluster];
+			for (uint32_t remaining = m_clusterCounts[cluster]; remaining > 0; chunk = m_chunks[chunk].next)
+			{
+				uint32_t count = std::min(remaining, light_chunk::SIZE);
+				destination = std::copy(m_chunks[chunk].lights, m_chunks[chunk].lights + count, destination);
+				remaining -= count;
+			}
+		}
+	});
+
+	m_stats.droppedLights = 0;
+	for (size_t dropped : m_sliceDropped)
+	{
+		m_stats.droppedLights += dropped;
+	}
+
+	m_stats.lightCount = count;
+	m_stats.indexCount = m_indices.size();
+	m_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void d3d11renderer::light_clusters::add_light(size_t cluster, uint32_t light, uint32_t slice)
+{
+	// A full chunk, or none yet, takes the next one from the pool
+	uint32_t slot = m_clusterCounts[cluster] % light_chunk::SIZE;
+	if (slot == 0)
+	{
+		size_t chunk = m_nextChunk.fetch_add(1, std::memory_order_relaxed);
+		if (chunk >= m_chunks.size())
+		{
+			m_sliceDropped[slice]++;
+			return;
+		}
+
+		if (m_clusterCounts[cluster] == 0)
+			m_clusterFirst[cluster] = static_cast<uint32_t>(chunk);
+		else
+			m_chunks[m_clusterLast[cluster]].next = static_cast<uint32_t>(chunk);
+		m_clusterLast[cluster] = static_cast<uint32_t>(chunk);
+	}
+
+	m_chunks[m_clusterLast[cluster]].lights[slot] = light;
+	m_clusterCounts[cluster]++;
+}
+
+const d3d11renderer::cluster_settings& d3d11renderer::light_clusters::get_settings() const
+{
+	return m_settings;
+}
+
+const d3d11renderer::cluster_stats& d3d11renderer::light_clusters::get_stats() const
+{
+	return m_stats;
+}
+
+const std::vector<d3d11renderer::packed_light>& d3d11renderer::light_clusters::get_lights() const
+{
+	return m_lights;
+}
+
+const std::vector<d3d11renderer::cluster_range>& d3d11renderer::light_clusters::get_ranges() const
+{
+	return m_ranges;
+}
+
+const std::vector<uint32_t>& d3d11renderer::light_clusters::get_indices() const
+{
+	return m_indices;
+}
+
+float d3d11renderer::light_clusters::get_slice_scale() const
+{
+	return m_sliceScale;
+}
+
+float d3d11renderer::light_clusters::get_slice_bias() const
+{
+	return m_sliceBias;
+}
+
+void d3d11renderer::light_clusters::build_cluster_bounds(const float projection[4][4])
+{
+	// A left-handed perspective keeps near and far in its third column
+	float scaleX = projection[0][0];
+	float scaleY = projection[1][1];
+	float nearZ = -projection[3][2] / projection[2][2];
+	float farZ = projection[3][2] / (1.0f - projection[2][2]);
+	if (scaleX == m_scaleX && scaleY == m_scaleY && nearZ == m_nearZ && farZ == m_farZ)
+	{
+		return;
+	}
+
+	m_scaleX = scaleX;
+	m_scaleY = scaleY;
+	m_nearZ = nearZ;
+	m_farZ = farZ;
+	m_sliceScale = static_cast<float>(m_settings.slices) / std::log(farZ / nearZ);
+	m_sliceBias = -std::log(nearZ) * m_sliceScale;
+
+	size_t paddedCount = static_cast<size_t>(m_rowStride) * m_settings.tilesY * m_settings.slices;
+	for (auto* values : { &m_boxMinX, &m_boxMinY, &m_boxMinZ, &m_sphereX, &m_sphereY, &m_sphereZ })
+	{
+		values->assign(paddedCount, FLT_MAX);
+	}
+	for (auto* values : { &m_boxMaxX, &m_boxMaxY, &m_boxMaxZ, &m_sphereRadius })
+	{
+		values->assign(paddedCount, -FLT_MAX);
+	}
+
+	for (uint32_t slice = 0; slice < m_settings.slices; slice++)
+	{
+		float sliceNear = nearZ * std::pow(farZ / nearZ, static_cast<float>(slice) / m_settings.slices);
+		float sliceFar = nearZ * std::pow(farZ / nearZ, static_cast<float>(slice + 1) / m_settings.slices);
+
+		for (uint32_t y = 0; y < m_settings.tilesY; y++)
+		{
+			// Tile rows go down the screen, NDC y goes up
+			float top = 1.0f - 2.0f * y / m_settings.tilesY;
+			float bottom = 1.0f - 2.0f * (y + 1) / m_settings.tilesY;
+
+			for (uint32_t x = 0; x < m_settings.tilesX; x++)
+			{
+				float left = -1.0f + 2.0f * x / m_settings.tilesX;
+				float right = -1.0f + 2.0f * (x + 1) / m_settings.tilesX;
+
+				size_t index = (static_cast<size_t>(slice) * m_settings.tilesY + y) * m_rowStride + x;
+				m_boxMinX[index] = std::min(left * sliceNear, left * sliceFar) / scaleX;
+				m_boxMaxX[index] = std::max(right * sliceNear, right * sliceFar) / scaleX;
+				m_boxMinY[index] = std::min(bottom * sliceNear, bottom * sliceFar) / scaleY;
+				m_boxMaxY[index] = std::max(top * sliceNear, top * sliceFar) / scaleY;
+				m_boxMinZ[index] = sliceNear;
+				m_boxMaxZ[index] = sliceFar;
+
+				float halfX = 0.5f * (m_boxMaxX[index] - m_boxMinX[index]);
+				float halfY = 0.5f * (m_boxMaxY[index] - m_boxMinY[index]);
+				float halfZ = 0.5f * (sliceFar - sliceNear);
+				m_sphereX[index] = m_boxMinX[index] + halfX;
+				m_sphereY[index] = m_boxMinY[index] + halfY;
+				m_sphereZ[index] = sliceNear + halfZ;
+				m_sphereRadius[index] = std::sqrt(halfX * halfX + halfY * halfY + halfZ * halfZ);
+			}
+		}
+	}
+}
+
+void d3d11renderer::light_clusters::compute_light_bounds(const punctual_lights& lights, size_t begin, size_t end, const float view[4][4])
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 nearZ = _mm_set1_ps(m_nearZ);
+	const __m128 farZ = _mm_set1_ps(m_farZ);
+	const __m128 scaleX = _mm_set1_ps(m_scaleX);
+	const __m128 scaleY = _mm_set1_ps(m_scaleY);
+
+	for (size_t i = begin; i < end; i += 4)
+	{
+		__m128 px = load4(lights.positionX, i);
+		__m128 py = load4(lights.positionY, i);
+		__m128 pz = load4(lights.positionZ, i);
+		__m128 dx = load4(lights.directionX, i);
+		__m128 dy = load4(lights.directionY, i);
+		__m128 dz = load4(lights.directionZ, i);
+		__m128 radius = load4(lights.range, i);
+		__m128 cosOuter = load4(lights.cosOuter, i);
+
+		// Row vectors times the view matrix
+		__m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(view[0][0])), _mm_mul_ps(py, _mm_set1_ps(view[1][0]))),
+			_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(view[2][0])), _mm_set1_ps(view[3][0])));
+		__m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(view[0][1])), _mm_mul_ps(py, _mm_set1_ps(view[1][1]))),
+			_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(view[2][1])), _mm_set1_ps(view[3][1])));
+		__m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(view[0][2])), _mm_mul_ps(py, _mm_set1_ps(view[1][2]))),
+			_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(view[2][2])), _mm_set1_ps(view[3][2])));
+		__m128 vdx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_set1_ps(view[0][0])), _mm_mul_ps(dy, _mm_set1_ps(view[1][0]))), _mm_mul_ps(dz, _mm_set1_ps(view[2][0])));
+		__m128 vdy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_set1_ps(view[0][1])), _mm_mul_ps(dy, _mm_set1_ps(view[1][1]))), _mm_mul_ps(dz, _mm_set1_ps(view[2][1])));
+		__m128 vdz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_set1_ps(view[0][2])), _mm_mul_ps(dy, _mm_set1_ps(view[1][2]))), _mm_mul_ps(dz, _mm_set1_ps(view[2][2])));
+		__m128 sinOuter = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(cosOuter, cosOuter)), zero));
+
+		_mm_storeu_ps(m_viewX.data() + i, vx);
+		_mm_storeu_ps(m_viewY.data() + i, vy);
+		_mm_storeu_ps(m_viewZ.data() + i, vz);
+		_mm_storeu_ps(m_viewDirectionX.data() + i, vdx);
+		_mm_storeu_ps(m_viewDirectionY.data() + i, vdy);
+		_mm_storeu_ps(m_viewDirectionZ.data() + i, vdz);
+		_mm_storeu_ps(m_sinOuter.data() + i, sinOuter);
+
+		// Depth range clipped to the frustum; lights entirely in front of near or behind far are culled
+		__m128 minZ = _mm_sub_ps(vz, radius);
+		__m128 maxZ = _mm_add_ps(vz, radius);
+		__m128 visible = _mm_and_ps(_mm_cmpge_ps(maxZ, nearZ), _mm_cmple_ps(minZ, farZ));
+		minZ = _mm_max_ps(minZ, nearZ);
+		maxZ = _mm_min_ps(maxZ, farZ);
+
+		// Conservative NDC extent of the sphere's view-space box: divide each edge by whichever depth widens it
+		__m128 left = _mm_sub_ps(vx, radius);
+		__m128 right = _mm_add_ps(vx, radius);
+		__m128 bottom = _mm_sub_ps(vy, radius);
+		__m128 top = _mm_add_ps(vy, radius);
+		__m128 minNdcX = _mm_div_ps(_mm_mul_ps(left, scaleX), _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(left, zero), minZ), _mm_andnot_ps(_mm_cmplt_ps(left, zero), maxZ)));
+		__m128 maxNdcX = _mm_div_ps(_mm_mul_ps(right, scaleX), _mm_or_ps(_mm_and_ps(_mm_cmpgt_ps(right, zero), minZ), _mm_andnot_ps(_mm_cmpgt_ps(right, zero), maxZ)));
+		__m128 minNdcY = _mm_div_ps(_mm_mul_ps(bottom, scaleY), _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(bottom, zero), minZ), _mm_andnot_ps(_mm_cmplt_ps(bottom, zero), maxZ)));
+		__m128 maxNdcY = _mm_div_ps(_mm_mul_ps(top, scaleY), _mm_or_ps(_mm_and_ps(_mm_cmpgt_ps(top, zero), minZ), _mm_andnot_ps(_mm_cmpgt_ps(top, zero), maxZ)));
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmple_ps(minNdcX, _mm_set1_ps(1.0f)), _mm_cmpge_ps(maxNdcX, _mm_set1_ps(-1.0f))));
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmple_ps(minNdcY, _mm_set1_ps(1.0f)), _mm_cmpge_ps(maxNdcY, _mm_set1_ps(-1.0f))));
+
+		alignas(16) float lanes[6][4];
+		_mm_store_ps(lanes[0], minNdcX);
+		_mm_store_ps(lanes[1], maxNdcX);
+		_mm_store_ps(lanes[2], minNdcY);
+		_mm_store_ps(lanes[3], maxNdcY);
+		_mm_store_ps(lanes[4], minZ);
+		_mm_store_ps(lanes[5], maxZ);
+		int visibleMask = _mm_movemask_ps(visible);
+
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			light_bounds& bounds = m_bounds[i + lane];
+			if (!(visibleMask & (1 << lane)) || i + lane >= lights.size())
+			{
+				bounds = { 1, 0, 1, 0, 1, 0 };
+				continue;
+			}
+
+			bounds.minX = to_tile(lanes[0][lane], m_settings.tilesX);
+			bounds.maxX = to_tile(lanes[1][lane], m_settings.tilesX);
+			bounds.minY = to_tile(-lanes[3][lane], m_settings.tilesY);
+			bounds.maxY = to_tile(-lanes[2][lane], m_settings.tilesY);
+			bounds.minSlice = get_slice(lanes[4][lane]);
+			bounds.maxSlice = get_slice(lanes[5][lane]);
+
+			size_t index = i + lane;
+			packed_light& packed = m_lights[index];
+			bool spot = lights.cosOuter[index] > -1.0f;
+			packed.position[0] = lights.positionX[index];
+			packed.position[1] = lights.positionY[index];
+			packed.position[2] = lights.positionZ[index];
+			packed.range = lights.range[index];
+			packed.color[0] = lights.colorR[index];
+			packed.color[1] = lights.colorG[index];
+			packed.color[2] = lights.colorB[index];
+			packed.direction[0] = lights.directionX[index];
+			packed.direction[1] = lights.directionY[index];
+			packed.direction[2] = lights.directionZ[index];
+			packed.spotScale = spot ? 1.0f / std::max(lights.cosInner[index] - lights.cosOuter[index], 1e-4f) : 0.0f;
+			packed.spotOffset = spot ? -lights.cosOuter[index] * packed.spotScale : 1.0f;
+		}
+	}
+}
+
+void d3d11renderer::light_clusters::bin_slice(const punctual_lights& lights, uint32_t slice)
+{
+	size_t clusterBase = static_cast<size_t>(slice) * m_settings.tilesY * m_settings.tilesX;
+	std::fill(m_clusterCounts.begin() + clusterBase, m_clusterCounts.begin() + clusterBase + static_cast<size_t>(m_settings.tilesY) * m_settings.tilesX, 0u);
+	m_sliceDropped[slice] = 0;
+
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const light_bounds& bounds = m_bounds[i];
+		if (slice < bounds.minSlice || slice > bounds.maxSlice)
+			continue;
+
+		__m128 x = _mm_set1_ps(m_viewX[i]);
+		__m128 y = _mm_set1_ps(m_viewY[i]);
+		__m128 z = _mm_set1_ps(m_viewZ[i]);
+		__m128 radius = _mm_set1_ps(lights.range[i]);
+		__m128 radiusSquared = _mm_mul_ps(radius, radius);
+
+		bool spot = lights.cosOuter[i] > -1.0f;
+		__m128 directionX = _mm_set1_ps(m_viewDirectionX[i]);
+		__m128 directionY = _mm_set1_ps(m_viewDirectionY[i]);
+		__m128 directionZ = _mm_set1_ps(m_viewDirectionZ[i]);
+		__m128 cosOuter = _mm_set1_ps(lights.cosOuter[i]);
+		__m128 sinOuter = _mm_set1_ps(m_sinOuter[i]);
+
+		for (uint32_t row = bounds.minY; row <= bounds.maxY; row++)
+		{
+			size_t rowBase = (static_cast<size_t>(slice) * m_settings.tilesY + row) * m_rowStride;
+			for (uint32_t column = bounds.minX & ~3u; column <= bounds.maxX; column += 4)
+			{
+				size_t index = rowBase + column;
+
+				// Sphere against box: squared distance from the center to the nearest point of each box
+				__m128 distanceX = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_boxMinX[index]), x), zero), _mm_max_ps(_mm_sub_ps(x, _mm_loadu_ps(&m_boxMaxX[index])), zero));
+				__m128 distanceY = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_boxMinY[index]), y), zero), _mm_max_ps(_mm_sub_ps(y, _mm_loadu_ps(&m_boxMaxY[index])), zero));
+				__m128 distanceZ = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_boxMinZ[index]), z), zero), _mm_max_ps(_mm_sub_ps(z, _mm_loadu_ps(&m_boxMaxZ[index])), zero));
+				__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(distanceX, distanceX), _mm_mul_ps(distanceY, distanceY)), _mm_mul_ps(distanceZ, distanceZ));
+				__m128 hit = _mm_cmple_ps(distanceSquared, radiusSquared);
+
+				if (spot)
+				{
+					// Cone against the cluster's bounding sphere: reject spheres outside the cone's angle, past its range or behind it
+					__m128 sphereRadius = _mm_loadu_ps(&m_sphereRadius[index]);
+					__m128 toSphereX = _mm_sub_ps(_mm_loadu_ps(&m_sphereX[index]), x);
+					__m128 toSphereY = _mm_sub_ps(_mm_loadu_ps(&m_sphereY[index]), y);
+					__m128 toSphereZ = _mm_sub_ps(_mm_loadu_ps(&m_sphereZ[index]), z);
+					__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toSphereX, toSphereX), _mm_mul_ps(toSphereY, toSphereY)), _mm_mul_ps(toSphereZ, toSphereZ));
+					__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toSphereX, directionX), _mm_mul_ps(toSphereY, directionY)), _mm_mul_ps(toSphereZ, directionZ));
+					__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSquared, _mm_mul_ps(along, along)), zero));
+					__m128 closest = _mm_sub_ps(_mm_mul_ps(cosOuter, across), _mm_mul_ps(along, sinOuter));
+
+					__m128 outside = _mm_cmpgt_ps(closest, sphereRadius);
+					outside = _mm_or_ps(outside, _mm_cmpgt_ps(along, _mm_add_ps(sphereRadius, radius)));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(along, _mm_sub_ps(zero, sphereRadius)));
+					hit = _mm_andnot_ps(outside, hit);
+				}
+
+				int mask = _mm_movemask_ps(hit);
+				while (mask)
+				{
+					uint32_t lane = 0;
+					while (!(mask & (1 << lane)))
+					{
+						lane++;
+					}
+					mask &= ~(1 << lane);
+
+					uint32_t tile = column + lane;
+					if (tile >= bounds.minX && tile <= bounds.maxX)
+					{
+						add_light(clusterBase + static_cast<size_t>(row) * m_settings.tilesX + tile, static_cast<uint32_t>(i), slice);
+					}
+				}
+			}
+		}
+	}
+}
+
+uint32_t d3d11renderer::light_clusters::get_slice(float viewDepth) const
+{
+	float slice = std::floor(std::log(viewDepth) * m_sliceScale + m_sliceBias);
+	return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(m_settings.slices - 1)));
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	// Point and spot lights, one array per attribute so binning can load four lights per register.
+	// Point lights are spots whose cone covers everything (cosOuter = -1).
+	struct punctual_lights
+	{
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> range;
+		std::vector<float> colorR, colorG, colorB;        // Intensity is folded into the color
+		std::vector<float> directionX, directionY, directionZ;
+		std::vector<float> cosInner, cosOuter;
+
+		size_t size() const;
+		void clear();
+		void add_point(float x, float y, float z, float lightRange, float r, float g, float b);
+		void add_spot(float x, float y, float z, float dx, float dy, float dz, float lightRange, float innerAngle, float outerAngle, float r, float g, float b);
+	};
+
+	struct cluster_settings
+	{
+		uint32_t tilesX = 16;
+		uint32_t tilesY = 9;
+		uint32_t slices = 24;  // Exponential in view depth between the near and far planes
+		uint32_t indexCapacity = 1 << 20;  // Light entries over every cluster; the storage is made up front
+	};
+
+	// One light as lightps.hlsl reads it from its structured buffer; world space
+	struct packed_light
+	{
+		float position[3];
+		float range;
+		float color[3];
+		float spotScale;       // saturate(dot(-L, direction) * spotScale + spotOffset) is the cone falloff
+		float direction[3];
+		float spotOffset;
+	};
+
+	// Slice of the index list holding one cluster's lights
+	struct cluster_range
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	struct cluster_stats
+	{
+		size_t lightCount = 0;
+		size_t indexCount = 0;
+		uint32_t maxLightsPerCluster = 0;
+		size_t droppedLights = 0;  // Entries past indexCapacity, left out
+		double milliseconds = 0.0;
+	};
+
+	// Assigns lights to a view-space froxel grid: screen tiles split into depth slices.
+	// Bounds of four lights are computed per SSE register; each worker then takes one depth slice and tests every
+	// light overlapping it against four clusters of a tile row at a time, sphere against the cluster's box and, for
+	// spots, cone against the cluster's bounding sphere. Nothing here touches the GPU.
+	class light_clusters
+	{
+	public:
+		light_clusters(const cluster_settings& settings);
+
+		// Matrices are row-major with row vectors, as DirectX::XMStoreFloat4x4 writes them; projection is a left-handed perspective
+		void build(const punctual_lights& lights, const float view[4][4], const float projection[4][4]);
+
+		const cluster_settings& get_settings() const;
+		const cluster_stats& get_stats() const;
+		const std::vector<packed_light>& get_lights() const;
+		const std::vector<cluster_range>& get_ranges() const;
+		const std::vector<uint32_t>& get_indices() const;
+
+		// slice = log(viewDepth) * scale + bias
+		float get_slice_scale() const;
+		float get_slice_bias() const;
+
+	private:
+		// Screen and depth extent of one light in clusters, inclusive; empty when it is outside the frustum
+		struct light_bounds
+		{
+			uint32_t minX, maxX, minY, maxY, minSlice, maxSlice;
+		};
+
+		void build_cluster_bounds(const float projection[4][4]);
+		void compute_light_bounds(const punctual_lights& lights, size_t begin, size_t end, const float view[4][4]);
+		void bin_slice(const punctual_lights& lights, uint32_t slice);
+		void add_light(size_t cluster, uint32_t light, uint32_t slice);
+		uint32_t get_slice(float viewDepth) const;
+
+	private:
+		cluster_settings m_settings;
+		cluster_stats m_stats;
+		uint32_t m_rowStride;  // tilesX rounded up to 4; padding clusters never pass a test
+
+		// Projection the cluster bounds were built for
+		float m_scaleX, m_scaleY, m_nearZ, m_farZ;
+		float m_sliceScale, m_sliceBias;
+
+		// Per cluster, SoA with rows padded to m_rowStride: view-space box and bounding sphere
+		std::vector<float> m_boxMinX, m_boxMinY, m_boxMinZ, m_boxMaxX, m_boxMaxY, m_boxMaxZ;
+		std::vector<float> m_sphereX, m_sphereY, m_sphereZ, m_sphereRadius;
+
+		// View-space lights of this frame
+		std::vector<float> m_viewX, m_viewY, m_viewZ, m_viewDirectionX, m_viewDirectionY, m_viewDirectionZ, m_sinOuter;
+		std::vector<light_bounds> m_bounds;
+
+		// A cluster's lights are a chain of fixed chunks from one pool, so binning never allocates however the lights fall.
+		// Only the pool cursor is shared between the slice workers
+		struct light_chunk
+		{
+			static constexpr uint32_t SIZE = 31;
+			uint32_t lights[SIZE];
+			uint32_t next;
+		};
+		std::vector<light_chunk> m_chunks;
+		std::atomic<size_t> m_nextChunk;
+		std::vector<uint32_t> m_clusterCounts;
+		std::vector<uint32_t> m_clusterFirst;  // Chunk chains per cluster
+		std::vector<uint32_t> m_clusterLast;
+		std::vector<size_t> m_sliceDropped;
+		std::vector<packed_light> m_lights;
+		std::vector<cluster_range> m_ranges;
+		std::vector<uint32_t> m_indices;
+	};
+}
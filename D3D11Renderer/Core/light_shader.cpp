@@ -1,8 +1,13 @@
 #include "light_shader.h"
 
+#include <cstring>
+#include <format>
+
 using namespace Microsoft::WRL;
+using d3d11renderer::material_features;
 
-light_shader::light_shader(ID3D11Device* device, HWND hwnd)
+light_shader::light_shader(ID3D11Device* device, HWND hwnd, d3d11renderer::shader_cache& shaderCache)
+    : m_permutationUsage(), m_boundFeatures(material_features::ALL)
 {
 	bool result;
 	wchar_t vsFilename[128];
@@ -22,7 +27,7 @@ light_shader::light_shader(ID3D11Device* device, HWND hwnd)
 	}
 
 	// Initialize the vertex and pixel shaders.
-	result = initialize_shader(device, hwnd, vsFilename, psFilename);
+	result = initialize_shader(device, hwnd, vsFilename, psFilename, shaderCache);
 	if (!result) {
 		throw std::runtime_error("Failed to initialize the vertex and pixel shaders.");
 	}
@@ -32,50 +37,301 @@ light_shader::~light_shader()
 {
 }
 
-bool light_shader::render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix,
-    ID3D11ShaderResourceView* diffuse, ID3D11ShaderResourceView* normal, ID3D11ShaderResourceView* specular, ID3D11ShaderResourceView* ao, ID3D11ShaderResourceView* emissive, ID3D11ShaderResourceView* metal,
+bool light_shader::prepare_permutations(ID3D11Device* device, HWND hwnd, const std::vector<uint32_t>& subMeshFeatures, d3d11renderer::shader_cache& shaderCache)
+{
+    // Compile the missing variants on worker threads first; failures are reported below one shader at a time
+    std::array<bool, material_features::PERMUTATION_COUNT> queued = {};
+    std::vector<d3d11renderer::shader_desc> missing;
+    for (uint32_t features : subMeshFeatures)
+    {
+        if (!m_pixelShaders[features] && !queued[features])
+        {
+            queued[features] = true;
+            missing.push_back(get_pixel_shader_desc(features));
+        }
+    }
+
+    std::string errors;
+    shaderCache.prefetch(missing, errors);
+
+    for (uint32_t features : subMeshFeatures)
+    {
+        if (!m_pixelShaders[features] && !compile_pixel_shader(device, hwnd, features, shaderCache))
+        {
+            return false;
+        }
+        m_permutationUsage[features].subMeshes++;
+    }
+
+    for (uint32_t features = 0; features < material_features::PERMUTATION_COUNT; features++)
+    {
+        if (m_permutationUsage[features].subMeshes > 0)
+        {
+            OutputDebugStringA(std::format("Light shader permutation {}: {} submeshes\n", get_permutation_name(features), m_permutationUsage[features].subMeshes).c_str());
+        }
+    }
+
+    return true;
+}
+
+const light_shader::PermutationUsage& light_shader::get_permutation_usage(uint32_t features) const
+{
+    return m_permutationUsage[features];
+}
+
+void light_shader::reset_draw_counts()
+{
+    for (auto& usage : m_permutationUsage)
+    {
+        usage.binds = 0;
+        usage.draws = 0;
+    }
+}
+
+const char* light_shader::get_permutation_name(uint32_t features)
+{
+    static const auto names = []()
+    {
+        std::vector<std::string> result(material_features::PERMUTATION_COUNT);
+        for (uint32_t permutation = 0; permutation < material_features::PERMUTATION_COUNT; permutation++)
+        {
+            std::string& name = result[permutation];
+            for (uint32_t bit = 0; bit < material_features::COUNT; bit++)
+            {
+                if (permutation & (1 << bit))
+                {
+                    name += name.empty() ? "" : " ";
+                    name += material_features::DEFINES[bit];
+                }
+            }
+            if (name.empty())
+            {
+                name = "NO_MAPS";
+            }
+        }
+        return result;
+    }();
+    return names[features].c_str();
+}
+
+bool light_shader::begin(ID3D11DeviceContext* deviceContext, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix,
     DirectX::XMFLOAT3 lightDirection, DirectX::XMFLOAT4 diffuseColor,
     DirectX::XMFLOAT4 ambientColor, DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 specularColor, float specularPower)
 {
-    bool result;
+    // Set the shader parameters that every draw of the pass shares.
+    if (!set_shader_parameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix,
+        lightDirection, diffuseColor, ambientColor, cameraPosition, specularColor, specularPower))
+    {
+        return false;
+    }
 
+    deviceContext->IASetInputLayout(m_layout.Get());
+    deviceContext->VSSetShader(m_vertexShader.Get(), NULL, 0);
 
-    // Set the shader parameters that it will use for rendering.
-    result = set_shader_parameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix, 
-        diffuse, normal, specular, ao, emissive, metal,
-        lightDirection, diffuseColor, ambientColor, cameraPosition, specularColor, specularPower);
-    if (!result)
+    // Set the sampler state in the pixel shader.
+    deviceContext->PSSetSamplers(0, 1, m_sampleState.GetAddressOf());
+
+    return true;
+}
+
+bool light_shader::set_material(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* const views[MATERIAL_TEXTURES], uint32_t features,
+    const d3d11renderer::material_factors& factors)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+    HRESULT result = deviceContext->Map(m_materialBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result))
     {
         return false;
     }
 
-    // Now render the prepared buffers with the shader.
-    render_shader(deviceContext, indexCount, startIndex);
+    MaterialBufferType* dataPtr = (MaterialBufferType*)mappedResource.pData;
+    dataPtr->baseColorFactor = DirectX::XMFLOAT4(factors.baseColor);
+    dataPtr->emissiveFactor = DirectX::XMFLOAT3(factors.emissive);
+    dataPtr->metallicFactor = factors.metallic;
+    dataPtr->roughnessFactor = factors.roughness;
+    dataPtr->padding = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+    deviceContext->Unmap(m_materialBuffer.Get(), 0);
+
+    // Feature sets that weren't prepared fall back to the variant that samples every map
+    if (!m_pixelShaders[features])
+    {
+        features = material_features::ALL;
+    }
+    m_boundFeatures = features;
+    m_permutationUsage[features].binds++;
+
+    deviceContext->PSSetConstantBuffers(4, 1, m_materialBuffer.GetAddressOf());
+    deviceContext->PSSetShaderResources(0, MATERIAL_TEXTURES, views);
+    deviceContext->PSSetShader(m_pixelShaders[features].Get(), NULL, 0);
 
     return true;
 }
 
-void light_shader::output_shader_error_message(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename)
+void light_shader::render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount, int startInstance)
 {
-    char* compileErrors;
-    unsigned long long bufferSize, i;
-    std::ofstream fout;
+    m_permutationUsage[m_boundFeatures].draws++;
 
+    // Render every instance of the submesh in one draw.
+    deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, 0, startInstance);
+}
 
-    // Get a pointer to the error message text buffer.
-    compileErrors = (char*)(errorMessage->GetBufferPointer());
+bool light_shader::set_environment(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* prefilteredSpecular, ID3D11ShaderResourceView* brdfLut,
+    const float irradiance[9][4], float specularMipCount)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+    HRESULT result = deviceContext->Map(m_environmentBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    EnvironmentBufferType* dataPtr = (EnvironmentBufferType*)mappedResource.pData;
+    for (int i = 0; i < 9; i++)
+    {
+        dataPtr->irradiance[i] = DirectX::XMFLOAT4(irradiance[i]);
+    }
+    dataPtr->specularMipCount = specularMipCount;
+    dataPtr->padding = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+    deviceContext->Unmap(m_environmentBuffer.Get(), 0);
+
+    // Slots after the material textures, so material binds don't disturb them
+    deviceContext->PSSetConstantBuffers(1, 1, m_environmentBuffer.GetAddressOf());
+    deviceContext->PSSetShaderResources(6, 1, &prefilteredSpecular);
+    deviceContext->PSSetShaderResources(7, 1, &brdfLut);
+    deviceContext->PSSetSamplers(1, 1, m_clampSampleState.GetAddressOf());
+
+    return true;
+}
+
+bool light_shader::set_light_clusters(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const d3d11renderer::light_clusters& clusters, float screenWidth, float screenHeight)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    const auto& settings = clusters.get_settings();
+
+    HRESULT result = deviceContext->Map(m_clusterBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    ClusterBufferType* dataPtr = (ClusterBufferType*)mappedResource.pData;
+    dataPtr->tileScale = DirectX::XMFLOAT2(settings.tilesX / screenWidth, settings.tilesY / screenHeight);
+    dataPtr->sliceScale = clusters.get_slice_scale();
+    dataPtr->sliceBias = clusters.get_slice_bias();
+    dataPtr->clusterCounts[0] = settings.tilesX;
+    dataPtr->clusterCounts[1] = settings.tilesY;
+    dataPtr->clusterCounts[2] = settings.slices;
+    dataPtr->padding = 0.0f;
+
+    deviceContext->Unmap(m_clusterBuffer.Get(), 0);
+
+    if (!update_structured_buffer(device, deviceContext, m_clusteredLights, clusters.get_lights().data(), static_cast<UINT>(clusters.get_lights().size()), sizeof(d3d11renderer::packed_light)) ||
+        !update_structured_buffer(device, deviceContext, m_clusterRanges, clusters.get_ranges().data(), static_cast<UINT>(clusters.get_ranges().size()), sizeof(d3d11renderer::cluster_range)) ||
+        !update_structured_buffer(device, deviceContext, m_clusterLightIndices, clusters.get_indices().data(), static_cast<UINT>(clusters.get_indices().size()), sizeof(uint32_t)))
+    {
+        return false;
+    }
+
+    ID3D11ShaderResourceView* views[3] = { m_clusteredLights.view.Get(), m_clusterRanges.view.Get(), m_clusterLightIndices.view.Get() };
+    deviceContext->PSSetConstantBuffers(2, 1, m_clusterBuffer.GetAddressOf());
+    deviceContext->PSSetShaderResources(8, 3, views);
+
+    return true;
+}
+
+bool light_shader::set_shadows(ID3D11DeviceContext* deviceContext, const d3d11renderer::shadow_cascades& cascades, ID3D11ShaderResourceView* shadowMap)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+    HRESULT result = deviceContext->Map(m_shadowBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    ShadowBufferType* dataPtr = (ShadowBufferType*)mappedResource.pData;
+    for (uint32_t i = 0; i < d3d11renderer::cascade_settings::MAX_CASCADES; i++)
+    {
+        const auto& cascade = cascades.get_cascade(i);
+        dataPtr->cascadeViewProjection[i] = DirectX::XMMatrixTranspose(DirectX::XMMATRIX(&cascade.viewProjection[0][0]));
+        dataPtr->cascadeSplits[i] = DirectX::XMFLOAT4(cascade.splitDepth, cascade.texelSize, 0.0f, 0.0f);
+    }
+    dataPtr->cascadeCount = cascades.get_cascade_count();
+    dataPtr->shadowTexelSize = 1.0f / static_cast<float>(cascades.get_settings().resolution);
+    dataPtr->padding = DirectX::XMFLOAT2(0.0f, 0.0f);
+
+    deviceContext->Unmap(m_shadowBuffer.Get(), 0);
+
+    deviceContext->PSSetConstantBuffers(3, 1, m_shadowBuffer.GetAddressOf());
+    deviceContext->PSSetShaderResources(11, 1, &shadowMap);
+    deviceContext->PSSetSamplers(2, 1, m_shadowSampleState.GetAddressOf());
+
+    return true;
+}
+
+bool light_shader::update_structured_buffer(ID3D11Device* device, ID3D11DeviceContext* deviceContext, StructuredBufferType& target, const void* data, UINT count, UINT stride)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT result;
+
+    // Grow by half again so a slowly rising light count doesn't recreate the buffer every frame
+    if (count > target.capacity || !target.buffer)
+    {
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        bufferDesc.ByteWidth = std::max(count + count / 2, 64u) * stride;
+        bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        bufferDesc.StructureByteStride = stride;
+
+        target.view.Reset();
+        target.buffer.Reset();
+        result = device->CreateBuffer(&bufferDesc, NULL, target.buffer.GetAddressOf());
+        if (FAILED(result))
+        {
+            target.capacity = 0;
+            return false;
+        }
+
+        result = device->CreateShaderResourceView(target.buffer.Get(), NULL, target.view.GetAddressOf());
+        if (FAILED(result))
+        {
+            return false;
+        }
+        target.capacity = bufferDesc.ByteWidth / stride;
+    }
+
+    if (count == 0)
+    {
+        return true;
+    }
+
+    result = deviceContext->Map(target.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result))
+    {
+        return false;
+    }
+    memcpy(mappedResource.pData, data, static_cast<size_t>(count) * stride);
+    deviceContext->Unmap(target.buffer.Get(), 0);
+
+    return true;
+}
+
+void light_shader::output_shader_error_message(const std::string& errorMessage, HWND hwnd, WCHAR* shaderFilename)
+{
+    std::ofstream fout;
 
-    // Get the length of the message.
-    bufferSize = errorMessage->GetBufferSize();
 
     // Open a file to write the error message to.
     fout.open("shader-error.txt");
 
     // Write out the error message.
-    for (i = 0; i < bufferSize; i++)
-    {
-        fout << compileErrors[i];
-    }
+    fout << errorMessage;
 
     // Close the file.
     fout.close();
@@ -87,7 +343,6 @@ void light_shader::output_shader_error_message(ID3D10Blob* errorMessage, HWND hw
 }
 
 bool light_shader::set_shader_parameters(ID3D11DeviceContext* deviceContext, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix,
-    ID3D11ShaderResourceView* diffuse, ID3D11ShaderResourceView* normal, ID3D11ShaderResourceView* specular, ID3D11ShaderResourceView* ao, ID3D11ShaderResourceView* emissive, ID3D11ShaderResourceView* metal,
     DirectX::XMFLOAT3 lightDirection, DirectX::XMFLOAT4 diffuseColor, DirectX::XMFLOAT4 ambientColor, DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 specularColor, float specularPower)
 {
     HRESULT result;
@@ -149,14 +404,6 @@ bool light_shader::set_shader_parameters(ID3D11DeviceContext* deviceContext, Dir
     // Now set the camera constant buffer in the vertex shader with the updated values.
     deviceContext->VSSetConstantBuffers(bufferNumber, 1, m_cameraBuffer.GetAddressOf());
 
-    // Set shader texture resource in the pixel shader.
-    deviceContext->PSSetShaderResources(0, 1, &diffuse);
-    deviceContext->PSSetShaderResources(1, 1, &normal);
-    deviceContext->PSSetShaderResources(2, 1, &specular);
-    deviceContext->PSSetShaderResources(3, 1, &ao);
-    deviceContext->PSSetShaderResources(4, 1, &emissive);
-    deviceContext->PSSetShaderResources(5, 1, &metal);
-
     result = deviceContext->Map(m_lightBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
     if (FAILED(result))
     {
@@ -186,31 +433,13 @@ bool light_shader::set_shader_parameters(ID3D11DeviceContext* deviceContext, Dir
     return true;
 }
 
-void light_shader::render_shader(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex)
-{
-    deviceContext->IASetInputLayout(m_layout.Get());
-
-    // Set the vertex and pixel shaders that will be used to render this triangle.
-    deviceContext->VSSetShader(m_vertexShader.Get(), NULL, 0);
-    deviceContext->PSSetShader(m_pixelShader.Get(), NULL, 0);
-
-    // Set the sampler state in the pixel shader.
-    deviceContext->PSSetSamplers(0, 1, m_sampleState.GetAddressOf());
-
-    // Render the triangle.
-    deviceContext->DrawIndexed(indexCount, startIndex, 0);
-
-    return;
-}
-
-bool light_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename)
+bool light_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename, d3d11renderer::shader_cache& shaderCache)
 {
     HRESULT result;
-    ComPtr<ID3D10Blob> errorMessage;
-    ComPtr<ID3D10Blob> vertexShaderBuffer;
-    ComPtr<ID3D10Blob> pixelShaderBuffer;
+    std::string errorMessage;
+    std::vector<uint8_t> vertexShaderBuffer;
 
-    D3D11_INPUT_ELEMENT_DESC polygonLayout[5];
+    D3D11_INPUT_ELEMENT_DESC polygonLayout[9];
     unsigned int numElements;
     D3D11_SAMPLER_DESC samplerDesc;
     D3D11_BUFFER_DESC matrixBufferDesc;
@@ -218,14 +447,13 @@ bool light_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsF
     D3D11_BUFFER_DESC lightBufferDesc;
 
 
-    result = D3DCompileFromFile(vsFilename, NULL, NULL, "main", "vs_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
-        vertexShaderBuffer.GetAddressOf(), errorMessage.GetAddressOf());
-    if (FAILED(result))
+    // Bytecode comes from the shader cache, which only compiles sources that changed
+    if (!shaderCache.get({ vsFilename, "main", "vs_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS }, vertexShaderBuffer, errorMessage))
     {
         // If the shader failed to compile it should have writen something to the error message.
-        if (errorMessage)
+        if (!errorMessage.empty())
         {
-            output_shader_error_message(errorMessage.Get(), hwnd, vsFilename);
+            output_shader_error_message(errorMessage, hwnd, vsFilename);
         }
         // If there was nothing in the error message then it simply could not find the shader file itself.
         else
@@ -236,32 +464,14 @@ bool light_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsF
         return false;
     }
 
-    result = D3DCompileFromFile(psFilename, NULL, NULL, "main", "ps_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
-        pixelShaderBuffer.GetAddressOf(), errorMessage.GetAddressOf());
-    if (FAILED(result))
+    // The variant with every map doubles as the fallback for feature sets that were never prepared
+    m_psFilename = psFilename;
+    if (!compile_pixel_shader(device, hwnd, material_features::ALL, shaderCache))
     {
-        // If the shader failed to compile it should have writen something to the error message.
-        if (errorMessage)
-        {
-            output_shader_error_message(errorMessage.Get(), hwnd, psFilename);
-        }
-        // If there was nothing in the error message then it simply could not find the file itself.
-        else
-        {
-            MessageBox(hwnd, psFilename, L"Missing Shader File", MB_OK);
-        }
-
         return false;
     }
 
-    result = device->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, m_vertexShader.GetAddressOf());
-    if (FAILED(result))
-    {
-        return false;
-    }
-
-    // Create the pixel shader from the buffer.
-    result = device->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(), NULL, m_pixelShader.GetAddressOf());
+    result = device->CreateVertexShader(vertexShaderBuffer.data(), vertexShaderBuffer.size(), NULL, m_vertexShader.GetAddressOf());
     if (FAILED(result))
     {
         return false;
@@ -309,11 +519,23 @@ bool light_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsF
     polygonLayout[4].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
     polygonLayout[4].InstanceDataStepRate = 0;
 
+    // Node transform rows from the model's instance stream
+    for (UINT row = 0; row < 4; row++)
+    {
+        polygonLayout[5 + row].SemanticName = "INSTANCE_TRANSFORM";
+        polygonLayout[5 + row].SemanticIndex = row;
+        polygonLayout[5 + row].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+        polygonLayout[5 + row].InputSlot = 1;
+        polygonLayout[5 + row].AlignedByteOffset = row == 0 ? 0 : D3D11_APPEND_ALIGNED_ELEMENT;
+        polygonLayout[5 + row].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+        polygonLayout[5 + row].InstanceDataStepRate = 1;
+    }
+
     // Get a count of the elements in the layout.
     numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
     // Create the vertex input layout.
-    result = device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(),
+    result = device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer.data(), vertexShaderBuffer.size(),
         &m_layout);
     if (FAILED(result))
     {
@@ -386,5 +608,112 @@ bool light_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsF
         return false;
     }
 
+    lightBufferDesc.ByteWidth = sizeof(EnvironmentBufferType);
+
+    // The environment buffer has the same usage as the light buffer.
+    result = device->CreateBuffer(&lightBufferDesc, NULL, m_environmentBuffer.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    lightBufferDesc.ByteWidth = sizeof(ClusterBufferType);
+
+    // So does the cluster grid description.
+    result = device->CreateBuffer(&lightBufferDesc, NULL, m_clusterBuffer.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    // The BRDF lookup table must not wrap at its edges.
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    result = device->CreateSamplerState(&samplerDesc, m_clampSampleState.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    lightBufferDesc.ByteWidth = sizeof(ShadowBufferType);
+    result = device->CreateBuffer(&lightBufferDesc, NULL, m_shadowBuffer.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    lightBufferDesc.ByteWidth = sizeof(MaterialBufferType);
+    result = device->CreateBuffer(&lightBufferDesc, NULL, m_materialBuffer.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    // Shadow lookups compare against the stored depth and filter the results; outside the map counts as lit.
+    samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+    samplerDesc.BorderColor[0] = 1.0f;
+    samplerDesc.BorderColor[1] = 1.0f;
+    samplerDesc.BorderColor[2] = 1.0f;
+    samplerDesc.BorderColor[3] = 1.0f;
+    result = device->CreateSamplerState(&samplerDesc, m_shadowSampleState.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool light_shader::compile_pixel_shader(ID3D11Device* device, HWND hwnd, uint32_t features, d3d11renderer::shader_cache& shaderCache)
+{
+    HRESULT result;
+    std::string errorMessage;
+    std::vector<uint8_t> pixelShaderBuffer;
+
+
+    if (!shaderCache.get(get_pixel_shader_desc(features), pixelShaderBuffer, errorMessage))
+    {
+        // If the shader failed to compile it should have writen something to the error message.
+        if (!errorMessage.empty())
+        {
+            output_shader_error_message(errorMessage, hwnd, m_psFilename.data());
+        }
+        // If there was nothing in the error message then it simply could not find the file itself.
+        else
+        {
+            MessageBox(hwnd, m_psFilename.c_str(), L"Missing Shader File", MB_OK);
+        }
+
+        return false;
+    }
+
+    // Create the pixel shader from the buffer.
+    result = device->CreatePixelShader(pixelShaderBuffer.data(), pixelShaderBuffer.size(), NULL, m_pixelShaders[features].GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
     return true;
-}
\ No newline at end of file
+}
+
+d3d11renderer::shader_desc light_shader::get_pixel_shader_desc(uint32_t features) const
+{
+    d3d11renderer::shader_desc desc = { m_psFilename, "main", "ps_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS };
+
+    // One define per map the permutation samples
+    for (uint32_t bit = 0; bit < material_features::COUNT; bit++)
+    {
+        if (features & (1 << bit))
+        {
+            desc.defines.push_back({ material_features::DEFINES[bit], "1" });
+        }
+    }
+
+    return desc;
+}
@@ -1,10 +1,17 @@
 #pragma once
 #include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
 #include <d3d11.h>
 #include <d3dcompiler.h>
 #include <directxmath.h>
 #include <fstream>
 #include <wrl/client.h>
+#include "shader_cache.h"
+#include "material_features.h"
+#include "light_clusters.h"
+#include "shadow_cascades.h"
 
 class light_shader
 {
@@ -32,27 +39,112 @@ private:
         DirectX::XMFLOAT4 specularColor;
     };
 
+    struct EnvironmentBufferType
+    {
+        DirectX::XMFLOAT4 irradiance[9];
+        float specularMipCount;
+        DirectX::XMFLOAT3 padding;
+    };
+
+    struct ClusterBufferType
+    {
+        DirectX::XMFLOAT2 tileScale;
+        float sliceScale;
+        float sliceBias;
+        uint32_t clusterCounts[3];
+        float padding;
+    };
+
+    struct ShadowBufferType
+    {
+        DirectX::XMMATRIX cascadeViewProjection[d3d11renderer::cascade_settings::MAX_CASCADES];
+        DirectX::XMFLOAT4 cascadeSplits[d3d11renderer::cascade_settings::MAX_CASCADES];  // View depth where each ends, world size of a texel
+        uint32_t cascadeCount;
+        float shadowTexelSize;
+        DirectX::XMFLOAT2 padding;
+    };
+
+    struct MaterialBufferType
+    {
+        DirectX::XMFLOAT4 baseColorFactor;
+        DirectX::XMFLOAT3 emissiveFactor;
+        float metallicFactor;
+        float roughnessFactor;
+        DirectX::XMFLOAT3 padding;
+    };
+
+    // Dynamic structured buffer that grows to fit what it is given
+    struct StructuredBufferType
+    {
+        Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+        UINT capacity = 0;
+    };
+
 public:
-    light_shader(ID3D11Device* device, HWND hwnd);
+    struct PermutationUsage
+    {
+        uint32_t subMeshes;  // Submeshes that were prepared with this permutation
+        uint32_t binds;      // Materials bound since the last reset_draw_counts
+        uint32_t draws;      // Draws since the last reset_draw_counts
+    };
+
+public:
+    static constexpr uint32_t MATERIAL_TEXTURES = 6;
+
+    light_shader(ID3D11Device* device, HWND hwnd, d3d11renderer::shader_cache& shaderCache);
 	~light_shader();
-    bool render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex,DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix,DirectX::XMMATRIX projectionMatrix,
-        ID3D11ShaderResourceView* diffuse, ID3D11ShaderResourceView* normal, ID3D11ShaderResourceView* specular, ID3D11ShaderResourceView* ao, ID3D11ShaderResourceView* emissive, ID3D11ShaderResourceView* metal,
+    // Compiles the pixel shader permutation of every feature set up front, so the first draw doesn't stall on the compiler.
+    bool prepare_permutations(ID3D11Device* device, HWND hwnd, const std::vector<uint32_t>& subMeshFeatures, d3d11renderer::shader_cache& shaderCache);
+    const PermutationUsage& get_permutation_usage(uint32_t features) const;
+    void reset_draw_counts();
+    // Built once for every permutation, so the UI can show them each frame without allocating
+    static const char* get_permutation_name(uint32_t features);
+
+    // Matrices, camera and sun shared by every draw of the lit pass; binds the shaders, then materials and draws follow.
+    bool begin(ID3D11DeviceContext* deviceContext, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix,
         DirectX::XMFLOAT3 lightDirection, DirectX::XMFLOAT4 diffuseColor,
         DirectX::XMFLOAT4 ambientColor, DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 specularColor, float specularPower);
+    // The six maps of a material in slots 0-5 (diffuse, normal, specular, AO, emissive, metal-roughness), the factors they
+    // are multiplied by and its permutation, for every draw until the next material
+    bool set_material(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* const views[MATERIAL_TEXTURES], uint32_t features,
+        const d3d11renderer::material_factors& factors);
+    // Draws instanceCount instances from the model's instance stream, starting at startInstance
+    void render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount, int startInstance);
+    // Image-based lighting shared by every draw; set once per frame before rendering.
+    bool set_environment(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* prefilteredSpecular, ID3D11ShaderResourceView* brdfLut,
+        const float irradiance[9][4], float specularMipCount);
+    // Point and spot lights binned this frame; also shared by every draw.
+    bool set_light_clusters(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const d3d11renderer::light_clusters& clusters, float screenWidth, float screenHeight);
+    // Cascaded shadow map of the directional light
+    bool set_shadows(ID3D11DeviceContext* deviceContext, const d3d11renderer::shadow_cascades& cascades, ID3D11ShaderResourceView* shadowMap);
 private:
-    void output_shader_error_message(ID3D10Blob*, HWND, WCHAR*);
+    void output_shader_error_message(const std::string&, HWND, WCHAR*);
 
     bool set_shader_parameters(ID3D11DeviceContext* deviceContext, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix,
-        ID3D11ShaderResourceView* diffuse, ID3D11ShaderResourceView* normal, ID3D11ShaderResourceView* specular, ID3D11ShaderResourceView* ao, ID3D11ShaderResourceView* emissive, ID3D11ShaderResourceView* metal,
         DirectX::XMFLOAT3 lightDirection, DirectX::XMFLOAT4 diffuseColor, DirectX::XMFLOAT4 ambientColor, DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 specularColor, float specularPower);
-    void render_shader(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex);
-    bool initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename);
+    bool initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename, d3d11renderer::shader_cache& shaderCache);
+    bool compile_pixel_shader(ID3D11Device* device, HWND hwnd, uint32_t features, d3d11renderer::shader_cache& shaderCache);
+    d3d11renderer::shader_desc get_pixel_shader_desc(uint32_t features) const;
+    bool update_structured_buffer(ID3D11Device* device, ID3D11DeviceContext* deviceContext, StructuredBufferType& target, const void* data, UINT count, UINT stride);
 private:
     Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
-    Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixelShader;
+    std::array<Microsoft::WRL::ComPtr<ID3D11PixelShader>, d3d11renderer::material_features::PERMUTATION_COUNT> m_pixelShaders;
+    std::array<PermutationUsage, d3d11renderer::material_features::PERMUTATION_COUNT> m_permutationUsage;
+    uint32_t m_boundFeatures;  // Permutation of the last set_material, which the draws count against
+    std::wstring m_psFilename;
     Microsoft::WRL::ComPtr<ID3D11InputLayout> m_layout;
     Microsoft::WRL::ComPtr<ID3D11Buffer> m_matrixBuffer;
     Microsoft::WRL::ComPtr<ID3D11SamplerState> m_sampleState;
     Microsoft::WRL::ComPtr<ID3D11Buffer> m_cameraBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer> m_lightBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_environmentBuffer;
+    Microsoft::WRL::ComPtr<ID3D11SamplerState> m_clampSampleState;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_clusterBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_shadowBuffer;
+    Microsoft::WRL::ComPtr<ID3D11SamplerState> m_shadowSampleState;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_materialBuffer;
+    StructuredBufferType m_clusteredLights;
+    StructuredBufferType m_clusterRanges;
+    StructuredBufferType m_clusterLightIndices;
 };
@@ -0,0 +1,97 @@
+#include "luminance_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace d3d11renderer;
+
+// Below this a pixel counts as black and goes to bin 0
+constexpr float MIN_LUMINANCE = 1e-5f;
+
+void d3d11renderer::luminance_histogram::build(const float* rgba, size_t width, size_t height, const exposure_settings& settings, bins& histogram)
+{
+	histogram.fill(0);
+
+	// Blocks past an odd edge repeat the last texel, like a clamped bilinear tap
+	for (size_t y = 0; y < height; y += 2)
+	{
+		size_t y1 = std::min(y + 1, height - 1);
+		for (size_t x = 0; x < width; x += 2)
+		{
+			size_t x1 = std::min(x + 1, width - 1);
+
+			float rgb[3];
+			for (size_t c = 0; c < 3; c++)
+			{
+				rgb[c] = (rgba[(y * width + x) * 4 + c] + rgba[(y * width + x1) * 4 + c] +
+					rgba[(y1 * width + x) * 4 + c] + rgba[(y1 * width + x1) * 4 + c]) * 0.25f;
+			}
+
+			float luminance = rgb[0] * 0.2126f + rgb[1] * 0.7152f + rgb[2] * 0.0722f;
+			histogram[get_bin(luminance, settings)]++;
+		}
+	}
+}
+
+uint32_t d3d11renderer::luminance_histogram::get_bin(float luminance, const exposure_settings& settings)
+{
+	if (!(luminance >= MIN_LUMINANCE))
+	{
+		return 0;
+	}
+
+	float range = settings.maxLogLuminance - settings.minLogLuminance;
+	float t = std::clamp((std::log2(luminance) - settings.minLogLuminance) / range, 0.0f, 1.0f);
+	return 1 + static_cast<uint32_t>(t * static_cast<float>(BIN_COUNT - 2));
+}
+
+float d3d11renderer::luminance_histogram::get_average_luminance(const bins& histogram, const exposure_settings& settings)
+{
+	float total = 0.0f;
+	for (uint32_t i = 1; i < BIN_COUNT; i++)
+	{
+		total += static_cast<float>(histogram[i]);
+	}
+
+	// Each bin contributes the part of its pixels that falls between the percentiles
+	float low = total * settings.lowPercentile;
+	float high = total * settings.highPercentile;
+	float range = settings.maxLogLuminance - settings.minLogLuminance;
+	float below = 0.0f, weightedSum = 0.0f, weight = 0.0f;
+	for (uint32_t i = 1; i < BIN_COUNT; i++)
+	{
+		float count = static_cast<float>(histogram[i]);
+		float overlap = std::max(std::min(below + count, high) - std::max(below, low), 0.0f);
+		float logLuminance = settings.minLogLuminance + (static_cast<float>(i - 1) + 0.5f) / static_cast<float>(BIN_COUNT - 2) * range;
+
+		weightedSum += overlap * logLuminance;
+		weight += overlap;
+		below += count;
+	}
+
+	return weight > 0.0f ? std::exp2(weightedSum / weight) : 0.0f;
+}
+
+exposure_state d3d11renderer::luminance_histogram::adapt(const exposure_state& previous, float averageLuminance, float deltaTime, const exposure_settings& settings)
+{
+	exposure_state state = previous;
+	if (averageLuminance <= 0.0f)
+	{
+		return state;
+	}
+
+	// Exponential approach in log space, so brightening by 2x takes as long wherever it starts
+	float adaptedLog = std::log2(averageLuminance);
+	if (previous.valid > 0.0f)
+	{
+		float previousLog = std::log2(previous.adaptedLuminance);
+		float speed = adaptedLog > previousLog ? settings.speedUp : settings.speedDown;
+		adaptedLog = previousLog + (adaptedLog - previousLog) * (1.0f - std::exp(-deltaTime * speed));
+	}
+
+	state.adaptedLuminance = std::exp2(adaptedLog);
+	state.exposure = settings.keyValue / state.adaptedLuminance;
+	state.targetLuminance = averageLuminance;
+	state.valid = 1.0f;
+	return state;
+}
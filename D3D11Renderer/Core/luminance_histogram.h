@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace d3d11renderer
+{
+	struct exposure_settings
+	{
+		float minLogLuminance = -10.0f;  // log2 of the darkest luminance with its own bin
+		float maxLogLuminance = 6.0f;
+		float lowPercentile = 0.1f;      // The darkest and brightest parts of the frame don't move the average
+		float highPercentile = 0.9f;
+		float speedUp = 3.0f;            // Adaptation rate per second towards a brighter scene
+		float speedDown = 1.0f;          // And towards a darker one, slower like the eye
+		float keyValue = 0.18f;          // Middle grey the average is mapped to
+	};
+
+	// State the adaptation pass carries from frame to frame, laid out as the tone mapper's cbuffer reads it
+	struct exposure_state
+	{
+		float adaptedLuminance = 0.0f;
+		float exposure = 1.0f;
+		float targetLuminance = 0.0f;
+		float valid = 0.0f;  // Zero until the first frame, which then adapts instantly
+	};
+
+	// CPU reference for the auto exposure compute shaders (postcs.hlsl and exposurecs.hlsl),
+	// step for step, so their results can be checked against it.
+	// Bin 0 holds pixels too dark to measure; bins 1 to BIN_COUNT - 1 split [minLogLuminance, maxLogLuminance] evenly.
+	class luminance_histogram
+	{
+	public:
+		static constexpr uint32_t BIN_COUNT = 256;
+		using bins = std::array<uint32_t, BIN_COUNT>;
+
+		// Bins the luminance of an RGBA float image downsampled 2x2, as the post pass does
+		static void build(const float* rgba, size_t width, size_t height, const exposure_settings& settings, bins& histogram);
+		static uint32_t get_bin(float luminance, const exposure_settings& settings);
+
+		// Average luminance of the pixels between the two percentiles, skipping bin 0
+		static float get_average_luminance(const bins& histogram, const exposure_settings& settings);
+
+		// Moves the adapted luminance towards this frame's average and derives the exposure
+		static exposure_state adapt(const exposure_state& previous, float averageLuminance, float deltaTime, const exposure_settings& settings);
+	};
+}
@@ -0,0 +1,148 @@
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+d3d11renderer::mapped_file::mapped_file()
+	: m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr), m_data(nullptr), m_size(0)
+{
+}
+
+d3d11renderer::mapped_file::~mapped_file()
+{
+	close();
+}
+
+bool d3d11renderer::mapped_file::open(const std::filesystem::path& filename)
+{
+	close();
+
+	m_file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	m_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void d3d11renderer::mapped_file::close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+
+	m_size = 0;
+}
+
+#else
+
+d3d11renderer::mapped_file::mapped_file()
+	: m_file(-1), m_data(nullptr), m_size(0)
+{
+}
+
+d3d11renderer::mapped_file::~mapped_file()
+{
+	close();
+}
+
+bool d3d11renderer::mapped_file::open(const std::filesystem::path& filename)
+{
+	close();
+
+	m_file = ::open(filename.c_str(), O_RDONLY);
+	if (m_file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(m_file, &status) != 0 || status.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+void d3d11renderer::mapped_file::close()
+{
+	if (m_data)
+	{
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+		m_data = nullptr;
+	}
+
+	if (m_file >= 0)
+	{
+		::close(m_file);
+		m_file = -1;
+	}
+
+	m_size = 0;
+}
+
+#endif
+
+const uint8_t* d3d11renderer::mapped_file::get_data() const
+{
+	return m_data;
+}
+
+size_t d3d11renderer::mapped_file::get_size() const
+{
+	return m_size;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace d3d11renderer
+{
+	// Read-only memory mapping of a whole file. Pages are read in by the OS on first touch,
+	// so pointers into the view can be handed straight to the GPU upload without a copy. Maps with mmap away from
+	// Windows, so the loaders built on it can be tested on any platform.
+	class mapped_file
+	{
+	public:
+		mapped_file();
+		~mapped_file();
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool open(const std::filesystem::path& filename);
+		void close();
+
+		const uint8_t* get_data() const;
+		size_t get_size() const;
+
+	private:
+#ifdef _WIN32
+		HANDLE m_file;
+		HANDLE m_mapping;
+#else
+		int m_file;
+#endif
+		const uint8_t* m_data;
+		size_t m_size;
+	};
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace d3d11renderer
+{
+	// Material maps a SubMesh provides, one bit each.
+	// The light pixel shader is compiled once per combination in use, with DEFINES naming the bits that are set.
+	struct material_features
+	{
+		static constexpr uint32_t DIFFUSE_MAP = 1 << 0;
+		static constexpr uint32_t NORMAL_MAP = 1 << 1;
+		static constexpr uint32_t AO_MAP = 1 << 2;
+		static constexpr uint32_t EMISSIVE_MAP = 1 << 3;
+		static constexpr uint32_t METAL_ROUGHNESS_MAP = 1 << 4;
+
+		static constexpr uint32_t COUNT = 5;
+		static constexpr uint32_t ALL = (1 << COUNT) - 1;
+		static constexpr uint32_t PERMUTATION_COUNT = 1 << COUNT;
+
+		// In bit order
+		static constexpr const char* DEFINES[COUNT] = { "HAS_DIFFUSE_MAP", "HAS_NORMAL_MAP", "HAS_AO_MAP", "HAS_EMISSIVE_MAP", "HAS_METAL_ROUGHNESS_MAP" };
+	};
+
+	// Constants a material's maps are multiplied by, glTF's factors and defaults. A missing map reads as white, so
+	// without one the factor is the value
+	struct material_factors
+	{
+		float baseColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };  // Linear RGBA
+		float emissive[3] = { 0.0f, 0.0f, 0.0f };
+		float metallic = 1.0f;
+		float roughness = 1.0f;
+
+		bool operator==(const material_factors&) const = default;
+	};
+}
@@ -0,0 +1,461 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	// Symmetric 4x4 quadric, summed from area-weighted planes
+	struct quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	enum class vertex_kind : uint8_t
+	{
+		Manifold,  // Free to move to any neighbour
+		Border,    // On an open edge
+		Seam,      // One of two wedges along a UV or normal seam
+		Locked
+	};
+
+	struct collapse
+	{
+		float cost;  // Squared distance from the planes around both ends
+		uint32_t from;
+		uint32_t to;
+		uint32_t siblingTo;  // Where the other wedge of a seam vertex goes
+	};
+
+	const float* get_position(const float* positions, size_t stride, uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * stride);
+	}
+
+	void add_plane(quadric& q, const double n[3], double d, double weight)
+	{
+		q.a00 += weight * n[0] * n[0];
+		q.a01 += weight * n[0] * n[1];
+		q.a02 += weight * n[0] * n[2];
+		q.a11 += weight * n[1] * n[1];
+		q.a12 += weight * n[1] * n[2];
+		q.a22 += weight * n[2] * n[2];
+		q.b0 += weight * n[0] * d;
+		q.b1 += weight * n[1] * d;
+		q.b2 += weight * n[2] * d;
+		q.c += weight * d * d;
+		q.weight += weight;
+	}
+
+	void add_quadric(quadric& q, const quadric& other)
+	{
+		q.a00 += other.a00;
+		q.a01 += other.a01;
+		q.a02 += other.a02;
+		q.a11 += other.a11;
+		q.a12 += other.a12;
+		q.a22 += other.a22;
+		q.b0 += other.b0;
+		q.b1 += other.b1;
+		q.b2 += other.b2;
+		q.c += other.c;
+		q.weight += other.weight;
+	}
+
+	// Weighted sum of squared plane distances, not yet divided by the weight
+	double evaluate(const quadric& q, const float p[3])
+	{
+		double x = p[0], y = p[1], z = p[2];
+		return q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+			2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+	}
+
+	void triangle_normal(const float* p0, const float* p1, const float* p2, double n[3])
+	{
+		double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	uint64_t edge_key(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+}
+
+void d3d11renderer::mesh_simplifier::simplify(const float* positions, size_t vertexCount, size_t stride, const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, std::vector<uint32_t>& result, simplify_stats& stats)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	stats = simplify_stats();
+	stats.sourceTriangles = indexCount / 3;
+	result.assign(indices, indices + indexCount / 3 * 3);
+
+	// Vertices at the same position are wedges of one corner, split by a UV or normal seam. Each gets the id of the
+	// first wedge seen, and the wedges of a position form a ring
+	std::vector<uint32_t> position(vertexCount), nextWedge(vertexCount);
+	std::vector<uint8_t> used(vertexCount, 0);
+	std::unordered_map<std::string_view, uint32_t> firstWedge;
+	for (uint32_t index : result)
+	{
+		if (used[index])
+		{
+			continue;
+		}
+		used[index] = 1;
+		auto key = std::string_view(reinterpret_cast<const char*>(get_position(positions, stride, index)), sizeof(float) * 3);
+		auto inserted = firstWedge.emplace(key, index);
+		uint32_t first = inserted.first->second;
+		position[index] = first;
+		nextWedge[index] = inserted.second ? index : nextWedge[first];
+		nextWedge[first] = index;
+	}
+
+	// Open edges between wedges are seams when the positions have a triangle on both sides, and borders when they don't
+	std::unordered_map<uint64_t, uint32_t> vertexEdges, positionEdges;
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (int edge = 0; edge < 3; edge++)
+		{
+			uint32_t a = result[i + edge], b = result[i + (edge + 1) % 3];
+			vertexEdges[edge_key(a, b)]++;
+			positionEdges[edge_key(position[a], position[b])]++;
+		}
+	}
+	std::vector<uint8_t> seamEdges(vertexCount, 0), borderEdges(vertexCount, 0), nonManifold(vertexCount, 0);
+	for (const auto& [key, uses] : vertexEdges)
+	{
+		uint32_t a = static_cast<uint32_t>(key >> 32), b = static_cast<uint32_t>(key & 0xffffffff);
+		uint32_t positionUses = positionEdges[edge_key(position[a], position[b])];
+		if (positionUses > 2 || uses > 2)
+		{
+			nonManifold[a] = nonManifold[b] = 1;
+		}
+		else if (uses == 1 && positionUses == 1)
+		{
+			borderEdges[a]++;
+			borderEdges[b]++;
+		}
+		else if (uses == 1)
+		{
+			seamEdges[a]++;
+			seamEdges[b]++;
+		}
+	}
+
+	// Seam and border vertices only slide along their seam or border, corners and anything else irregular stay put
+	std::vector<vertex_kind> kind(vertexCount, vertex_kind::Locked);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		if (!used[i] || nonManifold[i])
+		{
+			continue;
+		}
+		uint32_t wedges = 1;
+		for (uint32_t wedge = nextWedge[i]; wedge != i; wedge = nextWedge[wedge])
+		{
+			wedges++;
+		}
+
+		if (wedges == 1 && borderEdges[i] == 0 && seamEdges[i] == 0)
+		{
+			kind[i] = vertex_kind::Manifold;
+		}
+		else if (wedges == 1 && borderEdges[i] == 2 && seamEdges[i] == 0)
+		{
+			kind[i] = vertex_kind::Border;
+		}
+		else if (wedges == 2 && seamEdges[i] == 2 && borderEdges[i] == 0 && !nonManifold[nextWedge[i]])
+		{
+			kind[i] = vertex_kind::Seam;
+		}
+		else
+		{
+			stats.lockedVertices++;
+		}
+	}
+
+	// One quadric per position, so the wedges of a seam agree on their cost
+	std::vector<quadric> quadrics(vertexCount, quadric());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const float* p0 = get_position(positions, stride, result[i]);
+		double n[3];
+		triangle_normal(p0, get_position(positions, stride, result[i + 1]), get_position(positions, stride, result[i + 2]), n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0)
+		{
+			continue;
+		}
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+		for (int corner = 0; corner < 3; corner++)
+		{
+			add_plane(quadrics[position[result[i + corner]]], n, d, length * 0.5);
+		}
+	}
+
+	// Triangles around each vertex; a collapse hands the moving vertex's triangles to its target
+	std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+	for (size_t i = 0; i < result.size(); i++)
+	{
+		vertexTriangles[result[i]].push_back(static_cast<uint32_t>(i / 3));
+	}
+	std::vector<uint8_t> removed(result.size() / 3, 0);
+	size_t triangleCount = result.size() / 3;
+	double maxCost = static_cast<double>(maxError) * maxError;
+
+	// Triangles around vertex that have a corner at the position of other, and the last such corner
+	auto count_shared = [&](uint32_t vertex, uint32_t other, uint32_t& corner)
+	{
+		uint32_t count = 0;
+		for (uint32_t t : vertexTriangles[vertex])
+		{
+			const uint32_t* triangle = &result[t * 3];
+			for (int i = 0; i < 3; i++)
+			{
+				if (!removed[t] && triangle[i] != vertex && position[triangle[i]] == position[other])
+				{
+					corner = triangle[i];
+					count++;
+				}
+			}
+		}
+		return count;
+	};
+
+	// Whether moving vertex onto the position of target turns any of its triangles around
+	auto flips = [&](uint32_t vertex, uint32_t target)
+	{
+		const float* moved = get_position(positions, stride, target);
+		for (uint32_t t : vertexTriangles[vertex])
+		{
+			const uint32_t* triangle = &result[t * 3];
+			if (removed[t] || position[triangle[0]] == position[target] || position[triangle[1]] == position[target] ||
+				position[triangle[2]] == position[target])
+			{
+				continue;
+			}
+
+			const float* corners[3];
+			const float* after[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				corners[corner] = get_position(positions, stride, triangle[corner]);
+				after[corner] = triangle[corner] == vertex ? moved : corners[corner];
+			}
+			double n0[3], n1[3];
+			triangle_normal(corners[0], corners[1], corners[2], n0);
+			triangle_normal(after[0], after[1], after[2], n1);
+			if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	// Cheapest collapse that moves vertex, over every neighbour it may move to
+	auto find_collapse = [&](uint32_t a, collapse& best)
+	{
+		best.cost = FLT_MAX;
+		if (kind[a] == vertex_kind::Locked)
+		{
+			return false;
+		}
+
+		bool found = false;
+		for (uint32_t t : vertexTriangles[a])
+		{
+			for (int i = 0; removed[t] == 0 && i < 3; i++)
+			{
+				// A border vertex follows its border; a seam vertex follows its seam, with the wedge on the other side
+				// moving to the matching wedge of the target
+				uint32_t b = result[t * 3 + i];
+				if (position[b] == position[a] ||
+					(kind[a] != vertex_kind::Manifold && kind[b] != kind[a] && kind[b] != vertex_kind::Locked))
+				{
+					continue;
+				}
+
+				// The cost is cheap, so only a neighbour that would beat the best so far gets the topology checks
+				const quadric& qa = quadrics[position[a]];
+				const quadric& qb = quadrics[position[b]];
+				const float* target = get_position(positions, stride, b);
+				double weight = qa.weight + qb.weight;
+				float cost = static_cast<float>(std::max(weight > 0.0 ? (evaluate(qa, target) + evaluate(qb, target)) / weight : 0.0, 0.0));
+				if (cost >= best.cost)
+				{
+					continue;
+				}
+
+				uint32_t corner = b, siblingTo = b;
+				if (kind[a] == vertex_kind::Border && count_shared(a, b, corner) != 1)
+				{
+					continue;
+				}
+				if (kind[a] == vertex_kind::Seam && (count_shared(a, b, corner) != 1 || count_shared(nextWedge[a], b, siblingTo) != 1))
+				{
+					continue;
+				}
+				if (flips(a, b) || (kind[a] == vertex_kind::Seam && flips(nextWedge[a], b)))
+				{
+					continue;
+				}
+				best = { cost, a, b, siblingTo };
+				found = true;
+			}
+		}
+		return found;
+	};
+
+	// Each vertex has at most one entry. Collapses nearby mostly make an entry dearer, so it is found again when it
+	// comes off the heap and goes back in if it is no longer the cheapest; a collapse only has to queue the vertices
+	// around it that had nothing queued
+	std::vector<collapse> heap;
+	std::vector<uint8_t> queued(vertexCount, 0);
+	auto cheaper = [](const collapse& x, const collapse& y) { return x.cost > y.cost; };
+	auto push_collapse = [&](const collapse& candidate)
+	{
+		queued[candidate.from] = 1;
+		heap.push_back(candidate);
+		std::push_heap(heap.begin(), heap.end(), cheaper);
+	};
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		collapse candidate;
+		if (find_collapse(i, candidate) && candidate.cost <= maxCost)
+		{
+			push_collapse(candidate);
+		}
+	}
+
+	// Moves the triangles of from onto to; the ones that had both lose a corner and are gone
+	std::vector<uint32_t> changed;
+	auto move_triangles = [&](uint32_t from, uint32_t to)
+	{
+		for (uint32_t t : vertexTriangles[from])
+		{
+			if (removed[t])
+			{
+				continue;
+			}
+			uint32_t* triangle = &result[t * 3];
+			for (int i = 0; i < 3; i++)
+			{
+				triangle[i] = triangle[i] == from ? to : triangle[i];
+			}
+			if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+			{
+				removed[t] = 1;
+				triangleCount--;
+				changed.insert(changed.end(), triangle, triangle + 3);
+			}
+			else
+			{
+				vertexTriangles[to].push_back(t);
+			}
+		}
+		vertexTriangles[from].clear();
+		std::erase_if(vertexTriangles[to], [&](uint32_t t) { return removed[t] != 0; });
+	};
+
+	while (triangleCount * 3 > targetIndexCount && !heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), cheaper);
+		uint32_t a = heap.back().from;
+		heap.pop_back();
+		queued[a] = 0;
+
+		collapse candidate;
+		if (!find_collapse(a, candidate) || candidate.cost > maxCost)
+		{
+			continue;
+		}
+		if (!heap.empty() && candidate.cost > heap.front().cost)
+		{
+			push_collapse(candidate);
+			continue;
+		}
+
+		uint32_t b = candidate.to;
+		uint32_t sibling = kind[a] == vertex_kind::Seam ? nextWedge[a] : a, siblingTarget = candidate.siblingTo;
+		changed.clear();
+		move_triangles(a, b);
+		if (sibling != a)
+		{
+			move_triangles(sibling, siblingTarget);
+		}
+		add_quadric(quadrics[position[b]], quadrics[position[a]]);
+		stats.error = std::max(stats.error, std::sqrt(candidate.cost));
+		stats.collapses++;
+
+		// Neighbours that had no collapse left may have one now
+		for (uint32_t vertex : { b, siblingTarget })
+		{
+			for (uint32_t t : vertexTriangles[vertex])
+			{
+				changed.insert(changed.end(), &result[t * 3], &result[t * 3] + 3);
+			}
+		}
+		for (uint32_t vertex : changed)
+		{
+			if (!queued[vertex] && find_collapse(vertex, candidate) && candidate.cost <= maxCost)
+			{
+				push_collapse(candidate);
+			}
+		}
+	}
+
+	size_t write = 0;
+	for (size_t t = 0; t < removed.size(); t++)
+	{
+		if (!removed[t])
+		{
+			std::memmove(&result[write], &result[t * 3], 3 * sizeof(uint32_t));
+			write += 3;
+		}
+	}
+	result.resize(write);
+
+	stats.triangles = result.size() / 3;
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t d3d11renderer::mesh_simplifier::select_lod(const float* lodErrors, uint32_t lodCount, float pixelsPerUnit, uint32_t current, const lod_settings& settings)
+{
+	uint32_t lod = std::min(current, lodCount - 1);
+
+	// Finer as soon as the current one shows
+	if (lodErrors[lod] * pixelsPerUnit > settings.pixelError)
+	{
+		while (lod > 0 && lodErrors[lod] * pixelsPerUnit > settings.pixelError)
+		{
+			lod--;
+		}
+		return lod;
+	}
+
+	// Coarser only once the next one is clearly under the limit, so an object at the threshold doesn't flicker
+	float coarserLimit = settings.pixelError * (1.0f - settings.hysteresis);
+	while (lod + 1 < lodCount && lodErrors[lod + 1] * pixelsPerUnit <= coarserLimit)
+	{
+		lod++;
+	}
+	return lod;
+}
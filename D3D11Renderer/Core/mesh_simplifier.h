@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	struct lod_settings
+	{
+		float pixelError = 1.0f;   // A LOD is used while its error covers less than this many pixels on screen
+		float hysteresis = 0.25f;  // Dropping to a coarser LOD needs the error this fraction under the limit
+	};
+
+	struct simplify_stats
+	{
+		size_t sourceTriangles = 0;
+		size_t triangles = 0;
+		size_t lockedVertices = 0;  // Seam or border corners and other irregular vertices, never moved
+		size_t collapses = 0;
+		float error = 0.0f;         // Largest distance a collapse moved the surface, in position units
+		double milliseconds = 0.0;
+	};
+
+	// Quadric error metric simplification by half-edge collapses: a vertex merges into one of its neighbours, which
+	// keeps its own position, UV and normal, so no attribute is ever interpolated. Vertices that share a position with
+	// another vertex sit on a UV or normal seam, and vertices on an open edge sit on a border; they only collapse along
+	// their seam or border, both wedges of a seam together, so seams never tear. Corners stay locked. Each vertex keeps its
+	// cheapest collapse that flips no triangle in a priority queue, and taking one only re-evaluates the vertices around
+	// it, so the work grows close to linearly with the mesh. Nothing here touches the GPU.
+	class mesh_simplifier
+	{
+	public:
+		// positions is xyz floats every stride bytes; indices is a triangle list into them. Stops at targetIndexCount,
+		// when no collapse stays under maxError, or when nothing more can collapse.
+		static void simplify(const float* positions, size_t vertexCount, size_t stride, const uint32_t* indices, size_t indexCount,
+			size_t targetIndexCount, float maxError, std::vector<uint32_t>& result, simplify_stats& stats);
+
+		// LOD whose error is the most that projects under the pixel limit; errors rise from LOD 0. pixelsPerUnit is
+		// the screen size of one unit at the object's distance. current is last frame's LOD, which the hysteresis keeps.
+		static uint32_t select_lod(const float* lodErrors, uint32_t lodCount, float pixelsPerUnit, uint32_t current, const lod_settings& settings);
+	};
+}
@@ -0,0 +1,754 @@
+#include "meshopt_codec.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr uint8_t ATTRIBUTE_HEADER = 0xA0;
+	constexpr uint8_t TRIANGLE_HEADER = 0xE0;
+	constexpr uint8_t SEQUENCE_HEADER = 0xD0;
+	constexpr uint8_t TRIANGLE_VERSION = 1;
+	constexpr uint8_t SEQUENCE_VERSION = 1;
+
+	constexpr size_t GROUP_SIZE = 16;
+	constexpr size_t GROUP_DECODE_LIMIT = 24;  // Most bytes one group can read: 8 of 4-bit codes and 16 escapes
+	constexpr size_t ATTRIBUTE_TAIL = 32;      // The first element, padded to this; also lets groups skip bounds checks
+	constexpr size_t BLOCK_BYTES = 8192;
+	constexpr size_t BLOCK_MAX = 256;
+
+	// Pairs of vertex FIFO slots a triangle starting a new strip can name with four bits instead of a byte.
+	// The table travels at the end of every stream, so a decoder never relies on this particular one
+	const uint8_t TRIANGLE_AUX_TABLE[16] = { 0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xA9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00 };
+
+	// Elements per block, so a block of every byte stream fits in 8 KB
+	size_t block_size(size_t stride)
+	{
+		return std::min((BLOCK_BYTES / stride) & ~(GROUP_SIZE - 1), BLOCK_MAX);
+	}
+
+	uint8_t zigzag(uint8_t value)
+	{
+		return static_cast<uint8_t>((static_cast<int8_t>(value) >> 7) ^ (value << 1));
+	}
+
+	// Bytes a group takes at 0, 2, 4 or 8 bits per value; the top code of 2 and 4 bits escapes to a whole byte
+	size_t group_bytes(const uint8_t* group, int width)
+	{
+		if (width == 0)
+			return std::all_of(group, group + GROUP_SIZE, [](uint8_t value) { return value == 0; }) ? 0 : SIZE_MAX;
+		if (width == 3)
+			return GROUP_SIZE;
+
+		int bits = 1 << width;
+		uint8_t escape = static_cast<uint8_t>((1 << bits) - 1);
+		size_t result = GROUP_SIZE * bits / 8;
+		for (size_t i = 0; i < GROUP_SIZE; i++)
+		{
+			result += group[i] >= escape;
+		}
+		return result;
+	}
+
+	// Two bits of header per group pick its width, four groups to a byte
+	void encode_bytes(const uint8_t* values, size_t count, std::vector<uint8_t>& result)
+	{
+		size_t header = result.size();
+		result.resize(result.size() + (count / GROUP_SIZE + 3) / 4, 0);
+
+		for (size_t i = 0; i < count; i += GROUP_SIZE)
+		{
+			const uint8_t* group = values + i;
+			int width = 3;
+			size_t bytes = GROUP_SIZE;
+			for (int candidate = 0; candidate < 3; candidate++)
+			{
+				size_t candidateBytes = group_bytes(group, candidate);
+				if (candidateBytes < bytes)
+				{
+					width = candidate;
+					bytes = candidateBytes;
+				}
+			}
+
+			size_t groupIndex = i / GROUP_SIZE;
+			result[header + groupIndex / 4] |= static_cast<uint8_t>(width << ((groupIndex % 4) * 2));
+
+			if (width == 3)
+			{
+				result.insert(result.end(), group, group + GROUP_SIZE);
+			}
+			else if (width > 0)
+			{
+				// Codes fill each byte from the top down, then the escaped values follow in order
+				int bits = 1 << width;
+				uint8_t escape = static_cast<uint8_t>((1 << bits) - 1);
+				for (size_t j = 0; j < GROUP_SIZE; j += 8 / bits)
+				{
+					uint8_t packed = 0;
+					for (size_t k = j; k < j + 8 / bits; k++)
+					{
+						packed = static_cast<uint8_t>((packed << bits) | std::min(group[k], escape));
+					}
+					result.push_back(packed);
+				}
+				for (size_t j = 0; j < GROUP_SIZE; j++)
+				{
+					if (group[j] >= escape)
+						result.push_back(group[j]);
+				}
+			}
+		}
+	}
+
+	// One group of 16 values. Codes unpack with shifts and interleaves; the rare escapes are patched in after
+	inline const uint8_t* decode_group(const uint8_t* data, uint8_t* values, int width)
+	{
+		if (width == 0)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm_setzero_si128());
+			return data;
+		}
+		if (width == 3)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+			return data + GROUP_SIZE;
+		}
+
+		__m128i unpacked;
+		const uint8_t* escaped;
+		uint8_t escape;
+		if (width == 1)
+		{
+			int32_t packed;
+			std::memcpy(&packed, data, sizeof(packed));
+			__m128i bytes = _mm_cvtsi32_si128(packed);
+			const __m128i mask = _mm_set1_epi8(3);
+			__m128i first = _mm_and_si128(_mm_srli_epi16(bytes, 6), mask);
+			__m128i second = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+			__m128i third = _mm_and_si128(_mm_srli_epi16(bytes, 2), mask);
+			__m128i fourth = _mm_and_si128(bytes, mask);
+			unpacked = _mm_unpacklo_epi16(_mm_unpacklo_epi8(first, second), _mm_unpacklo_epi8(third, fourth));
+			escaped = data + 4;
+			escape = 3;
+		}
+		else
+		{
+			__m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+			const __m128i mask = _mm_set1_epi8(15);
+			unpacked = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask), _mm_and_si128(bytes, mask));
+			escaped = data + 8;
+			escape = 15;
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(values), unpacked);
+		unsigned int escapes = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(unpacked, _mm_set1_epi8(static_cast<char>(escape)))));
+		while (escapes)
+		{
+			values[std::countr_zero(escapes)] = *escaped++;
+			escapes &= escapes - 1;
+		}
+		return escaped;
+	}
+
+	const uint8_t* decode_bytes(const uint8_t* data, const uint8_t* end, uint8_t* values, size_t count)
+	{
+		const uint8_t* header = data;
+		size_t headerSize = (count / GROUP_SIZE + 3) / 4;
+		if (static_cast<size_t>(end - data) < headerSize)
+			return nullptr;
+		data += headerSize;
+
+		for (size_t i = 0; i < count; i += GROUP_SIZE)
+		{
+			// The tail keeps the last real group this far from the end, so a group never reads past it
+			if (static_cast<size_t>(end - data) < GROUP_DECODE_LIMIT)
+				return nullptr;
+
+			size_t group = i / GROUP_SIZE;
+			data = decode_group(data, values + i, (header[group / 4] >> ((group % 4) * 2)) & 3);
+		}
+		return data;
+	}
+
+	// Byte streams come four at a time, which transposes into whole 32-bit words of four elements per register
+	const uint8_t* decode_attribute_block(const uint8_t* data, const uint8_t* end, uint8_t* elements, size_t count, size_t stride, uint8_t* last)
+	{
+		alignas(16) uint8_t deltas[4][BLOCK_MAX];
+		alignas(16) uint8_t words[64];
+		size_t padded = (count + GROUP_SIZE - 1) & ~(GROUP_SIZE - 1);
+		const __m128i lowBits = _mm_set1_epi8(0x7F);
+		const __m128i one = _mm_set1_epi8(1);
+
+		for (size_t k = 0; k < stride; k += 4)
+		{
+			__m128i running[4];
+			for (int c = 0; c < 4; c++)
+			{
+				data = decode_bytes(data, end, deltas[c], padded);
+				if (!data)
+					return nullptr;
+				running[c] = _mm_set1_epi8(static_cast<char>(last[k + c]));
+			}
+
+			for (size_t i = 0; i < padded; i += GROUP_SIZE)
+			{
+				__m128i channels[4];
+				for (int c = 0; c < 4; c++)
+				{
+					// Undo the zigzag, then a prefix sum over the 16 deltas in four shifted adds
+					__m128i value = _mm_load_si128(reinterpret_cast<const __m128i*>(deltas[c] + i));
+					value = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(value, 1), lowBits), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(value, one)));
+					value = _mm_add_epi8(value, _mm_slli_si128(value, 1));
+					value = _mm_add_epi8(value, _mm_slli_si128(value, 2));
+					value = _mm_add_epi8(value, _mm_slli_si128(value, 4));
+					value = _mm_add_epi8(value, _mm_slli_si128(value, 8));
+					value = _mm_add_epi8(value, running[c]);
+
+					// The last byte carries on into the next group
+					__m128i top = _mm_shufflehi_epi16(_mm_unpackhi_epi8(value, value), _MM_SHUFFLE(3, 3, 3, 3));
+					running[c] = _mm_shuffle_epi32(top, _MM_SHUFFLE(3, 3, 3, 3));
+					channels[c] = value;
+				}
+
+				__m128i low01 = _mm_unpacklo_epi8(channels[0], channels[1]);
+				__m128i high01 = _mm_unpackhi_epi8(channels[0], channels[1]);
+				__m128i low23 = _mm_unpacklo_epi8(channels[2], channels[3]);
+				__m128i high23 = _mm_unpackhi_epi8(channels[2], channels[3]);
+				_mm_store_si128(reinterpret_cast<__m128i*>(words), _mm_unpacklo_epi16(low01, low23));
+				_mm_store_si128(reinterpret_cast<__m128i*>(words + 16), _mm_unpackhi_epi16(low01, low23));
+				_mm_store_si128(reinterpret_cast<__m128i*>(words + 32), _mm_unpacklo_epi16(high01, high23));
+				_mm_store_si128(reinterpret_cast<__m128i*>(words + 48), _mm_unpackhi_epi16(high01, high23));
+
+				size_t groupCount = std::min(GROUP_SIZE, count - i);
+				uint8_t* out = elements + i * stride + k;
+				for (size_t j = 0; j < groupCount; j++)
+				{
+					std::memcpy(out + j * stride, words + j * 4, 4);
+				}
+			}
+
+			std::memcpy(last + k, elements + (count - 1) * stride + k, 4);
+		}
+		return data;
+	}
+
+	bool decode_attributes(uint8_t* elements, size_t count, size_t stride, const uint8_t* data, size_t size)
+	{
+		const uint8_t* end = data + size;
+		if (size < 1 + std::max(stride, ATTRIBUTE_TAIL) || data[0] != ATTRIBUTE_HEADER)
+			return false;
+		data++;
+
+		uint8_t last[256];
+		std::memcpy(last, end - stride, stride);
+
+		size_t blockSize = block_size(stride);
+		for (size_t offset = 0; offset < count; offset += blockSize)
+		{
+			data = decode_attribute_block(data, end, elements + offset * stride, std::min(blockSize, count - offset), stride, last);
+			if (!data)
+				return false;
+		}
+		return static_cast<size_t>(end - data) == std::max(stride, ATTRIBUTE_TAIL);
+	}
+
+	void encode_varint(uint32_t value, std::vector<uint8_t>& result)
+	{
+		do
+		{
+			result.push_back(static_cast<uint8_t>((value & 127) | (value > 127 ? 128 : 0)));
+			value >>= 7;
+		} while (value);
+	}
+
+	// At most five bytes, so malformed data can't run on
+	uint32_t decode_varint(const uint8_t*& data)
+	{
+		uint8_t lead = *data++;
+		if (lead < 128)
+			return lead;
+
+		uint32_t result = lead & 127;
+		uint32_t shift = 7;
+		for (int i = 0; i < 4; i++)
+		{
+			uint8_t group = *data++;
+			result |= static_cast<uint32_t>(group & 127) << shift;
+			shift += 7;
+			if (group < 128)
+				break;
+		}
+		return result;
+	}
+
+	void encode_delta(uint32_t index, uint32_t last, std::vector<uint8_t>& result)
+	{
+		uint32_t delta = index - last;
+		encode_varint((delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31), result);
+	}
+
+	uint32_t decode_delta(const uint8_t*& data, uint32_t last)
+	{
+		uint32_t value = decode_varint(data);
+		return last + ((value >> 1) ^ (0u - (value & 1)));
+	}
+
+	// The decoder rebuilds both FIFOs from what it decodes, so every push here has to match one there exactly
+	struct triangle_fifos
+	{
+		uint32_t edges[16][2];
+		uint32_t vertices[16];
+		size_t edgeOffset = 0;
+		size_t vertexOffset = 0;
+
+		triangle_fifos()
+		{
+			std::memset(edges, 0xFF, sizeof(edges));
+			std::memset(vertices, 0xFF, sizeof(vertices));
+		}
+
+		void push_edge(uint32_t a, uint32_t b)
+		{
+			edges[edgeOffset][0] = a;
+			edges[edgeOffset][1] = b;
+			edgeOffset = (edgeOffset + 1) & 15;
+		}
+
+		void push_vertex(uint32_t v, bool advance = true)
+		{
+			vertices[vertexOffset] = v;
+			vertexOffset = (vertexOffset + advance) & 15;
+		}
+
+		// Age of the edge a-b, b-c or c-a in the FIFO, times 4, plus which of them it is
+		int find_edge(uint32_t a, uint32_t b, uint32_t c) const
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				size_t index = (edgeOffset - 1 - i) & 15;
+				if (edges[index][0] == a && edges[index][1] == b)
+					return (i << 2) | 0;
+				if (edges[index][0] == b && edges[index][1] == c)
+					return (i << 2) | 1;
+				if (edges[index][0] == c && edges[index][1] == a)
+					return (i << 2) | 2;
+			}
+			return -1;
+		}
+
+		int find_vertex(uint32_t v) const
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				if (vertices[(vertexOffset - 1 - i) & 15] == v)
+					return i;
+			}
+			return -1;
+		}
+	};
+
+	// Version 1 codes vertices one before or after the last explicit one in the edge-hit byte itself
+	constexpr int FEC_MAX = 13;
+
+	bool decode_triangles(uint8_t* destination, size_t indexCount, size_t indexSize, const uint8_t* buffer, size_t size)
+	{
+		if (size < 1 + indexCount / 3 + 16 || (buffer[0] & 0xF0) != TRIANGLE_HEADER || (buffer[0] & 0x0F) > TRIANGLE_VERSION)
+			return false;
+
+		int fecMax = (buffer[0] & 0x0F) >= 1 ? FEC_MAX : 15;
+		triangle_fifos fifos;
+		uint32_t next = 0, last = 0;
+		const uint8_t* code = buffer + 1;
+		const uint8_t* data = code + indexCount / 3;
+		const uint8_t* safeEnd = buffer + size - 16;
+		const uint8_t* auxTable = safeEnd;
+
+		auto write = [&](size_t i, uint32_t a, uint32_t b, uint32_t c)
+		{
+			if (indexSize == 2)
+			{
+				uint16_t triangle[3] = { static_cast<uint16_t>(a), static_cast<uint16_t>(b), static_cast<uint16_t>(c) };
+				std::memcpy(destination + i * 2, triangle, sizeof(triangle));
+			}
+			else
+			{
+				uint32_t triangle[3] = { a, b, c };
+				std::memcpy(destination + i * 4, triangle, sizeof(triangle));
+			}
+		};
+
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			// A triangle reads at most 16 data bytes, and the table is 16 bytes, so nothing past the buffer is read
+			if (data > safeEnd)
+				return false;
+
+			uint8_t codeTri = *code++;
+			if (codeTri < 0xF0)
+			{
+				// Shares an edge with a recent triangle; the third vertex is new, recent, or coded explicitly
+				const uint32_t* edge = fifos.edges[(fifos.edgeOffset - 1 - (codeTri >> 4)) & 15];
+				uint32_t a = edge[0], b = edge[1];
+				int fec = codeTri & 15;
+				if (fec < fecMax)
+				{
+					uint32_t c = fec == 0 ? next : fifos.vertices[(fifos.vertexOffset - 1 - fec) & 15];
+					next += fec == 0;
+					write(i, a, b, c);
+					fifos.push_vertex(c, fec == 0);
+					fifos.push_edge(c, b);
+					fifos.push_edge(a, c);
+				}
+				else
+				{
+					// 13 and 14 are the last explicit vertex minus and plus one
+					uint32_t c = fec != 15 ? last + (fec - (fec ^ 3)) : decode_delta(data, last);
+					last = c;
+					write(i, a, b, c);
+					fifos.push_vertex(c);
+					fifos.push_edge(c, b);
+					fifos.push_edge(a, c);
+				}
+			}
+			else
+			{
+				// A new strip: a is the next new vertex or explicit, b and c come from the aux byte or the table
+				uint8_t aux;
+				bool explicitA = codeTri == 0xFF;
+				bool fromTable = codeTri < 0xFE;
+				if (fromTable)
+				{
+					aux = auxTable[codeTri & 15];
+				}
+				else
+				{
+					aux = *data++;
+					// All zero outside the table restarts the new vertex count
+					if (aux == 0)
+						next = 0;
+				}
+
+				int feb = aux >> 4, fec = aux & 15;
+				uint32_t a = explicitA ? 0 : next++;
+				uint32_t b = feb == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - feb) & 15];
+				uint32_t c = fec == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - fec) & 15];
+				if (!fromTable)
+				{
+					if (explicitA)
+						last = a = decode_delta(data, last);
+					if (feb == 15)
+						last = b = decode_delta(data, last);
+					if (fec == 15)
+						last = c = decode_delta(data, last);
+				}
+
+				write(i, a, b, c);
+				fifos.push_vertex(a);
+				fifos.push_vertex(b, feb == 0 || feb == 15);
+				fifos.push_vertex(c, fec == 0 || fec == 15);
+				fifos.push_edge(b, a);
+				fifos.push_edge(c, b);
+				fifos.push_edge(a, c);
+			}
+		}
+		return data == safeEnd;
+	}
+
+	bool decode_sequence(uint8_t* destination, size_t indexCount, size_t indexSize, const uint8_t* buffer, size_t size)
+	{
+		if (size < 1 + indexCount + 4 || (buffer[0] & 0xF0) != SEQUENCE_HEADER || (buffer[0] & 0x0F) > SEQUENCE_VERSION)
+			return false;
+
+		const uint8_t* data = buffer + 1;
+		const uint8_t* safeEnd = buffer + size - 4;
+		uint32_t last[2] = {};
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			// Five bytes at most per index, four of them covered by the tail
+			if (data >= safeEnd)
+				return false;
+
+			// The low bit picks which of two baselines the delta is from
+			uint32_t value = decode_varint(data);
+			uint32_t baseline = value & 1;
+			value >>= 1;
+			uint32_t index = last[baseline] + ((value >> 1) ^ (0u - (value & 1)));
+			last[baseline] = index;
+
+			if (indexSize == 2)
+			{
+				uint16_t narrow = static_cast<uint16_t>(index);
+				std::memcpy(destination + i * 2, &narrow, sizeof(narrow));
+			}
+			else
+			{
+				std::memcpy(destination + i * 4, &index, sizeof(index));
+			}
+		}
+		return data == safeEnd;
+	}
+
+	template<typename T>
+	void filter_octahedral(T* data, size_t count)
+	{
+		const float maximum = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+		for (size_t i = 0; i < count; i++)
+		{
+			// z is stored as one minus |x| minus |y| at the same scale; the lower hemisphere folds over the diagonals
+			float x = static_cast<float>(data[i * 4 + 0]);
+			float y = static_cast<float>(data[i * 4 + 1]);
+			float z = static_cast<float>(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+			float t = z < 0.0f ? z : 0.0f;
+			x -= x >= 0.0f ? t : -t;
+			y -= y >= 0.0f ? t : -t;
+
+			float scale = maximum / std::sqrt(x * x + y * y + z * z);
+			data[i * 4 + 0] = static_cast<T>(static_cast<int>(x * scale + (x >= 0.0f ? 0.5f : -0.5f)));
+			data[i * 4 + 1] = static_cast<T>(static_cast<int>(y * scale + (y >= 0.0f ? 0.5f : -0.5f)));
+			data[i * 4 + 2] = static_cast<T>(static_cast<int>(z * scale + (z >= 0.0f ? 0.5f : -0.5f)));
+		}
+	}
+
+	void filter_quaternion(int16_t* data, size_t count)
+	{
+		const float scale = 1.0f / std::sqrt(2.0f);
+		for (size_t i = 0; i < count; i++)
+		{
+			// The fourth value holds the range of the other three above its low two bits, which name the dropped one
+			int16_t* q = data + i * 4;
+			float range = scale / static_cast<float>(q[3] | 3);
+			float x = q[0] * range, y = q[1] * range, z = q[2] * range;
+			float w = std::sqrt(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+			int dropped = q[3] & 3;
+
+			int16_t xf = static_cast<int16_t>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f));
+			int16_t yf = static_cast<int16_t>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f));
+			int16_t zf = static_cast<int16_t>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f));
+			int16_t wf = static_cast<int16_t>(w * 32767.0f + 0.5f);
+			q[(dropped + 1) & 3] = xf;
+			q[(dropped + 2) & 3] = yf;
+			q[(dropped + 3) & 3] = zf;
+			q[dropped] = wf;
+		}
+	}
+
+	void filter_exponential(uint32_t* data, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			int32_t mantissa = static_cast<int32_t>(data[i] << 8) >> 8;
+			int32_t exponent = static_cast<int32_t>(data[i]) >> 24;
+			float power;
+			uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+			std::memcpy(&power, &bits, sizeof(power));
+			float value = power * static_cast<float>(mantissa);
+			std::memcpy(&data[i], &value, sizeof(value));
+		}
+	}
+}
+
+void d3d11renderer::encode_meshopt_attributes(const uint8_t* elements, size_t count, size_t stride, std::vector<uint8_t>& result)
+{
+	result.push_back(ATTRIBUTE_HEADER);
+
+	uint8_t first[256] = {};
+	if (count > 0)
+		std::memcpy(first, elements, stride);
+	uint8_t last[256];
+	std::memcpy(last, first, stride);
+
+	// Each byte of the element is its own stream of deltas from the element before
+	uint8_t deltas[BLOCK_MAX] = {};
+	size_t blockSize = block_size(stride);
+	for (size_t offset = 0; offset < count; offset += blockSize)
+	{
+		size_t size = std::min(blockSize, count - offset);
+		const uint8_t* block = elements + offset * stride;
+		for (size_t k = 0; k < stride; k++)
+		{
+			uint8_t previous = last[k];
+			for (size_t i = 0; i < size; i++)
+			{
+				uint8_t value = block[i * stride + k];
+				deltas[i] = zigzag(static_cast<uint8_t>(value - previous));
+				previous = value;
+			}
+			encode_bytes(deltas, (size + GROUP_SIZE - 1) & ~(GROUP_SIZE - 1), result);
+		}
+		std::memcpy(last, block + (size - 1) * stride, stride);
+	}
+
+	// The first element ends the stream, where the decoder finds it before reading anything else
+	if (stride < ATTRIBUTE_TAIL)
+		result.insert(result.end(), ATTRIBUTE_TAIL - stride, 0);
+	result.insert(result.end(), first, first + stride);
+}
+
+void d3d11renderer::encode_meshopt_triangles(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& result)
+{
+	static const int rotations[3][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 } };
+
+	std::vector<uint8_t> codes, data;
+	codes.reserve(indexCount / 3);
+	triangle_fifos fifos;
+	uint32_t next = 0, last = 0;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const uint32_t* triangle = indices + i;
+		int edge = fifos.find_edge(triangle[0], triangle[1], triangle[2]);
+		if (edge >= 0 && (edge >> 2) < 15)
+		{
+			// Rotated so a-b is the edge already seen
+			const int* order = rotations[edge & 3];
+			uint32_t a = triangle[order[0]], b = triangle[order[1]], c = triangle[order[2]];
+			int fc = fifos.find_vertex(c);
+			int fec = fc >= 1 && fc < FEC_MAX ? fc : (c == next ? (next++, 0) : 15);
+			if (fec == 15 && c + 1 == last)
+				fec = 13, last = c;
+			if (fec == 15 && c == last + 1)
+				fec = 14, last = c;
+
+			codes.push_back(static_cast<uint8_t>(((edge >> 2) << 4) | fec));
+			if (fec == 15)
+			{
+				encode_delta(c, last, data);
+				last = c;
+			}
+			if (fec == 0 || fec >= FEC_MAX)
+				fifos.push_vertex(c);
+			fifos.push_edge(c, b);
+			fifos.push_edge(a, c);
+			continue;
+		}
+
+		// Rotated so the next new vertex comes first where there is one
+		const int* order = rotations[triangle[1] == next ? 1 : (triangle[2] == next ? 2 : 0)];
+		uint32_t a = triangle[order[0]], b = triangle[order[1]], c = triangle[order[2]];
+
+		// 0, 1, 2 again restarts the new vertex count, as when meshes are simply appended
+		bool reset = a == 0 && b == 1 && c == 2 && next > 0;
+		if (reset)
+		{
+			next = 0;
+			std::memset(fifos.vertices, 0xFF, sizeof(fifos.vertices));
+		}
+
+		int fb = fifos.find_vertex(b);
+		int fc = fifos.find_vertex(c);
+		int fea = a == next ? (next++, 0) : 15;
+		int feb = fb >= 0 && fb < 14 ? fb + 1 : (b == next ? (next++, 0) : 15);
+		int fec = fc >= 0 && fc < 14 ? fc + 1 : (c == next ? (next++, 0) : 15);
+
+		uint8_t aux = static_cast<uint8_t>((feb << 4) | fec);
+		const uint8_t* found = std::find(TRIANGLE_AUX_TABLE, TRIANGLE_AUX_TABLE + 14, aux);
+		if (fea == 0 && found != TRIANGLE_AUX_TABLE + 14 && !reset)
+		{
+			codes.push_back(static_cast<uint8_t>(0xF0 | (found - TRIANGLE_AUX_TABLE)));
+		}
+		else
+		{
+			codes.push_back(static_cast<uint8_t>(0xFE | (fea == 15)));
+			data.push_back(aux);
+		}
+
+		if (fea == 15)
+		{
+			encode_delta(a, last, data);
+			last = a;
+		}
+		if (feb == 15)
+		{
+			encode_delta(b, last, data);
+			last = b;
+		}
+		if (fec == 15)
+		{
+			encode_delta(c, last, data);
+			last = c;
+		}
+
+		fifos.push_vertex(a);
+		if (feb == 0 || feb == 15)
+			fifos.push_vertex(b);
+		if (fec == 0 || fec == 15)
+			fifos.push_vertex(c);
+		fifos.push_edge(b, a);
+		fifos.push_edge(c, b);
+		fifos.push_edge(a, c);
+	}
+
+	result.push_back(TRIANGLE_HEADER | TRIANGLE_VERSION);
+	result.insert(result.end(), codes.begin(), codes.end());
+	result.insert(result.end(), data.begin(), data.end());
+	result.insert(result.end(), TRIANGLE_AUX_TABLE, TRIANGLE_AUX_TABLE + 16);
+}
+
+void d3d11renderer::encode_meshopt_indices(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& result)
+{
+	result.push_back(SEQUENCE_HEADER | SEQUENCE_VERSION);
+
+	// Two baselines, switching whenever the delta from the current one gets too big for one byte, so interleaved
+	// runs such as a list of lines each stay cheap
+	uint32_t last[2] = {};
+	uint32_t current = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t index = indices[i];
+		int32_t distance = static_cast<int32_t>(index - last[current]);
+		current ^= (distance < 0 ? -static_cast<int64_t>(distance) : distance) >= 30;
+
+		uint32_t delta = index - last[current];
+		uint32_t value = (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+		encode_varint((value << 1) | current, result);
+		last[current] = index;
+	}
+
+	result.insert(result.end(), 4, 0);
+}
+
+bool d3d11renderer::decode_meshopt(uint8_t* destination, size_t count, size_t stride, const uint8_t* source, size_t sourceSize,
+	meshopt_mode mode, meshopt_filter filter)
+{
+	switch (mode)
+	{
+	case meshopt_mode::Attributes:
+		if (stride == 0 || stride > 256 || stride % 4 != 0 || !decode_attributes(destination, count, stride, source, sourceSize))
+			return false;
+		break;
+	case meshopt_mode::Triangles:
+		return (stride == 2 || stride == 4) && count % 3 == 0 && filter == meshopt_filter::None &&
+			decode_triangles(destination, count, stride, source, sourceSize);
+	case meshopt_mode::Indices:
+		return (stride == 2 || stride == 4) && filter == meshopt_filter::None && decode_sequence(destination, count, stride, source, sourceSize);
+	}
+
+	switch (filter)
+	{
+	case meshopt_filter::None:
+		return true;
+	case meshopt_filter::Octahedral:
+		if (stride == 4)
+			filter_octahedral(reinterpret_cast<int8_t*>(destination), count);
+		else if (stride == 8)
+			filter_octahedral(reinterpret_cast<int16_t*>(destination), count);
+		else
+			return false;
+		return true;
+	case meshopt_filter::Quaternion:
+		if (stride != 8)
+			return false;
+		filter_quaternion(reinterpret_cast<int16_t*>(destination), count);
+		return true;
+	case meshopt_filter::Exponential:
+		filter_exponential(reinterpret_cast<uint32_t*>(destination), count * stride / 4);
+		return true;
+	}
+	return false;
+}
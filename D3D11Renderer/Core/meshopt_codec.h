@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	// The streams of the glTF EXT_meshopt_compression extension, which any loader supporting it reads byte for byte.
+	// Attributes are per-byte deltas from the previous element, packed in groups of 16 at 0, 2, 4 or 8 bits.
+	// Triangles code each one against a cache of recent edges and vertices; other indices are varint deltas. The
+	// output is meant to be compressed further by the file system or transport, which the layout leaves easy to do.
+	enum class meshopt_mode
+	{
+		Attributes,
+		Triangles,
+		Indices
+	};
+
+	// Applied to attribute data after decoding; the encoders here are lossless and never filter
+	enum class meshopt_filter
+	{
+		None,
+		Octahedral,   // Normals or tangents as 8 or 16-bit octahedral xy, rebuilt as normalized xyz
+		Quaternion,   // Rotations as three 16-bit components and the index of the dropped one
+		Exponential   // Floats as a 24-bit mantissa and an 8-bit exponent
+	};
+
+	// Appends the encoding of count elements of stride bytes, a multiple of 4 up to 256
+	void encode_meshopt_attributes(const uint8_t* elements, size_t count, size_t stride, std::vector<uint8_t>& result);
+	// A triangle list. Fewer bytes come out when the triangles are in vertex cache order and the vertices in first-use order
+	void encode_meshopt_triangles(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& result);
+	void encode_meshopt_indices(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& result);
+
+	// Decodes count elements of stride bytes, indices being 2 or 4 bytes wide, then applies the filter. False when the
+	// combination is not allowed or the data does not decode to exactly that many elements; source is only read
+	// within sourceSize either way. Attributes decode with SSE2 16 bytes at a time.
+	bool decode_meshopt(uint8_t* destination, size_t count, size_t stride, const uint8_t* source, size_t sourceSize,
+		meshopt_mode mode, meshopt_filter filter);
+}
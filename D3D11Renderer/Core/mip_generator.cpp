@@ -0,0 +1,387 @@
+#include "mip_generator.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+using namespace d3d11renderer;
+
+// Rows handed to a worker at once
+constexpr size_t ROWS_PER_JOB = 16;
+
+// Matches the pow(x, 2.2) decode in the pixel shaders
+constexpr float GAMMA = 2.2f;
+
+namespace
+{
+	// Float RGBA image, 4 floats per texel
+	struct float_image
+	{
+		size_t width = 0;
+		size_t height = 0;
+		std::vector<float> texels;
+
+		void resize(size_t w, size_t h)
+		{
+			width = w;
+			height = h;
+			texels.resize(w * h * 4);
+		}
+
+		float* row(size_t y) { return texels.data() + y * width * 4; }
+		const float* row(size_t y) const { return texels.data() + y * width * 4; }
+	};
+
+	// Filter taps for every output texel of one axis. Sources wrap, matching the WRAP samplers.
+	struct filter_taps
+	{
+		size_t tapCount = 0;
+		std::vector<size_t> indices;  // tapCount per output texel
+		std::vector<float> weights;   // tapCount per output texel, normalized
+	};
+
+	float sinc(float x)
+	{
+		if (std::fabs(x) < 1e-5f)
+			return 1.0f;
+
+		x *= 3.14159265f;
+		return std::sin(x) / x;
+	}
+
+	// Zeroth order modified Bessel function of the first kind
+	float bessel_i0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		float halfX = x * 0.5f;
+		for (int k = 1; k < 32; k++)
+		{
+			term *= (halfX / k) * (halfX / k);
+			sum += term;
+			if (term < sum * 1e-7f)
+				break;
+		}
+		return sum;
+	}
+
+	// Half-width of the filter in destination texels
+	float filter_support(mip_filter filter)
+	{
+		switch (filter)
+		{
+		case mip_filter::Box:
+			return 0.5f;
+		case mip_filter::Lanczos:
+			return 3.0f;
+		case mip_filter::Kaiser:
+		default:
+			return 3.0f;
+		}
+	}
+
+	float evaluate_filter(mip_filter filter, float x)
+	{
+		switch (filter)
+		{
+		case mip_filter::Box:
+			return std::fabs(x) <= 0.5f ? 1.0f : 0.0f;
+		case mip_filter::Lanczos:
+			return std::fabs(x) < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+		case mip_filter::Kaiser:
+		default:
+		{
+			// Kaiser-windowed sinc, width 3 and alpha 4
+			const float width = 3.0f;
+			const float alpha = 4.0f;
+			float t = x / width;
+			if (t * t >= 1.0f)
+				return 0.0f;
+			return sinc(x) * bessel_i0(alpha * std::sqrt(1.0f - t * t)) / bessel_i0(alpha);
+		}
+		}
+	}
+
+	filter_taps build_taps(size_t sourceSize, size_t destinationSize, mip_filter filter)
+	{
+		filter_taps taps;
+
+		float scale = static_cast<float>(destinationSize) / static_cast<float>(sourceSize);
+		float radius = filter_support(filter) / scale;
+		taps.tapCount = static_cast<size_t>(std::ceil(radius * 2.0f)) + 1;
+		taps.indices.resize(taps.tapCount * destinationSize);
+		taps.weights.resize(taps.tapCount * destinationSize);
+
+		for (size_t x = 0; x < destinationSize; x++)
+		{
+			float center = (static_cast<float>(x) + 0.5f) / scale;
+			long long first = static_cast<long long>(std::floor(center - radius));
+			float total = 0.0f;
+
+			for (size_t t = 0; t < taps.tapCount; t++)
+			{
+				long long i = first + static_cast<long long>(t);
+				float weight = evaluate_filter(filter, (static_cast<float>(i) + 0.5f - center) * scale);
+				long long wrapped = i % static_cast<long long>(sourceSize);
+				if (wrapped < 0)
+					wrapped += static_cast<long long>(sourceSize);
+
+				taps.indices[x * taps.tapCount + t] = static_cast<size_t>(wrapped);
+				taps.weights[x * taps.tapCount + t] = weight;
+				total += weight;
+			}
+
+			for (size_t t = 0; t < taps.tapCount; t++)
+			{
+				taps.weights[x * taps.tapCount + t] /= total;
+			}
+		}
+
+		return taps;
+	}
+
+	void decode_level(const Image& source, const mip_settings& settings, float_image& destination)
+	{
+		float toLinear[256];
+		for (int i = 0; i < 256; i++)
+		{
+			float value = static_cast<float>(i) / 255.0f;
+			toLinear[i] = settings.gammaSpace ? std::pow(value, GAMMA) : value;
+		}
+
+		destination.resize(source.width, source.height);
+
+		parallel_for(source.height, ROWS_PER_JOB, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				const uint8_t* in = source.pixels + y * source.rowPitch;
+				float* out = destination.row(y);
+				for (size_t x = 0; x < source.width * 4; x += 4)
+				{
+					out[x + 0] = toLinear[in[x + 0]];
+					out[x + 1] = toLinear[in[x + 1]];
+					out[x + 2] = toLinear[in[x + 2]];
+					out[x + 3] = static_cast<float>(in[x + 3]) / 255.0f;
+				}
+			}
+		});
+	}
+
+	// Resamples along X; the result has the destination width and the source height.
+	void filter_horizontal(const float_image& source, const filter_taps& taps, size_t destinationWidth, float_image& destination)
+	{
+		destination.resize(destinationWidth, source.height);
+
+		parallel_for(source.height, ROWS_PER_JOB, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				const float* in = source.row(y);
+				float* out = destination.row(y);
+
+				for (size_t x = 0; x < destinationWidth; x++)
+				{
+					const size_t* index = &taps.indices[x * taps.tapCount];
+					const float* weight = &taps.weights[x * taps.tapCount];
+					__m128 sum = _mm_setzero_ps();
+
+					for (size_t t = 0; t < taps.tapCount; t++)
+					{
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + index[t] * 4), _mm_set1_ps(weight[t])));
+					}
+
+					_mm_storeu_ps(out + x * 4, sum);
+				}
+			}
+		});
+	}
+
+	// Resamples along Y; whole rows are accumulated so the inner loop streams through memory.
+	void filter_vertical(const float_image& source, const filter_taps& taps, size_t destinationHeight, float_image& destination)
+	{
+		destination.resize(source.width, destinationHeight);
+
+		parallel_for(destinationHeight, ROWS_PER_JOB, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				const size_t* index = &taps.indices[y * taps.tapCount];
+				const float* weight = &taps.weights[y * taps.tapCount];
+				float* out = destination.row(y);
+				std::memset(out, 0, source.width * 4 * sizeof(float));
+
+				for (size_t t = 0; t < taps.tapCount; t++)
+				{
+					const float* in = source.row(index[t]);
+					__m128 w = _mm_set1_ps(weight[t]);
+
+					for (size_t x = 0; x < source.width * 4; x += 4)
+					{
+						_mm_storeu_ps(out + x, _mm_add_ps(_mm_loadu_ps(out + x), _mm_mul_ps(_mm_loadu_ps(in + x), w)));
+					}
+				}
+			}
+		});
+	}
+
+	void renormalize(float_image& image)
+	{
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 half = _mm_set1_ps(0.5f);
+
+		parallel_for(image.height, ROWS_PER_JOB, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				float* texel = image.row(y);
+				for (size_t x = 0; x < image.width; x++, texel += 4)
+				{
+					float alpha = texel[3];
+
+					// [0, 1] -> [-1, 1], normalize xyz, back to [0, 1]
+					__m128 n = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(texel), two), one);
+					__m128 squared = _mm_mul_ps(n, n);
+					float lengthSq = _mm_cvtss_f32(squared) + _mm_cvtss_f32(_mm_shuffle_ps(squared, squared, 1)) + _mm_cvtss_f32(_mm_shuffle_ps(squared, squared, 2));
+					if (lengthSq > 1e-12f)
+					{
+						n = _mm_mul_ps(n, _mm_set1_ps(1.0f / std::sqrt(lengthSq)));
+					}
+					else
+					{
+						n = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+					}
+
+					_mm_storeu_ps(texel, _mm_add_ps(_mm_mul_ps(n, half), half));
+					texel[3] = alpha;
+				}
+			}
+		});
+	}
+
+	float alpha_coverage(const float_image& image, float cutoff, float scale)
+	{
+		size_t covered = 0;
+		const float* texel = image.texels.data();
+		for (size_t i = 0; i < image.width * image.height; i++, texel += 4)
+		{
+			if (texel[3] * scale > cutoff)
+				covered++;
+		}
+		return static_cast<float>(covered) / static_cast<float>(image.width * image.height);
+	}
+
+	// Finds the alpha scale that gives this level the same coverage as the top level.
+	float find_alpha_scale(const float_image& image, float cutoff, float targetCoverage)
+	{
+		float low = 0.0f;
+		float high = 4.0f;
+		for (int i = 0; i < 12; i++)
+		{
+			float middle = (low + high) * 0.5f;
+			if (alpha_coverage(image, cutoff, middle) > targetCoverage)
+				high = middle;
+			else
+				low = middle;
+		}
+
+		// Coverage is a step function of the scale; keep whichever side of the step lands closer.
+		float lowError = std::fabs(alpha_coverage(image, cutoff, low) - targetCoverage);
+		float highError = std::fabs(alpha_coverage(image, cutoff, high) - targetCoverage);
+		return lowError <= highError ? low : high;
+	}
+
+	void encode_level(const float_image& source, const mip_settings& settings, float alphaScale, const Image& destination)
+	{
+		float inverseGamma = settings.gammaSpace ? 1.0f / GAMMA : 1.0f;
+		__m128 zero = _mm_setzero_ps();
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 scale = _mm_setr_ps(1.0f, 1.0f, 1.0f, alphaScale);
+
+		parallel_for(source.height, ROWS_PER_JOB, [&](size_t begin, size_t end)
+		{
+			alignas(16) float texel[4];
+
+			for (size_t y = begin; y < end; y++)
+			{
+				const float* in = source.row(y);
+				uint8_t* out = destination.pixels + y * destination.rowPitch;
+
+				for (size_t x = 0; x < source.width; x++, in += 4, out += 4)
+				{
+					// Negative lobes of the windowed filters can overshoot, so clamp first
+					_mm_store_ps(texel, _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in), scale), zero), one));
+
+					for (int c = 0; c < 3; c++)
+					{
+						float value = settings.gammaSpace ? std::pow(texel[c], inverseGamma) : texel[c];
+						out[c] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+					}
+					out[3] = static_cast<uint8_t>(texel[3] * 255.0f + 0.5f);
+				}
+			}
+		});
+	}
+}
+
+bool d3d11renderer::mip_generator::generate(const Image& source, const mip_settings& settings, ScratchImage& mipChain)
+{
+	if (source.format != DXGI_FORMAT_R8G8B8A8_UNORM || source.width == 0 || source.height == 0)
+	{
+		return false;
+	}
+
+	size_t levels = 1;
+	for (size_t size = std::max(source.width, source.height); size > 1; size >>= 1)
+	{
+		levels++;
+	}
+
+	HRESULT result = mipChain.Initialize2D(source.format, source.width, source.height, 1, levels);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	// Level 0 is the source itself
+	const Image* top = mipChain.GetImage(0, 0, 0);
+	for (size_t y = 0; y < source.height; y++)
+	{
+		std::memcpy(top->pixels + y * top->rowPitch, source.pixels + y * source.rowPitch, source.width * 4);
+	}
+
+	float_image current, horizontal, next;
+	decode_level(source, settings, current);
+
+	float targetCoverage = settings.alphaCutoff > 0.0f ? alpha_coverage(current, settings.alphaCutoff, 1.0f) : 0.0f;
+
+	for (size_t level = 1; level < levels; level++)
+	{
+		size_t width = std::max<size_t>(1, current.width / 2);
+		size_t height = std::max<size_t>(1, current.height / 2);
+
+		filter_horizontal(current, build_taps(current.width, width, settings.filter), width, horizontal);
+		filter_vertical(horizontal, build_taps(current.height, height, settings.filter), height, next);
+
+		if (settings.normalMap)
+		{
+			renormalize(next);
+		}
+
+		float alphaScale = 1.0f;
+		if (settings.alphaCutoff > 0.0f)
+		{
+			alphaScale = find_alpha_scale(next, settings.alphaCutoff, targetCoverage);
+		}
+
+		encode_level(next, settings, alphaScale, *mipChain.GetImage(level, 0, 0));
+		std::swap(current, next);
+	}
+
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <DirectXTex.h>
+
+namespace d3d11renderer
+{
+	enum class mip_filter
+	{
+		Box,
+		Kaiser,
+		Lanczos
+	};
+
+	struct mip_settings
+	{
+		mip_filter filter = mip_filter::Kaiser;
+		bool gammaSpace = true;    // Color data; filter in linear space and re-encode with gamma 2.2
+		bool normalMap = false;    // Renormalize the XYZ vector stored in RGB after filtering
+		float alphaCutoff = 0.0f;  // When > 0, scale alpha so every mip keeps the alpha-test coverage of the top level
+	};
+
+	// Builds full mip chains on the CPU.
+	// Each level is resampled from the previous one with a separable windowed filter in float,
+	// with SSE kernels running one RGBA texel per register and rows split across worker threads.
+	class mip_generator
+	{
+	public:
+		// The source must be R8G8B8A8_UNORM; level 0 of the result is an exact copy of it.
+		static bool generate(const DirectX::Image& source, const mip_settings& settings, DirectX::ScratchImage& mipChain);
+	};
+}
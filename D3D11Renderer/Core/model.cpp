@@ -1,12 +1,28 @@
 #include "model.h"
+#include "gltf_file.h"
+#include "mesh_simplifier.h"
+#include "parallel.h"
+#include "scene_graph.h"
 
 #include <stdexcept>
 #include <filesystem>
-
-
-model::model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* modelfilename, const char* mtlBasePath)
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <xmmintrin.h>
+#include <assimp/GltfMaterial.h>
+
+
+model::model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* modelfilename, const char* mtlBasePath,
+	const d3d11renderer::batch_settings& batching, Importer importer, d3d11renderer::compression_quality textureQuality)
+	: m_filename(modelfilename), m_importStats(), m_batchStats(), m_lodMilliseconds(0.0)
 {
-	auto result = load_model(device, deviceContext, modelfilename, mtlBasePath);
+	auto result = load_model(device, deviceContext, modelfilename, mtlBasePath, batching, importer, textureQuality);
 	if (!result)
 	{
 		throw std::runtime_error("Failed to initialize model");
@@ -20,6 +36,11 @@ model::model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const cha
 
 }
 
+model::model()
+	: m_importStats(), m_batchStats(), m_lodMilliseconds(0.0)
+{
+}
+
 model::~model()
 {
 }
@@ -34,6 +55,40 @@ const std::vector<model::SubMesh>& model::get_sub_meshes() const
 	return m_submeshes;
 }
 
+const std::vector<model::Material>& model::get_materials() const
+{
+	return m_materials;
+}
+
+const std::vector<model::Node>& model::get_nodes() const
+{
+	return m_nodes;
+}
+
+void model::refresh_materials()
+{
+	for (auto& material : m_materials) {
+		for (uint32_t slot = 0; slot < Material::TEXTURE_COUNT; slot++) {
+			material.views[slot] = material.textures[slot] ? material.textures[slot]->get_texture() : nullptr;
+		}
+	}
+}
+
+const std::unordered_map<std::string, std::shared_ptr<texture>>& model::get_textures() const
+{
+	return m_textures;
+}
+
+size_t model::get_instance_count() const
+{
+	return m_instances.size();
+}
+
+size_t model::get_vertex_bytes() const
+{
+	return m_vertices.size() * (sizeof(VertexType) + sizeof(DirectX::XMFLOAT3));
+}
+
 bool model::initialize_buffers(ID3D11Device* device)
 {
 	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
@@ -76,22 +131,46 @@ bool model::initialize_buffers(ID3D11Device* device)
 		return false;
 	}
 
+	// Positions alone for depth-only passes, which then fetch 12 bytes per vertex instead of the whole vertex
+	std::vector<DirectX::XMFLOAT3> positions(m_vertices.size());
+	for (size_t i = 0; i < m_vertices.size(); i++) {
+		positions[i] = m_vertices[i].position;
+	}
+
+	vertexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(DirectX::XMFLOAT3) * positions.size());
+	vertexData.pSysMem = positions.data();
+	result = device->CreateBuffer(&vertexBufferDesc, &vertexData, m_positionBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		return false;
+	}
+
+	// Per-instance node transforms, the second vertex stream of every pass
+	vertexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(DirectX::XMFLOAT4X4) * m_instances.size());
+	vertexData.pSysMem = m_instances.data();
+	result = device->CreateBuffer(&vertexBufferDesc, &vertexData, m_instanceBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		return false;
+	}
+
 	return true;
 }
 
 
 void model::render_buffers(ID3D11DeviceContext* deviceContext)
 {
-	unsigned int stride;
-	unsigned int offset;
+	unsigned int strides[2];
+	unsigned int offsets[2];
 
 
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
-	offset = 0;
+	// Set vertex buffer strides and offsets.
+	strides[0] = sizeof(VertexType);
+	strides[1] = sizeof(DirectX::XMFLOAT4X4);
+	offsets[0] = 0;
+	offsets[1] = 0;
 
-	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, m_vertexBuffer.GetAddressOf(), &stride, &offset);
+	// Set the vertex and instance buffers to active in the input assembler so they can be rendered.
+	ID3D11Buffer* buffers[2] = { m_vertexBuffer.Get(), m_instanceBuffer.Get() };
+	deviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
 	deviceContext->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
@@ -102,97 +181,111 @@ void model::render_buffers(ID3D11DeviceContext* deviceContext)
 	return;
 }
 
-bool model::load_texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const aiScene* scene, const char* textureBasePath) {
-	// Iterate through all materials in the scene
-	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
-		aiMaterial* material = scene->mMaterials[i];
+void model::render_positions(ID3D11DeviceContext* deviceContext)
+{
+	unsigned int strides[2] = { sizeof(DirectX::XMFLOAT3), sizeof(DirectX::XMFLOAT4X4) };
+	unsigned int offsets[2] = { 0, 0 };
+	ID3D11Buffer* buffers[2] = { m_positionBuffer.Get(), m_instanceBuffer.Get() };
 
-		aiString textureFile;
+	deviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	deviceContext->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
 
-		// Load diffuse texture
-		if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-			if (material->GetTexture(aiTextureType_DIFFUSE, 0, &textureFile) == AI_SUCCESS) {
-				std::string diffusePath = std::string(textureBasePath) + "/" + textureFile.C_Str();
-				std::wstring wDiffusePath(diffusePath.begin(), diffusePath.end());
+bool model::load_texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::vector<MaterialSource>& materials, const char* textureBasePath,
+	d3d11renderer::compression_quality textureQuality) {
+	// What each Material slot is sampled for. Emissive maps are 8-bit images like the base color and cook the same way;
+	// intensities above 1 come from the material's emissive factor
+	static const texture::usage usages[Material::TEXTURE_COUNT] = { texture::usage::Color, texture::usage::Normal, texture::usage::Color,
+		texture::usage::Mask, texture::usage::Color, texture::usage::Packed };
+
+	for (const auto& material : materials) {
+		for (uint32_t slot = 0; slot < Material::TEXTURE_COUNT; slot++) {
+			const std::string& textureFile = material.textures[slot];
+			if (textureFile.empty() || m_textures.count(textureFile)) {
+				continue;
+			}
 
-				if (std::filesystem::exists(diffusePath)) {
-					auto diffuseTexture = std::make_shared<texture>(device, deviceContext, wDiffusePath.c_str());
-					m_textures[textureFile.C_Str()] = diffuseTexture;
-				}
+			std::string path = std::string(textureBasePath) + "/" + textureFile;
+			std::wstring wPath(path.begin(), path.end());
+			if (std::filesystem::exists(path)) {
+				// Alpha-tested materials keep their cutout coverage down the mip chain
+				float alphaCutoff = slot == 0 ? material.alphaCutoff : 0.0f;
+				m_textures[textureFile] = std::make_shared<texture>(device, deviceContext, wPath.c_str(), usages[slot], alphaCutoff, textureQuality);
 			}
 		}
+	}
 
-		// Load normal map
-		if (material->GetTextureCount(aiTextureType_NORMALS) > 0) {
-			if (material->GetTexture(aiTextureType_NORMALS, 0, &textureFile) == AI_SUCCESS) {
-				std::string normalPath = std::string(textureBasePath) + "/" + textureFile.C_Str();
-				std::wstring wNormalPath(normalPath.begin(), normalPath.end());
+	return true;  // Return true regardless of texture loading success or failure
+}
 
-				if (std::filesystem::exists(normalPath)) {
-					auto normalTexture = std::make_shared<texture>(device, deviceContext, wNormalPath.c_str());
-					m_textures[textureFile.C_Str()] = normalTexture;
-				}
-			}
-		}
+bool model::load_model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* modelfilename, const char* mtlPath, const d3d11renderer::batch_settings& batching,
+	Importer importer, d3d11renderer::compression_quality textureQuality)
+{
+	std::vector<MaterialSource> materials;
+	std::vector<uint32_t> subMeshMaterials;
+	if (!import_meshes(modelfilename, importer, materials, subMeshMaterials)) {
+		return false;
+	}
 
-		// Load specular map (if applicable)
-		if (material->GetTextureCount(aiTextureType_SPECULAR) > 0) {
-			if (material->GetTexture(aiTextureType_SPECULAR, 0, &textureFile) == AI_SUCCESS) {
-				std::string specularPath = std::string(textureBasePath) + "/" + textureFile.C_Str();
-				std::wstring wSpecularPath(specularPath.begin(), specularPath.end());
+	// Load textures
+	if (!load_texture(device, deviceContext, materials, mtlPath, textureQuality)) {
+		OutputDebugStringA("Failed to load textures.");
+		return false;
+	}
 
-				if (std::filesystem::exists(specularPath)) {
-					auto specularTexture = std::make_shared<texture>(device, deviceContext, wSpecularPath.c_str());
-					m_textures[textureFile.C_Str()] = specularTexture;
-				}
-			}
-		}
+	// Submeshes with the same maps share a material
+	std::vector<uint16_t> materialIds;
+	for (const auto& material : materials) {
+		materialIds.push_back(add_material(material));
+	}
+	for (size_t i = 0; i < m_submeshes.size(); i++) {
+		m_submeshes[i].materialId = materialIds[subMeshMaterials[i]];
+	}
 
-		if (material->GetTextureCount(aiTextureType_LIGHTMAP) > 0) {
-			if (material->GetTexture(aiTextureType_LIGHTMAP, 0, &textureFile) == AI_SUCCESS) {
-				std::string specularPath = std::string(textureBasePath) + "/" + textureFile.C_Str();
-				std::wstring wSpecularPath(specularPath.begin(), specularPath.end());
+	generate_lods();
 
-				if (std::filesystem::exists(specularPath)) {
-					auto specularTexture = std::make_shared<texture>(device, deviceContext, wSpecularPath.c_str());
-					m_textures[textureFile.C_Str()] = specularTexture;
-				}
-			}
-		}
+	if (batching.enabled) {
+		batch_sub_meshes(batching);
+	}
+	else {
+		m_batchStats.drawsBefore = m_batchStats.drawsAfter = m_submeshes.size();
+	}
 
-		if (material->GetTextureCount(aiTextureType_EMISSIVE) > 0) {
-			if (material->GetTexture(aiTextureType_EMISSIVE, 0, &textureFile) == AI_SUCCESS) {
-				std::string specularPath = std::string(textureBasePath) + "/" + textureFile.C_Str();
-				std::wstring wSpecularPath(specularPath.begin(), specularPath.end());
+	// Drawn in this order, each material is bound once for its whole run of submeshes
+	std::stable_sort(m_submeshes.begin(), m_submeshes.end(), [](const SubMesh& a, const SubMesh& b) {
+		return a.materialId < b.materialId;
+	});
 
-				if (std::filesystem::exists(specularPath)) {
-					auto specularTexture = std::make_shared<texture>(device, deviceContext, wSpecularPath.c_str());
-					m_textures[textureFile.C_Str()] = specularTexture;
-				}
-			}
-		}
+	plan_texture_arrays();
 
-		if (material->GetTextureCount(aiTextureType_METALNESS) > 0) {
-			if (material->GetTexture(aiTextureType_METALNESS, 0, &textureFile) == AI_SUCCESS) {
-				std::string specularPath = std::string(textureBasePath) + "/" + textureFile.C_Str();
-				std::wstring wSpecularPath(specularPath.begin(), specularPath.end());
+	return true;
+}
 
-				if (std::filesystem::exists(specularPath)) {
-					auto specularTexture = std::make_shared<texture>(device, deviceContext, wSpecularPath.c_str());
-					m_textures[textureFile.C_Str()] = specularTexture;
-				}
-			}
-		}
+bool model::import_meshes(const char* modelfilename, Importer importer, std::vector<MaterialSource>& materials, std::vector<uint32_t>& subMeshMaterials)
+{
+	auto start = std::chrono::steady_clock::now();
+	bool gltf = importer == Importer::Gltf && std::filesystem::path(modelfilename).extension() == ".gltf";
+	m_importStats = {};
+	if (!(gltf ? import_gltf(modelfilename, materials, subMeshMaterials) : import_assimp(modelfilename, materials, subMeshMaterials))) {
+		return false;
 	}
 
-	return true;  // Return true regardless of texture loading success or failure
+	// The glTF importer has filled in the decode figures
+	m_importStats.importer = gltf ? Importer::Gltf : Importer::Assimp;
+	m_importStats.meshes = m_submeshes.size();
+	m_importStats.vertices = m_vertices.size();
+	m_importStats.indices = m_indices.size();
+	m_importStats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
 }
 
-bool model::load_model(ID3D11Device* device, ID3D11DeviceContext* deviceContext,const char* modelfilename, const char* mtlPath)
+bool model::import_assimp(const char* modelfilename, std::vector<MaterialSource>& materials, std::vector<uint32_t>& subMeshMaterials)
 {
 	Assimp::Importer importer;
+	// Node transforms stay out of the vertices, so a mesh used by several nodes is stored once and instanced
 	const aiScene* scene = importer.ReadFile(modelfilename, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace |
-		aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_PreTransformVertices );
+		aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
 
 	// Check for errors
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
@@ -200,117 +293,644 @@ bool model::load_model(ID3D11Device* device, ID3D11DeviceContext* deviceContext,
 		return false;
 	}
 
-	// Load textures
-	if (!load_texture(device, deviceContext, scene, mtlPath)) {
-		OutputDebugStringA("Failed to load textures.");
+	// Each slot's map, in the order the light shader binds them
+	static const aiTextureType types[Material::TEXTURE_COUNT] = { aiTextureType_DIFFUSE, aiTextureType_NORMALS, aiTextureType_SPECULAR,
+		aiTextureType_LIGHTMAP, aiTextureType_EMISSIVE, aiTextureType_METALNESS };
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+		const aiMaterial* material = scene->mMaterials[i];
+		MaterialSource source = {};
+		aiString texturePath;
+		for (uint32_t slot = 0; slot < Material::TEXTURE_COUNT; slot++) {
+			if (material->GetTexture(types[slot], 0, &texturePath) == AI_SUCCESS) {
+				source.textures[slot] = texturePath.C_Str();
+			}
+		}
+
+		aiString alphaMode;
+		if (material->Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode) == AI_SUCCESS && std::string(alphaMode.C_Str()) == "MASK") {
+			source.alphaCutoff = 0.5f;
+			material->Get(AI_MATKEY_GLTF_ALPHACUTOFF, source.alphaCutoff);
+		}
+
+		// PBR factors where the format has them, the diffuse color where it doesn't. Formats without metalness are
+		// read as dielectric, as they were drawn before factors existed
+		d3d11renderer::material_factors& factors = source.factors;
+		aiColor4D baseColor;
+		if (material->Get(AI_MATKEY_BASE_COLOR, baseColor) == AI_SUCCESS || material->Get(AI_MATKEY_COLOR_DIFFUSE, baseColor) == AI_SUCCESS) {
+			factors.baseColor[0] = baseColor.r;
+			factors.baseColor[1] = baseColor.g;
+			factors.baseColor[2] = baseColor.b;
+			factors.baseColor[3] = baseColor.a;
+		}
+
+		// Formats without factors leave the emissive color black beside an emissive map that should show as it is
+		aiColor3D emissive;
+		if (material->Get(AI_MATKEY_COLOR_EMISSIVE, emissive) == AI_SUCCESS && (source.textures[4].empty() || !emissive.IsBlack())) {
+			factors.emissive[0] = emissive.r;
+			factors.emissive[1] = emissive.g;
+			factors.emissive[2] = emissive.b;
+		}
+		if (material->Get(AI_MATKEY_METALLIC_FACTOR, factors.metallic) != AI_SUCCESS) {
+			factors.metallic = 0.0f;
+		}
+		material->Get(AI_MATKEY_ROUGHNESS_FACTOR, factors.roughness);
+		materials.push_back(source);
+	}
+
+	// Where each mesh is placed, then each placed mesh once
+	std::vector<std::vector<uint32_t>> meshInstances(scene->mNumMeshes);
+	process_node(scene->mRootNode, -1, meshInstances);
+	std::vector<DirectX::XMFLOAT4X4> nodeTransforms = get_node_transforms();
+
+	// First pass: where each placed mesh goes in the final buffers, so they are sized once
+	std::vector<unsigned int> placedMeshes;
+	std::vector<unsigned int> vertexStarts;
+	size_t vertexCount = 0, indexCount = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+		if (meshInstances[i].empty()) {
+			continue;
+		}
+
+		const aiMesh* mesh = scene->mMeshes[i];
+		size_t meshIndices = 0;
+		if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+			meshIndices = static_cast<size_t>(mesh->mNumFaces) * 3;
+		}
+		else {
+			for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
+				meshIndices += mesh->mFaces[j].mNumIndices;
+			}
+		}
+
+		SubMesh subMesh = {};
+		subMesh.startIndex = static_cast<int>(indexCount);
+		subMesh.indexCount = static_cast<int>(meshIndices);
+		subMesh.lods[0] = { subMesh.startIndex, subMesh.indexCount, 0.0f };
+		subMesh.lodCount = 1;
+		subMesh.lod = 0;
+		subMesh.startInstance = static_cast<int>(m_instances.size());
+		subMesh.instanceCount = static_cast<int>(meshInstances[i].size());
+		for (uint32_t node : meshInstances[i]) {
+			m_instances.push_back(nodeTransforms[node]);
+		}
+		m_submeshes.push_back(subMesh);
+		subMeshMaterials.push_back(mesh->mMaterialIndex);
+
+		placedMeshes.push_back(i);
+		vertexStarts.push_back(static_cast<unsigned int>(vertexCount));
+		vertexCount += mesh->mNumVertices;
+		indexCount += meshIndices;
+	}
+	m_vertices.resize(vertexCount);
+	m_indices.resize(indexCount);
+
+	// Second pass: every mesh converts straight into its ranges
+	d3d11renderer::parallel_for(placedMeshes.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const aiMesh* mesh = scene->mMeshes[placedMeshes[i]];
+			process_mesh(mesh, vertexStarts[i], m_submeshes[i]);
+			measure_sub_mesh(vertexStarts[i], mesh->mNumVertices, m_submeshes[i]);
+		}
+	});
+
+	return true;
+}
+
+bool model::import_gltf(const char* modelfilename, std::vector<MaterialSource>& materials, std::vector<uint32_t>& subMeshMaterials)
+{
+	d3d11renderer::gltf_file file;
+	if (!file.open(modelfilename)) {
+		OutputDebugStringA(file.get_error().c_str());
 		return false;
 	}
+	m_importStats.compressedBytes = file.get_stats().compressedBytes;
+	m_importStats.decodedBytes = file.get_stats().decodedBytes;
+	m_importStats.decodeMilliseconds = file.get_stats().decodeMilliseconds;
+
+	// The same slots Assimp fills from glTF: occlusion is its lightmap, and there is no specular map
+	for (const auto& material : file.get_materials()) {
+		MaterialSource source = {};
+		source.textures[0] = material.baseColor;
+		source.textures[1] = material.normal;
+		source.textures[3] = material.occlusion;
+		source.textures[4] = material.emissive;
+		source.textures[5] = material.metallicRoughness;
+		source.alphaCutoff = material.alphaCutoff;
+		source.factors = material.factors;
+		materials.push_back(source);
+	}
+	// Primitives without a material get an empty one, as Assimp gives them its default
+	uint32_t defaultMaterial = static_cast<uint32_t>(materials.size());
+	materials.push_back(MaterialSource());
+
+	// The file lists parents first, as m_nodes keeps them
+	for (const auto& node : file.get_nodes()) {
+		m_nodes.push_back({ node.parent == d3d11renderer::gltf_node::NO_PARENT ? -1 : static_cast<int>(node.parent),
+			DirectX::XMFLOAT3(node.translation), DirectX::XMFLOAT4(node.rotation), DirectX::XMFLOAT3(node.scale) });
+	}
+	std::vector<DirectX::XMFLOAT4X4> nodeTransforms = get_node_transforms();
+
+	// Instances grouped by mesh, each primitive of a mesh placed by all of them
+	std::vector<std::vector<DirectX::XMFLOAT4X4>> meshInstances(file.get_mesh_count());
+	for (const auto& instance : file.get_instances()) {
+		meshInstances[instance.mesh].push_back(nodeTransforms[instance.node]);
+	}
+
+	// The file lays every primitive out in one range, so the buffers are sized once and filled in place
+	std::vector<unsigned int> vertexStarts;
+	std::vector<unsigned int> vertexCounts;
+	for (const auto& primitive : file.get_primitives()) {
+		if (meshInstances[primitive.mesh].empty()) {
+			continue;
+		}
+
+		SubMesh subMesh = {};
+		subMesh.startIndex = static_cast<int>(primitive.startIndex);
+		subMesh.indexCount = static_cast<int>(primitive.indexCount);
+		subMesh.lods[0] = { subMesh.startIndex, subMesh.indexCount, 0.0f };
+		subMesh.lodCount = 1;
+		subMesh.lod = 0;
+		subMesh.startInstance = static_cast<int>(m_instances.size());
+		subMesh.instanceCount = static_cast<int>(meshInstances[primitive.mesh].size());
+		m_instances.insert(m_instances.end(), meshInstances[primitive.mesh].begin(), meshInstances[primitive.mesh].end());
+		m_submeshes.push_back(subMesh);
+		subMeshMaterials.push_back(primitive.material == d3d11renderer::gltf_primitive::NO_MATERIAL ? defaultMaterial : primitive.material);
+		vertexStarts.push_back(static_cast<unsigned int>(primitive.startVertex));
+		vertexCounts.push_back(static_cast<unsigned int>(primitive.vertexCount));
+	}
+	m_vertices.resize(file.get_vertex_count());
+	m_indices.resize(file.get_index_count());
 
-	// Process meshes
-	process_node(device, deviceContext, scene->mRootNode, scene);
+	d3d11renderer::gltf_vertex_layout layout = { sizeof(VertexType), offsetof(VertexType, position), offsetof(VertexType, texture),
+		offsetof(VertexType, normal), offsetof(VertexType, tangent), offsetof(VertexType, bitangent) };
+	file.read(m_vertices.data(), layout, m_indices.data());
+
+	d3d11renderer::parallel_for(m_submeshes.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			measure_sub_mesh(vertexStarts[i], vertexCounts[i], m_submeshes[i]);
+		}
+	});
 
 	return true;
-} 
+}
 
-void model::process_node(ID3D11Device* device, ID3D11DeviceContext* deviceContext, aiNode* node, const aiScene* scene)
+void model::process_node(const aiNode* node, int parent, std::vector<std::vector<uint32_t>>& meshInstances)
 {
-	// Process each mesh in this node
+	aiVector3D scale, position;
+	aiQuaternion rotation;
+	node->mTransformation.Decompose(scale, rotation, position);
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back({ parent, DirectX::XMFLOAT3(position.x, position.y, position.z), DirectX::XMFLOAT4(rotation.x, rotation.y, rotation.z, rotation.w),
+		DirectX::XMFLOAT3(scale.x, scale.y, scale.z) });
+
+	// Each mesh in this node is one more instance of it
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		process_mesh(device, deviceContext, mesh, scene);
+		meshInstances[node->mMeshes[i]].push_back(index);
 	}
 
 	// Process child nodes
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		process_node(device, deviceContext, node->mChildren[i], scene);
+		process_node(node->mChildren[i], static_cast<int>(index), meshInstances);
 	}
 }
 
-void model::process_mesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, aiMesh* mesh, const aiScene* scene)
+std::vector<DirectX::XMFLOAT4X4> model::get_node_transforms() const
 {
-	std::vector<VertexType> vertices;
-	std::vector<unsigned int> indices;
+	d3d11renderer::scene_graph graph;
+	graph.reserve(m_nodes.size() + 1);
+	std::vector<uint32_t> ids;
+	for (const Node& node : m_nodes) {
+		uint32_t id = graph.add_node(node.parent < 0 ? d3d11renderer::scene_graph::ROOT : ids[node.parent]);
+		graph.set_translation(id, node.translation.x, node.translation.y, node.translation.z);
+		graph.set_rotation(id, node.rotation.x, node.rotation.y, node.rotation.z, node.rotation.w);
+		graph.set_scale(id, node.scale.x, node.scale.y, node.scale.z);
+		ids.push_back(id);
+	}
+	graph.update();
 
-	// Keep track of the starting index in the global vertex buffer
-	unsigned int vertexStartIndex = m_vertices.size(); // Starting index for this submesh
+	std::vector<DirectX::XMFLOAT4X4> transforms(m_nodes.size());
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		graph.get_world(ids[i], transforms[i].m);
+	}
+	return transforms;
+}
 
-	// Process vertices
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-		VertexType vertex;
-		vertex.position = DirectX::XMFLOAT3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+const d3d11renderer::texture_array_planner& model::get_array_plan() const
+{
+	return m_arrayPlan;
+}
+
+const model::ImportStats& model::get_import_stats() const
+{
+	return m_importStats;
+}
+
+model::ImportStats model::time_import(Importer importer) const
+{
+	model scratch;
+	std::vector<MaterialSource> materials;
+	std::vector<uint32_t> subMeshMaterials;
+	if (!scratch.import_meshes(m_filename.c_str(), importer, materials, subMeshMaterials)) {
+		return ImportStats{ importer };
+	}
+	return scratch.m_importStats;
+}
+
+const d3d11renderer::batch_stats& model::get_batch_stats() const
+{
+	return m_batchStats;
+}
+
+void model::set_lod(size_t subMesh, int lod)
+{
+	m_submeshes[subMesh].lod = std::clamp(lod, 0, m_submeshes[subMesh].lodCount - 1);
+}
+
+size_t model::get_lod_triangles(int lod) const
+{
+	size_t triangles = 0;
+	for (const auto& subMesh : m_submeshes) {
+		triangles += subMesh.lods[std::min(lod, subMesh.lodCount - 1)].indexCount / 3;
+	}
+	return triangles;
+}
 
-		if (mesh->mTextureCoords[0]) {
-			vertex.texture = DirectX::XMFLOAT2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+double model::get_lod_milliseconds() const
+{
+	return m_lodMilliseconds;
+}
+
+void model::generate_lods()
+{
+	// A level has to drop at least this share of the triangles before it to be worth keeping. Low enough to keep the
+	// fourth level of DamagedHelmet, whose UV seams hold it near 3200 triangles after two halvings
+	constexpr float MIN_REDUCTION = 0.1f;
+	// Vertices that differ only past the normal are welded for the simplifier
+	constexpr size_t WELD_BYTES = offsetof(VertexType, tangent);
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Each submesh is simplified on its own thread into its own list, and the lists are appended in order afterwards
+	std::vector<std::vector<unsigned int>> lodIndices(m_submeshes.size());
+	d3d11renderer::parallel_for(m_submeshes.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			SubMesh& subMesh = m_submeshes[i];
+			if (subMesh.indexCount == 0) {
+				continue;
+			}
+
+			// Each mesh's vertices are its own and contiguous, so the simplifier only sees that range
+			auto first = m_indices.begin() + subMesh.startIndex;
+			auto last = first + subMesh.indexCount;
+			auto [lowest, highest] = std::minmax_element(first, last);
+			unsigned int base = *lowest;
+
+			// Files with per-face tangents, like SciFiHelmet, split every corner into a vertex per triangle, which the
+			// simplifier would take for wedges of a seam and lock. The LODs use the first of each set of copies instead
+			std::vector<uint32_t> welded(*highest - base + 1);
+			std::iota(welded.begin(), welded.end(), 0u);
+			std::vector<uint32_t> order = welded;
+			auto compare = [&](uint32_t a, uint32_t b) { return std::memcmp(&m_vertices[base + a], &m_vertices[base + b], WELD_BYTES); };
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				int result = compare(a, b);
+				return result < 0 || (result == 0 && a < b);
+			});
+			for (size_t j = 1; j < order.size(); j++) {
+				if (compare(order[j - 1], order[j]) == 0) {
+					welded[order[j]] = welded[order[j - 1]];
+				}
+			}
+
+			std::vector<uint32_t> source(first, last);
+			for (auto& index : source) {
+				index = welded[index - base];
+			}
+
+			// Errors come out in the mesh's own units; the largest instance shows them largest
+			float scale = 0.0f;
+			for (int j = subMesh.startInstance; j < subMesh.startInstance + subMesh.instanceCount; j++) {
+				DirectX::XMMATRIX transform = DirectX::XMLoadFloat4x4(&m_instances[j]);
+				scale = std::max({ scale,
+					DirectX::XMVectorGetX(DirectX::XMVector3Length(transform.r[0])),
+					DirectX::XMVectorGetX(DirectX::XMVector3Length(transform.r[1])),
+					DirectX::XMVectorGetX(DirectX::XMVector3Length(transform.r[2])) });
+			}
+
+			// Every level starts from the one before, so the errors add up
+			std::vector<uint32_t> simplified;
+			while (subMesh.lodCount < MAX_LODS) {
+				d3d11renderer::simplify_stats stats;
+				d3d11renderer::mesh_simplifier::simplify(&m_vertices[base].position.x, *highest - base + 1, sizeof(VertexType),
+					source.data(), source.size(), source.size() / 6 * 3, FLT_MAX, simplified, stats);
+				if (simplified.empty() || simplified.size() > source.size() * (1.0f - MIN_REDUCTION)) {
+					break;
+				}
+
+				Lod& lod = subMesh.lods[subMesh.lodCount];
+				lod.startIndex = static_cast<int>(lodIndices[i].size());
+				lod.indexCount = static_cast<int>(simplified.size());
+				lod.error = subMesh.lods[subMesh.lodCount - 1].error + stats.error * scale;
+				for (uint32_t index : simplified) {
+					lodIndices[i].push_back(index + base);
+				}
+				subMesh.lodCount++;
+				source.swap(simplified);
+			}
 		}
-		else {
-			vertex.texture = DirectX::XMFLOAT2(0.0f, 0.0f);
+	});
+
+	for (size_t i = 0; i < m_submeshes.size(); i++) {
+		SubMesh& subMesh = m_submeshes[i];
+		for (int lod = 1; lod < subMesh.lodCount; lod++) {
+			subMesh.lods[lod].startIndex += static_cast<int>(m_indices.size());
 		}
+		m_indices.insert(m_indices.end(), lodIndices[i].begin(), lodIndices[i].end());
+	}
+
+	m_lodMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void model::batch_sub_meshes(const d3d11renderer::batch_settings& settings)
+{
+	// Only a mesh placed once can take its node transform into its own vertices. Mirrored ones would flip their winding
+	std::vector<d3d11renderer::batch_input> inputs;
+	for (const auto& subMesh : m_submeshes) {
+		d3d11renderer::batch_input input = {};
+		input.material = subMesh.materialId;
+		input.indexCount = static_cast<uint32_t>(subMesh.indexCount);
+		input.center[0] = subMesh.boundsCenter.x;
+		input.center[1] = subMesh.boundsCenter.y;
+		input.center[2] = subMesh.boundsCenter.z;
+		input.radius = subMesh.boundsRadius;
+		input.mergeable = subMesh.instanceCount == 1 &&
+			DirectX::XMVectorGetX(DirectX::XMMatrixDeterminant(DirectX::XMLoadFloat4x4(&m_instances[subMesh.startInstance]))) > 0.0f;
+		inputs.push_back(input);
+	}
 
-		if (mesh->mNormals) {
-			vertex.normal = DirectX::XMFLOAT3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+	d3d11renderer::static_batcher batcher(settings);
+	batcher.build(inputs);
+
+	DirectX::XMFLOAT4X4 identity;
+	DirectX::XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+
+	std::vector<unsigned int> indices;
+	std::vector<DirectX::XMFLOAT4X4> instances;
+	std::vector<SubMesh> subMeshes;
+	indices.reserve(m_indices.size());
+	for (const auto& batch : batcher.get_batches()) {
+		const SubMesh& single = m_submeshes[batch.members[0]];
+		SubMesh merged = single;
+		merged.startInstance = static_cast<int>(instances.size());
+
+		if (batch.members.size() == 1) {
+			for (int lod = 0; lod < single.lodCount; lod++) {
+				merged.lods[lod].startIndex = static_cast<int>(indices.size());
+				indices.insert(indices.end(), m_indices.begin() + single.lods[lod].startIndex, m_indices.begin() + single.lods[lod].startIndex + single.lods[lod].indexCount);
+			}
+			merged.startIndex = merged.lods[0].startIndex;
+			instances.insert(instances.end(), m_instances.begin() + single.startInstance, m_instances.begin() + single.startInstance + single.instanceCount);
+			subMeshes.push_back(merged);
+			continue;
 		}
 
-		if (mesh->mTangents && mesh->mBitangents) {
-			vertex.tangent = DirectX::XMFLOAT3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
-			vertex.bitangent = DirectX::XMFLOAT3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+		merged.lodCount = 1;
+		for (uint32_t member : batch.members) {
+			const SubMesh& subMesh = m_submeshes[member];
+			auto first = m_indices.begin() + subMesh.startIndex;
+			auto last = first + subMesh.indexCount;
+
+			// Each mesh's vertices are its own and contiguous, so its index range spans exactly them
+			auto [lowest, highest] = std::minmax_element(first, last);
+			DirectX::XMMATRIX transform = DirectX::XMLoadFloat4x4(&m_instances[subMesh.startInstance]);
+			DirectX::XMMATRIX normalTransform = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, transform));
+			for (unsigned int i = *lowest; i <= *highest; i++) {
+				VertexType& vertex = m_vertices[i];
+				DirectX::XMStoreFloat3(&vertex.position, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&vertex.position), transform));
+				DirectX::XMStoreFloat3(&vertex.normal, DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&vertex.normal), normalTransform)));
+				DirectX::XMStoreFloat3(&vertex.tangent, DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&vertex.tangent), transform)));
+				DirectX::XMStoreFloat3(&vertex.bitangent, DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&vertex.bitangent), transform)));
+			}
+
+			merged.lodCount = std::max(merged.lodCount, subMesh.lodCount);
+
+			// The member with the fewest UV units per model unit asks for the finest mips
+			if (subMesh.uvDensity > 0.0f && (merged.uvDensity <= 0.0f || subMesh.uvDensity < merged.uvDensity)) {
+				merged.uvDensity = subMesh.uvDensity;
+			}
 		}
 
-		vertices.push_back(vertex); // Add to local vertex list
+		// Each level of the batch is every member at that level, or at its coarsest if it has fewer
+		for (int lod = 0; lod < merged.lodCount; lod++) {
+			Lod& level = merged.lods[lod];
+			level = { static_cast<int>(indices.size()), 0, 0.0f };
+			for (uint32_t member : batch.members) {
+				const SubMesh& subMesh = m_submeshes[member];
+				const Lod& source = subMesh.lods[std::min(lod, subMesh.lodCount - 1)];
+				indices.insert(indices.end(), m_indices.begin() + source.startIndex, m_indices.begin() + source.startIndex + source.indexCount);
+				level.indexCount += source.indexCount;
+				level.error = std::max(level.error, source.error);
+			}
+		}
+		merged.startIndex = merged.lods[0].startIndex;
+		merged.indexCount = merged.lods[0].indexCount;
+		merged.boundsCenter = DirectX::XMFLOAT3(batch.center[0], batch.center[1], batch.center[2]);
+		merged.boundsRadius = batch.radius;
+		merged.instanceCount = 1;
+		instances.push_back(identity);
+		subMeshes.push_back(merged);
 	}
 
-	// Process indices
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++) {
-			// Adjust index to point to the correct vertex in the global vertex buffer
-			indices.push_back(face.mIndices[j] + vertexStartIndex);
+	m_indices.swap(indices);
+	m_instances.swap(instances);
+	m_submeshes.swap(subMeshes);
+	m_batchStats = batcher.get_stats();
+}
+
+void model::plan_texture_arrays()
+{
+	// Every texture a material uses, once, in the order first seen
+	std::vector<d3d11renderer::array_texture_desc> textures;
+	std::unordered_map<const texture*, int32_t> textureIndices;
+	std::vector<d3d11renderer::array_material_desc> materials;
+	for (const auto& material : m_materials) {
+		d3d11renderer::array_material_desc desc = {};
+		desc.features = material.features;
+		for (uint32_t slot = 0; slot < d3d11renderer::array_material_desc::MAX_SLOTS; slot++) {
+			const texture* tex = slot < Material::TEXTURE_COUNT ? material.textures[slot] : nullptr;
+			if (!tex) {
+				desc.textures[slot] = d3d11renderer::array_material_desc::NO_TEXTURE;
+				continue;
+			}
+
+			auto inserted = textureIndices.emplace(tex, static_cast<int32_t>(textures.size()));
+			if (inserted.second) {
+				textures.push_back(tex->get_array_desc());
+			}
+			desc.textures[slot] = inserted.first->second;
 		}
+		materials.push_back(desc);
 	}
 
-	// Create the SubMesh for this mesh
-	SubMesh subMesh;
-	subMesh.startIndex = m_indices.size(); // Set the start index for this submesh
-	subMesh.indexCount = indices.size();
+	std::vector<uint16_t> drawMaterials;
+	for (const auto& subMesh : m_submeshes) {
+		drawMaterials.push_back(subMesh.materialId);
+	}
 
-	// Handle materials and assign textures
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		aiString texturePath;
+	m_arrayPlan.plan(textures, materials, drawMaterials);
+}
 
-		// Assign diffuse texture
-		if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS) {
-			subMesh.diffuseTexture = m_textures[texturePath.C_Str()];
+uint16_t model::add_material(const MaterialSource& source)
+{
+	// The feature bit each slot enables, in the order the light shader binds them
+	static const uint32_t slotFeatures[Material::TEXTURE_COUNT] = { d3d11renderer::material_features::DIFFUSE_MAP,
+		d3d11renderer::material_features::NORMAL_MAP, 0, d3d11renderer::material_features::AO_MAP,
+		d3d11renderer::material_features::EMISSIVE_MAP, d3d11renderer::material_features::METAL_ROUGHNESS_MAP };
+
+	Material material = {};
+	material.factors = source.factors;
+	for (uint32_t slot = 0; slot < Material::TEXTURE_COUNT; slot++) {
+		if (source.textures[slot].empty()) {
+			continue;
 		}
 
-		// Assign normal map texture
-		if (material->GetTexture(aiTextureType_NORMALS, 0, &texturePath) == AI_SUCCESS) {
-			subMesh.normalTexture = m_textures[texturePath.C_Str()];
+		// Maps that failed to load count as missing
+		auto found = m_textures.find(source.textures[slot]);
+		if (found != m_textures.end() && found->second) {
+			material.textures[slot] = found->second.get();
+			material.views[slot] = found->second->get_texture();
+			material.features |= slotFeatures[slot];
 		}
+	}
 
-		// Assign specular map texture
-		if (material->GetTexture(aiTextureType_SPECULAR, 0, &texturePath) == AI_SUCCESS) {
-			subMesh.specularTexture = m_textures[texturePath.C_Str()];
+	for (size_t i = 0; i < m_materials.size(); i++) {
+		if (std::equal(std::begin(material.textures), std::end(material.textures), std::begin(m_materials[i].textures)) &&
+			material.factors == m_materials[i].factors) {
+			return static_cast<uint16_t>(i);
 		}
+	}
 
-		// Assign Ambient Occlusion (AO) map texture
-		if (material->GetTexture(aiTextureType_LIGHTMAP, 0, &texturePath) == AI_SUCCESS) {
-			subMesh.aoTexture = m_textures[texturePath.C_Str()];
-		}
+	if (m_materials.size() > UINT16_MAX) {
+		throw std::runtime_error("Too many materials for 16-bit material ids");
+	}
+	m_materials.push_back(material);
+	return static_cast<uint16_t>(m_materials.size() - 1);
+}
 
-		// Assign Emissive texture
-		if (material->GetTexture(aiTextureType_EMISSIVE, 0, &texturePath) == AI_SUCCESS) {
-			subMesh.emissiveTexture = m_textures[texturePath.C_Str()];
-		}
+void model::process_mesh(const aiMesh* mesh, unsigned int vertexStartIndex, const SubMesh& subMesh)
+{
+	// Written in place; every mesh has its own ranges of the final buffers, so meshes convert side by side
+	std::span<VertexType> vertices(m_vertices.data() + vertexStartIndex, mesh->mNumVertices);
+	std::span<unsigned int> indices(m_indices.data() + subMesh.startIndex, subMesh.indexCount);
+
+	// Each attribute is one unaligned four-float load and store, in VertexType order, so the float a store writes past
+	// its attribute is overwritten by the next one. The last vertex goes a float at a time: no load reads past the end
+	// of Assimp's arrays, and no store reaches into the next mesh's vertices, which another thread may be writing
+	static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "Assimp built with single precision");
+	static_assert(offsetof(VertexType, texture) == 12 && offsetof(VertexType, normal) == 20 && offsetof(VertexType, tangent) == 32 &&
+		offsetof(VertexType, bitangent) == 44 && sizeof(VertexType) == 56, "Attribute stores rely on the vertex layout");
+	const aiVector3D* uvs = mesh->mTextureCoords[0];
+	const aiVector3D* normals = mesh->mNormals;
+	const aiVector3D* tangents = mesh->mBitangents ? mesh->mTangents : nullptr;
+	const aiVector3D* bitangents = mesh->mTangents ? mesh->mBitangents : nullptr;
+	const __m128 zero = _mm_setzero_ps();
+	unsigned int simdCount = mesh->mNumVertices > 0 ? mesh->mNumVertices - 1 : 0;
+	for (unsigned int i = 0; i < simdCount; i++) {
+		float* out = &vertices[i].position.x;
+		_mm_storeu_ps(out, _mm_loadu_ps(&mesh->mVertices[i].x));
+		_mm_storel_pi(reinterpret_cast<__m64*>(out + 3), uvs ? _mm_loadu_ps(&uvs[i].x) : zero);
+		_mm_storeu_ps(out + 5, normals ? _mm_loadu_ps(&normals[i].x) : zero);
+		_mm_storeu_ps(out + 8, tangents ? _mm_loadu_ps(&tangents[i].x) : zero);
+		__m128 bitangent = bitangents ? _mm_loadu_ps(&bitangents[i].x) : zero;
+		_mm_storel_pi(reinterpret_cast<__m64*>(out + 11), bitangent);
+		_mm_store_ss(out + 13, _mm_movehl_ps(bitangent, bitangent));
+	}
+	for (unsigned int i = simdCount; i < mesh->mNumVertices; i++) {
+		VertexType& vertex = vertices[i];
+		vertex.position = DirectX::XMFLOAT3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		vertex.texture = uvs ? DirectX::XMFLOAT2(uvs[i].x, uvs[i].y) : DirectX::XMFLOAT2(0.0f, 0.0f);
+		vertex.normal = normals ? DirectX::XMFLOAT3(normals[i].x, normals[i].y, normals[i].z) : DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+		vertex.tangent = tangents ? DirectX::XMFLOAT3(tangents[i].x, tangents[i].y, tangents[i].z) : DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+		vertex.bitangent = bitangents ? DirectX::XMFLOAT3(bitangents[i].x, bitangents[i].y, bitangents[i].z) : DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	}
 
-		// Assign Metal-Roughness texture
-		if (material->GetTexture(aiTextureType_METALNESS, 0, &texturePath) == AI_SUCCESS) {
-			subMesh.metalRoughnessTexture = m_textures[texturePath.C_Str()];
+	// Process indices, adjusted to point into the global vertex buffer
+	unsigned int* index = indices.data();
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+		const aiFace& face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; j++) {
+			*index++ = face.mIndices[j] + vertexStartIndex;
 		}
 	}
+}
+
+void model::measure_sub_mesh(unsigned int vertexStartIndex, unsigned int vertexCount, SubMesh& subMesh)
+{
+	std::span<const VertexType> vertices(m_vertices.data() + vertexStartIndex, vertexCount);
+	std::span<const unsigned int> indices(m_indices.data() + subMesh.startIndex, subMesh.indexCount);
+
+	// Bounding sphere around the AABB center
+	DirectX::XMVECTOR minimum = DirectX::XMVectorReplicate(FLT_MAX);
+	DirectX::XMVECTOR maximum = DirectX::XMVectorReplicate(-FLT_MAX);
+	for (const auto& vertex : vertices) {
+		DirectX::XMVECTOR position = DirectX::XMLoadFloat3(&vertex.position);
+		minimum = DirectX::XMVectorMin(minimum, position);
+		maximum = DirectX::XMVectorMax(maximum, position);
+	}
+
+	DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(minimum, maximum), 0.5f);
+	DirectX::XMVECTOR radius = DirectX::XMVectorZero();
+	for (const auto& vertex : vertices) {
+		radius = DirectX::XMVectorMax(radius, DirectX::XMVector3Length(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertex.position), center)));
+	}
+	// Grown to enclose the mesh's sphere at every instance, so culling and streaming can treat the submesh as one object
+	DirectX::XMVECTOR instanceMinimum = DirectX::XMVectorReplicate(FLT_MAX);
+	DirectX::XMVECTOR instanceMaximum = DirectX::XMVectorReplicate(-FLT_MAX);
+	std::vector<DirectX::XMVECTOR> instanceCenters;
+	std::vector<float> instanceRadii;
+	float maxScale = 0.0f;
+	for (int i = subMesh.startInstance; i < subMesh.startInstance + subMesh.instanceCount; i++) {
+		DirectX::XMMATRIX transform = DirectX::XMLoadFloat4x4(&m_instances[i]);
+		float scale = std::sqrt(std::max({
+			DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(transform.r[0])),
+			DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(transform.r[1])),
+			DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(transform.r[2])) }));
+		DirectX::XMVECTOR instanceCenter = DirectX::XMVector3Transform(center, transform);
+		float instanceRadius = DirectX::XMVectorGetX(radius) * scale;
+
+		DirectX::XMVECTOR extent = DirectX::XMVectorReplicate(instanceRadius);
+		instanceMinimum = DirectX::XMVectorMin(instanceMinimum, DirectX::XMVectorSubtract(instanceCenter, extent));
+		instanceMaximum = DirectX::XMVectorMax(instanceMaximum, DirectX::XMVectorAdd(instanceCenter, extent));
+		instanceCenters.push_back(instanceCenter);
+		instanceRadii.push_back(instanceRadius);
+		maxScale = std::max(maxScale, scale);
+	}
+
+	DirectX::XMVECTOR boundsCenter = DirectX::XMVectorScale(DirectX::XMVectorAdd(instanceMinimum, instanceMaximum), 0.5f);
+	float boundsRadius = 0.0f;
+	for (size_t i = 0; i < instanceCenters.size(); i++) {
+		boundsRadius = std::max(boundsRadius, DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(instanceCenters[i], boundsCenter))) + instanceRadii[i]);
+	}
+	DirectX::XMStoreFloat3(&subMesh.boundsCenter, boundsCenter);
+	subMesh.boundsRadius = boundsRadius;
+
+	// Texel density for mip streaming: sqrt of UV area over surface area
+	float uvArea = 0.0f, surfaceArea = 0.0f;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const VertexType& v0 = vertices[indices[i] - vertexStartIndex];
+		const VertexType& v1 = vertices[indices[i + 1] - vertexStartIndex];
+		const VertexType& v2 = vertices[indices[i + 2] - vertexStartIndex];
+
+		DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&v0.position);
+		DirectX::XMVECTOR edge = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&v1.position), p0), DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&v2.position), p0));
+		surfaceArea += 0.5f * DirectX::XMVectorGetX(DirectX::XMVector3Length(edge));
+		uvArea += 0.5f * std::fabs((v1.texture.x - v0.texture.x) * (v2.texture.y - v0.texture.y) - (v2.texture.x - v0.texture.x) * (v1.texture.y - v0.texture.y));
+	}
+	subMesh.uvDensity = surfaceArea > 0.0f ? std::sqrt(uvArea / surfaceArea) : 0.0f;
+
+	// The largest instance stretches the texture furthest, so it decides the mips needed
+	if (maxScale > 0.0f) {
+		subMesh.uvDensity /= maxScale;
+	}
 
-	// Store the vertices and indices
-	m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
-	m_indices.insert(m_indices.end(), indices.begin(), indices.end());
-	m_submeshes.push_back(subMesh);
 }
 
@@ -7,7 +7,10 @@
 #include <fstream>
 #include <vector>
 #include <unordered_map>
+#include <string>
 #include "texture.h"
+#include "material_features.h"
+#include "static_batcher.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -26,39 +29,156 @@ private:
 	};
 
 public:
+	// One per distinct set of maps. The views are resolved ahead of time so a draw binds them as they are
+	struct Material
+	{
+		static constexpr uint32_t TEXTURE_COUNT = 6;
+
+		ID3D11ShaderResourceView* views[TEXTURE_COUNT];  // Light shader slots: diffuse, normal, specular, AO, emissive, metal-roughness
+		texture* textures[TEXTURE_COUNT];                // Owned by m_textures; null where the material has no map
+		uint32_t features;                               // material_features bits of the maps that were found
+		d3d11renderer::material_factors factors;         // What the light shader multiplies the maps by
+	};
+
+	// A node of the file's hierarchy relative to its parent, parents first; -1 at the top
+	struct Node
+	{
+		int parent;
+		DirectX::XMFLOAT3 translation;
+		DirectX::XMFLOAT4 rotation;  // Unit quaternion
+		DirectX::XMFLOAT3 scale;
+	};
+
+	static constexpr int MAX_LODS = 5;
+
+	struct Lod
+	{
+		int startIndex;
+		int indexCount;
+		float error;  // Furthest the surface strays from the full mesh, in model units at the largest instance scale
+	};
+
 	struct SubMesh
 	{
 		int startIndex;
 		int indexCount;
-		std::shared_ptr<texture> diffuseTexture;  // Diffuse texture
-		std::shared_ptr<texture> normalTexture;   // Normal map
-		std::shared_ptr<texture> specularTexture; // Specular map
-		std::shared_ptr<texture> aoTexture;           // AO map
-		std::shared_ptr<texture> emissiveTexture;     // Emissive map
-		std::shared_ptr<texture> metalRoughnessTexture; // Metallic-Roughness map
+		Lod lods[MAX_LODS];              // lods[0] is the full mesh; each after it has about half the triangles, or what seams allow
+		int lodCount;
+		int lod;                         // The one drawn, kept from frame to frame by set_lod
+		DirectX::XMFLOAT3 boundsCenter;  // Bounding sphere in model space, around every instance
+		float boundsRadius;
+		float uvDensity;                 // UV units per model-space unit, averaged over the surface, at the largest instance scale
+		int startInstance;               // Range of the instance stream placing this mesh, one entry per node using it
+		int instanceCount;
+		uint16_t materialId;             // Into get_materials(); submeshes are sorted by it
 	};
 
 
-	model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* modelfilename, const char* mtlbasepath);
+	// What reads the file. .gltf files go through our own loader by default; everything else is Assimp's
+	enum class Importer
+	{
+		Assimp,
+		Gltf
+	};
+
+	// Reading the file's meshes into the vertex and index buffers, textures aside
+	struct ImportStats
+	{
+		Importer importer;
+		size_t meshes;
+		size_t vertices;
+		size_t indices;
+		double milliseconds;
+		size_t compressedBytes;     // Geometry stored with EXT_meshopt_compression, and what it decoded to
+		size_t decodedBytes;
+		double decodeMilliseconds;  // Part of milliseconds
+	};
+
+	// With batching enabled, static submeshes that share a material are merged at import. textureQuality is the
+	// encoder tier the material textures are cooked with
+	model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* modelfilename, const char* mtlbasepath,
+		const d3d11renderer::batch_settings& batching = d3d11renderer::batch_settings(), Importer importer = Importer::Gltf,
+		d3d11renderer::compression_quality textureQuality = d3d11renderer::compression_quality::Fast);
 	~model();
 
 	void render(ID3D11DeviceContext*);
+	// Binds the position-only vertex stream with the same index buffer, for depth-only passes
+	void render_positions(ID3D11DeviceContext*);
 	const std::vector<SubMesh>& get_sub_meshes() const;
+	const std::vector<Material>& get_materials() const;
+	const std::vector<Node>& get_nodes() const;
+	// Texture streaming recreates views as mips come and go; re-reads them into the materials
+	void refresh_materials();
+	// How the material textures would pack into texture arrays, planned at load
+	const d3d11renderer::texture_array_planner& get_array_plan() const;
+	const ImportStats& get_import_stats() const;
+	// Reads this model's file again with the given importer, geometry only, to compare load times
+	ImportStats time_import(Importer importer) const;
+	const d3d11renderer::batch_stats& get_batch_stats() const;
+	void set_lod(size_t subMesh, int lod);
+	// Triangles in each LOD level over every submesh, and the time simplification took at import
+	size_t get_lod_triangles(int lod) const;
+	double get_lod_milliseconds() const;
+	const std::unordered_map<std::string, std::shared_ptr<texture>>& get_textures() const;
+	size_t get_instance_count() const;
+	// Full and position-only vertex streams together
+	size_t get_vertex_bytes() const;
 
 private:
+	// A material as the file names it: texture paths per Material slot, empty where it has none
+	struct MaterialSource
+	{
+		std::string textures[Material::TEXTURE_COUNT];
+		float alphaCutoff;  // Above 0 for alpha-tested materials
+		d3d11renderer::material_factors factors;
+	};
+
+	// Geometry only, for time_import
+	model();
+
 	bool initialize_buffers(ID3D11Device*);
 	void render_buffers(ID3D11DeviceContext*);
 
-	bool load_texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const aiScene* scene, const char* textureBasePath);
-	bool load_model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* modelfilename, const char* mtlPath);
-	void process_node(ID3D11Device* device, ID3D11DeviceContext* deviceContext, aiNode* node, const aiScene* scene);
-	void process_mesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, aiMesh* mesh, const aiScene* scene);
+	bool load_texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::vector<MaterialSource>& materials, const char* textureBasePath,
+		d3d11renderer::compression_quality textureQuality);
+	bool load_model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* modelfilename, const char* mtlPath, const d3d11renderer::batch_settings& batching,
+		Importer importer, d3d11renderer::compression_quality textureQuality);
+	// Fill the vertices, indices, submeshes and instances, and name each submesh's entry in materials.
+	// Submesh material ids are left for load_model to resolve once the textures are loaded
+	bool import_meshes(const char* modelfilename, Importer importer, std::vector<MaterialSource>& materials, std::vector<uint32_t>& subMeshMaterials);
+	bool import_assimp(const char* modelfilename, std::vector<MaterialSource>& materials, std::vector<uint32_t>& subMeshMaterials);
+	bool import_gltf(const char* modelfilename, std::vector<MaterialSource>& materials, std::vector<uint32_t>& subMeshMaterials);
+	// Adds the node and its children to m_nodes, and each node to the instances of every mesh it references
+	void process_node(const aiNode* node, int parent, std::vector<std::vector<uint32_t>>& meshInstances);
+	// Model-space transform of every node, from a scene graph of m_nodes
+	std::vector<DirectX::XMFLOAT4X4> get_node_transforms() const;
+	// Fills the mesh's ranges of the already sized vertex and index buffers. Safe to run for several meshes at once
+	void process_mesh(const aiMesh* mesh, unsigned int vertexStartIndex, const SubMesh& subMesh);
+	// Bounds and texel density of a submesh whose vertices and instances are in place. Safe to run for several at once
+	void measure_sub_mesh(unsigned int vertexStartIndex, unsigned int vertexCount, SubMesh& subMesh);
+	// Index of the material with these maps and factors, added if it is new
+	uint16_t add_material(const MaterialSource& source);
+	void plan_texture_arrays();
+	// Simplifies every submesh into its LOD chain, appended after the full meshes in the index buffer
+	void generate_lods();
+	// Bakes the node transform of every merged submesh into its vertices and lays each batch's indices out together
+	void batch_sub_meshes(const d3d11renderer::batch_settings& settings);
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer, m_indexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_positionBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceBuffer;
 	std::vector<VertexType> m_vertices;
 	std::vector<unsigned int> m_indices;
 	std::vector<SubMesh> m_submeshes;
+	std::vector<Material> m_materials;
+	d3d11renderer::texture_array_planner m_arrayPlan;
+	std::string m_filename;
+	ImportStats m_importStats;
+	d3d11renderer::batch_stats m_batchStats;
+	double m_lodMilliseconds;
+	std::vector<Node> m_nodes;
+	std::vector<DirectX::XMFLOAT4X4> m_instances;  // Row-vector transforms, grouped by submesh
 
 	// A map from material name to texture resource
 	std::unordered_map<std::string, std::shared_ptr<texture>> m_textures;
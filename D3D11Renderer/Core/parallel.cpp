@@ -0,0 +1,114 @@
+#include "parallel.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	// Sleeping threads that pick up chunks of whichever parallel_for calls are running. A call from inside a chunk
+	// simply adds its own job, so nesting works and never waits on a chunk nobody can reach.
+	class worker_pool
+	{
+	public:
+		worker_pool()
+			: m_stopping(false)
+		{
+			m_jobs.reserve(64);
+			for (size_t i = 0; i + 1 < worker_count(); i++)
+			{
+				m_threads.emplace_back([this]() { work(); });
+			}
+		}
+
+		~worker_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+			}
+			m_wake.notify_all();
+			for (auto& thread : m_threads)
+			{
+				thread.join();
+			}
+		}
+
+		void run(detail::parallel_job& job)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_jobs.push_back(&job);
+			}
+			m_wake.notify_all();
+
+			// The calling thread takes part as well.
+			run_chunks(job);
+
+			// Chunks other threads took may still be running, and they hold the job until they let go of it
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [&]() { return job.doneChunks.load() == job.chunkCount && job.helpers == 0; });
+			m_jobs.erase(std::find(m_jobs.begin(), m_jobs.end(), &job));
+		}
+
+	private:
+		static void run_chunks(detail::parallel_job& job)
+		{
+			for (;;)
+			{
+				size_t chunk = job.nextChunk.fetch_add(1);
+				if (chunk >= job.chunkCount)
+					break;
+
+				size_t begin = chunk * job.grain;
+				job.run(job.func, begin, std::min(begin + job.grain, job.count));
+				job.doneChunks.fetch_add(1);
+			}
+		}
+
+		detail::parallel_job* find_open_job() const
+		{
+			for (detail::parallel_job* job : m_jobs)
+			{
+				if (job->nextChunk.load() < job->chunkCount)
+					return job;
+			}
+			return nullptr;
+		}
+
+		void work()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			for (;;)
+			{
+				m_wake.wait(lock, [&]() { return m_stopping || find_open_job() != nullptr; });
+				if (m_stopping)
+					return;
+
+				detail::parallel_job* job = find_open_job();
+				job->helpers++;
+				lock.unlock();
+				run_chunks(*job);
+				lock.lock();
+				job->helpers--;
+				m_done.notify_all();
+			}
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		std::vector<detail::parallel_job*> m_jobs;
+		std::vector<std::thread> m_threads;
+		bool m_stopping;
+	};
+}
+
+void d3d11renderer::detail::run_parallel(parallel_job& job)
+{
+	static worker_pool pool;
+	pool.run(job);
+}
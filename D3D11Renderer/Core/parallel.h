@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+namespace d3d11renderer
+{
+	// Number of worker threads used by parallel_for (at least one).
+	inline size_t worker_count()
+	{
+		return std::max<size_t>(1, std::thread::hardware_concurrency());
+	}
+
+	namespace detail
+	{
+		// One parallel_for call, on the caller's stack for as long as the call lasts.
+		struct parallel_job
+		{
+			void (*run)(void* func, size_t begin, size_t end);
+			void* func;
+			size_t count;
+			size_t grain;
+			size_t chunkCount;
+			std::atomic<size_t> nextChunk;
+			std::atomic<size_t> doneChunks;
+			size_t helpers;  // Pool threads working on it, guarded by the pool's lock
+		};
+
+		// Offers the job to the pool, works on it from the calling thread too, and returns once every chunk is done.
+		void run_parallel(parallel_job& job);
+	}
+
+	// Runs func(begin, end) over [0, count) split into chunks of `grain` items.
+	// Chunks are handed out dynamically, so uneven work still balances across threads.
+	// The threads are started by the first call and kept, so a call allocates nothing and can be made every frame.
+	template<typename Func>
+	void parallel_for(size_t count, size_t grain, Func&& func)
+	{
+		if (count == 0)
+			return;
+
+		grain = std::max<size_t>(1, grain);
+		size_t chunkCount = (count + grain - 1) / grain;
+
+		if (chunkCount <= 1 || worker_count() <= 1)
+		{
+			func(size_t(0), count);
+			return;
+		}
+
+		using function_type = std::remove_reference_t<Func>;
+		detail::parallel_job job;
+		job.run = [](void* function, size_t begin, size_t end)
+		{
+			(*static_cast<function_type*>(function))(begin, end);
+		};
+		job.func = const_cast<void*>(static_cast<const void*>(std::addressof(func)));
+		job.count = count;
+		job.grain = grain;
+		job.chunkCount = chunkCount;
+		job.nextChunk = 0;
+		job.doneChunks = 0;
+		job.helpers = 0;
+		detail::run_parallel(job);
+	}
+}
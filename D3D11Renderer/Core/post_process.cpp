@@ -0,0 +1,77 @@
+#include "post_process.h"
+
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+
+// Matches the thread group size in postcs.hlsl
+constexpr uint32_t TILE_SIZE = 8;
+
+post_process::post_process(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache)
+{
+	std::vector<uint8_t> csBlob;
+	std::string errors;
+	HRESULT result;
+
+	if (!shaderCache.get({ L"Shaders/postcs.hlsl", "main", "cs_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS }, csBlob, errors)) {
+		throw std::runtime_error("Failed to compile the post process shader. " + errors);
+	}
+	result = device->CreateComputeShader(csBlob.data(), csBlob.size(), nullptr, m_computeShader.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the post process shader.");
+	}
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.ByteWidth = sizeof(PostParamsType);
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	result = device->CreateBuffer(&bufferDesc, nullptr, m_paramsBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the post process parameter buffer.");
+	}
+}
+
+post_process::~post_process()
+{
+}
+
+bool post_process::render(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* hdrTexture, ID3D11UnorderedAccessView* output, uint32_t width, uint32_t height,
+	const auto_exposure& exposure, const GradingSettings& settings)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result = deviceContext->Map(m_paramsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	PostParamsType* dataPtr = (PostParamsType*)mappedResource.pData;
+	dataPtr->outputSize[0] = width;
+	dataPtr->outputSize[1] = height;
+	dataPtr->exposure = settings.exposure;
+	dataPtr->saturation = settings.saturation;
+	dataPtr->tint[0] = settings.tint[0];
+	dataPtr->tint[1] = settings.tint[1];
+	dataPtr->tint[2] = settings.tint[2];
+	dataPtr->contrast = settings.contrast;
+	dataPtr->inverseGamma = 1.0f / settings.gamma;
+	deviceContext->Unmap(m_paramsBuffer.Get(), 0);
+
+	ID3D11Buffer* constantBuffers[3] = { m_paramsBuffer.Get(), exposure.get_exposure_buffer(), exposure.get_params_buffer() };
+	ID3D11UnorderedAccessView* uavs[2] = { output, exposure.get_histogram_uav() };
+
+	deviceContext->CSSetShader(m_computeShader.Get(), nullptr, 0);
+	deviceContext->CSSetConstantBuffers(0, 3, constantBuffers);
+	deviceContext->CSSetShaderResources(0, 1, &hdrTexture);
+	deviceContext->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
+	deviceContext->Dispatch((width + TILE_SIZE - 1) / TILE_SIZE, (height + TILE_SIZE - 1) / TILE_SIZE, 1);
+
+	// The scene goes back to being a render target and the back buffer to ImGui
+	ID3D11ShaderResourceView* nullSRV = nullptr;
+	ID3D11UnorderedAccessView* nullUAVs[2] = { nullptr, nullptr };
+	deviceContext->CSSetUnorderedAccessViews(0, 2, nullUAVs, nullptr);
+	deviceContext->CSSetShaderResources(0, 1, &nullSRV);
+	deviceContext->CSSetShader(nullptr, nullptr, 0);
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include "shader_cache.h"
+#include "auto_exposure.h"
+
+// Fused compute post chain. One dispatch over 8x8 tiles reads the multisampled HDR scene once per pixel and writes
+// the final display color once: resolve, exposure, tone mapping, color grading and gamma all happen in registers.
+// It also fills the auto exposure histogram from the same samples, so exposure needs no pass over the scene of its own.
+class post_process
+{
+public:
+	struct GradingSettings
+	{
+		float exposure = 1.0f;  // Compensation on top of the automatic exposure
+		float saturation = 1.0f;
+		float contrast = 1.0f;
+		float tint[3] = { 1.0f, 1.0f, 1.0f };
+		float gamma = 2.2f;
+	};
+
+private:
+	struct PostParamsType
+	{
+		uint32_t outputSize[2];
+		float exposure;
+		float saturation;
+		float tint[3];
+		float contrast;
+		float inverseGamma;
+		float padding[3];
+	};
+
+public:
+	post_process(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache);
+	~post_process();
+
+	// hdrTexture is multisampled; output must be a UNORM UAV of width x height, such as the back buffer.
+	// The exposure histogram must have been cleared with auto_exposure::begin_frame
+	bool render(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* hdrTexture, ID3D11UnorderedAccessView* output, uint32_t width, uint32_t height,
+		const auto_exposure& exposure, const GradingSettings& settings);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader> m_computeShader;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_paramsBuffer;
+};
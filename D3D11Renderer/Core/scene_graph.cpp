@@ -0,0 +1,342 @@
+#include "scene_graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+#include <xmmintrin.h>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	// Levels smaller than this are updated on the calling thread
+	constexpr size_t LEVEL_GRAIN = 4096;
+
+	// Local scale, rotation and translation as four rows of three; the same formulas update_four runs four wide
+	void compose_local(float qx, float qy, float qz, float qw, float sx, float sy, float sz, float tx, float ty, float tz, float local[12])
+	{
+		local[0] = (1.0f - 2.0f * (qy * qy + qz * qz)) * sx;
+		local[1] = 2.0f * (qx * qy + qz * qw) * sx;
+		local[2] = 2.0f * (qx * qz - qy * qw) * sx;
+		local[3] = 2.0f * (qx * qy - qz * qw) * sy;
+		local[4] = (1.0f - 2.0f * (qx * qx + qz * qz)) * sy;
+		local[5] = 2.0f * (qy * qz + qx * qw) * sy;
+		local[6] = 2.0f * (qx * qz + qy * qw) * sz;
+		local[7] = 2.0f * (qy * qz - qx * qw) * sz;
+		local[8] = (1.0f - 2.0f * (qx * qx + qy * qy)) * sz;
+		local[9] = tx;
+		local[10] = ty;
+		local[11] = tz;
+	}
+}
+
+d3d11renderer::scene_graph::scene_graph()
+	: m_stats(), m_levelsDirty(true)
+{
+	add_node(ROOT);
+}
+
+uint32_t d3d11renderer::scene_graph::add_node(uint32_t parent)
+{
+	uint32_t id = static_cast<uint32_t>(m_index.size());
+	uint32_t index = static_cast<uint32_t>(m_parent.size());
+
+	// Appended after everything, so it still follows its parent until the next sort
+	m_parent.push_back(id == ROOT ? index : m_index[parent]);
+	m_id.push_back(id);
+	m_dirty.push_back(1);
+	m_translationX.push_back(0.0f);
+	m_translationY.push_back(0.0f);
+	m_translationZ.push_back(0.0f);
+	m_rotationX.push_back(0.0f);
+	m_rotationY.push_back(0.0f);
+	m_rotationZ.push_back(0.0f);
+	m_rotationW.push_back(1.0f);
+	m_scaleX.push_back(1.0f);
+	m_scaleY.push_back(1.0f);
+	m_scaleZ.push_back(1.0f);
+	for (size_t i = 0; i < 12; i++)
+	{
+		m_world[i].push_back(i == 0 || i == 4 || i == 8 ? 1.0f : 0.0f);
+	}
+
+	m_index.push_back(index);
+	m_levelsDirty = true;
+	return id;
+}
+
+void d3d11renderer::scene_graph::reserve(size_t nodeCount)
+{
+	m_parent.reserve(nodeCount);
+	m_id.reserve(nodeCount);
+	m_dirty.reserve(nodeCount);
+	for (auto* values : { &m_translationX, &m_translationY, &m_translationZ, &m_rotationX, &m_rotationY, &m_rotationZ, &m_rotationW,
+		&m_scaleX, &m_scaleY, &m_scaleZ })
+	{
+		values->reserve(nodeCount);
+	}
+	for (auto& values : m_world)
+	{
+		values.reserve(nodeCount);
+	}
+	m_index.reserve(nodeCount);
+}
+
+void d3d11renderer::scene_graph::set_translation(uint32_t node, float x, float y, float z)
+{
+	uint32_t index = m_index[node];
+	m_translationX[index] = x;
+	m_translationY[index] = y;
+	m_translationZ[index] = z;
+	m_dirty[index] = 1;
+}
+
+void d3d11renderer::scene_graph::set_rotation(uint32_t node, float x, float y, float z, float w)
+{
+	uint32_t index = m_index[node];
+	m_rotationX[index] = x;
+	m_rotationY[index] = y;
+	m_rotationZ[index] = z;
+	m_rotationW[index] = w;
+	m_dirty[index] = 1;
+}
+
+void d3d11renderer::scene_graph::set_scale(uint32_t node, float x, float y, float z)
+{
+	uint32_t index = m_index[node];
+	m_scaleX[index] = x;
+	m_scaleY[index] = y;
+	m_scaleZ[index] = z;
+	m_dirty[index] = 1;
+}
+
+void d3d11renderer::scene_graph::mark_dirty(uint32_t node)
+{
+	m_dirty[m_index[node]] = 1;
+}
+
+void d3d11renderer::scene_graph::update()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	if (m_levelsDirty)
+	{
+		sort_levels();
+	}
+
+	std::atomic<size_t> updated = 0;
+
+	// The root has no parent to multiply by
+	if (m_dirty[0])
+	{
+		float local[12];
+		compose_local(m_rotationX[0], m_rotationY[0], m_rotationZ[0], m_rotationW[0], m_scaleX[0], m_scaleY[0], m_scaleZ[0],
+			m_translationX[0], m_translationY[0], m_translationZ[0], local);
+		for (size_t i = 0; i < 12; i++)
+		{
+			m_world[i][0] = local[i];
+		}
+		updated++;
+	}
+
+	// A level only reads the one above it, which is complete by then
+	for (size_t level = 1; level + 1 < m_levelOffsets.size(); level++)
+	{
+		size_t levelBegin = m_levelOffsets[level];
+		parallel_for(m_levelOffsets[level + 1] - levelBegin, LEVEL_GRAIN, [&](size_t begin, size_t end)
+		{
+			uint32_t batch[4];
+			size_t batchSize = 0, count = 0;
+			for (size_t i = levelBegin + begin; i < levelBegin + end; i++)
+			{
+				// Dirtiness flows down as the levels are walked
+				m_dirty[i] |= m_dirty[m_parent[i]];
+				if (!m_dirty[i])
+				{
+					continue;
+				}
+
+				batch[batchSize++] = static_cast<uint32_t>(i);
+				if (batchSize == 4)
+				{
+					update_four(batch);
+					batchSize = 0;
+					count += 4;
+				}
+			}
+
+			// Unused lanes repeat the last node, which writes the same result twice
+			if (batchSize > 0)
+			{
+				count += batchSize;
+				for (size_t lane = batchSize; lane < 4; lane++)
+				{
+					batch[lane] = batch[batchSize - 1];
+				}
+				update_four(batch);
+			}
+			updated += count;
+		});
+	}
+
+	std::fill(m_dirty.begin(), m_dirty.end(), uint8_t(0));
+
+	m_stats.nodeCount = m_parent.size();
+	m_stats.levelCount = m_levelOffsets.size() - 1;
+	m_stats.updatedNodes = updated;
+	m_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void d3d11renderer::scene_graph::get_world(uint32_t node, float world[4][4]) const
+{
+	uint32_t index = m_index[node];
+	for (size_t row = 0; row < 4; row++)
+	{
+		world[row][0] = m_world[row * 3][index];
+		world[row][1] = m_world[row * 3 + 1][index];
+		world[row][2] = m_world[row * 3 + 2][index];
+		world[row][3] = row == 3 ? 1.0f : 0.0f;
+	}
+}
+
+size_t d3d11renderer::scene_graph::get_node_count() const
+{
+	return m_parent.size();
+}
+
+const scene_graph_stats& d3d11renderer::scene_graph::get_stats() const
+{
+	return m_stats;
+}
+
+void d3d11renderer::scene_graph::sort_levels()
+{
+	// Parents always sit before their children, so one pass finds every depth
+	size_t count = m_parent.size();
+	std::vector<uint32_t> depth(count, 0);
+	uint32_t maxDepth = 0;
+	for (size_t i = 1; i < count; i++)
+	{
+		depth[i] = depth[m_parent[i]] + 1;
+		maxDepth = std::max(maxDepth, depth[i]);
+	}
+
+	m_levelOffsets.assign(maxDepth + 2, 0);
+	for (uint32_t nodeDepth : depth)
+	{
+		m_levelOffsets[nodeDepth + 1]++;
+	}
+	for (size_t level = 1; level < m_levelOffsets.size(); level++)
+	{
+		m_levelOffsets[level] += m_levelOffsets[level - 1];
+	}
+
+	// Stable counting sort by depth
+	std::vector<size_t> cursor(m_levelOffsets.begin(), m_levelOffsets.end() - 1);
+	std::vector<uint32_t> order(count), newIndex(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		newIndex[i] = static_cast<uint32_t>(cursor[depth[i]]++);
+		order[newIndex[i]] = static_cast<uint32_t>(i);
+	}
+
+	auto permute = [&](auto& values)
+	{
+		std::remove_reference_t<decltype(values)> sorted(values.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			sorted[i] = values[order[i]];
+		}
+		values.swap(sorted);
+	};
+
+	std::vector<uint32_t> parent(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		parent[i] = newIndex[m_parent[order[i]]];
+	}
+	m_parent.swap(parent);
+
+	permute(m_id);
+	permute(m_dirty);
+	for (auto* values : { &m_translationX, &m_translationY, &m_translationZ, &m_rotationX, &m_rotationY, &m_rotationZ, &m_rotationW,
+		&m_scaleX, &m_scaleY, &m_scaleZ })
+	{
+		permute(*values);
+	}
+	for (auto& values : m_world)
+	{
+		permute(values);
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		m_index[m_id[i]] = static_cast<uint32_t>(i);
+	}
+	m_levelsDirty = false;
+}
+
+void d3d11renderer::scene_graph::update_four(const uint32_t index[4])
+{
+	auto gather = [&](const std::vector<float>& values, const uint32_t* indices)
+	{
+		return _mm_set_ps(values[indices[3]], values[indices[2]], values[indices[1]], values[indices[0]]);
+	};
+
+	uint32_t parent[4] = { m_parent[index[0]], m_parent[index[1]], m_parent[index[2]], m_parent[index[3]] };
+
+	// Local rotation rows from the quaternions, each scaled by its axis
+	__m128 qx = gather(m_rotationX, index), qy = gather(m_rotationY, index), qz = gather(m_rotationZ, index), qw = gather(m_rotationW, index);
+	__m128 sx = gather(m_scaleX, index), sy = gather(m_scaleY, index), sz = gather(m_scaleZ, index);
+	__m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+
+	__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+	__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+	__m128 xw = _mm_mul_ps(qx, qw), yw = _mm_mul_ps(qy, qw), zw = _mm_mul_ps(qz, qw);
+
+	__m128 local[12];
+	local[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+	local[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), sx);
+	local[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), sx);
+	local[3] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), sy);
+	local[4] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+	local[5] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), sy);
+	local[6] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), sz);
+	local[7] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), sz);
+	local[8] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+	local[9] = gather(m_translationX, index);
+	local[10] = gather(m_translationY, index);
+	local[11] = gather(m_translationZ, index);
+
+	__m128 parentWorld[12];
+	for (size_t i = 0; i < 12; i++)
+	{
+		parentWorld[i] = gather(m_world[i], parent);
+	}
+
+	// world = local * parent with row vectors; the translation row also adds the parent's translation
+	for (size_t row = 0; row < 4; row++)
+	{
+		for (size_t column = 0; column < 3; column++)
+		{
+			__m128 value = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(local[row * 3], parentWorld[column]),
+				_mm_mul_ps(local[row * 3 + 1], parentWorld[3 + column])),
+				_mm_mul_ps(local[row * 3 + 2], parentWorld[6 + column]));
+			if (row == 3)
+			{
+				value = _mm_add_ps(value, parentWorld[9 + column]);
+			}
+
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, value);
+			std::vector<float>& target = m_world[row * 3 + column];
+			target[index[0]] = lanes[0];
+			target[index[1]] = lanes[1];
+			target[index[2]] = lanes[2];
+			target[index[3]] = lanes[3];
+		}
+	}
+}
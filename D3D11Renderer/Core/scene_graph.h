@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	struct scene_graph_stats
+	{
+		size_t nodeCount = 0;
+		size_t levelCount = 0;
+		size_t updatedNodes = 0;  // Dirty nodes and their descendants recomputed by the last update
+		double milliseconds = 0.0;
+	};
+
+	// Object transforms as a flat hierarchy. Every attribute is its own array, kept sorted by depth so each level is
+	// contiguous and comes after its parents. An update walks the levels in order: a node is recomputed when it or its
+	// parent is dirty, four nodes per SSE register from local scale, rotation and translation to local-to-world. Nodes of
+	// one level never depend on each other, so every level is split across worker threads.
+	// Node ids stay valid while the arrays are reordered. Nothing here touches the GPU.
+	class scene_graph
+	{
+	public:
+		static constexpr uint32_t ROOT = 0;
+
+		scene_graph();
+
+		// The parent must already exist; new nodes start at identity
+		uint32_t add_node(uint32_t parent = ROOT);
+		void reserve(size_t nodeCount);
+
+		void set_translation(uint32_t node, float x, float y, float z);
+		// Unit quaternion, x y z w
+		void set_rotation(uint32_t node, float x, float y, float z, float w);
+		void set_scale(uint32_t node, float x, float y, float z);
+		void mark_dirty(uint32_t node);
+
+		// Recomputes local-to-world for dirty subtrees only
+		void update();
+
+		// Row-major with row vectors, as DirectX::XMLoadFloat4x4 reads it
+		void get_world(uint32_t node, float world[4][4]) const;
+
+		size_t get_node_count() const;
+		const scene_graph_stats& get_stats() const;
+
+	private:
+		void sort_levels();
+		void update_four(const uint32_t index[4]);
+
+	private:
+		scene_graph_stats m_stats;
+		bool m_levelsDirty;
+
+		// Per node, in level order
+		std::vector<uint32_t> m_parent;  // Index of the parent; the root is its own parent
+		std::vector<uint32_t> m_id;
+		std::vector<uint8_t> m_dirty;
+		std::vector<float> m_translationX, m_translationY, m_translationZ;
+		std::vector<float> m_rotationX, m_rotationY, m_rotationZ, m_rotationW;
+		std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+		std::vector<float> m_world[12];  // Three rotation-scale rows then the translation row; the fourth column is always 0 0 0 1
+
+		std::vector<uint32_t> m_index;         // Node id to array index
+		std::vector<size_t> m_levelOffsets;    // Start of each level, plus the end
+	};
+}
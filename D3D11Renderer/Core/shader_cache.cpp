@@ -0,0 +1,317 @@
+#include "shader_cache.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+
+using namespace d3d11renderer;
+
+// Bump when the cache file layout changes
+constexpr uint32_t CACHE_VERSION = 1;
+
+namespace
+{
+	struct cache_header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint64_t size;
+	};
+
+	class fnv1a
+	{
+	public:
+		void mix(const void* data, size_t count)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < count; i++)
+			{
+				m_hash ^= bytes[i];
+				m_hash *= 1099511628211ull;
+			}
+		}
+
+		// Strings end in a zero so "ab" + "c" differs from "a" + "bc"
+		void mix(std::string_view text)
+		{
+			mix(text.data(), text.size());
+			mix("", 1);
+		}
+
+		uint64_t get() const
+		{
+			return m_hash;
+		}
+
+	private:
+		uint64_t m_hash = 14695981039346656037ull;
+	};
+
+	bool read_file(const std::filesystem::path& path, std::string& contents)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+
+	// Name inside #include "name" or #include <name>, empty for any other line
+	std::string_view get_include(std::string_view line)
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string_view::npos || line[i] != '#')
+		{
+			return {};
+		}
+
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string_view::npos || line.substr(i, 7) != "include")
+		{
+			return {};
+		}
+
+		i = line.find_first_not_of(" \t", i + 7);
+		if (i == std::string_view::npos || (line[i] != '"' && line[i] != '<'))
+		{
+			return {};
+		}
+
+		size_t end = line.find(line[i] == '"' ? '"' : '>', i + 1);
+		return end == std::string_view::npos ? std::string_view() : line.substr(i + 1, end - i - 1);
+	}
+
+	// Hashes a source file and, depth first, every file it includes. Includes are looked up next to the including file
+	// like D3D_COMPILE_STANDARD_FILE_INCLUDE does; ones that can't be found are left for the compiler to report.
+	bool hash_source(const std::filesystem::path& path, std::unordered_set<std::string>& visited, fnv1a& hash)
+	{
+		std::string source;
+		if (!read_file(path, source))
+		{
+			return false;
+		}
+
+		hash.mix(path.filename().string());
+		hash.mix(source);
+
+		std::string_view remaining = source;
+		while (!remaining.empty())
+		{
+			size_t end = remaining.find('\n');
+			std::string_view line = remaining.substr(0, end);
+			remaining = end == std::string_view::npos ? std::string_view() : remaining.substr(end + 1);
+
+			std::string_view include = get_include(line);
+			if (include.empty())
+			{
+				continue;
+			}
+
+			std::filesystem::path includePath = (path.parent_path() / include).lexically_normal();
+			if (visited.insert(includePath.string()).second && !hash_source(includePath, visited, hash))
+			{
+				hash.mix(include);
+			}
+		}
+
+		return true;
+	}
+}
+
+d3d11renderer::shader_cache::shader_cache(const std::filesystem::path& directory, uint64_t compilerVersion, shader_compile_function compiler)
+	: m_directory(directory), m_compilerVersion(compilerVersion), m_compiler(std::move(compiler))
+{
+	// Without the directory every shader is still compiled, just not kept between runs
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+}
+
+bool d3d11renderer::shader_cache::get(const shader_desc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+	errors.clear();
+
+	uint64_t key = compute_key(desc);
+	if (key == 0)
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto found = m_bytecode.find(key);
+		if (found != m_bytecode.end())
+		{
+			bytecode = found->second;
+			m_stats.memoryHits++;
+			return true;
+		}
+	}
+
+	bool loaded = load_bytecode(key, bytecode);
+	double milliseconds = 0.0;
+	if (!loaded)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (!m_compiler(desc, bytecode, errors))
+		{
+			return false;
+		}
+		milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		save_bytecode(key, bytecode);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_bytecode[key] = bytecode;
+	if (loaded)
+	{
+		m_stats.diskHits++;
+	}
+	else
+	{
+		m_stats.compiles++;
+		m_stats.compileMilliseconds += milliseconds;
+	}
+
+	return true;
+}
+
+bool d3d11renderer::shader_cache::prefetch(const std::vector<shader_desc>& descs, std::string& errors)
+{
+	// Descs with the same key are fetched once, so two workers never compile the same permutation side by side.
+	// Missing files have no key and are each reported.
+	std::vector<size_t> unique;
+	std::unordered_set<uint64_t> keys;
+	for (size_t i = 0; i < descs.size(); i++)
+	{
+		uint64_t key = compute_key(descs[i]);
+		if (key == 0 || keys.insert(key).second)
+		{
+			unique.push_back(i);
+		}
+	}
+
+	std::vector<std::string> shaderErrors(unique.size());
+	std::vector<uint8_t> succeeded(unique.size(), 0);
+
+	// One shader per job; compile times vary too much for bigger chunks
+	parallel_for(unique.size(), 1, [&](size_t begin, size_t end)
+	{
+		std::vector<uint8_t> bytecode;
+		for (size_t i = begin; i < end; i++)
+		{
+			succeeded[i] = get(descs[unique[i]], bytecode, shaderErrors[i]) ? 1 : 0;
+		}
+	});
+
+	errors.clear();
+	bool result = true;
+	for (size_t i = 0; i < unique.size(); i++)
+	{
+		if (!succeeded[i])
+		{
+			errors += shaderErrors[i].empty() ? "Missing shader file " + descs[unique[i]].path.string() + "\n" : shaderErrors[i];
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+uint64_t d3d11renderer::shader_cache::compute_key(const shader_desc& desc) const
+{
+	fnv1a hash;
+	const uint64_t versions[] = { CACHE_VERSION, m_compilerVersion, desc.flags };
+	hash.mix(versions, sizeof(versions));
+	hash.mix(desc.entryPoint);
+	hash.mix(desc.profile);
+	for (const auto& [name, value] : desc.defines)
+	{
+		hash.mix(name);
+		hash.mix(value);
+	}
+
+	std::unordered_set<std::string> visited = { desc.path.lexically_normal().string() };
+	if (!hash_source(desc.path, visited, hash))
+	{
+		return 0;
+	}
+
+	return hash.get() != 0 ? hash.get() : 1;
+}
+
+d3d11renderer::shader_cache_stats d3d11renderer::shader_cache::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+std::filesystem::path d3d11renderer::shader_cache::get_cache_path(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(key));
+	return m_directory / name;
+}
+
+bool d3d11renderer::shader_cache::load_bytecode(uint64_t key, std::vector<uint8_t>& bytecode) const
+{
+	std::ifstream file(get_cache_path(key), std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	cache_header header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || std::string_view(header.magic, 4) != "SHC1" || header.version != CACHE_VERSION || header.key != key || header.size == 0)
+	{
+		return false;
+	}
+
+	bytecode.resize(static_cast<size_t>(header.size));
+	file.read(reinterpret_cast<char*>(bytecode.data()), bytecode.size());
+
+	return static_cast<bool>(file);
+}
+
+bool d3d11renderer::shader_cache::save_bytecode(uint64_t key, const std::vector<uint8_t>& bytecode) const
+{
+	std::filesystem::path path = get_cache_path(key);
+
+	// Written next to the final name and renamed, so a reader never sees a partial file
+	std::filesystem::path temporaryPath = path;
+	temporaryPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+	bool written;
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		cache_header header = { { 'S', 'H', 'C', '1' }, CACHE_VERSION, key, bytecode.size() };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(bytecode.data()), bytecode.size());
+		written = static_cast<bool>(file);
+	}
+
+	std::error_code error;
+	if (written)
+	{
+		std::filesystem::rename(temporaryPath, path, error);
+	}
+	if (!written || error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace d3d11renderer
+{
+	// Everything that decides what bytecode a shader compiles to
+	struct shader_desc
+	{
+		std::filesystem::path path;
+		std::string entryPoint = "main";
+		std::string profile;
+		std::vector<std::pair<std::string, std::string>> defines;
+		uint32_t flags = 0;
+	};
+
+	// Compiles one shader. errors stays empty when the source file couldn't be found.
+	using shader_compile_function = std::function<bool(const shader_desc& desc, std::vector<uint8_t>& bytecode, std::string& errors)>;
+
+	struct shader_cache_stats
+	{
+		size_t memoryHits = 0;
+		size_t diskHits = 0;
+		size_t compiles = 0;
+		double compileMilliseconds = 0.0;  // Summed over worker threads
+	};
+
+	// Keeps compiled bytecode in memory and in one file per shader on disk.
+	// The key hashes the source with every file it includes, the defines, entry point, profile, flags and compiler
+	// version, so editing a shader or anything it includes recompiles only what changed.
+	// The compiler is passed in, which keeps this free of D3D and lets get be called from several threads.
+	class shader_cache
+	{
+	public:
+		shader_cache(const std::filesystem::path& directory, uint64_t compilerVersion, shader_compile_function compiler);
+
+		bool get(const shader_desc& desc, std::vector<uint8_t>& bytecode, std::string& errors);
+
+		// Loads or compiles every shader on worker threads so later gets come from memory; descs with the same key
+		// are fetched once. Returns false if any failed; errors holds the messages of all of them.
+		bool prefetch(const std::vector<shader_desc>& descs, std::string& errors);
+
+		// Zero when the source file can't be read
+		uint64_t compute_key(const shader_desc& desc) const;
+
+		shader_cache_stats get_stats() const;
+
+	private:
+		std::filesystem::path get_cache_path(uint64_t key) const;
+		bool load_bytecode(uint64_t key, std::vector<uint8_t>& bytecode) const;
+		bool save_bytecode(uint64_t key, const std::vector<uint8_t>& bytecode) const;
+
+	private:
+		std::filesystem::path m_directory;
+		uint64_t m_compilerVersion;
+		shader_compile_function m_compiler;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<uint64_t, std::vector<uint8_t>> m_bytecode;
+		shader_cache_stats m_stats;
+	};
+}
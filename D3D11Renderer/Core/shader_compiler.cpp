@@ -0,0 +1,40 @@
+#include "shader_compiler.h"
+
+#include <d3dcompiler.h>
+#include <wrl/client.h>
+
+using Microsoft::WRL::ComPtr;
+
+bool d3d11renderer::shader_compiler::compile(const shader_desc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+	// The define list ends with a null entry
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const auto& [name, value] : desc.defines)
+	{
+		macros.push_back({ name.c_str(), value.c_str() });
+	}
+	macros.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> shaderBlob;
+	ComPtr<ID3DBlob> errorBlob;
+	HRESULT result = D3DCompileFromFile(desc.path.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, desc.entryPoint.c_str(), desc.profile.c_str(),
+		desc.flags, 0, shaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+	if (FAILED(result))
+	{
+		// No error text means the file itself couldn't be opened
+		if (errorBlob)
+		{
+			errors.assign(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize());
+		}
+		return false;
+	}
+
+	const uint8_t* data = static_cast<const uint8_t*>(shaderBlob->GetBufferPointer());
+	bytecode.assign(data, data + shaderBlob->GetBufferSize());
+	return true;
+}
+
+uint64_t d3d11renderer::shader_compiler::get_version()
+{
+	return D3D_COMPILER_VERSION;
+}
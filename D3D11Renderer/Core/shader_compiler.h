@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "shader_cache.h"
+
+namespace d3d11renderer
+{
+	// D3DCompiler front end for shader_cache
+	class shader_compiler
+	{
+	public:
+		static bool compile(const shader_desc& desc, std::vector<uint8_t>& bytecode, std::string& errors);
+		static uint64_t get_version();
+	};
+}
@@ -0,0 +1,170 @@
+#include "shadow_cascades.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	float dot3(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void normalize3(float v[3])
+	{
+		float length = std::sqrt(dot3(v, v));
+		length = length > 0.0f ? length : 1.0f;
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+
+	void cross3(const float a[3], const float b[3], float result[3])
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+}
+
+d3d11renderer::shadow_cascades::shadow_cascades(const cascade_settings& settings)
+	: m_settings(), m_cascades(), m_milliseconds(0.0)
+{
+	set_settings(settings);
+}
+
+void d3d11renderer::shadow_cascades::set_settings(const cascade_settings& settings)
+{
+	m_settings = settings;
+	m_settings.count = std::clamp(m_settings.count, 1u, cascade_settings::MAX_CASCADES);
+	m_settings.resolution = std::max(m_settings.resolution, 16u);
+	m_settings.splitLambda = std::clamp(m_settings.splitLambda, 0.0f, 1.0f);
+}
+
+const cascade_settings& d3d11renderer::shadow_cascades::get_settings() const
+{
+	return m_settings;
+}
+
+void d3d11renderer::shadow_cascades::update(const float view[4][4], const float projection[4][4], const float lightDirection[3], const shadow_caster* casters, size_t casterCount)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Frustum shape from the projection; k is the slope of the frustum's corner edges
+	float nearZ = -projection[3][2] / projection[2][2];
+	float farZ = std::min(projection[3][2] / (1.0f - projection[2][2]), std::max(m_settings.maxDistance, nearZ * 2.0f));
+	float cornerSlopeSquared = 1.0f / (projection[0][0] * projection[0][0]) + 1.0f / (projection[1][1] * projection[1][1]);
+
+	// Light basis, built like XMMatrixLookToLH with the world origin as its eye so snapping is relative to a fixed point
+	float forward[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	normalize3(forward);
+	float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+	if (std::abs(forward[1]) > 0.99f)
+	{
+		worldUp[1] = 0.0f;
+		worldUp[2] = 1.0f;
+	}
+	float right[3], up[3];
+	cross3(worldUp, forward, right);
+	normalize3(right);
+	cross3(forward, right, up);
+
+	float splitNear = nearZ;
+	for (uint32_t i = 0; i < m_settings.count; i++)
+	{
+		shadow_cascade& cascade = m_cascades[i];
+
+		// Practical split: logarithmic near the camera where it matters, blended towards uniform further out
+		float fraction = static_cast<float>(i + 1) / static_cast<float>(m_settings.count);
+		float logarithmic = nearZ * std::pow(farZ / nearZ, fraction);
+		float uniform = nearZ + (farZ - nearZ) * fraction;
+		float splitFar = m_settings.splitLambda * logarithmic + (1.0f - m_settings.splitLambda) * uniform;
+
+		// Smallest sphere through the near and far corner rings of the split; its center lies on the view axis
+		float centerZ = (splitNear + splitFar) * (1.0f + cornerSlopeSquared) * 0.5f;
+		float radius;
+		if (centerZ >= splitFar)
+		{
+			centerZ = splitFar;
+			radius = splitFar * std::sqrt(cornerSlopeSquared);
+		}
+		else
+		{
+			radius = std::sqrt((splitFar - centerZ) * (splitFar - centerZ) + splitFar * splitFar * cornerSlopeSquared);
+		}
+
+		// Back to world space through the inverse of the rigid view matrix
+		float center[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			center[axis] = -view[3][0] * view[axis][0] - view[3][1] * view[axis][1] + (centerZ - view[3][2]) * view[axis][2];
+		}
+
+		// Whole texels in light space, so moving the camera slides the cascade a texel at a time. The snapped center is
+		// up to a texel off the sphere's, so the box reaches a texel past the sphere on every side
+		float texelSize = 2.0f * radius / static_cast<float>(m_settings.resolution - 2);
+		float halfWidth = radius + texelSize;
+		float lightX = std::floor(dot3(center, right) / texelSize) * texelSize;
+		float lightY = std::floor(dot3(center, up) / texelSize) * texelSize;
+		float lightZ = dot3(center, forward);
+
+		// Casters overlapping the cascade's box across the light, and anywhere towards the light from its far side
+		float nearLight = lightZ - radius;
+		float farLight = lightZ + radius;
+		cascade.casters.clear();
+		cascade.casters.reserve(casterCount);
+		for (size_t c = 0; c < casterCount; c++)
+		{
+			const shadow_caster& caster = casters[c];
+			float casterZ = dot3(caster.center, forward);
+			if (std::abs(dot3(caster.center, right) - lightX) > halfWidth + caster.radius ||
+				std::abs(dot3(caster.center, up) - lightY) > halfWidth + caster.radius ||
+				casterZ - caster.radius > farLight)
+			{
+				continue;
+			}
+
+			cascade.casters.push_back(static_cast<uint32_t>(c));
+			nearLight = std::min(nearLight, casterZ - caster.radius);
+		}
+
+		// Orthographic projection of the light-space box into [-1, 1] x [-1, 1] x [0, 1]
+		float depthScale = 1.0f / (farLight - nearLight);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cascade.viewProjection[axis][0] = right[axis] / halfWidth;
+			cascade.viewProjection[axis][1] = up[axis] / halfWidth;
+			cascade.viewProjection[axis][2] = forward[axis] * depthScale;
+			cascade.viewProjection[axis][3] = 0.0f;
+		}
+		cascade.viewProjection[3][0] = -lightX / halfWidth;
+		cascade.viewProjection[3][1] = -lightY / halfWidth;
+		cascade.viewProjection[3][2] = -nearLight * depthScale;
+		cascade.viewProjection[3][3] = 1.0f;
+
+		cascade.splitDepth = splitFar;
+		cascade.texelSize = texelSize;
+		splitNear = splitFar;
+	}
+
+	m_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t d3d11renderer::shadow_cascades::get_cascade_count() const
+{
+	return m_settings.count;
+}
+
+const shadow_cascade& d3d11renderer::shadow_cascades::get_cascade(uint32_t index) const
+{
+	return m_cascades[index];
+}
+
+double d3d11renderer::shadow_cascades::get_milliseconds() const
+{
+	return m_milliseconds;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	struct cascade_settings
+	{
+		static constexpr uint32_t MAX_CASCADES = 4;
+
+		uint32_t count = 4;          // 1 to MAX_CASCADES
+		uint32_t resolution = 2048;  // Texels along each side of every cascade
+		float splitLambda = 0.75f;   // Blend from uniform (0) to logarithmic (1) split distances
+		float maxDistance = 150.0f;  // Shadows end here, or at the far plane if that is nearer
+	};
+
+	// World-space bounding sphere of something that casts a shadow
+	struct shadow_caster
+	{
+		float center[3];
+		float radius;
+	};
+
+	struct shadow_cascade
+	{
+		float viewProjection[4][4];  // World to light clip space, row-major with row vectors
+		float splitDepth;            // View depth where this cascade ends
+		float texelSize;             // World units covered by one shadow-map texel
+		std::vector<uint32_t> casters;  // Indices of the casters overlapping this cascade
+	};
+
+	// Fits a cascaded shadow map to the camera frustum.
+	// Each split of the frustum gets the bounding sphere of its corners, worked out in view space so its radius never
+	// changes while the camera moves or turns; the light-space center is then snapped to whole texels, so static
+	// shadows don't shimmer, with a texel of margin that keeps the sphere inside. The depth range of every cascade is
+	// stretched back to the casters that overlap it.
+	class shadow_cascades
+	{
+	public:
+		shadow_cascades(const cascade_settings& settings);
+
+		void set_settings(const cascade_settings& settings);
+		const cascade_settings& get_settings() const;
+
+		// Matrices are row-major with row vectors and the projection is a left-handed perspective, as in light_clusters.
+		// lightDirection is the way the light travels.
+		void update(const float view[4][4], const float projection[4][4], const float lightDirection[3], const shadow_caster* casters, size_t casterCount);
+
+		uint32_t get_cascade_count() const;
+		const shadow_cascade& get_cascade(uint32_t index) const;
+		double get_milliseconds() const;
+
+	private:
+		cascade_settings m_settings;
+		shadow_cascade m_cascades[cascade_settings::MAX_CASCADES];
+		double m_milliseconds;
+	};
+}
@@ -0,0 +1,199 @@
+#include "shadow_map.h"
+
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+
+shadow_map::shadow_map(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache)
+	: m_cascadeCount(0), m_resolution(0)
+{
+	create_shaders(device, shaderCache);
+}
+
+shadow_map::~shadow_map()
+{
+}
+
+bool shadow_map::resize(ID3D11Device* device, uint32_t cascadeCount, uint32_t resolution)
+{
+	if (cascadeCount == m_cascadeCount && resolution == m_resolution && m_depthTexture)
+	{
+		return true;
+	}
+
+	m_depthSRV.Reset();
+	m_depthViews.clear();
+	m_depthTexture.Reset();
+	m_cascadeCount = 0;
+	m_resolution = 0;
+
+	// Typeless so the same memory is written as depth and sampled as a float
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = resolution;
+	textureDesc.Height = resolution;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = cascadeCount;
+	textureDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+	HRESULT result = device->CreateTexture2D(&textureDesc, nullptr, m_depthTexture.GetAddressOf());
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < cascadeCount; i++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC depthViewDesc = {};
+		depthViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		depthViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		depthViewDesc.Texture2DArray.FirstArraySlice = i;
+		depthViewDesc.Texture2DArray.ArraySize = 1;
+
+		ComPtr<ID3D11DepthStencilView> depthView;
+		result = device->CreateDepthStencilView(m_depthTexture.Get(), &depthViewDesc, depthView.GetAddressOf());
+		if (FAILED(result))
+		{
+			return false;
+		}
+		m_depthViews.push_back(depthView);
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.ArraySize = cascadeCount;
+
+	result = device->CreateShaderResourceView(m_depthTexture.Get(), &srvDesc, m_depthSRV.GetAddressOf());
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	m_cascadeCount = cascadeCount;
+	m_resolution = resolution;
+	return true;
+}
+
+bool shadow_map::begin_cascade(ID3D11DeviceContext* deviceContext, uint32_t cascade, const d3d11renderer::shadow_cascade& cascadeData, const DirectX::XMMATRIX& worldMatrix)
+{
+	if (cascade >= m_cascadeCount)
+	{
+		return false;
+	}
+
+	// The lit pass samples the array from t11; it can't stay bound while it is written
+	if (cascade == 0)
+	{
+		ID3D11ShaderResourceView* nullSRV = nullptr;
+		deviceContext->PSSetShaderResources(11, 1, &nullSRV);
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result = deviceContext->Map(m_matrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	MatrixBufferType* dataPtr = (MatrixBufferType*)mappedResource.pData;
+	dataPtr->world = DirectX::XMMatrixTranspose(worldMatrix);
+	dataPtr->lightViewProjection = DirectX::XMMatrixTranspose(DirectX::XMMATRIX(&cascadeData.viewProjection[0][0]));
+	deviceContext->Unmap(m_matrixBuffer.Get(), 0);
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = static_cast<float>(m_resolution);
+	viewport.Height = static_cast<float>(m_resolution);
+	viewport.MaxDepth = 1.0f;
+
+	deviceContext->ClearDepthStencilView(m_depthViews[cascade].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	deviceContext->OMSetRenderTargets(0, nullptr, m_depthViews[cascade].Get());
+	deviceContext->RSSetViewports(1, &viewport);
+	deviceContext->RSSetState(m_rasterState.Get());
+
+	deviceContext->IASetInputLayout(m_layout.Get());
+	deviceContext->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+	deviceContext->VSSetConstantBuffers(0, 1, m_matrixBuffer.GetAddressOf());
+	deviceContext->PSSetShader(nullptr, nullptr, 0);
+
+	return true;
+}
+
+void shadow_map::render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount, int startInstance)
+{
+	deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, 0, startInstance);
+}
+
+ID3D11ShaderResourceView* shadow_map::get_srv() const
+{
+	return m_depthSRV.Get();
+}
+
+uint32_t shadow_map::get_resolution() const
+{
+	return m_resolution;
+}
+
+void shadow_map::create_shaders(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache)
+{
+	std::vector<uint8_t> vsBlob;
+	std::string errors;
+
+	if (!shaderCache.get({ L"Shaders/shadowvs.hlsl", "main", "vs_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS }, vsBlob, errors)) {
+		throw std::runtime_error("Failed to compile the shadow vertex shader. " + errors);
+	}
+
+	HRESULT result = device->CreateVertexShader(vsBlob.data(), vsBlob.size(), nullptr, m_vertexShader.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the shadow vertex shader.");
+	}
+
+	// Matches model::render_positions: positions, then the node transform rows per instance
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[5] = {};
+	polygonLayout[0].SemanticName = "POSITION";
+	polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	polygonLayout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	for (UINT row = 0; row < 4; row++)
+	{
+		polygonLayout[1 + row].SemanticName = "INSTANCE_TRANSFORM";
+		polygonLayout[1 + row].SemanticIndex = row;
+		polygonLayout[1 + row].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		polygonLayout[1 + row].InputSlot = 1;
+		polygonLayout[1 + row].AlignedByteOffset = row * static_cast<UINT>(sizeof(DirectX::XMFLOAT4));
+		polygonLayout[1 + row].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		polygonLayout[1 + row].InstanceDataStepRate = 1;
+	}
+
+	result = device->CreateInputLayout(polygonLayout, 5, vsBlob.data(), vsBlob.size(), m_layout.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the shadow input layout.");
+	}
+
+	D3D11_BUFFER_DESC matrixBufferDesc = {};
+	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
+	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	result = device->CreateBuffer(&matrixBufferDesc, nullptr, m_matrixBuffer.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the shadow matrix buffer.");
+	}
+
+	// Both faces cast, since Sponza's cloth and foliage are single sheets; slope-scaled bias keeps lit faces from self-shadowing
+	D3D11_RASTERIZER_DESC rasterDesc = {};
+	rasterDesc.FillMode = D3D11_FILL_SOLID;
+	rasterDesc.CullMode = D3D11_CULL_NONE;
+	rasterDesc.DepthBias = 100;
+	rasterDesc.SlopeScaledDepthBias = 1.5f;
+	rasterDesc.DepthBiasClamp = 0.0f;
+	rasterDesc.DepthClipEnable = false;
+
+	result = device->CreateRasterizerState(&rasterDesc, m_rasterState.GetAddressOf());
+	if (FAILED(result)) {
+		throw std::runtime_error("Failed to create the shadow rasterizer state.");
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <d3d11.h>
+#include <directxmath.h>
+#include <wrl/client.h>
+#include <vector>
+#include "shader_cache.h"
+#include "shadow_cascades.h"
+
+// Depth texture array holding one slice per shadow cascade, and the position-only pass that fills it.
+// Casters are drawn with only a vertex shader bound and depth clipping off, so anything between the light and
+// a cascade's near plane is flattened onto it instead of being cut away.
+class shadow_map
+{
+private:
+	struct MatrixBufferType
+	{
+		DirectX::XMMATRIX world;
+		DirectX::XMMATRIX lightViewProjection;
+	};
+
+public:
+	shadow_map(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache);
+	~shadow_map();
+
+	// Recreates the array when the cascade count or resolution changes
+	bool resize(ID3D11Device* device, uint32_t cascadeCount, uint32_t resolution);
+
+	// Clears and binds one slice; casters are then drawn with render() after the model's render_positions()
+	bool begin_cascade(ID3D11DeviceContext* deviceContext, uint32_t cascade, const d3d11renderer::shadow_cascade& cascadeData, const DirectX::XMMATRIX& worldMatrix);
+	void render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount, int startInstance);
+
+	ID3D11ShaderResourceView* get_srv() const;
+	uint32_t get_resolution() const;
+
+private:
+	void create_shaders(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_layout;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_matrixBuffer;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_rasterState;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_depthTexture;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilView>> m_depthViews;  // One per cascade
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_depthSRV;
+	uint32_t m_cascadeCount;
+	uint32_t m_resolution;
+};
@@ -1,14 +1,17 @@
 #include "skybox.h"
 #include <format>
 #include <DirectXTex.h>
+#include "texture_compressor.h"
+#include <algorithm>
+#include <vector>
 
 
 using namespace Microsoft::WRL;
 
-skybox::skybox(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::wstring& hdrFileName)
+skybox::skybox(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::wstring& hdrFileName, d3d11renderer::shader_cache& shaderCache)
 {
     CreateCubemapTexture(device, deviceContext, hdrFileName);
-    CreateShaders(device);
+    CreateShaders(device, shaderCache);
     CreateShaderResourceView(device);
 }
 
@@ -17,11 +20,12 @@ skybox::~skybox()
 
 }
 
-void skybox::render(ID3D11DeviceContext* context, int indexCount, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix)
+void skybox::render(ID3D11DeviceContext* context, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix)
 {
     set_shader_parameters(context, viewMatrix, projectionMatrix);
-    context->IASetInputLayout(m_layout.Get());
 
+    // The vertex shader makes its own triangle
+    context->IASetInputLayout(nullptr);
     context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
 
     context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
@@ -30,7 +34,27 @@ void skybox::render(ID3D11DeviceContext* context, int indexCount, DirectX::XMMAT
 
     // Set primitive topology to triangle list
     context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    context->DrawIndexed(indexCount, 0, 0); // Draw the sphere using index buffer
+    context->Draw(3, 0);
+}
+
+const d3d11renderer::compression_report& skybox::get_report() const
+{
+    return m_report;
+}
+
+ID3D11ShaderResourceView* skybox::get_specular_srv() const
+{
+    return m_specularSRV.Get();
+}
+
+ID3D11ShaderResourceView* skybox::get_brdf_lut_srv() const
+{
+    return m_brdfLutSRV.Get();
+}
+
+const d3d11renderer::ibl_data& skybox::get_ibl() const
+{
+    return m_ibl;
 }
 
 void skybox::CreateCubemapTexture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::wstring& hdrFileName)
@@ -48,79 +72,144 @@ void skybox::CreateCubemapTexture(ID3D11Device* device, ID3D11DeviceContext* dev
         throw std::runtime_error("Failed to retrieve image data.");
     }
 
+    CreateEnvironmentLighting(device, scratchImage, hdrFileName);
+
+    // Store the panorama as BC6H, 1 byte per texel instead of 16
+    DirectX::ScratchImage compressed;
+    const DirectX::Image* upload = image;
+    m_format = image->format;
+
+    if (d3d11renderer::texture_compressor::is_block_compressible(scratchImage.GetMetadata()) &&
+        d3d11renderer::texture_compressor::compress(scratchImage, DXGI_FORMAT_BC6H_UF16, d3d11renderer::compression_quality::Fast, compressed, &m_report)) {
+        upload = compressed.GetImage(0, 0, 0);
+        m_format = upload->format;
+    }
+
     // Create a 2D texture for the panorama (instead of a cubemap)
     D3D11_TEXTURE2D_DESC textureDesc = {};
     textureDesc.Width = image->width;   // Full panorama width
     textureDesc.Height = image->height; // Full panorama height
     textureDesc.MipLevels = 1;
     textureDesc.ArraySize = 1;          // Single 2D texture
-    textureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    textureDesc.Format = m_format;
     textureDesc.SampleDesc.Count = 1;
-    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
     textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
+    D3D11_SUBRESOURCE_DATA initData = {};
+    initData.pSysMem = upload->pixels;
+    initData.SysMemPitch = static_cast<UINT>(upload->rowPitch);
+    initData.SysMemSlicePitch = static_cast<UINT>(upload->slicePitch);
+
     // Create the 2D texture for the panorama
-    HRESULT createTextureResult = device->CreateTexture2D(&textureDesc, nullptr, m_cubemapTexture.GetAddressOf());
+    HRESULT createTextureResult = device->CreateTexture2D(&textureDesc, &initData, m_cubemapTexture.GetAddressOf());
     if (FAILED(createTextureResult)) {
         throw std::runtime_error("Failed to create panorama texture.");
     }
+}
+
+void skybox::CreateEnvironmentLighting(ID3D11Device* device, const DirectX::ScratchImage& panorama, const std::wstring& hdrFileName)
+{
+    d3d11renderer::ibl_settings settings;
+    std::wstring cachePath = hdrFileName + L".ibl";
+    uint64_t key = d3d11renderer::ibl_baker::compute_key(hdrFileName, settings);
+
+    // The convolution runs once per HDR file; later starts read the cache
+    if (!d3d11renderer::ibl_baker::load_cache(cachePath, key, m_ibl)) {
+        DirectX::ScratchImage converted;
+        const DirectX::Image* image = panorama.GetImage(0, 0, 0);
+        if (image->format != DXGI_FORMAT_R32G32B32A32_FLOAT) {
+            HRESULT hr = DirectX::Convert(*image, DXGI_FORMAT_R32G32B32A32_FLOAT, DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, converted);
+            if (FAILED(hr)) {
+                throw std::runtime_error("Failed to convert HDR file.");
+            }
+            image = converted.GetImage(0, 0, 0);
+        }
+
+        d3d11renderer::environment_map environment;
+        environment.width = image->width;
+        environment.height = image->height;
+        environment.texels = reinterpret_cast<const float*>(image->pixels);
+        d3d11renderer::ibl_baker::bake(environment, settings, m_ibl);
+
+        if (!d3d11renderer::ibl_baker::save_cache(cachePath, key, m_ibl)) {
+            OutputDebugStringA("skybox: failed to write the IBL cache\n");
+        }
+    }
+
+    // Prefiltered specular cube; subresources are face-major, like the baked data
+    D3D11_TEXTURE2D_DESC cubeDesc = {};
+    cubeDesc.Width = m_ibl.specularSize;
+    cubeDesc.Height = m_ibl.specularSize;
+    cubeDesc.MipLevels = m_ibl.specularMips;
+    cubeDesc.ArraySize = 6;
+    cubeDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    cubeDesc.SampleDesc.Count = 1;
+    cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+    std::vector<D3D11_SUBRESOURCE_DATA> cubeData;
+    for (uint32_t face = 0; face < 6; face++) {
+        for (uint32_t mip = 0; mip < m_ibl.specularMips; mip++) {
+            UINT size = std::max(1u, m_ibl.specularSize >> mip);
+            cubeData.push_back({ m_ibl.specular.data() + d3d11renderer::ibl_baker::get_specular_offset(m_ibl, face, mip), size * 16, size * size * 16 });
+        }
+    }
+
+    ComPtr<ID3D11Texture2D> cubeTexture;
+    HRESULT hr = device->CreateTexture2D(&cubeDesc, cubeData.data(), cubeTexture.GetAddressOf());
+    if (FAILED(hr) || FAILED(device->CreateShaderResourceView(cubeTexture.Get(), nullptr, m_specularSRV.GetAddressOf()))) {
+        throw std::runtime_error("Failed to create the prefiltered environment.");
+    }
 
-    // Copy the data from the loaded HDR image into the texture
-    deviceContext->UpdateSubresource(
-        m_cubemapTexture.Get(),
-        0, nullptr, image->pixels, image->rowPitch, 0
-    );
+    D3D11_TEXTURE2D_DESC lutDesc = {};
+    lutDesc.Width = m_ibl.lutSize;
+    lutDesc.Height = m_ibl.lutSize;
+    lutDesc.MipLevels = 1;
+    lutDesc.ArraySize = 1;
+    lutDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+    lutDesc.SampleDesc.Count = 1;
+    lutDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    lutDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    D3D11_SUBRESOURCE_DATA lutData = { m_ibl.brdfLut.data(), m_ibl.lutSize * 8, 0 };
+    ComPtr<ID3D11Texture2D> lutTexture;
+    hr = device->CreateTexture2D(&lutDesc, &lutData, lutTexture.GetAddressOf());
+    if (FAILED(hr) || FAILED(device->CreateShaderResourceView(lutTexture.Get(), nullptr, m_brdfLutSRV.GetAddressOf()))) {
+        throw std::runtime_error("Failed to create the BRDF lookup table.");
+    }
+
+    // The GPU has its own copy now
+    m_ibl.specular.clear();
+    m_ibl.specular.shrink_to_fit();
+    m_ibl.brdfLut.clear();
+    m_ibl.brdfLut.shrink_to_fit();
 }
 
-void skybox::CreateShaders(ID3D11Device* device)
+void skybox::CreateShaders(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache)
 {
     D3D11_BUFFER_DESC matrixBufferDesc;
     D3D11_SAMPLER_DESC samplerDesc;
-    D3D11_INPUT_ELEMENT_DESC polygonLayout[2];
-    unsigned int numElements;
-    ComPtr<ID3DBlob> vsBlob;
-    ComPtr<ID3DBlob> psBlob;
-
-    HRESULT hr = D3DCompileFromFile(L"Shaders/skyboxvs.hlsl", nullptr, nullptr, "main", "vs_5_0", 0, 0, vsBlob.GetAddressOf(), nullptr);
-    if (SUCCEEDED(hr)) {
-        hr = device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, m_vertexShader.GetAddressOf());
+    std::vector<uint8_t> vsBlob;
+    std::vector<uint8_t> psBlob;
+    std::string errors;
+
+    HRESULT hr;
+    if (shaderCache.get({ L"Shaders/skyboxvs.hlsl", "main", "vs_5_0", {}, 0 }, vsBlob, errors)) {
+        hr = device->CreateVertexShader(vsBlob.data(), vsBlob.size(), nullptr, m_vertexShader.GetAddressOf());
     }
     else {
-        throw std::runtime_error("Failed to compile vertex shader.");
+        throw std::runtime_error("Failed to compile vertex shader. " + errors);
     }
 
-    hr = D3DCompileFromFile(L"Shaders/skyboxps.hlsl", nullptr, nullptr, "main", "ps_5_0", 0, 0, psBlob.GetAddressOf(), nullptr);
-    if (SUCCEEDED(hr)) {
-        hr = device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, m_pixelShader.GetAddressOf());
+    if (shaderCache.get({ L"Shaders/skyboxps.hlsl", "main", "ps_5_0", {}, 0 }, psBlob, errors)) {
+        hr = device->CreatePixelShader(psBlob.data(), psBlob.size(), nullptr, m_pixelShader.GetAddressOf());
     }
     else {
-        throw std::runtime_error("Failed to compile pixel shader.");
+        throw std::runtime_error("Failed to compile pixel shader. " + errors);
     }
 
-    polygonLayout[0].SemanticName = "POSITION";
-    polygonLayout[0].SemanticIndex = 0;
-    polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-    polygonLayout[0].InputSlot = 0;
-    polygonLayout[0].AlignedByteOffset = 0;
-    polygonLayout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-    polygonLayout[0].InstanceDataStepRate = 0;
-
-    polygonLayout[1].SemanticName = "TEXCOORD";
-    polygonLayout[1].SemanticIndex = 0;
-    polygonLayout[1].Format = DXGI_FORMAT_R32G32_FLOAT;
-    polygonLayout[1].InputSlot = 0;
-    polygonLayout[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-    polygonLayout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-    polygonLayout[1].InstanceDataStepRate = 0;
-
-    // Get a count of the elements in the layout.
-    numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
-
-    // Create the vertex input layout.
-    device->CreateInputLayout(polygonLayout, numElements, vsBlob->GetBufferPointer(),
-        vsBlob->GetBufferSize(), m_layout.GetAddressOf());
-
-
     matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
     matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
     matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
@@ -153,7 +242,7 @@ void skybox::CreateShaders(ID3D11Device* device)
 void skybox::CreateShaderResourceView(ID3D11Device* device)
 {
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    srvDesc.Format = m_format;
     srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D; // Use 2D texture instead of cubemap
     srvDesc.Texture2D.MipLevels = 1;
     srvDesc.Texture2D.MostDetailedMip = 0;
@@ -172,8 +261,9 @@ void skybox::set_shader_parameters(ID3D11DeviceContext* deviceContext, DirectX::
     unsigned int bufferNumber;
 
 
-    viewMatrix = DirectX::XMMatrixTranspose(viewMatrix);
-    projectionMatrix = DirectX::XMMatrixTranspose(projectionMatrix);
+    // Without the translation the sky stays at infinity, and the inverse maps screen points straight to directions
+    viewMatrix.r[3] = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+    DirectX::XMMATRIX inverseViewProjection = DirectX::XMMatrixInverse(nullptr, DirectX::XMMatrixMultiply(viewMatrix, projectionMatrix));
 
     // Lock the constant buffer so it can be written to.
     deviceContext->Map(m_matrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
@@ -181,20 +271,17 @@ void skybox::set_shader_parameters(ID3D11DeviceContext* deviceContext, DirectX::
     // Get a pointer to the data in the constant buffer.
     dataPtr = (MatrixBufferType*)mappedResource.pData;
 
-    dataPtr->view = viewMatrix;
-    dataPtr->projection = projectionMatrix;
+    dataPtr->inverseViewProjection = DirectX::XMMatrixTranspose(inverseViewProjection);
 
     // Unlock the constant buffer.
     deviceContext->Unmap(m_matrixBuffer.Get(), 0);
 
-    // Set the position of the constant buffer in the vertex shader.
+    // Set the position of the constant buffer in the pixel shader.
     bufferNumber = 0;
 
-    // Finanly set the constant buffer in the vertex shader with the updated values.
-    deviceContext->VSSetConstantBuffers(bufferNumber, 1, m_matrixBuffer.GetAddressOf());
+    // Finanly set the constant buffer in the pixel shader with the updated values.
+    deviceContext->PSSetConstantBuffers(bufferNumber, 1, m_matrixBuffer.GetAddressOf());
 
     // Set shader texture resource in the pixel shader.
     deviceContext->PSSetShaderResources(0, 1, m_cubemapSRV.GetAddressOf());
-    ID3D11Buffer* nullBuffer = nullptr;
-    deviceContext->PSSetConstantBuffers(0, 1, &nullBuffer);
 }
@@ -3,7 +3,11 @@
 #include <wrl/client.h>
 #include <DirectXMath.h>
 #include <iostream>
+#include <DirectXTex.h>
 #include "stb_image.h"
+#include "texture_compressor.h"
+#include "ibl_baker.h"
+#include "shader_cache.h"
 
 
 class  skybox
@@ -11,17 +15,24 @@ class  skybox
 private:
 	struct MatrixBufferType
 	{
-		DirectX::XMMATRIX view;
-		DirectX::XMMATRIX projection;
+		DirectX::XMMATRIX inverseViewProjection;
 	};
 
 public:
-	 skybox(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::wstring& hdrFileName);
+	 skybox(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::wstring& hdrFileName, d3d11renderer::shader_cache& shaderCache);
 	~skybox();
-	void render(ID3D11DeviceContext* context, int indexCount, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix);
+	// Full-screen triangle at the far plane; draw after the scene with set_depth(false) so only sky pixels are shaded
+	void render(ID3D11DeviceContext* context, DirectX::XMMATRIX viewMatrix, DirectX::XMMATRIX projectionMatrix);
+	const d3d11renderer::compression_report& get_report() const;
+
+	// Image-based lighting derived from the panorama
+	ID3D11ShaderResourceView* get_specular_srv() const;
+	ID3D11ShaderResourceView* get_brdf_lut_srv() const;
+	const d3d11renderer::ibl_data& get_ibl() const;
 private:
 	void CreateCubemapTexture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::wstring& hdrFileName);
-	void CreateShaders(ID3D11Device* device);
+	void CreateEnvironmentLighting(ID3D11Device* device, const DirectX::ScratchImage& panorama, const std::wstring& hdrFileName);
+	void CreateShaders(ID3D11Device* device, d3d11renderer::shader_cache& shaderCache);
 	void CreateShaderResourceView(ID3D11Device* device);
 	void set_shader_parameters(ID3D11DeviceContext* deviceContext, DirectX::XMMATRIX viewMatrix,
 		DirectX::XMMATRIX projectionMatrix);
@@ -31,9 +42,15 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_cubemapSRV;
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixelShader;
-	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_layout;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_matrixBuffer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_sampleState;
 
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_specularSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_brdfLutSRV;
+	d3d11renderer::ibl_data m_ibl;  // Only the irradiance and sizes are kept once the textures exist
+
+	DXGI_FORMAT m_format;
+	d3d11renderer::compression_report m_report;
+
 	int m_width, m_height;
 };
\ No newline at end of file
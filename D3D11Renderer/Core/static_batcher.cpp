@@ -0,0 +1,138 @@
+#include "static_batcher.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace d3d11renderer;
+
+d3d11renderer::static_batcher::static_batcher(const batch_settings& settings)
+	: m_settings(settings), m_stats()
+{
+}
+
+void d3d11renderer::static_batcher::build(const std::vector<batch_input>& subMeshes)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	m_batches.clear();
+	m_stats = batch_stats();
+	m_stats.drawsBefore = subMeshes.size();
+
+	// Mergeable submeshes grouped by material, everything else on its own
+	std::vector<uint32_t> members;
+	for (uint32_t i = 0; i < subMeshes.size(); i++)
+	{
+		if (subMeshes[i].mergeable)
+		{
+			members.push_back(i);
+		}
+		else
+		{
+			m_batches.push_back(make_batch(subMeshes, &i, 1));
+		}
+	}
+	std::stable_sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+		return subMeshes[a].material < subMeshes[b].material;
+	});
+
+	for (size_t begin = 0; begin < members.size();)
+	{
+		size_t end = begin;
+		while (end < members.size() && subMeshes[members[end]].material == subMeshes[members[begin]].material)
+		{
+			end++;
+		}
+		split(subMeshes, members, begin, end);
+		begin = end;
+	}
+
+	m_stats.drawsAfter = m_batches.size();
+	for (const auto& batch : m_batches)
+	{
+		m_stats.mergedSubMeshes += batch.members.size() > 1 ? batch.members.size() : 0;
+	}
+	m_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const std::vector<static_batch>& d3d11renderer::static_batcher::get_batches() const
+{
+	return m_batches;
+}
+
+const batch_stats& d3d11renderer::static_batcher::get_stats() const
+{
+	return m_stats;
+}
+
+void d3d11renderer::static_batcher::split(const std::vector<batch_input>& subMeshes, std::vector<uint32_t>& members, size_t begin, size_t end)
+{
+	static_batch batch = make_batch(subMeshes, members.data() + begin, end - begin);
+	if (end - begin == 1 || (batch.radius <= m_settings.maxRadius && batch.indexCount <= m_settings.maxIndices))
+	{
+		m_batches.push_back(std::move(batch));
+		return;
+	}
+
+	// Halve along the axis the centers spread furthest on
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = begin; i < end; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], subMeshes[members[i]].center[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], subMeshes[members[i]].center[axis]);
+		}
+	}
+	int axis = 0;
+	for (int candidate = 1; candidate < 3; candidate++)
+	{
+		if (boundsMax[candidate] - boundsMin[candidate] > boundsMax[axis] - boundsMin[axis])
+		{
+			axis = candidate;
+		}
+	}
+
+	size_t middle = begin + (end - begin) / 2;
+	std::nth_element(members.begin() + begin, members.begin() + middle, members.begin() + end, [&](uint32_t a, uint32_t b) {
+		return subMeshes[a].center[axis] < subMeshes[b].center[axis];
+	});
+	split(subMeshes, members, begin, middle);
+	split(subMeshes, members, middle, end);
+}
+
+static_batch d3d11renderer::static_batcher::make_batch(const std::vector<batch_input>& subMeshes, const uint32_t* members, size_t count) const
+{
+	static_batch batch;
+	batch.members.assign(members, members + count);
+	batch.material = subMeshes[members[0]].material;
+	batch.indexCount = 0;
+
+	// Sphere around the box of the member spheres
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < count; i++)
+	{
+		const batch_input& input = subMeshes[members[i]];
+		batch.indexCount += input.indexCount;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], input.center[axis] - input.radius);
+			boundsMax[axis] = std::max(boundsMax[axis], input.center[axis] + input.radius);
+		}
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		batch.center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+	}
+
+	batch.radius = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		const batch_input& input = subMeshes[members[i]];
+		float dx = input.center[0] - batch.center[0], dy = input.center[1] - batch.center[1], dz = input.center[2] - batch.center[2];
+		batch.radius = std::max(batch.radius, std::sqrt(dx * dx + dy * dy + dz * dz) + input.radius);
+	}
+
+	return batch;
+}
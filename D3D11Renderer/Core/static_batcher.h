@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	struct batch_settings
+	{
+		bool enabled = false;
+		float maxRadius = 10.0f;       // Bounding sphere a batch may reach before it is split, so it can still be culled
+		uint32_t maxIndices = 300000;  // And its index count
+	};
+
+	// One submesh as the batcher sees it
+	struct batch_input
+	{
+		uint32_t material;
+		uint32_t indexCount;
+		float center[3];
+		float radius;
+		bool mergeable;  // Static and placed once; the rest always stay on their own
+	};
+
+	struct static_batch
+	{
+		std::vector<uint32_t> members;  // Input indices
+		uint32_t material;
+		uint32_t indexCount;
+		float center[3];
+		float radius;
+	};
+
+	struct batch_stats
+	{
+		size_t drawsBefore = 0;
+		size_t drawsAfter = 0;
+		size_t mergedSubMeshes = 0;  // Inputs that ended up in a batch with others
+		double milliseconds = 0.0;
+	};
+
+	// Merges mergeable submeshes that share a material into batches that can be drawn as one index range.
+	// Each material's submeshes start as one batch, which is split in half along the longest axis of its members'
+	// centers until it fits the radius and index limits. Nothing here touches the GPU; the caller lays out the
+	// indices of each batch contiguously.
+	class static_batcher
+	{
+	public:
+		static_batcher(const batch_settings& settings);
+
+		void build(const std::vector<batch_input>& subMeshes);
+
+		// Every input is in exactly one batch; single submeshes get a batch of their own
+		const std::vector<static_batch>& get_batches() const;
+		const batch_stats& get_stats() const;
+
+	private:
+		void split(const std::vector<batch_input>& subMeshes, std::vector<uint32_t>& members, size_t begin, size_t end);
+		static_batch make_batch(const std::vector<batch_input>& subMeshes, const uint32_t* members, size_t count) const;
+
+	private:
+		batch_settings m_settings;
+		std::vector<static_batch> m_batches;
+		batch_stats m_stats;
+	};
+}
@@ -1,10 +1,25 @@
 #include "texture.h"
 #include <d3d11.h>
 #include <stdexcept>
+#include <format>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <bit>
 
-texture::texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename)
+// Lowest top-mip PSNR (dB) at which an opaque color texture is allowed to drop from BC7 to BC1
+constexpr float MIN_BC1_PSNR = 36.0f;
+// Part of every cooked file's key; bump it when the encoders or mip filters change their output
+constexpr uint32_t COOK_VERSION = 1;
+
+texture::texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename, usage textureUsage, float alphaCutoff,
+    d3d11renderer::compression_quality quality)
+    : m_metadata(), m_allocatedMip(0), m_residentMip(0), m_streamId(0), m_loadMilliseconds(0.0f)
 {
-    auto result = initialize(device, deviceContext, filename);
+    auto result = initialize(device, deviceContext, filename, textureUsage, alphaCutoff, quality);
     if (!result) {
         throw std::runtime_error("Failed to initialize texture");
     }
@@ -22,17 +37,404 @@ ID3D11ShaderResourceView* texture::get_texture()
         return nullptr;
 }
 
-bool texture::initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename)
+const d3d11renderer::compression_report& texture::get_report() const
+{
+    return m_report;
+}
+
+bool texture::initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename, usage textureUsage, float alphaCutoff,
+    d3d11renderer::compression_quality quality)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::wstring cookedPath = std::wstring(filename) + L".dds";
+    uint64_t cookKey = get_cook_key(textureUsage, alphaCutoff, quality);
+
+    // The cooked file is used as long as it is newer than its source and was cooked with the same settings;
+    // otherwise cook it again.
+    if (!load_cooked(cookedPath.c_str(), filename, cookKey))
+    {
+        if (!cook(filename, textureUsage, alphaCutoff, quality))
+        {
+            return false;
+        }
+
+        // A failed write only means the next run cooks again
+        if (!d3d11renderer::dds_file::save(cookedPath.c_str(), m_mipData, cookKey))
+        {
+            OutputDebugStringA("texture: failed to write the cooked file\n");
+        }
+    }
+
+    // Start with the mips that are always resident; the streamer brings in the rest
+    uint32_t baseMip = d3d11renderer::texture_streamer::get_base_mip(get_stream_desc());
+    std::vector<D3D11_SUBRESOURCE_DATA> initialData;
+    for (size_t mip = baseMip; mip < m_mips.size(); mip++)
+    {
+        initialData.push_back({ m_mips[mip].pixels, static_cast<UINT>(m_mips[mip].rowPitch), static_cast<UINT>(m_mips[mip].slicePitch) });
+    }
+
+    if (!create_resource(device, baseMip, initialData.data()))
+    {
+        return false;
+    }
+
+    m_residentMip = baseMip;
+
+    auto end = std::chrono::steady_clock::now();
+    m_loadMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+    OutputDebugStringA(std::format("texture: {} KB {}, {:.1f} ms\n", m_report.compressedBytes / 1024,
+        m_cooked.get_images().empty() ? "cooked" : "mapped", m_loadMilliseconds).c_str());
+
+    return true;
+}
+
+float texture::get_load_milliseconds() const
+{
+    return m_loadMilliseconds;
+}
+
+d3d11renderer::array_texture_desc texture::get_array_desc() const
+{
+    d3d11renderer::array_texture_desc desc;
+    desc.width = static_cast<uint32_t>(m_metadata.width);
+    desc.height = static_cast<uint32_t>(m_metadata.height);
+    desc.mipLevels = static_cast<uint32_t>(m_metadata.mipLevels);
+    desc.format = static_cast<uint32_t>(m_metadata.format);
+    return desc;
+}
+
+bool texture::load_cooked(const wchar_t* cookedPath, const wchar_t* sourcePath, uint64_t cookKey)
+{
+    std::error_code error;
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, error);
+    if (error)
+    {
+        return false;
+    }
+
+    auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    if (!error && sourceTime > cookedTime)
+    {
+        return false;
+    }
+
+    if (!m_cooked.open(cookedPath, cookKey))
+    {
+        return false;
+    }
+
+    m_metadata = m_cooked.get_metadata();
+    m_mips = m_cooked.get_images();
+
+    // Quality was measured when the file was cooked; only the sizes are known here
+    m_report = {};
+    m_report.format = m_metadata.format;
+    for (const DirectX::Image& image : m_mips)
+    {
+        m_report.sourceBytes += image.width * image.height * 4;
+        m_report.compressedBytes += image.slicePitch;
+    }
+
+    return true;
+}
+
+bool texture::cook(const wchar_t* filename, usage textureUsage, float alphaCutoff, d3d11renderer::compression_quality quality)
 {
     HRESULT result;
+    DirectX::ScratchImage image;
+    DirectX::ScratchImage rgba;
+    DirectX::ScratchImage mipChain;
+    DirectX::ScratchImage compressed;
 
-    result = DirectX::CreateWICTextureFromFile(device, deviceContext, filename, m_texture.GetAddressOf(), m_textureView.GetAddressOf());
+    // Decode on the CPU; the shaders do their own gamma conversion so keep the data as plain UNORM.
+    result = DirectX::LoadFromWICFile(filename, DirectX::WIC_FLAGS_IGNORE_SRGB, nullptr, image);
     if (FAILED(result))
     {
         return false;
     }
 
-    deviceContext->GenerateMips(m_textureView.Get());
+    if (!to_rgba8(image, rgba))
+    {
+        return false;
+    }
+
+    // Block-compressed formats can't be render targets, so the mip chain has to be built before encoding.
+    if (!d3d11renderer::mip_generator::generate(*rgba.GetImage(0, 0, 0), get_mip_settings(textureUsage, alphaCutoff), mipChain))
+    {
+        return false;
+    }
+
+    const DirectX::ScratchImage* upload = &mipChain;
+
+    m_report = {};
+    m_report.format = mipChain.GetMetadata().format;
+    m_report.sourceBytes = mipChain.GetPixelsSize();
+    m_report.compressedBytes = m_report.sourceBytes;
+
+    if (d3d11renderer::texture_compressor::is_block_compressible(mipChain.GetMetadata()))
+    {
+        if (compress(mipChain, textureUsage, quality, compressed))
+        {
+            upload = &compressed;
+        }
+    }
+
+    OutputDebugStringA(std::format("texture: {} -> {} KB, {:.2f} dB, {:.1f} ms\n",
+        m_report.sourceBytes / 1024, m_report.compressedBytes / 1024, m_report.psnr, m_report.milliseconds).c_str());
+
+    m_mipData = std::move(upload == &compressed ? compressed : mipChain);
+    m_metadata = m_mipData.GetMetadata();
+    m_mips.assign(m_mipData.GetImages(), m_mipData.GetImages() + m_mipData.GetImageCount());
+
+    return true;
+}
+
+d3d11renderer::streamed_texture_desc texture::get_stream_desc() const
+{
+    const DirectX::TexMetadata& metadata = m_metadata;
+
+    d3d11renderer::streamed_texture_desc desc;
+    desc.width = static_cast<uint32_t>(metadata.width);
+    desc.height = static_cast<uint32_t>(metadata.height);
+    for (size_t mip = 0; mip < metadata.mipLevels; mip++)
+    {
+        desc.mipBytes.push_back(m_mips[mip].slicePitch);
+    }
+
+    // Block-compressed resources need a top level that is a whole number of blocks
+    desc.coarsestTopMip = static_cast<uint32_t>(metadata.mipLevels - 1);
+    if (DirectX::IsCompressed(metadata.format))
+    {
+        desc.coarsestTopMip = 0;
+        while (desc.coarsestTopMip + 1 < metadata.mipLevels &&
+            ((metadata.width >> (desc.coarsestTopMip + 1)) % 4) == 0 && (metadata.width >> (desc.coarsestTopMip + 1)) > 0 &&
+            ((metadata.height >> (desc.coarsestTopMip + 1)) % 4) == 0 && (metadata.height >> (desc.coarsestTopMip + 1)) > 0)
+        {
+            desc.coarsestTopMip++;
+        }
+    }
+
+    return desc;
+}
+
+bool texture::apply_streaming(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const d3d11renderer::streaming_change& change)
+{
+    if (change.reallocate)
+    {
+        Microsoft::WRL::ComPtr<ID3D11Resource> previous = m_texture;
+        uint32_t previousMip = m_allocatedMip;
+
+        if (!create_resource(device, change.allocatedMip, nullptr))
+        {
+            return false;
+        }
+
+        // Carry over the resident mips the new resource still covers
+        for (uint32_t mip = std::max(m_residentMip, change.allocatedMip); mip < m_mips.size(); mip++)
+        {
+            deviceContext->CopySubresourceRegion(m_texture.Get(), mip - change.allocatedMip, 0, 0, 0, previous.Get(), mip - previousMip, nullptr);
+        }
+    }
+
+    for (uint32_t mip = change.residentMip; mip < change.uploadEnd; mip++)
+    {
+        // Straight from the mapped file when the texture was cooked
+        const DirectX::Image& image = m_mips[mip];
+        deviceContext->UpdateSubresource(m_texture.Get(), mip - m_allocatedMip, nullptr, image.pixels,
+            static_cast<UINT>(image.rowPitch), static_cast<UINT>(image.slicePitch));
+    }
+
+    // Mips above the resident one are allocated but may not have data yet
+    m_residentMip = change.residentMip;
+    deviceContext->SetResourceMinLOD(m_texture.Get(), static_cast<float>(m_residentMip - m_allocatedMip));
+
+    return true;
+}
+
+void texture::set_stream_id(size_t streamId)
+{
+    m_streamId = streamId;
+}
+
+size_t texture::get_stream_id() const
+{
+    return m_streamId;
+}
+
+bool texture::create_resource(ID3D11Device* device, uint32_t allocatedMip, const D3D11_SUBRESOURCE_DATA* initialData)
+{
+    const DirectX::TexMetadata& metadata = m_metadata;
+
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = static_cast<UINT>(std::max<size_t>(1, metadata.width >> allocatedMip));
+    textureDesc.Height = static_cast<UINT>(std::max<size_t>(1, metadata.height >> allocatedMip));
+    textureDesc.MipLevels = static_cast<UINT>(metadata.mipLevels - allocatedMip);
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = metadata.format;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> resource;
+    HRESULT result = device->CreateTexture2D(&textureDesc, initialData, resource.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+    result = device->CreateShaderResourceView(resource.Get(), nullptr, view.GetAddressOf());
+    if (FAILED(result))
+    {
+        return false;
+    }
+
+    m_texture = resource;
+    m_textureView = view;
+    m_allocatedMip = allocatedMip;
+
+    return true;
+}
+
+DXGI_FORMAT texture::get_compressed_format(usage textureUsage)
+{
+    switch (textureUsage)
+    {
+    case usage::Normal:
+        return DXGI_FORMAT_BC5_UNORM;
+    case usage::Mask:
+        return DXGI_FORMAT_BC4_UNORM;
+    case usage::Hdr:
+        return DXGI_FORMAT_BC6H_UF16;
+    case usage::Color:
+    case usage::Packed:
+    default:
+        return DXGI_FORMAT_BC7_UNORM;
+    }
+}
+
+d3d11renderer::mip_settings texture::get_mip_settings(usage textureUsage, float alphaCutoff)
+{
+    d3d11renderer::mip_settings settings;
+
+    switch (textureUsage)
+    {
+    case usage::Color:
+    case usage::Hdr:
+        // Both are decoded with pow(x, 2.2) in the shaders
+        settings.gammaSpace = true;
+        settings.alphaCutoff = alphaCutoff;
+        break;
+    case usage::Normal:
+        settings.gammaSpace = false;
+        settings.normalMap = true;
+        break;
+    case usage::Mask:
+    case usage::Packed:
+    default:
+        settings.gammaSpace = false;
+        break;
+    }
+
+    return settings;
+}
+
+uint64_t texture::get_cook_key(usage textureUsage, float alphaCutoff, d3d11renderer::compression_quality quality)
+{
+    // FNV-1a over the version and everything that decides the cooked bytes: usage, format choice, encoder quality
+    // and mip settings
+    d3d11renderer::mip_settings mipSettings = get_mip_settings(textureUsage, alphaCutoff);
+    const uint32_t parameters[] = { COOK_VERSION, static_cast<uint32_t>(textureUsage), static_cast<uint32_t>(get_compressed_format(textureUsage)),
+        static_cast<uint32_t>(quality),
+        std::bit_cast<uint32_t>(MIN_BC1_PSNR), static_cast<uint32_t>(mipSettings.filter), mipSettings.gammaSpace, mipSettings.normalMap,
+        std::bit_cast<uint32_t>(mipSettings.alphaCutoff) };
+
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(parameters);
+    for (size_t i = 0; i < sizeof(parameters); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool texture::compress(const DirectX::ScratchImage& mipChain, usage textureUsage, d3d11renderer::compression_quality quality,
+    DirectX::ScratchImage& compressed)
+{
+    // Opaque color maps try BC1 first and keep it if the error stays under the threshold
+    if (textureUsage == usage::Color && mipChain.IsAlphaAllOpaque())
+    {
+        if (d3d11renderer::texture_compressor::compress(mipChain, DXGI_FORMAT_BC1_UNORM, quality, compressed, &m_report) &&
+            m_report.psnr >= MIN_BC1_PSNR)
+        {
+            return true;
+        }
+    }
+
+    // A "mask" that actually carries color (a packed ORM map, say) can't lose its other channels
+    if (textureUsage == usage::Mask && !is_single_channel(*mipChain.GetImage(0, 0, 0)))
+    {
+        textureUsage = usage::Packed;
+    }
+
+    return d3d11renderer::texture_compressor::compress(mipChain, get_compressed_format(textureUsage), quality, compressed, &m_report);
+}
+
+bool texture::to_rgba8(const DirectX::ScratchImage& image, DirectX::ScratchImage& converted)
+{
+    const DirectX::Image* source = image.GetImage(0, 0, 0);
+
+    // Convert() expands R8 to (r, 0, 0, 1); masks are easier to handle as grayscale RGB.
+    if (source->format == DXGI_FORMAT_R8_UNORM || source->format == DXGI_FORMAT_A8_UNORM)
+    {
+        HRESULT result = converted.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, source->width, source->height, 1, 1);
+        if (FAILED(result))
+        {
+            return false;
+        }
+
+        const DirectX::Image* destination = converted.GetImage(0, 0, 0);
+        bool alphaOnly = source->format == DXGI_FORMAT_A8_UNORM;
+        for (size_t y = 0; y < source->height; y++)
+        {
+            const uint8_t* in = source->pixels + y * source->rowPitch;
+            uint8_t* out = destination->pixels + y * destination->rowPitch;
+            for (size_t x = 0; x < source->width; x++, out += 4)
+            {
+                out[0] = out[1] = out[2] = alphaOnly ? 255 : in[x];
+                out[3] = alphaOnly ? in[x] : 255;
+            }
+        }
+
+        return true;
+    }
+
+    if (source->format == DXGI_FORMAT_R8G8B8A8_UNORM)
+    {
+        return SUCCEEDED(converted.InitializeFromImage(*source));
+    }
+
+    HRESULT result = DirectX::Convert(*source, DXGI_FORMAT_R8G8B8A8_UNORM, DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, converted);
+    return SUCCEEDED(result);
+}
+
+bool texture::is_single_channel(const DirectX::Image& image)
+{
+    if (image.format != DXGI_FORMAT_R8G8B8A8_UNORM)
+        return false;
+
+    // Grayscale stored as RGB; allow a little slack for JPEG chroma noise
+    for (size_t y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = image.pixels + y * image.rowPitch;
+        for (size_t x = 0; x < image.width; x++, row += 4)
+        {
+            if (std::abs(row[0] - row[1]) > 2 || std::abs(row[0] - row[2]) > 2)
+                return false;
+        }
+    }
 
     return true;
 }
@@ -6,17 +6,70 @@
 
 #include <WICTextureLoader.h>
 #include <DDSTextureLoader.h>
+#include <DirectXTex.h>
 
+#include "texture_compressor.h"
+#include "mip_generator.h"
+#include "texture_streamer.h"
+#include "dds_file.h"
+#include "texture_array_planner.h"
+
+// Source images are cooked once into "<source>.dds" holding the compressed mip chain; later runs map
+// that file and upload from it directly, unless its cook key shows other settings made it. The GPU resource
+// holds only the base mips until a texture_streamer asks for more through apply_streaming.
 class texture
 {
 public:
-	texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename);
+	// What the texture is sampled for; picks the block-compressed format.
+	enum class usage
+	{
+		Color,   // BC1 when opaque and close enough to the source, BC7 otherwise
+		Packed,  // Several unrelated channels such as metal-roughness, BC7
+		Normal,  // Tangent-space XY in BC5, Z is rebuilt in the shader
+		Mask,    // Single channel such as AO, BC4 (BC7 if the image isn't grayscale)
+		Hdr      // BC6H
+	};
+
+	// alphaCutoff is the material's alpha-test threshold; mips keep the top level's coverage when it is set.
+	// quality trades cook time for a wider BC6H/BC7 search; it is part of the cook key, so changing it re-cooks.
+	texture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename, usage textureUsage = usage::Color, float alphaCutoff = 0.0f,
+		d3d11renderer::compression_quality quality = d3d11renderer::compression_quality::Fast);
 	~texture();
 
 
 	ID3D11ShaderResourceView* get_texture();
-	bool initialize(ID3D11Device*, ID3D11DeviceContext*, const wchar_t* filename);
+	const d3d11renderer::compression_report& get_report() const;
+	float get_load_milliseconds() const;
+	bool initialize(ID3D11Device*, ID3D11DeviceContext*, const wchar_t* filename, usage textureUsage, float alphaCutoff, d3d11renderer::compression_quality quality);
+
+	d3d11renderer::streamed_texture_desc get_stream_desc() const;
+	bool apply_streaming(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const d3d11renderer::streaming_change& change);
+	void set_stream_id(size_t streamId);
+	size_t get_stream_id() const;
+	// Size and format, for planning texture arrays
+	d3d11renderer::array_texture_desc get_array_desc() const;
+
+	static DXGI_FORMAT get_compressed_format(usage textureUsage);
+	static d3d11renderer::mip_settings get_mip_settings(usage textureUsage, float alphaCutoff);
+private:
+	bool load_cooked(const wchar_t* cookedPath, const wchar_t* sourcePath, uint64_t cookKey);
+	bool cook(const wchar_t* filename, usage textureUsage, float alphaCutoff, d3d11renderer::compression_quality quality);
+	bool create_resource(ID3D11Device* device, uint32_t allocatedMip, const D3D11_SUBRESOURCE_DATA* initialData);
+	bool compress(const DirectX::ScratchImage& mipChain, usage textureUsage, d3d11renderer::compression_quality quality, DirectX::ScratchImage& compressed);
+	// Changes whenever the settings or encoders would cook different bytes
+	static uint64_t get_cook_key(usage textureUsage, float alphaCutoff, d3d11renderer::compression_quality quality);
+	static bool to_rgba8(const DirectX::ScratchImage& image, DirectX::ScratchImage& converted);
+	static bool is_single_channel(const DirectX::Image& image);
 private:
 	Microsoft::WRL::ComPtr<ID3D11Resource> m_texture;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_textureView;
+	d3d11renderer::compression_report m_report;
+	DirectX::ScratchImage m_mipData;       // Owns the mips when they were cooked this run
+	d3d11renderer::dds_file m_cooked;      // Owns them when they come from a cooked file
+	DirectX::TexMetadata m_metadata;
+	std::vector<DirectX::Image> m_mips;
+	uint32_t m_allocatedMip;
+	uint32_t m_residentMip;
+	size_t m_streamId;
+	float m_loadMilliseconds;
 };
@@ -0,0 +1,109 @@
+#include "texture_array_planner.h"
+
+#include <chrono>
+#include <map>
+#include <tuple>
+
+using namespace d3d11renderer;
+
+d3d11renderer::texture_array_planner::texture_array_planner()
+	: m_report()
+{
+}
+
+void d3d11renderer::texture_array_planner::plan(const std::vector<array_texture_desc>& textures, const std::vector<array_material_desc>& materials,
+	const std::vector<uint16_t>& drawMaterials)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	m_arrays.clear();
+	m_slices.assign(textures.size(), { NO_ARRAY, 0 });
+	m_materialBindings.assign(materials.size(), 0);
+	m_report = array_packing_report();
+
+	// Every texture goes into the open array with its description, and opens a new one when there is none or it is full
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>, uint32_t> openArrays;
+	for (uint32_t i = 0; i < textures.size(); i++)
+	{
+		const array_texture_desc& desc = textures[i];
+		auto key = std::make_tuple(desc.format, desc.width, desc.height, desc.mipLevels);
+		auto found = openArrays.find(key);
+		if (found == openArrays.end() || m_arrays[found->second].textures.size() == MAX_SLICES)
+		{
+			openArrays[key] = static_cast<uint32_t>(m_arrays.size());
+			m_arrays.push_back({ desc, {} });
+			found = openArrays.find(key);
+		}
+
+		texture_array& target = m_arrays[found->second];
+		m_slices[i] = { found->second, static_cast<uint32_t>(target.textures.size()) };
+		target.textures.push_back(i);
+	}
+
+	// A material binds one array per slot; its binding is that list plus the permutation
+	std::map<std::vector<uint32_t>, uint32_t> bindings;
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		std::vector<uint32_t> key(array_material_desc::MAX_SLOTS + 1);
+		for (uint32_t slot = 0; slot < array_material_desc::MAX_SLOTS; slot++)
+		{
+			int32_t textureIndex = materials[i].textures[slot];
+			key[slot] = textureIndex == array_material_desc::NO_TEXTURE ? NO_ARRAY : m_slices[textureIndex].array;
+		}
+		key[array_material_desc::MAX_SLOTS] = materials[i].features;
+
+		auto inserted = bindings.emplace(key, static_cast<uint32_t>(bindings.size()));
+		m_materialBindings[i] = inserted.first->second;
+	}
+
+	// Draws merge while the material, or with arrays the binding, stays the same
+	std::vector<bool> bindingUsed(bindings.size(), false);
+	for (size_t i = 0; i < drawMaterials.size(); i++)
+	{
+		uint32_t binding = m_materialBindings[drawMaterials[i]];
+		if (i == 0 || drawMaterials[i] != drawMaterials[i - 1])
+		{
+			m_report.materialRuns++;
+		}
+		if (i == 0 || binding != m_materialBindings[drawMaterials[i - 1]])
+		{
+			m_report.mergedDraws++;
+		}
+		if (!bindingUsed[binding])
+		{
+			bindingUsed[binding] = true;
+			m_report.sortedMergedDraws++;
+		}
+	}
+
+	m_report.textureCount = textures.size();
+	m_report.arrayCount = m_arrays.size();
+	for (const auto& array : m_arrays)
+	{
+		m_report.singleSliceArrays += array.textures.size() == 1 ? 1 : 0;
+	}
+	m_report.materialCount = materials.size();
+	m_report.bindingCount = bindings.size();
+	m_report.draws = drawMaterials.size();
+	m_report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const std::vector<texture_array>& d3d11renderer::texture_array_planner::get_arrays() const
+{
+	return m_arrays;
+}
+
+const std::vector<texture_slice>& d3d11renderer::texture_array_planner::get_slices() const
+{
+	return m_slices;
+}
+
+const std::vector<uint32_t>& d3d11renderer::texture_array_planner::get_material_bindings() const
+{
+	return m_materialBindings;
+}
+
+const array_packing_report& d3d11renderer::texture_array_planner::get_report() const
+{
+	return m_report;
+}
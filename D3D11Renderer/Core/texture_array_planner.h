@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	// What decides whether two textures can be slices of one Texture2DArray
+	struct array_texture_desc
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		uint32_t format = 0;  // DXGI_FORMAT
+	};
+
+	struct array_material_desc
+	{
+		static constexpr uint32_t MAX_SLOTS = 8;
+		static constexpr int32_t NO_TEXTURE = -1;
+
+		int32_t textures[MAX_SLOTS];  // Index into the planned textures for each slot, or NO_TEXTURE
+		uint32_t features;            // Shader permutation; materials only merge within one
+	};
+
+	struct texture_array
+	{
+		array_texture_desc desc;
+		std::vector<uint32_t> textures;  // In slice order
+	};
+
+	// Where a texture ends up
+	struct texture_slice
+	{
+		uint32_t array;
+		uint32_t slice;
+	};
+
+	struct array_packing_report
+	{
+		size_t textureCount = 0;
+		size_t arrayCount = 0;
+		size_t singleSliceArrays = 0;  // Textures nothing else matched
+		size_t materialCount = 0;
+		size_t bindingCount = 0;       // Distinct sets of arrays and permutation across the materials
+		size_t draws = 0;              // One per submesh
+		size_t materialRuns = 0;       // Runs of consecutive draws with one material, what is bound today
+		size_t mergedDraws = 0;        // Runs of consecutive draws with one binding, in the same order
+		size_t sortedMergedDraws = 0;  // The same with draws reordered by binding
+		double milliseconds = 0.0;
+	};
+
+	// Groups textures with the same size, mip count and format into texture arrays, so materials that differ only in
+	// which textures they use bind the same arrays and tell their draws apart by slice index. Consecutive draws whose
+	// materials share every array and the shader permutation could then go out as one draw, with the slices as
+	// per-draw data. Nothing here touches the GPU; the report says how many draws that would save.
+	class texture_array_planner
+	{
+	public:
+		static constexpr uint32_t MAX_SLICES = 2048;  // D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+		static constexpr uint32_t NO_ARRAY = UINT32_MAX;
+
+		texture_array_planner();
+
+		// drawMaterials is the material of every draw in submission order
+		void plan(const std::vector<array_texture_desc>& textures, const std::vector<array_material_desc>& materials,
+			const std::vector<uint16_t>& drawMaterials);
+
+		const std::vector<texture_array>& get_arrays() const;
+		// Array and slice of each planned texture
+		const std::vector<texture_slice>& get_slices() const;
+		// Materials with the same binding bind the same arrays and permutation
+		const std::vector<uint32_t>& get_material_bindings() const;
+		const array_packing_report& get_report() const;
+
+	private:
+		std::vector<texture_array> m_arrays;
+		std::vector<texture_slice> m_slices;
+		std::vector<uint32_t> m_materialBindings;
+		array_packing_report m_report;
+	};
+}
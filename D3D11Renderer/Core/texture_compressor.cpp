@@ -0,0 +1,246 @@
+#include "texture_compressor.h"
+#include "bc_encoder.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// Block rows handed to a worker at once; 16 block rows are 64 pixel rows.
+constexpr size_t BLOCK_ROWS_PER_JOB = 16;
+
+bool d3d11renderer::texture_compressor::compress(const ScratchImage& source, DXGI_FORMAT format, compression_quality quality,
+	ScratchImage& compressed, compression_report* report)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	TexMetadata metadata = source.GetMetadata();
+	metadata.format = format;
+
+	HRESULT result = compressed.Initialize(metadata);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	if (compressed.GetImageCount() != source.GetImageCount())
+	{
+		return false;
+	}
+
+	if (is_fast_format(format))
+	{
+		// The fast path reads RGBA8 only.
+		const ScratchImage* input = &source;
+		ScratchImage converted;
+		if (source.GetMetadata().format != DXGI_FORMAT_R8G8B8A8_UNORM)
+		{
+			result = Convert(source.GetImages(), source.GetImageCount(), source.GetMetadata(), DXGI_FORMAT_R8G8B8A8_UNORM,
+				TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, converted);
+			if (FAILED(result))
+			{
+				return false;
+			}
+			input = &converted;
+		}
+
+		for (size_t i = 0; i < input->GetImageCount(); i++)
+		{
+			compress_image_fast(input->GetImages()[i], compressed.GetImages()[i]);
+		}
+	}
+	else
+	{
+		TEX_COMPRESS_FLAGS flags = get_compress_flags(format, quality);
+
+		for (size_t i = 0; i < source.GetImageCount(); i++)
+		{
+			if (!compress_image(source.GetImages()[i], compressed.GetImages()[i], flags))
+			{
+				return false;
+			}
+		}
+	}
+
+	if (report)
+	{
+		auto end = std::chrono::steady_clock::now();
+
+		report->format = format;
+		report->sourceBytes = source.GetPixelsSize();
+		report->compressedBytes = compressed.GetPixelsSize();
+		report->milliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+		report->psnr = compute_psnr(*source.GetImage(0, 0, 0), *compressed.GetImage(0, 0, 0), get_compared_channels(format));
+	}
+
+	return true;
+}
+
+float d3d11renderer::texture_compressor::compute_psnr(const Image& source, const Image& compressed, CMSE_FLAGS flags)
+{
+	float mse = 0.0f;
+
+	// ComputeMSE decodes block-compressed images internally and sums the error of every compared channel.
+	HRESULT result = ComputeMSE(source, compressed, mse, nullptr, flags);
+	if (FAILED(result))
+	{
+		return 0.0f;
+	}
+
+	int channelCount = 4;
+	for (CMSE_FLAGS ignored : { CMSE_IGNORE_RED, CMSE_IGNORE_GREEN, CMSE_IGNORE_BLUE, CMSE_IGNORE_ALPHA })
+	{
+		if (flags & ignored)
+			channelCount--;
+	}
+
+	mse /= static_cast<float>(channelCount);
+	if (mse <= 0.0f)
+	{
+		return INFINITY;
+	}
+
+	return 10.0f * std::log10(1.0f / mse);
+}
+
+bool d3d11renderer::texture_compressor::is_block_compressible(const TexMetadata& metadata)
+{
+	// D3D11 requires the top level of a block-compressed texture to be a multiple of the block size.
+	return metadata.dimension == TEX_DIMENSION_TEXTURE2D && (metadata.width % 4) == 0 && (metadata.height % 4) == 0;
+}
+
+bool d3d11renderer::texture_compressor::is_fast_format(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC4_UNORM || format == DXGI_FORMAT_BC5_UNORM;
+}
+
+CMSE_FLAGS d3d11renderer::texture_compressor::get_compared_channels(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+		return CMSE_IGNORE_ALPHA;
+	case DXGI_FORMAT_BC4_UNORM:
+		return CMSE_IGNORE_GREEN | CMSE_IGNORE_BLUE | CMSE_IGNORE_ALPHA;
+	case DXGI_FORMAT_BC5_UNORM:
+		return CMSE_IGNORE_BLUE | CMSE_IGNORE_ALPHA;
+	default:
+		return CMSE_DEFAULT;
+	}
+}
+
+TEX_COMPRESS_FLAGS d3d11renderer::texture_compressor::get_compress_flags(DXGI_FORMAT format, compression_quality quality)
+{
+	TEX_COMPRESS_FLAGS flags = TEX_COMPRESS_DEFAULT;
+
+	switch (format)
+	{
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		// Fast only tries mode 6, normal skips the 3-subset modes, slow searches every mode.
+		if (quality == compression_quality::Fast)
+			flags = TEX_COMPRESS_BC7_QUICK;
+		else if (quality == compression_quality::Slow)
+			flags = TEX_COMPRESS_BC7_USE_3SUBSETS;
+		break;
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+		// The BC6H codec has a single search mode; uniform weighting is cheaper to evaluate.
+		if (quality == compression_quality::Fast)
+			flags = TEX_COMPRESS_UNIFORM;
+		break;
+	default:
+		if (quality != compression_quality::Fast)
+			flags = TEX_COMPRESS_DITHER;
+		break;
+	}
+
+	return flags;
+}
+
+bool d3d11renderer::texture_compressor::compress_image(const Image& source, const Image& destination, TEX_COMPRESS_FLAGS flags)
+{
+	size_t blockRows = (source.height + 3) / 4;
+	std::atomic<bool> succeeded = true;
+
+	parallel_for(blockRows, BLOCK_ROWS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		size_t firstRow = begin * 4;
+		size_t rowCount = std::min(end * 4, source.height) - firstRow;
+
+		// A strip of the source image that covers whole block rows
+		Image strip = source;
+		strip.height = rowCount;
+		strip.slicePitch = source.rowPitch * rowCount;
+		strip.pixels = source.pixels + firstRow * source.rowPitch;
+
+		ScratchImage encoded;
+		HRESULT result = Compress(strip, destination.format, flags, TEX_THRESHOLD_DEFAULT, encoded);
+		if (FAILED(result))
+		{
+			succeeded = false;
+			return;
+		}
+
+		const Image* encodedImage = encoded.GetImage(0, 0, 0);
+		size_t rowBytes = std::min(encodedImage->rowPitch, destination.rowPitch);
+		for (size_t row = 0; row < end - begin; row++)
+		{
+			std::memcpy(destination.pixels + (begin + row) * destination.rowPitch, encodedImage->pixels + row * encodedImage->rowPitch, rowBytes);
+		}
+	});
+
+	return succeeded;
+}
+
+void d3d11renderer::texture_compressor::compress_image_fast(const Image& source, const Image& destination)
+{
+	size_t blocksWide = (source.width + 3) / 4;
+	size_t blockRows = (source.height + 3) / 4;
+	size_t blockBytes = destination.format == DXGI_FORMAT_BC5_UNORM ? 16 : 8;
+
+	parallel_for(blockRows, BLOCK_ROWS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		alignas(16) uint8_t pixels[64];
+
+		for (size_t blockY = begin; blockY < end; blockY++)
+		{
+			uint8_t* block = destination.pixels + blockY * destination.rowPitch;
+
+			for (size_t blockX = 0; blockX < blocksWide; blockX++, block += blockBytes)
+			{
+				// Gather the block, clamping at the edges of mips smaller than 4x4
+				for (size_t y = 0; y < 4; y++)
+				{
+					size_t sourceY = std::min(blockY * 4 + y, source.height - 1);
+					const uint8_t* row = source.pixels + sourceY * source.rowPitch;
+
+					for (size_t x = 0; x < 4; x++)
+					{
+						size_t sourceX = std::min(blockX * 4 + x, source.width - 1);
+						std::memcpy(pixels + y * 16 + x * 4, row + sourceX * 4, 4);
+					}
+				}
+
+				switch (destination.format)
+				{
+				case DXGI_FORMAT_BC1_UNORM:
+					encode_bc1_block(pixels, block);
+					break;
+				case DXGI_FORMAT_BC4_UNORM:
+					encode_bc4_block(pixels, 0, block);
+					break;
+				default:
+					encode_bc5_block(pixels, block);
+					break;
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXTex.h>
+
+namespace d3d11renderer
+{
+	enum class compression_quality
+	{
+		Fast,
+		Normal,
+		Slow
+	};
+
+	struct compression_report
+	{
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		size_t sourceBytes = 0;
+		size_t compressedBytes = 0;
+		float psnr = 0.0f;          // Top mip against the source, in dB
+		float milliseconds = 0.0f;  // Wall time spent encoding
+	};
+
+	// CPU block-compression encoder for cooked textures.
+	// BC1, BC4 and BC5 go through the SSE2 encoders in bc_encoder.h; everything else is split
+	// into strips of 4x4 block rows and encoded with the SIMD codecs from DirectXTex.
+	// Both paths encode block rows in parallel, so the work scales with core count.
+	class texture_compressor
+	{
+	public:
+		static bool compress(const DirectX::ScratchImage& source, DXGI_FORMAT format, compression_quality quality,
+			DirectX::ScratchImage& compressed, compression_report* report);
+
+		static float compute_psnr(const DirectX::Image& source, const DirectX::Image& compressed, DirectX::CMSE_FLAGS flags);
+		static bool is_block_compressible(const DirectX::TexMetadata& metadata);
+
+	private:
+		static bool is_fast_format(DXGI_FORMAT format);
+		static DirectX::CMSE_FLAGS get_compared_channels(DXGI_FORMAT format);
+		static DirectX::TEX_COMPRESS_FLAGS get_compress_flags(DXGI_FORMAT format, compression_quality quality);
+		static bool compress_image(const DirectX::Image& source, const DirectX::Image& destination, DirectX::TEX_COMPRESS_FLAGS flags);
+		static void compress_image_fast(const DirectX::Image& source, const DirectX::Image& destination);
+	};
+}
@@ -2,7 +2,7 @@
 
 using namespace Microsoft::WRL;
 
-texture_shader::texture_shader(ID3D11Device* device, HWND hwnd)
+texture_shader::texture_shader(ID3D11Device* device, HWND hwnd, d3d11renderer::shader_cache& shaderCache)
 {
 	bool result;
 	wchar_t vsFilename[128];
@@ -22,7 +22,7 @@ texture_shader::texture_shader(ID3D11Device* device, HWND hwnd)
 	}
 
 	// Initialize the vertex and pixel shaders.
-	result = initialize_shader(device, hwnd, vsFilename, psFilename);
+	result = initialize_shader(device, hwnd, vsFilename, psFilename, shaderCache);
 	if (!result) {
 		throw std::runtime_error("Failed to initialize the vertex and pixel shaders.");
 	}
@@ -51,25 +51,24 @@ bool texture_shader::render(ID3D11DeviceContext* deviceContext, int indexCount,
 	return true;
 }
 
-bool texture_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename)
+bool texture_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename, d3d11renderer::shader_cache& shaderCache)
 {
 	HRESULT result;
-	ComPtr<ID3D10Blob> errorMessage;
-	ComPtr<ID3D10Blob> vertexShaderBuffer;
-	ComPtr<ID3D10Blob> pixelShaderBuffer;
+	std::string errorMessage;
+	std::vector<uint8_t> vertexShaderBuffer;
+	std::vector<uint8_t> pixelShaderBuffer;
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[2];
 	unsigned int numElements;
 	D3D11_BUFFER_DESC matrixBufferDesc;
 	D3D11_SAMPLER_DESC samplerDesc;
 
-	result = D3DCompileFromFile(vsFilename, NULL, NULL, "main", "vs_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
-		vertexShaderBuffer.GetAddressOf(), errorMessage.GetAddressOf());
-	if (FAILED(result))
+	// Bytecode comes from the shader cache, which only compiles sources that changed
+	if (!shaderCache.get({ vsFilename, "main", "vs_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS }, vertexShaderBuffer, errorMessage))
 	{
 		// If the shader failed to compile it should have writen something to the error message.
-		if (errorMessage)
+		if (!errorMessage.empty())
 		{
-			output_shader_error_message(errorMessage.Get(), hwnd, vsFilename);
+			output_shader_error_message(errorMessage, hwnd, vsFilename);
 		}
 		// If there was nothing in the error message then it simply could not find the shader file itself.
 		else
@@ -80,14 +79,12 @@ bool texture_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* v
 		return false;
 	}
 
-	result = D3DCompileFromFile(psFilename, NULL, NULL, "main", "ps_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
-		pixelShaderBuffer.GetAddressOf(), errorMessage.GetAddressOf());
-	if (FAILED(result))
+	if (!shaderCache.get({ psFilename, "main", "ps_5_0", {}, D3D10_SHADER_ENABLE_STRICTNESS }, pixelShaderBuffer, errorMessage))
 	{
 		// If the shader failed to compile it should have writen something to the error message.
-		if (errorMessage)
+		if (!errorMessage.empty())
 		{
-			output_shader_error_message(errorMessage.Get(), hwnd, psFilename);
+			output_shader_error_message(errorMessage, hwnd, psFilename);
 		}
 		// If there was nothing in the error message then it simply could not find the file itself.
 		else
@@ -98,14 +95,14 @@ bool texture_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* v
 		return false;
 	}
 
-	result = device->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, m_vertexShader.GetAddressOf());
+	result = device->CreateVertexShader(vertexShaderBuffer.data(), vertexShaderBuffer.size(), NULL, m_vertexShader.GetAddressOf());
 	if (FAILED(result))
 	{
 		return false;
 	}
 
 	// Create the pixel shader from the buffer.
-	result = device->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(), NULL, m_pixelShader.GetAddressOf());
+	result = device->CreatePixelShader(pixelShaderBuffer.data(), pixelShaderBuffer.size(), NULL, m_pixelShader.GetAddressOf());
 	if (FAILED(result))
 	{
 		return false;
@@ -131,8 +128,8 @@ bool texture_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* v
 	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
 	// Create the vertex input layout.
-	result = device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(),
-		vertexShaderBuffer->GetBufferSize(), m_layout.GetAddressOf());
+	result = device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer.data(),
+		vertexShaderBuffer.size(), m_layout.GetAddressOf());
 	if (FAILED(result))
 	{
 		return false;
@@ -178,27 +175,16 @@ bool texture_shader::initialize_shader(ID3D11Device* device, HWND hwnd, WCHAR* v
 }
 
 
-void texture_shader::output_shader_error_message(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename)
+void texture_shader::output_shader_error_message(const std::string& errorMessage, HWND hwnd, WCHAR* shaderFilename)
 {
-	char* compileErrors;
-	unsigned long long bufferSize, i;
 	std::ofstream fout;
 
 
-	// Get a pointer to the error message text buffer.
-	compileErrors = (char*)(errorMessage->GetBufferPointer());
-
-	// Get the length of the message.
-	bufferSize = errorMessage->GetBufferSize();
-
 	// Open a file to write the error message to.
 	fout.open("shader-error.txt");
 
 	// Write out the error message.
-	for (i = 0; i < bufferSize; i++)
-	{
-		fout << compileErrors[i];
-	}
+	fout << errorMessage;
 
 	// Close the file.
 	fout.close();
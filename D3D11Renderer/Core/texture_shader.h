@@ -4,7 +4,9 @@
 #include <d3dcompiler.h>
 #include <directxmath.h>
 #include <fstream>
+#include <string>
 #include <wrl/client.h>
+#include "shader_cache.h"
 
 class texture_shader
 {
@@ -16,18 +18,18 @@ private:
 		DirectX::XMMATRIX projection;
 	};
 public:
-	texture_shader(ID3D11Device* device, HWND hwnd);
+	texture_shader(ID3D11Device* device, HWND hwnd, d3d11renderer::shader_cache& shaderCache);
 	~texture_shader();
 
 	bool render(ID3D11DeviceContext* deviceContext, int indexCount, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix,
 		DirectX::XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture);
 private:
-	void output_shader_error_message(ID3D10Blob*, HWND, WCHAR*);
+	void output_shader_error_message(const std::string&, HWND, WCHAR*);
 
 	bool set_shader_parameters(ID3D11DeviceContext* deviceContext, DirectX::XMMATRIX worldMatrix, DirectX::XMMATRIX viewMatrix,
 		DirectX::XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture);
 	void render_shader(ID3D11DeviceContext* deviceContext, int indexCount);
-	bool initialize_shader(ID3D11Device*, HWND, WCHAR*, WCHAR*);
+	bool initialize_shader(ID3D11Device*, HWND, WCHAR*, WCHAR*, d3d11renderer::shader_cache&);
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
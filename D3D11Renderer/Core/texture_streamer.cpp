@@ -0,0 +1,241 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+d3d11renderer::texture_streamer::texture_streamer(const streaming_settings& settings)
+	: m_settings(settings), m_candidateCapacity(0), m_frame(0)
+{
+}
+
+size_t d3d11renderer::texture_streamer::register_texture(const streamed_texture_desc& desc)
+{
+	texture_state state;
+	state.desc = desc;
+	state.baseMip = get_base_mip(desc);
+	state.allocatedMip = state.baseMip;
+	state.residentMip = state.baseMip;
+	state.wantedMip = static_cast<float>(state.baseMip);
+	state.wantedFrame = m_frame;
+
+	m_textures.push_back(state);
+
+	// Sized for every mip of every texture, so update never grows them
+	m_candidateCapacity += desc.mipBytes.size();
+	m_candidates.reserve(m_candidateCapacity);
+	m_targets.reserve(m_textures.size());
+	m_changeIndex.reserve(m_textures.size());
+	return m_textures.size() - 1;
+}
+
+void d3d11renderer::texture_streamer::request(size_t textureId, float uvDensity, float pixelsPerUnit)
+{
+	texture_state& state = m_textures[textureId];
+	float mip = compute_mip(state.desc, uvDensity, pixelsPerUnit);
+
+	// The finest request wins until it hasn't been repeated for keepFrames
+	if (mip <= state.wantedMip || m_frame - state.wantedFrame > m_settings.keepFrames)
+	{
+		state.wantedMip = mip;
+		state.wantedFrame = m_frame;
+	}
+}
+
+void d3d11renderer::texture_streamer::update(std::vector<streaming_change>& changes)
+{
+	m_frame++;
+	changes.clear();
+	changes.reserve(m_textures.size());
+
+	std::vector<uint32_t>& targets = m_targets;
+	plan_budget(targets);
+
+	// Allocations move one mip per update towards the plan. Shrinking goes first, as it frees budget; then textures
+	// grow while the budget holds, smallest mips first like the plan, so the budget is kept on every frame and not only
+	// once the plan is reached.
+	std::vector<size_t>& changeIndex = m_changeIndex;
+	changeIndex.assign(m_textures.size(), SIZE_MAX);
+	size_t allocatedBytes = 0;
+	m_candidates.clear();
+	for (size_t id = 0; id < m_textures.size(); id++)
+	{
+		texture_state& state = m_textures[id];
+		if (targets[id] > state.allocatedMip)
+		{
+			state.allocatedMip++;
+			state.residentMip = std::max(state.residentMip, state.allocatedMip);
+
+			changeIndex[id] = changes.size();
+			changes.push_back({ id, true, state.allocatedMip, state.residentMip, state.residentMip });
+		}
+		else if (targets[id] < state.allocatedMip)
+		{
+			uint32_t mip = state.allocatedMip - 1;
+			m_candidates.push_back({ id, mip, std::max(state.desc.width >> mip, state.desc.height >> mip) });
+		}
+		allocatedBytes += get_range_bytes(state, state.allocatedMip);
+	}
+
+	std::sort(m_candidates.begin(), m_candidates.end(), [](const mip_candidate& a, const mip_candidate& b)
+	{
+		return a.size != b.size ? a.size < b.size : a.textureId < b.textureId;
+	});
+
+	for (const mip_candidate& candidate : m_candidates)
+	{
+		texture_state& state = m_textures[candidate.textureId];
+		size_t bytes = state.desc.mipBytes[candidate.mip];
+		if (allocatedBytes + bytes > m_settings.budgetBytes)
+			continue;
+
+		allocatedBytes += bytes;
+		state.allocatedMip = candidate.mip;
+
+		changeIndex[candidate.textureId] = changes.size();
+		changes.push_back({ candidate.textureId, true, state.allocatedMip, state.residentMip, state.residentMip });
+	}
+
+	// Fill allocated mips coarse to fine across all textures, so every texture gets sharper at the same pace
+	m_candidates.clear();
+	for (size_t id = 0; id < m_textures.size(); id++)
+	{
+		const texture_state& state = m_textures[id];
+		for (uint32_t mip = state.residentMip; mip > state.allocatedMip; mip--)
+		{
+			m_candidates.push_back({ id, mip - 1, std::max(state.desc.width >> (mip - 1), state.desc.height >> (mip - 1)) });
+		}
+	}
+
+	std::sort(m_candidates.begin(), m_candidates.end(), [](const mip_candidate& a, const mip_candidate& b)
+	{
+		return a.size != b.size ? a.size < b.size : a.textureId < b.textureId;
+	});
+
+	size_t uploadedBytes = 0;
+	for (const mip_candidate& candidate : m_candidates)
+	{
+		texture_state& state = m_textures[candidate.textureId];
+		size_t bytes = state.desc.mipBytes[candidate.mip];
+		if (uploadedBytes > 0 && uploadedBytes + bytes > m_settings.uploadBytesPerFrame)
+			break;
+
+		uploadedBytes += bytes;
+		state.residentMip = candidate.mip;
+
+		if (changeIndex[candidate.textureId] == SIZE_MAX)
+		{
+			changeIndex[candidate.textureId] = changes.size();
+			changes.push_back({ candidate.textureId, false, state.allocatedMip, candidate.mip + 1, candidate.mip + 1 });
+		}
+		changes[changeIndex[candidate.textureId]].residentMip = candidate.mip;
+	}
+
+	m_stats.textureCount = m_textures.size();
+	m_stats.allocatedBytes = 0;
+	m_stats.pendingBytes = 0;
+	m_stats.uploadedBytes = uploadedBytes;
+	for (const texture_state& state : m_textures)
+	{
+		m_stats.allocatedBytes += get_range_bytes(state, state.allocatedMip);
+		m_stats.pendingBytes += get_range_bytes(state, state.allocatedMip) - get_range_bytes(state, state.residentMip);
+	}
+}
+
+const d3d11renderer::streaming_settings& d3d11renderer::texture_streamer::get_settings() const
+{
+	return m_settings;
+}
+
+const d3d11renderer::streaming_stats& d3d11renderer::texture_streamer::get_stats() const
+{
+	return m_stats;
+}
+
+uint32_t d3d11renderer::texture_streamer::get_resident_mip(size_t textureId) const
+{
+	return m_textures[textureId].residentMip;
+}
+
+uint32_t d3d11renderer::texture_streamer::get_allocated_mip(size_t textureId) const
+{
+	return m_textures[textureId].allocatedMip;
+}
+
+uint32_t d3d11renderer::texture_streamer::get_base_mip(const streamed_texture_desc& desc)
+{
+	uint32_t mipCount = static_cast<uint32_t>(desc.mipBytes.size());
+	uint32_t mip = 0;
+	while (mip + 1 < mipCount && std::max(desc.width >> mip, desc.height >> mip) > RESIDENT_SIZE)
+	{
+		mip++;
+	}
+	return std::min(mip, desc.coarsestTopMip);
+}
+
+float d3d11renderer::texture_streamer::compute_mip(const streamed_texture_desc& desc, float uvDensity, float pixelsPerUnit)
+{
+	float coarsest = static_cast<float>(desc.mipBytes.size() - 1);
+	float texelsPerUnit = uvDensity * std::sqrt(static_cast<float>(desc.width) * static_cast<float>(desc.height));
+	if (texelsPerUnit <= 0.0f || pixelsPerUnit <= 0.0f)
+		return coarsest;
+
+	// One texel per pixel is mip 0; every halving of the screen size moves one mip down
+	return std::clamp(std::log2(texelsPerUnit / pixelsPerUnit), 0.0f, coarsest);
+}
+
+size_t d3d11renderer::texture_streamer::get_range_bytes(const texture_state& state, uint32_t firstMip) const
+{
+	size_t bytes = 0;
+	for (size_t mip = firstMip; mip < state.desc.mipBytes.size(); mip++)
+	{
+		bytes += state.desc.mipBytes[mip];
+	}
+	return bytes;
+}
+
+void d3d11renderer::texture_streamer::plan_budget(std::vector<uint32_t>& targets)
+{
+	targets.resize(m_textures.size());
+
+	// The base mips are never dropped, so they come off the budget first
+	size_t usedBytes = 0;
+	m_stats.wantedBytes = 0;
+	m_candidates.clear();
+	for (size_t id = 0; id < m_textures.size(); id++)
+	{
+		texture_state& state = m_textures[id];
+		if (m_frame - state.wantedFrame > m_settings.keepFrames)
+		{
+			state.wantedMip = static_cast<float>(state.baseMip);
+		}
+
+		uint32_t wantedTop = std::min(state.baseMip, static_cast<uint32_t>(state.wantedMip));
+		targets[id] = state.baseMip;
+		usedBytes += get_range_bytes(state, state.baseMip);
+		m_stats.wantedBytes += get_range_bytes(state, wantedTop);
+
+		for (uint32_t mip = state.baseMip; mip > wantedTop; mip--)
+		{
+			m_candidates.push_back({ id, mip - 1, std::max(state.desc.width >> (mip - 1), state.desc.height >> (mip - 1)) });
+		}
+	}
+
+	// Grant the smallest mips first; a texture stops growing at the first mip that doesn't fit
+	std::sort(m_candidates.begin(), m_candidates.end(), [](const mip_candidate& a, const mip_candidate& b)
+	{
+		return a.size != b.size ? a.size < b.size : a.textureId < b.textureId;
+	});
+
+	for (const mip_candidate& candidate : m_candidates)
+	{
+		if (targets[candidate.textureId] != candidate.mip + 1)
+			continue;
+
+		size_t bytes = m_textures[candidate.textureId].desc.mipBytes[candidate.mip];
+		if (usedBytes + bytes > m_settings.budgetBytes)
+			continue;
+
+		usedBytes += bytes;
+		targets[candidate.textureId] = candidate.mip;
+	}
+}
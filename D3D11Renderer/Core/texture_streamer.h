@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3d11renderer
+{
+	struct streaming_settings
+	{
+		size_t budgetBytes = 256 * 1024 * 1024;        // Allocated mips of every streamed texture together
+		size_t uploadBytesPerFrame = 4 * 1024 * 1024;  // A single larger mip still goes through when nothing else was uploaded
+		uint32_t keepFrames = 60;                      // How long a request keeps its mips wanted
+	};
+
+	// Mip layout of a streamed texture
+	struct streamed_texture_desc
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<size_t> mipBytes;  // One entry per mip, finest first
+		uint32_t coarsestTopMip = 0;   // Coarsest mip a GPU resource may start at; block-compressed tops need multiples of 4
+	};
+
+	// What has to happen to one texture on the GPU this frame
+	struct streaming_change
+	{
+		size_t textureId = 0;
+		bool reallocate = false;   // Recreate the resource starting at allocatedMip, keeping the resident mips it still covers
+		uint32_t allocatedMip = 0; // First mip of the GPU resource
+		uint32_t residentMip = 0;  // Finest mip with data; sampling gets clamped to it
+		uint32_t uploadEnd = 0;    // Mips [residentMip, uploadEnd) are uploaded this frame
+	};
+
+	struct streaming_stats
+	{
+		size_t textureCount = 0;
+		size_t allocatedBytes = 0;
+		size_t wantedBytes = 0;    // What every request would cost without the budget
+		size_t uploadedBytes = 0;  // This frame
+		size_t pendingBytes = 0;   // Allocated but not uploaded yet
+	};
+
+	// Decides which mips of each texture are resident.
+	// Textures always keep their smallest mips. Finer mips are requested from the on-screen texel density of the
+	// meshes that use them and granted coarse-to-fine across all textures until the budget runs out. Each allocation
+	// moves one mip per update and the mips are uploaded a few at a time, so neither memory nor upload work spikes.
+	// Nothing here touches the GPU; the owner applies the returned changes to its resources.
+	class texture_streamer
+	{
+	public:
+		// Mips this size and smaller are always resident
+		static constexpr uint32_t RESIDENT_SIZE = 64;
+
+		texture_streamer(const streaming_settings& settings);
+
+		size_t register_texture(const streamed_texture_desc& desc);
+
+		// uvDensity is UV units per world unit of the surface, pixelsPerUnit the screen size of one world unit there.
+		void request(size_t textureId, float uvDensity, float pixelsPerUnit);
+		void update(std::vector<streaming_change>& changes);
+
+		const streaming_settings& get_settings() const;
+		const streaming_stats& get_stats() const;
+		uint32_t get_resident_mip(size_t textureId) const;
+		uint32_t get_allocated_mip(size_t textureId) const;
+
+		static uint32_t get_base_mip(const streamed_texture_desc& desc);
+		static float compute_mip(const streamed_texture_desc& desc, float uvDensity, float pixelsPerUnit);
+
+	private:
+		struct texture_state
+		{
+			streamed_texture_desc desc;
+			uint32_t baseMip = 0;
+			uint32_t allocatedMip = 0;
+			uint32_t residentMip = 0;
+			float wantedMip = 0.0f;
+			uint64_t wantedFrame = 0;
+		};
+
+		struct mip_candidate
+		{
+			size_t textureId;
+			uint32_t mip;
+			uint32_t size;
+		};
+
+		size_t get_range_bytes(const texture_state& state, uint32_t firstMip) const;
+		void plan_budget(std::vector<uint32_t>& targets);
+
+	private:
+		streaming_settings m_settings;
+		std::vector<texture_state> m_textures;
+		std::vector<mip_candidate> m_candidates;
+		size_t m_candidateCapacity;  // Mips over every registered texture
+		// Per texture, kept between updates so a frame allocates nothing once every texture is registered
+		std::vector<uint32_t> m_targets;
+		std::vector<size_t> m_changeIndex;
+		streaming_stats m_stats;
+		uint64_t m_frame;
+	};
+}
@@ -0,0 +1,28 @@
+cbuffer MatrixBuffer : register(b0)
+{
+    matrix worldMatrix;
+    matrix viewMatrix;
+    matrix projectionMatrix;
+};
+
+struct VertexInputType
+{
+    float3 position : POSITION;
+    float4 instanceRow0 : INSTANCE_TRANSFORM0; // Node transform, from the per-instance stream
+    float4 instanceRow1 : INSTANCE_TRANSFORM1;
+    float4 instanceRow2 : INSTANCE_TRANSFORM2;
+    float4 instanceRow3 : INSTANCE_TRANSFORM3;
+};
+
+// Depth prepass, fed by the position-only vertex stream with no pixel shader bound.
+// The lit pass tests EQUAL against this depth, so the position is computed exactly as lightvs.hlsl does it
+float4 main(VertexInputType input) : SV_POSITION
+{
+    float4x4 instanceMatrix = float4x4(input.instanceRow0, input.instanceRow1, input.instanceRow2, input.instanceRow3);
+
+    precise float4 clipPosition = mul(float4(input.position, 1.0f), instanceMatrix);
+    clipPosition = mul(clipPosition, worldMatrix);
+    clipPosition = mul(clipPosition, viewMatrix);
+    clipPosition = mul(clipPosition, projectionMatrix);
+    return clipPosition;
+}
@@ -0,0 +1,27 @@
+// Shared by the fused post pass, which bins the histogram, and the adaptation pass; the CPU reference is luminance_histogram.cpp
+#define BIN_COUNT 256
+#define MIN_LUMINANCE 1e-5f
+
+cbuffer ExposureParams : register(b2)
+{
+    float minLogLuminance;
+    float logLuminanceRange;
+    float lowPercentile;
+    float highPercentile;
+    float speedUp;
+    float speedDown;
+    float deltaTime;
+    float keyValue;
+};
+
+// Bin 0 holds pixels too dark to measure, the rest split the log range evenly
+uint get_bin(float luminance)
+{
+    if (luminance < MIN_LUMINANCE)
+    {
+        return 0;
+    }
+
+    float t = saturate((log2(luminance) - minLogLuminance) / logLuminanceRange);
+    return 1 + uint(t * (BIN_COUNT - 2));
+}
@@ -0,0 +1,72 @@
+#include "exposure.hlsli"
+
+ByteAddressBuffer histogram : register(t0);
+RWByteAddressBuffer exposureState : register(u0); // Adapted luminance, exposure, target luminance, valid
+
+groupshared float prefix[BIN_COUNT];
+groupshared float sums[BIN_COUNT];
+groupshared float weights[BIN_COUNT];
+
+// One thread per bin: average the log luminance between the percentiles, then adapt towards it
+[numthreads(BIN_COUNT, 1, 1)]
+void main(uint groupIndex : SV_GroupIndex)
+{
+    float count = groupIndex > 0 ? float(histogram.Load(groupIndex * 4)) : 0.0f;
+    prefix[groupIndex] = count;
+    GroupMemoryBarrierWithGroupSync();
+
+    // Inclusive prefix sum over the bins
+    [unroll]
+    for (uint offset = 1; offset < BIN_COUNT; offset <<= 1)
+    {
+        float previous = groupIndex >= offset ? prefix[groupIndex - offset] : 0.0f;
+        GroupMemoryBarrierWithGroupSync();
+        prefix[groupIndex] += previous;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    // Part of this bin's pixels that lies between the percentiles
+    float total = prefix[BIN_COUNT - 1];
+    float below = prefix[groupIndex] - count;
+    float overlap = max(min(below + count, total * highPercentile) - max(below, total * lowPercentile), 0.0f);
+    float logLuminance = minLogLuminance + (float(groupIndex) - 0.5f) / float(BIN_COUNT - 2) * logLuminanceRange;
+    sums[groupIndex] = overlap * logLuminance;
+    weights[groupIndex] = overlap;
+    GroupMemoryBarrierWithGroupSync();
+
+    [unroll]
+    for (uint stride = BIN_COUNT / 2; stride > 0; stride >>= 1)
+    {
+        if (groupIndex < stride)
+        {
+            sums[groupIndex] += sums[groupIndex + stride];
+            weights[groupIndex] += weights[groupIndex + stride];
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (groupIndex == 0)
+    {
+        float4 state = asfloat(exposureState.Load4(0));
+
+        // An empty histogram leaves the exposure where it was
+        if (weights[0] > 0.0f)
+        {
+            float averageLog = sums[0] / weights[0];
+            float adaptedLog = averageLog;
+
+            // Exponential approach in log space; the first frame takes the target directly
+            if (state.w > 0.0f)
+            {
+                float previousLog = log2(state.x);
+                float speed = averageLog > previousLog ? speedUp : speedDown;
+                adaptedLog = previousLog + (averageLog - previousLog) * (1.0f - exp(-deltaTime * speed));
+            }
+
+            float adapted = exp2(adaptedLog);
+            state = float4(adapted, keyValue / adapted, exp2(averageLog), 1.0f);
+        }
+
+        exposureState.Store4(0, asuint(state));
+    }
+}
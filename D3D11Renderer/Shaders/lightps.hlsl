@@ -4,7 +4,26 @@ Texture2D specularMap : register(t2);
 Texture2D aoMap : register(t3);
 Texture2D emissiveMap : register(t4);
 Texture2D metalRoughnessMap : register(t5);
+TextureCube prefilteredSpecular : register(t6);
+Texture2D brdfLut : register(t7);
+// Clustered point and spot lights, see light_clusters.h
+struct PackedLight
+{
+    float3 position;
+    float range;
+    float3 color;
+    float spotScale;
+    float3 direction;
+    float spotOffset;
+};
+
+StructuredBuffer<PackedLight> clusteredLights : register(t8);
+StructuredBuffer<uint2> clusterRanges : register(t9);  // Offset and count into clusterLightIndices
+StructuredBuffer<uint> clusterLightIndices : register(t10);
+Texture2DArray<float> shadowMap : register(t11); // One slice per cascade
 SamplerState SampleType : register(s0);
+SamplerState ClampSampler : register(s1);
+SamplerComparisonState ShadowSampler : register(s2);
 
 // Inside cbuffer (if required):
 cbuffer LightBuffer
@@ -16,6 +35,45 @@ cbuffer LightBuffer
     float4 specularColor; // Existing lighting data
 };
 
+// Image-based lighting baked from the skybox
+cbuffer EnvironmentBuffer : register(b1)
+{
+    float4 irradiance[9]; // SH9 of the diffuse irradiance over pi
+    float specularMipCount;
+    float3 environmentPadding;
+};
+
+// Froxel grid the lights were binned into
+cbuffer ClusterBuffer : register(b2)
+{
+    float2 tileScale; // Tiles per pixel
+    float sliceScale; // slice = log(viewDepth) * sliceScale + sliceBias
+    float sliceBias;
+    uint3 clusterCounts; // Tiles across, tiles down, depth slices
+    float clusterPadding;
+};
+
+// Cascaded shadow map of the directional light, see shadow_cascades.h
+#define MAX_CASCADES 4
+cbuffer ShadowBuffer : register(b3)
+{
+    matrix cascadeViewProjection[MAX_CASCADES];
+    float4 cascadeSplits[MAX_CASCADES]; // x: view depth where the cascade ends, y: world size of one texel
+    uint cascadeCount;
+    float shadowTexelSize; // In texture coordinates
+    float2 shadowPadding;
+};
+
+// Constants the material's maps are multiplied by, and what stands in for a map it doesn't have
+cbuffer MaterialBuffer : register(b4)
+{
+    float4 baseColorFactor; // Linear
+    float3 emissiveFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    float3 materialPadding;
+};
+
 // Update the PixelInputType to include new texture coordinates (optional if using the same texture coordinates)
 struct PixelInputType
 {
@@ -25,8 +83,91 @@ struct PixelInputType
     float3 tangent : TANGENT;
     float3 bitangent : BITANGENT;
     float3 viewDirection : TEXCOORD1;
+    float3 worldPosition : TEXCOORD2;
+    float viewDepth : TEXCOORD3;
 };
 
+// Diffuse light arriving from the environment around normal n
+float3 evaluate_irradiance(float3 n)
+{
+    float3 result = irradiance[0].rgb * 0.282095f;
+    result += irradiance[1].rgb * 0.488603f * n.y;
+    result += irradiance[2].rgb * 0.488603f * n.z;
+    result += irradiance[3].rgb * 0.488603f * n.x;
+    result += irradiance[4].rgb * 1.092548f * n.x * n.y;
+    result += irradiance[5].rgb * 1.092548f * n.y * n.z;
+    result += irradiance[6].rgb * 0.315392f * (3.0f * n.z * n.z - 1.0f);
+    result += irradiance[7].rgb * 1.092548f * n.x * n.z;
+    result += irradiance[8].rgb * 0.546274f * (n.x * n.x - n.y * n.y);
+    return max(result, 0.0f);
+}
+
+// How much of the directional light reaches this point, 0 to 1
+float evaluate_shadow(PixelInputType input)
+{
+    uint cascade = 0;
+    [loop]
+    while (cascade < cascadeCount && input.viewDepth > cascadeSplits[cascade].x)
+    {
+        cascade++;
+    }
+    if (cascade >= cascadeCount)
+    {
+        return 1.0f;
+    }
+
+    // Push the lookup out along the surface normal by about a texel so lit faces don't shadow themselves
+    float3 offsetPosition = input.worldPosition + normalize(input.normal) * cascadeSplits[cascade].y * 1.5f;
+    float4 shadowPosition = mul(float4(offsetPosition, 1.0f), cascadeViewProjection[cascade]);
+    float2 uv = shadowPosition.xy * float2(0.5f, -0.5f) + 0.5f;
+
+    // 3x3 taps of 2x2 hardware PCF
+    float lit = 0.0f;
+    [unroll]
+    for (int y = -1; y <= 1; y++)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; x++)
+        {
+            lit += shadowMap.SampleCmpLevelZero(ShadowSampler, float3(uv + float2(x, y) * shadowTexelSize, cascade), shadowPosition.z);
+        }
+    }
+    return lit / 9.0f;
+}
+
+// Diffuse and specular from the point and spot lights binned into this pixel's cluster
+void evaluate_clustered_lights(PixelInputType input, float3 normal, float roughness, out float3 diffuse, out float3 specular)
+{
+    diffuse = 0.0f;
+    specular = 0.0f;
+
+    uint2 tile = min(uint2(input.position.xy * tileScale), clusterCounts.xy - 1);
+    uint slice = uint(clamp(log(input.viewDepth) * sliceScale + sliceBias, 0.0f, float(clusterCounts.z - 1)));
+    uint2 range = clusterRanges[(slice * clusterCounts.y + tile.y) * clusterCounts.x + tile.x];
+
+    float3 viewDir = normalize(input.viewDirection);
+    for (uint i = 0; i < range.y; i++)
+    {
+        PackedLight light = clusteredLights[clusterLightIndices[range.x + i]];
+
+        float3 toLight = light.position - input.worldPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float3 lightDir = toLight * rsqrt(max(distanceSquared, 1e-8f));
+
+        // Inverse square falloff windowed to reach zero at the light's range
+        float window = saturate(1.0f - pow(distanceSquared / (light.range * light.range), 2.0f));
+        float attenuation = window * window / (distanceSquared + 1.0f);
+        float cone = saturate(dot(-lightDir, light.direction) * light.spotScale + light.spotOffset);
+        float3 radiance = light.color * attenuation * cone * cone;
+
+        float nDotL = saturate(dot(normal, lightDir));
+        diffuse += radiance * nDotL;
+
+        float3 halfVector = normalize(lightDir + viewDir);
+        specular += radiance * nDotL * pow(saturate(dot(normal, halfVector)), specularPower) * (1.0f - roughness);
+    }
+}
+
 // Main pixel shader
 float4 main(PixelInputType input) : SV_TARGET
 {
@@ -37,25 +178,47 @@ float4 main(PixelInputType input) : SV_TARGET
     float4 color;
     float3 reflection;
     float4 specular;
-    float3 normalTangentSpace;
     float3 normalWorldSpace;
+#ifdef HAS_NORMAL_MAP
+    float3 normalTangentSpace;
+#endif
 
+    // Maps a submesh doesn't have are compiled out (HAS_*_MAP defines) and replaced by neutral values
+#ifdef HAS_DIFFUSE_MAP
     textureColor = pow(diffuseMap.Sample(SampleType, input.tex), 2.2); // Convert diffuse to linear space
+#else
+    textureColor = float4(1.0f, 1.0f, 1.0f, 1.0f);
+#endif
+    textureColor *= baseColorFactor;
+
+#ifdef HAS_EMISSIVE_MAP
     emissive = pow(emissiveMap.Sample(SampleType, input.tex), 2.2); // Convert emissive to linear space
+#else
+    emissive = float4(1.0f, 1.0f, 1.0f, 1.0f);
+#endif
+    emissive.rgb *= emissiveFactor;
 
     // Sample the AO map (ambient occlusion) and factor it into ambient lighting
+#ifdef HAS_AO_MAP
     float ao = aoMap.Sample(SampleType, input.tex).r;
+#else
+    float ao = 1.0f;
+#endif
 
     // Sample the metal-roughness map and extract metalness and roughness
+#ifdef HAS_METAL_ROUGHNESS_MAP
     float4 metalRoughness = metalRoughnessMap.Sample(SampleType, input.tex);
-    float metalness = metalRoughness.r;
-    float roughness = metalRoughness.g;
-
-    // Set default output color to ambient light (factor in AO)
-    color = ambientColor * ao;
+    float metalness = metalRoughness.r * metallicFactor;
+    float roughness = metalRoughness.g * roughnessFactor;
+#else
+    float metalness = metallicFactor;
+    float roughness = roughnessFactor;
+#endif
 
-    // Sample and transform the normal map
-    normalTangentSpace = normalMap.Sample(SampleType, input.tex).xyz * 2.0f - 1.0f;
+#ifdef HAS_NORMAL_MAP
+    // Sample and transform the normal map; it's stored as two-channel BC5 so rebuild Z from XY
+    normalTangentSpace.xy = normalMap.Sample(SampleType, input.tex).xy * 2.0f - 1.0f;
+    normalTangentSpace.z = sqrt(saturate(1.0f - dot(normalTangentSpace.xy, normalTangentSpace.xy)));
 
     // Construct the TBN matrix
     float3x3 TBN = float3x3(normalize(input.tangent), normalize(input.bitangent), normalize(input.normal));
@@ -63,17 +226,25 @@ float4 main(PixelInputType input) : SV_TARGET
     // Transform the normal from tangent space to world space
     normalWorldSpace = mul(normalTangentSpace, TBN);
     normalWorldSpace = normalize(normalWorldSpace);
+#else
+    normalWorldSpace = normalize(input.normal);
+#endif
+
+    // Start from the environment's diffuse light instead of a flat ambient (factor in AO)
+    color = float4(evaluate_irradiance(normalWorldSpace) * ao, 1.0f);
 
     // Invert the light direction for lighting calculations
     lightDir = -normalize(lightDirection);
 
-    // Calculate diffuse light intensity
+    // Calculate diffuse light intensity, darkened where the cascaded shadow map says the light is blocked
     lightIntensity = saturate(dot(normalWorldSpace, lightDir));
 
     if (lightIntensity > 0.0f)
     {
+        float shadow = evaluate_shadow(input);
+
         // Add diffuse lighting
-        color += diffuseColor * lightIntensity;
+        color += diffuseColor * lightIntensity * shadow;
 
         // Calculate reflection and specular component
         reflection = normalize(2.0f * lightIntensity * normalWorldSpace - lightDir);
@@ -81,15 +252,28 @@ float4 main(PixelInputType input) : SV_TARGET
         specular = specularColor * specIntensity;
 
         // Modulate the specular highlight by roughness
-        color += specular * (1.0f - roughness);
+        color += specular * (1.0f - roughness) * shadow;
     }
 
+    // Add the clustered point and spot lights
+    float3 clusteredDiffuse, clusteredSpecular;
+    evaluate_clustered_lights(input, normalWorldSpace, roughness, clusteredDiffuse, clusteredSpecular);
+    color.rgb += clusteredDiffuse + clusteredSpecular;
+
     // Combine metallic reflection and diffuse color
     float3 F0 = lerp(float3(0.04f, 0.04f, 0.04f), textureColor.rgb, metalness);
     color.rgb = lerp(color.rgb, F0, metalness);
 
+    // Split-sum specular from the prefiltered environment
+    float3 viewDir = normalize(input.viewDirection);
+    float nDotV = saturate(dot(normalWorldSpace, viewDir));
+    float3 reflected = reflect(-viewDir, normalWorldSpace);
+    float3 prefiltered = prefilteredSpecular.SampleLevel(SampleType, reflected, roughness * (specularMipCount - 1.0f)).rgb;
+    float2 environmentBrdf = brdfLut.SampleLevel(ClampSampler, float2(nDotV, roughness), 0).rg;
+    float3 environmentSpecular = prefiltered * (F0 * environmentBrdf.x + environmentBrdf.y) * ao;
+
     // Combine the final color with texture, ambient occlusion, and emissive
-    color.rgb = saturate(color.rgb * textureColor.rgb + emissive.rgb);
+    color.rgb = saturate(color.rgb * textureColor.rgb + environmentSpecular + emissive.rgb);
     color.a = 1.0f;
     return color;
 }
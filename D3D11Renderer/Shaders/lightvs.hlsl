@@ -18,6 +18,10 @@ struct VertexInputType
     float3 normal : NORMAL;
     float3 tangent : TANGENT;
     float3 bitangent : BITANGENT;
+    float4 instanceRow0 : INSTANCE_TRANSFORM0; // Node transform, from the per-instance stream
+    float4 instanceRow1 : INSTANCE_TRANSFORM1;
+    float4 instanceRow2 : INSTANCE_TRANSFORM2;
+    float4 instanceRow3 : INSTANCE_TRANSFORM3;
 };
 
 struct PixelInputType
@@ -28,6 +32,8 @@ struct PixelInputType
     float3 tangent : TANGENT;
     float3 bitangent : BITANGENT;
     float3 viewDirection : TEXCOORD1;
+    float3 worldPosition : TEXCOORD2;
+    float viewDepth : TEXCOORD3;
 };
 
 PixelInputType main(VertexInputType input)
@@ -38,18 +44,22 @@ PixelInputType main(VertexInputType input)
 	// Change the position vector to 4 components for matrix calculations
     input.position.w = 1.0f;
 
-	// Transform position from object space to clip space
-    output.position = mul(input.position, worldMatrix);
-    output.position = mul(output.position, viewMatrix);
-    output.position = mul(output.position, projectionMatrix);
+    float4x4 instanceMatrix = float4x4(input.instanceRow0, input.instanceRow1, input.instanceRow2, input.instanceRow3);
+
+	// Transform position from object space to clip space, step for step as depthvs.hlsl so the depth prepass matches exactly
+    precise float4 clipPosition = mul(input.position, instanceMatrix);
+    clipPosition = mul(clipPosition, worldMatrix);
+    clipPosition = mul(clipPosition, viewMatrix);
+    clipPosition = mul(clipPosition, projectionMatrix);
+    output.position = clipPosition;
 
 	// Pass texture coordinates to pixel shader
     output.tex = input.tex;
     
 	// Transform normal, tangent, and bitangent vectors to world space
-    output.normal = mul(input.normal, (float3x3) worldMatrix);
-    output.tangent = mul(input.tangent, (float3x3) worldMatrix);
-    output.bitangent = mul(input.bitangent, (float3x3) worldMatrix);
+    output.normal = mul(mul(input.normal, (float3x3) instanceMatrix), (float3x3) worldMatrix);
+    output.tangent = mul(mul(input.tangent, (float3x3) instanceMatrix), (float3x3) worldMatrix);
+    output.bitangent = mul(mul(input.bitangent, (float3x3) instanceMatrix), (float3x3) worldMatrix);
 
     // Normalize the vectors
     output.normal = normalize(output.normal);
@@ -57,10 +67,14 @@ PixelInputType main(VertexInputType input)
     output.bitangent = normalize(output.bitangent);
 
 	// Calculate the world position of the vertex
-    worldPosition = mul(input.position, worldMatrix);
+    worldPosition = mul(mul(input.position, instanceMatrix), worldMatrix);
 
 	// Calculate the view direction (camera to the vertex) and normalize it
     output.viewDirection = normalize(cameraPosition.xyz - worldPosition.xyz);
 
+    // Clustered lights are looked up by world position and view depth
+    output.worldPosition = worldPosition.xyz;
+    output.viewDepth = mul(worldPosition, viewMatrix).z;
+
     return output;
 }
@@ -0,0 +1,111 @@
+#include "exposure.hlsli"
+
+Texture2DMS<float4> hdrTexture : register(t0); // Multisampled scene, read sample by sample
+RWTexture2D<unorm float4> output : register(u0); // Back buffer or any UAV-capable target
+RWByteAddressBuffer histogram : register(u1); // BIN_COUNT uints, cleared before the dispatch
+
+cbuffer PostParams : register(b0)
+{
+    uint2 outputSize;
+    float exposureCompensation; // On top of the automatic exposure
+    float saturation;
+    float3 tint;
+    float contrast; // Around middle grey, in linear space
+    float inverseGamma;
+    float3 padding;
+};
+
+// Written by the auto exposure compute passes, never by the CPU. It is last frame's value, as this pass fills the histogram
+cbuffer AutoExposureParams : register(b1)
+{
+    float adaptedLuminance;
+    float autoExposure;
+    float targetLuminance;
+    float autoExposureValid;
+};
+
+#define TILE_SIZE 8
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+#define MIDDLE_GREY 0.18f
+
+static const float3 LUMA = float3(0.2126f, 0.7152f, 0.0722f);
+
+groupshared float tileLuminance[TILE_PIXELS];
+groupshared uint localBins[BIN_COUNT];
+
+// ACES approximation function
+float3 ACESFilm(float3 x)
+{
+    const float a = 2.51;
+    const float b = 0.03;
+    const float c = 2.43;
+    const float d = 0.59;
+    const float e = 0.14;
+    return saturate((x * (a * x + b)) / (x * (c * x + d) + e));
+}
+
+float3 grade(float3 color)
+{
+    color = max(lerp(dot(color, LUMA).xxx, color, saturation), 0.0f);
+    color = MIDDLE_GREY * pow(color / MIDDLE_GREY, contrast);
+    return saturate(color * tint);
+}
+
+// The whole post chain in one pass: each thread reads its pixel's samples once and writes the display pixel once.
+// Resolve, exposure, tone mapping, grading and gamma stay in registers, and the histogram for next frame's exposure
+// is gathered on the side from the same samples.
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void main(uint3 dispatchId : SV_DispatchThreadID, uint3 groupThreadId : SV_GroupThreadID, uint groupIndex : SV_GroupIndex)
+{
+    for (uint bin = groupIndex; bin < BIN_COUNT; bin += TILE_PIXELS)
+    {
+        localBins[bin] = 0;
+    }
+
+    // Threads past the edge load the last pixel, so a 2x2 block on an odd edge repeats it like the CPU reference
+    int2 pixel = int2(min(dispatchId.xy, outputSize - 1));
+
+    uint width, height, sampleCount;
+    hdrTexture.GetDimensions(width, height, sampleCount);
+
+    // Tone map every sample before averaging, so a bright edge over a dark one resolves smoothly instead of aliasing
+    float exposure = autoExposure * exposureCompensation;
+    float3 average = 0.0f;
+    float3 mapped = 0.0f;
+    for (uint s = 0; s < sampleCount; s++)
+    {
+        float3 hdr = hdrTexture.Load(pixel, s).rgb;
+        average += hdr;
+        mapped += ACESFilm(hdr * exposure);
+    }
+    average /= sampleCount;
+    mapped /= sampleCount;
+
+    tileLuminance[groupIndex] = dot(average, LUMA);
+    GroupMemoryBarrierWithGroupSync();
+
+    // Tiles start on even pixels, so the thread at the top left of each 2x2 block bins the block's average
+    if (all((groupThreadId.xy & 1) == 0) && all(dispatchId.xy < outputSize))
+    {
+        float luminance = (tileLuminance[groupIndex] + tileLuminance[groupIndex + 1] +
+            tileLuminance[groupIndex + TILE_SIZE] + tileLuminance[groupIndex + TILE_SIZE + 1]) * 0.25f;
+        InterlockedAdd(localBins[get_bin(luminance)], 1);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint i = groupIndex; i < BIN_COUNT; i += TILE_PIXELS)
+    {
+        if (localBins[i] > 0)
+        {
+            histogram.InterlockedAdd(i * 4, localBins[i]);
+        }
+    }
+
+    if (any(dispatchId.xy >= outputSize))
+    {
+        return;
+    }
+
+    float3 color = pow(grade(mapped), inverseGamma);
+    output[dispatchId.xy] = float4(color, 1.0f);
+}
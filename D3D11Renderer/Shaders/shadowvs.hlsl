@@ -0,0 +1,22 @@
+cbuffer MatrixBuffer : register(b0)
+{
+    matrix worldMatrix;
+    matrix lightViewProjection;
+};
+
+struct VertexInputType
+{
+    float3 position : POSITION;
+    float4 instanceRow0 : INSTANCE_TRANSFORM0; // Node transform, from the per-instance stream
+    float4 instanceRow1 : INSTANCE_TRANSFORM1;
+    float4 instanceRow2 : INSTANCE_TRANSFORM2;
+    float4 instanceRow3 : INSTANCE_TRANSFORM3;
+};
+
+// Depth only; the position-only vertex stream feeds this and no pixel shader is bound
+float4 main(VertexInputType input) : SV_POSITION
+{
+    float4x4 instanceMatrix = float4x4(input.instanceRow0, input.instanceRow1, input.instanceRow2, input.instanceRow3);
+    float4 worldPosition = mul(mul(float4(input.position, 1.0f), instanceMatrix), worldMatrix);
+    return mul(worldPosition, lightViewProjection);
+}
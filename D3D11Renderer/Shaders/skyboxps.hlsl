@@ -2,16 +2,27 @@
 Texture2D<float4> panoramaTexture : register(t0); // Single panoramic texture
 SamplerState SampleType : register(s0);
 
+cbuffer MatrixBuffer : register(b0)
+{
+    matrix inverseViewProjection; // Rotation-only view, so the far plane point is the view direction
+};
+
 struct VS_OUTPUT
 {
     float4 position : SV_POSITION;
-    float2 texCoords : TEXCOORD0;
+    float2 ndc : TEXCOORD0;
 };
 
+static const float PI = 3.14159265f;
+
 float4 main(VS_OUTPUT input) : SV_TARGET
 {
-    // Sample the panorama texture using the input texture coordinates
-    float4 color = pow(panoramaTexture.Sample(SampleType, input.texCoords), 2.2);
+    float4 farPoint = mul(float4(input.ndc, 1.0f, 1.0f), inverseViewProjection);
+    float3 direction = normalize(farPoint.xyz / farPoint.w);
+
+    // Equirectangular lookup, the same mapping ibl_baker uses
+    float2 texCoords = float2(0.5f - atan2(direction.z, direction.x) / (2.0f * PI), acos(clamp(direction.y, -1.0f, 1.0f)) / PI);
+    float4 color = pow(panoramaTexture.SampleLevel(SampleType, texCoords, 0), 2.2);
 
     return color;
 }
@@ -1,35 +1,18 @@
-cbuffer MatrixBuffer
-{
-    matrix viewMatrix;
-    matrix projectionMatrix;
-};
-
 struct VS_OUTPUT
 {
     float4 position : SV_POSITION;
-    float2 texCoords : TEXCOORD0;
+    float2 ndc : TEXCOORD0;
 };
 
-VS_OUTPUT main(float3 position : POSITION, float2 texCoord : TEXCOORD0)
+// One triangle covering the screen, built from the vertex id with no vertex buffer.
+// It sits on the far plane so the depth test leaves only pixels no geometry reached
+VS_OUTPUT main(uint vertexId : SV_VertexID)
 {
     VS_OUTPUT output;
 
-    // Remove the translation component from the view matrix
-    matrix rotationOnlyView = viewMatrix;
-    rotationOnlyView[3][0] = 0.0f;
-    rotationOnlyView[3][1] = 0.0f;
-    rotationOnlyView[3][2] = 0.0f;
-
-    // Scale the skybox position to the edge of the view frustum
-    float3 scaledPosition = position * 300.0f;
-    float4 worldPosition = float4(scaledPosition, 1.0f);
-
-    // Apply rotation-only view matrix and projection matrix
-    output.position = mul(worldPosition, rotationOnlyView);
-    output.position = mul(output.position, projectionMatrix);
-
-    // Pass through texture coordinates
-    output.texCoords = texCoord;
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    output.ndc = uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f);
+    output.position = float4(output.ndc, 1.0f, 1.0f);
 
     return output;
 }
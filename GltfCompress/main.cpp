@@ -0,0 +1,406 @@
+// Rewrites a .gltf so its geometry buffer views use EXT_meshopt_compression, which the renderer's glTF loader decodes
+// at import. Compression is lossless: vertex data keeps its format and order and triangles stay as they were, some
+// starting at another corner, so the result renders exactly as before.
+// Every decoded view is checked against the original, and the tool reports the ratio and decode speed it measured.
+//
+//     GltfCompress input.gltf output.gltf
+//
+// The output keeps the input's image URIs, so write it to the same directory. Its data goes to output.bin beside it.
+
+#include "../D3D11Renderer/Core/json.h"
+#include "../D3D11Renderer/Core/mapped_file.h"
+#include "../D3D11Renderer/Core/meshopt_codec.h"
+#include "../D3D11Renderer/Core/parallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr int64_t MODE_TRIANGLES = 4;
+	constexpr const char* EXTENSION = "EXT_meshopt_compression";
+
+	// How a buffer view is written out
+	enum class view_kind
+	{
+		Unknown,     // Not read by any accessor yet
+		Copy,
+		Attributes,
+		Triangles,
+		Indices
+	};
+
+	struct view_plan
+	{
+		view_kind kind = view_kind::Unknown;
+		size_t stride = 0;       // Element size the codec sees
+		bool listsOnly = true;   // Index view read only by triangle lists, each starting on a whole triangle
+	};
+
+	struct encoded_view
+	{
+		size_t view;
+		meshopt_mode mode;
+		size_t count;
+		size_t stride;
+		const uint8_t* original;
+		size_t encodedOffset;  // Into the output buffer
+		size_t encodedSize;
+	};
+
+	uint32_t component_size(int64_t componentType)
+	{
+		switch (componentType)
+		{
+		case 5120: case 5121: return 1;
+		case 5122: case 5123: return 2;
+		case 5125: case 5126: return 4;
+		default: return 0;
+		}
+	}
+
+	uint32_t component_count(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT2") return 4;
+		if (type == "MAT3") return 9;
+		if (type == "MAT4") return 16;
+		return 0;
+	}
+
+	// Every accessor reading a view has to agree on what it holds, or the view is copied as it is
+	void plan_view(view_plan& plan, view_kind kind, size_t stride)
+	{
+		if (plan.kind == view_kind::Unknown)
+		{
+			plan.kind = kind;
+			plan.stride = stride;
+		}
+		else if (plan.kind != kind || plan.stride != stride)
+		{
+			plan.kind = view_kind::Copy;
+		}
+	}
+
+	void align(std::vector<uint8_t>& data, size_t alignment)
+	{
+		data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+	}
+
+	const char* mode_name(meshopt_mode mode)
+	{
+		switch (mode)
+		{
+		case meshopt_mode::Attributes: return "ATTRIBUTES";
+		case meshopt_mode::Triangles: return "TRIANGLES";
+		default: return "INDICES";
+		}
+	}
+
+	uint32_t read_index(const uint8_t* data, size_t i, size_t stride)
+	{
+		if (stride == 2)
+		{
+			uint16_t value;
+			std::memcpy(&value, data + i * 2, sizeof(value));
+			return value;
+		}
+		uint32_t value;
+		std::memcpy(&value, data + i * 4, sizeof(value));
+		return value;
+	}
+
+	// Triangle coding may start a triangle at another corner, which keeps its winding; anything else must match exactly
+	bool same_view(const encoded_view& entry, const uint8_t* decoded)
+	{
+		if (entry.mode != meshopt_mode::Triangles)
+			return std::memcmp(decoded, entry.original, entry.count * entry.stride) == 0;
+
+		for (size_t i = 0; i < entry.count; i += 3)
+		{
+			uint32_t a = read_index(entry.original, i, entry.stride), b = read_index(entry.original, i + 1, entry.stride),
+				c = read_index(entry.original, i + 2, entry.stride);
+			uint32_t x = read_index(decoded, i, entry.stride), y = read_index(decoded, i + 1, entry.stride),
+				z = read_index(decoded, i + 2, entry.stride);
+			if (!(a == x && b == y && c == z) && !(a == y && b == z && c == x) && !(a == z && b == x && c == y))
+				return false;
+		}
+		return true;
+	}
+
+	int fail(const std::string& error)
+	{
+		std::fprintf(stderr, "GltfCompress: %s\n", error.c_str());
+		return 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::fprintf(stderr, "Usage: GltfCompress input.gltf output.gltf\n");
+		return 1;
+	}
+	std::filesystem::path input = argv[1], output = argv[2];
+
+	json_value root;
+	{
+		mapped_file text;
+		std::string error;
+		if (!text.open(input))
+			return fail("Can't open " + input.string());
+		if (!parse_json(reinterpret_cast<const char*>(text.get_data()), text.get_size(), root, error))
+			return fail(error);
+	}
+	for (const json_value& extension : root.array("extensionsUsed"))
+	{
+		if (extension.string == EXTENSION)
+			return fail(input.string() + " is already compressed");
+	}
+
+	std::vector<std::unique_ptr<mapped_file>> buffers;
+	for (const json_value& buffer : root.array("buffers"))
+	{
+		const json_value* uri = buffer.find("uri");
+		if (!uri || uri->type != json_value::kind::String || uri->string.rfind("data:", 0) == 0)
+			return fail("Only external .bin buffers are supported");
+		auto file = std::make_unique<mapped_file>();
+		std::filesystem::path path = input.parent_path() / std::u8string(uri->string.begin(), uri->string.end());
+		if (!file->open(path))
+			return fail("Can't open buffer " + path.string());
+		buffers.push_back(std::move(file));
+	}
+
+	json_value* views = root.find("bufferViews");
+	if (!views || views->type != json_value::kind::Array)
+		return fail("No buffer views");
+	std::vector<const uint8_t*> viewData;
+	for (const json_value& view : views->items)
+	{
+		int64_t buffer = view.integer("buffer", -1);
+		int64_t offset = view.integer("byteOffset", 0);
+		int64_t length = view.integer("byteLength", 0);
+		if (buffer < 0 || buffer >= static_cast<int64_t>(buffers.size()) || offset < 0 || length < 0 ||
+			static_cast<size_t>(offset + length) > buffers[buffer]->get_size())
+			return fail("Buffer view out of range");
+		viewData.push_back(buffers[buffer]->get_data() + offset);
+	}
+
+	// Index accessors are the ones primitives name; the primitive mode decides whether triangle coding applies
+	const auto& accessors = root.array("accessors");
+	std::vector<int64_t> indexMode(accessors.size(), -1);
+	for (const json_value& mesh : root.array("meshes"))
+	{
+		for (const json_value& primitive : mesh.array("primitives"))
+		{
+			int64_t indices = primitive.integer("indices", -1);
+			if (indices < 0 || indices >= static_cast<int64_t>(accessors.size()))
+				continue;
+			int64_t mode = primitive.integer("mode", MODE_TRIANGLES);
+			indexMode[indices] = indexMode[indices] == -1 || indexMode[indices] == mode ? mode : 0;
+		}
+	}
+
+	std::vector<view_plan> plans(views->items.size());
+	for (size_t i = 0; i < accessors.size(); i++)
+	{
+		const json_value& source = accessors[i];
+		int64_t view = source.integer("bufferView", -1);
+		if (view < 0 || view >= static_cast<int64_t>(plans.size()))
+			continue;
+
+		const json_value* type = source.find("type");
+		size_t componentSize = component_size(source.integer("componentType", 0));
+		size_t elementSize = componentSize * (type ? component_count(type->string) : 0);
+		size_t byteStride = static_cast<size_t>(views->items[view].integer("byteStride", 0));
+		view_plan& plan = plans[view];
+		if (elementSize == 0 || source.find("sparse"))
+		{
+			plan.kind = view_kind::Copy;
+		}
+		else if (indexMode[i] >= 0)
+		{
+			plan_view(plan, byteStride == 0 && (elementSize == 2 || elementSize == 4) ? view_kind::Indices : view_kind::Copy, elementSize);
+			size_t offset = static_cast<size_t>(source.integer("byteOffset", 0));
+			size_t count = static_cast<size_t>(source.integer("count", 0));
+			if (indexMode[i] != MODE_TRIANGLES || offset % (elementSize * 3) != 0 || count % 3 != 0)
+				plan.listsOnly = false;
+		}
+		else
+		{
+			plan_view(plan, view_kind::Attributes, byteStride ? byteStride : elementSize);
+		}
+	}
+
+	// Streams the codec takes: attribute elements of whole 32-bit words up to 256 bytes, 16 or 32-bit indices
+	std::vector<uint8_t> data;
+	std::vector<encoded_view> encoded;
+	size_t fallbackSize = 0;
+	for (size_t i = 0; i < plans.size(); i++)
+	{
+		view_plan& plan = plans[i];
+		json_value& view = views->items[i];
+		size_t length = static_cast<size_t>(view.integer("byteLength", 0));
+		if (plan.kind == view_kind::Indices && plan.listsOnly && length % (plan.stride * 3) == 0)
+			plan.kind = view_kind::Triangles;
+		if (plan.kind == view_kind::Attributes && (plan.stride % 4 != 0 || plan.stride > 256))
+			plan.kind = view_kind::Copy;
+		if (plan.kind == view_kind::Unknown || plan.stride == 0 || length % plan.stride != 0 || length == 0)
+			plan.kind = view_kind::Copy;
+
+		if (plan.kind == view_kind::Copy)
+		{
+			align(data, 4);
+			view.member("buffer") = json_value::make_number(0);
+			view.member("byteOffset") = json_value::make_number(static_cast<double>(data.size()));
+			data.insert(data.end(), viewData[i], viewData[i] + length);
+			continue;
+		}
+
+		encoded_view entry = {};
+		entry.view = i;
+		entry.count = length / plan.stride;
+		entry.stride = plan.stride;
+		entry.original = viewData[i];
+		entry.mode = plan.kind == view_kind::Attributes ? meshopt_mode::Attributes :
+			plan.kind == view_kind::Triangles ? meshopt_mode::Triangles : meshopt_mode::Indices;
+
+		align(data, 4);
+		entry.encodedOffset = data.size();
+		if (entry.mode == meshopt_mode::Attributes)
+		{
+			encode_meshopt_attributes(entry.original, entry.count, entry.stride, data);
+		}
+		else
+		{
+			std::vector<uint32_t> indices(entry.count);
+			for (size_t j = 0; j < entry.count; j++)
+				indices[j] = read_index(entry.original, j, entry.stride);
+			if (entry.mode == meshopt_mode::Triangles)
+				encode_meshopt_triangles(indices.data(), indices.size(), data);
+			else
+				encode_meshopt_indices(indices.data(), indices.size(), data);
+		}
+		entry.encodedSize = data.size() - entry.encodedOffset;
+
+		// The view itself moves to the fallback buffer, which loaders without the extension would read instead
+		json_value compression = json_value::make_object();
+		compression.member("buffer") = json_value::make_number(0);
+		compression.member("byteOffset") = json_value::make_number(static_cast<double>(entry.encodedOffset));
+		compression.member("byteLength") = json_value::make_number(static_cast<double>(entry.encodedSize));
+		compression.member("byteStride") = json_value::make_number(static_cast<double>(entry.stride));
+		compression.member("count") = json_value::make_number(static_cast<double>(entry.count));
+		compression.member("mode") = json_value::make_string(mode_name(entry.mode));
+
+		fallbackSize = (fallbackSize + 3) & ~size_t(3);
+		view.member("buffer") = json_value::make_number(1);
+		view.member("byteOffset") = json_value::make_number(static_cast<double>(fallbackSize));
+		view.member("extensions").member(EXTENSION) = compression;
+		fallbackSize += length;
+		encoded.push_back(entry);
+	}
+	align(data, 4);
+
+	// Decoded the way the loader does it, every view in parallel, and compared with the original bytes
+	size_t decodedSize = 0;
+	std::vector<size_t> decodedOffsets;
+	for (const encoded_view& entry : encoded)
+	{
+		decodedOffsets.push_back(decodedSize);
+		decodedSize += (entry.count * entry.stride + 15) & ~size_t(15);
+	}
+	std::vector<uint8_t> decoded(decodedSize);
+	std::vector<uint8_t> matches(encoded.size(), 0);
+	auto decodeStart = std::chrono::steady_clock::now();
+	parallel_for(encoded.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const encoded_view& entry = encoded[i];
+			matches[i] = decode_meshopt(decoded.data() + decodedOffsets[i], entry.count, entry.stride, data.data() + entry.encodedOffset,
+				entry.encodedSize, entry.mode, meshopt_filter::None);
+		}
+	});
+	double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+	for (size_t i = 0; i < encoded.size(); i++)
+	{
+		const encoded_view& entry = encoded[i];
+		if (!matches[i] || !same_view(entry, decoded.data() + decodedOffsets[i]))
+			return fail("Buffer view " + std::to_string(entry.view) + " does not decode back to the original");
+	}
+
+	std::filesystem::path binary = output;
+	binary.replace_extension(".bin");
+	json_value outputBuffer = json_value::make_object();
+	std::u8string binaryName = binary.filename().u8string();
+	outputBuffer.member("uri") = json_value::make_string(std::string(binaryName.begin(), binaryName.end()));
+	outputBuffer.member("byteLength") = json_value::make_number(static_cast<double>(data.size()));
+	json_value& bufferList = root.member("buffers");
+	bufferList = json_value::make_array();
+	bufferList.items.push_back(outputBuffer);
+	if (!encoded.empty())
+	{
+		json_value fallback = json_value::make_object();
+		fallback.member("byteLength") = json_value::make_number(static_cast<double>(fallbackSize));
+		fallback.member("extensions").member(EXTENSION).member("fallback") = json_value::make_boolean(true);
+		bufferList.items.push_back(fallback);
+
+		for (const char* list : { "extensionsUsed", "extensionsRequired" })
+		{
+			json_value& extensions = root.member(list);
+			if (extensions.type != json_value::kind::Array)
+				extensions = json_value::make_array();
+			extensions.items.push_back(json_value::make_string(EXTENSION));
+		}
+	}
+
+	std::string text;
+	write_json(root, text);
+	std::ofstream jsonFile(output, std::ios::binary);
+	std::ofstream binaryFile(binary, std::ios::binary);
+	jsonFile.write(text.data(), static_cast<std::streamsize>(text.size()));
+	binaryFile.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	if (!jsonFile || !binaryFile)
+		return fail("Can't write " + output.string());
+
+	// Per stream kind, then everything the decoder touched
+	size_t totalOriginal = 0, totalEncoded = 0;
+	for (meshopt_mode mode : { meshopt_mode::Attributes, meshopt_mode::Triangles, meshopt_mode::Indices })
+	{
+		size_t count = 0, original = 0, compressed = 0;
+		for (const encoded_view& entry : encoded)
+		{
+			if (entry.mode != mode)
+				continue;
+			count++;
+			original += entry.count * entry.stride;
+			compressed += entry.encodedSize;
+		}
+		if (count == 0)
+			continue;
+		std::printf("%-10s %4zu views %12zu -> %12zu bytes, ratio %.2f\n", mode_name(mode), count, original, compressed,
+			static_cast<double>(original) / compressed);
+		totalOriginal += original;
+		totalEncoded += compressed;
+	}
+	if (totalEncoded > 0)
+	{
+		std::printf("Total      %4zu views %12zu -> %12zu bytes, ratio %.2f\n", encoded.size(), totalOriginal, totalEncoded,
+			static_cast<double>(totalOriginal) / totalEncoded);
+		std::printf("Decode     %.2f ms, %.2f GB/s on %zu threads\n", decodeSeconds * 1000.0, totalOriginal / decodeSeconds / 1e9, worker_count());
+	}
+	std::printf("Wrote %s and %s\n", output.string().c_str(), binary.string().c_str());
+	return 0;
+}
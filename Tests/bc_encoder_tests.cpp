@@ -0,0 +1,194 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/bc_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr size_t SIZE = 256;
+
+	// Smooth gradients with a little noise, like a photo or a baked albedo; alpha is opaque
+	std::vector<uint8_t> make_image(uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<int> noise(-3, 3);
+		std::vector<uint8_t> pixels(SIZE * SIZE * 4);
+		for (size_t y = 0; y < SIZE; y++)
+		{
+			for (size_t x = 0; x < SIZE; x++)
+			{
+				uint8_t* pixel = &pixels[(y * SIZE + x) * 4];
+				int values[3] = { static_cast<int>(x), static_cast<int>(y), static_cast<int>(128 + 100 * std::sin(x * 0.05) * std::cos(y * 0.03)) };
+				for (int c = 0; c < 3; c++)
+				{
+					pixel[c] = static_cast<uint8_t>(std::clamp(values[c] + noise(random), 0, 255));
+				}
+				pixel[3] = 255;
+			}
+		}
+		return pixels;
+	}
+
+	// The 4x4 block at bx, by as the encoders read it, 4 rows of 16 bytes
+	void read_block(const std::vector<uint8_t>& image, size_t bx, size_t by, uint8_t* block)
+	{
+		for (size_t row = 0; row < 4; row++)
+		{
+			std::memcpy(block + row * 16, &image[((by * 4 + row) * SIZE + bx * 4) * 4], 16);
+		}
+	}
+
+	void decode_565(uint16_t color, int* rgb)
+	{
+		int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// Reference decoders, written from the format description rather than the encoder
+	void decode_bc1(const uint8_t* block, uint8_t* pixels)
+	{
+		uint16_t c0, c1;
+		uint32_t indices;
+		std::memcpy(&c0, block, 2);
+		std::memcpy(&c1, block + 2, 2);
+		std::memcpy(&indices, block + 4, 4);
+		int palette[4][3];
+		decode_565(c0, palette[0]);
+		decode_565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = c0 > c1 ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = c0 > c1 ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			const int* color = palette[(indices >> (2 * i)) & 3];
+			for (int c = 0; c < 3; c++)
+			{
+				pixels[i * 4 + c] = static_cast<uint8_t>(color[c]);
+			}
+		}
+	}
+
+	void decode_bc4(const uint8_t* block, uint8_t* values)
+	{
+		int r0 = block[0], r1 = block[1];
+		int palette[8] = { r0, r1 };
+		for (int i = 2; i < 8; i++)
+		{
+			palette[i] = r0 > r1 ? ((8 - i) * r0 + (i - 1) * r1) / 7 : i < 6 ? ((6 - i) * r0 + (i - 1) * r1) / 5 : i == 6 ? 0 : 255;
+		}
+		uint64_t indices = 0;
+		std::memcpy(&indices, block + 2, 6);
+		for (int i = 0; i < 16; i++)
+		{
+			values[i] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+		}
+	}
+
+	double psnr(double squaredError, size_t samples)
+	{
+		return squaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 * samples / squaredError) : 99.0;
+	}
+}
+
+TEST(bc1_psnr_on_smooth_color)
+{
+	std::vector<uint8_t> image = make_image(1);
+	double squaredError = 0.0;
+	for (size_t by = 0; by < SIZE / 4; by++)
+	{
+		for (size_t bx = 0; bx < SIZE / 4; bx++)
+		{
+			uint8_t pixels[64], block[8], decoded[64];
+			read_block(image, bx, by, pixels);
+			encode_bc1_block(pixels, block);
+			decode_bc1(block, decoded);
+			for (int i = 0; i < 64; i++)
+			{
+				int error = i % 4 == 3 ? 0 : pixels[i] - decoded[i];
+				squaredError += error * error;
+			}
+
+			// Always the opaque 4-color mode
+			uint16_t c0, c1;
+			std::memcpy(&c0, block, 2);
+			std::memcpy(&c1, block + 2, 2);
+			CHECK(c0 > c1 || (c0 == c1 && std::memcmp(block + 4, "\0\0\0\0", 4) == 0));
+		}
+	}
+
+	// Above the 36 dB texture uses to keep BC1 for opaque color
+	CHECK(psnr(squaredError, SIZE * SIZE * 3) >= 39.0);
+}
+
+TEST(bc4_error_within_one_palette_step)
+{
+	std::vector<uint8_t> image = make_image(2);
+	double squaredError = 0.0;
+	for (int channel = 0; channel < 3; channel++)
+	{
+		for (size_t by = 0; by < SIZE / 4; by++)
+		{
+			for (size_t bx = 0; bx < SIZE / 4; bx++)
+			{
+				uint8_t pixels[64], block[8], decoded[16];
+				read_block(image, bx, by, pixels);
+				encode_bc4_block(pixels, channel, block);
+				decode_bc4(block, decoded);
+
+				// Endpoints at the block's range split it into 7 steps, so no texel is more than half a step off
+				int low = 255, high = 0;
+				for (int i = 0; i < 16; i++)
+				{
+					low = std::min<int>(low, pixels[i * 4 + channel]);
+					high = std::max<int>(high, pixels[i * 4 + channel]);
+				}
+				for (int i = 0; i < 16; i++)
+				{
+					int error = pixels[i * 4 + channel] - decoded[i];
+					CHECK(std::abs(error) <= (high - low) / 14 + 1);
+					squaredError += error * error;
+				}
+			}
+		}
+	}
+	CHECK(psnr(squaredError, SIZE * SIZE * 3) >= 50.0);
+}
+
+TEST(bc5_keeps_normal_xy_apart)
+{
+	// Red and green vary independently, as a tangent-space normal map's X and Y do
+	std::vector<uint8_t> image = make_image(3);
+	double squaredError[2] = {};
+	for (size_t by = 0; by < SIZE / 4; by++)
+	{
+		for (size_t bx = 0; bx < SIZE / 4; bx++)
+		{
+			uint8_t pixels[64], block[16], decoded[2][16];
+			read_block(image, bx, by, pixels);
+			encode_bc5_block(pixels, block);
+			decode_bc4(block, decoded[0]);
+			decode_bc4(block + 8, decoded[1]);
+			for (int channel = 0; channel < 2; channel++)
+			{
+				for (int i = 0; i < 16; i++)
+				{
+					int error = pixels[i * 4 + channel] - decoded[channel][i];
+					squaredError[channel] += error * error;
+				}
+			}
+		}
+	}
+	CHECK(psnr(squaredError[0], SIZE * SIZE) >= 50.0);
+	CHECK(psnr(squaredError[1], SIZE * SIZE) >= 50.0);
+}
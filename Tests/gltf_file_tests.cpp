@@ -0,0 +1,319 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/gltf_file.h"
+#include "../D3D11Renderer/Core/scene_graph.h"
+
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	struct gltf_vertex
+	{
+		float position[3];
+		float texcoord[2];
+		float normal[3];
+		float tangent[3];
+		float bitangent[3];
+	};
+
+	const gltf_vertex_layout LAYOUT = { sizeof(gltf_vertex), offsetof(gltf_vertex, position), offsetof(gltf_vertex, texcoord),
+		offsetof(gltf_vertex, normal), offsetof(gltf_vertex, tangent), offsetof(gltf_vertex, bitangent) };
+
+	float dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	bool is_unit(const float* v)
+	{
+		return std::fabs(std::sqrt(dot(v, v)) - 1.0f) <= 1e-3f;
+	}
+
+	// Opens and reads a bundled model, checking what holds for any file: every index in range and unit normals and
+	// tangents
+	bool load(const char* path, gltf_file& file, std::vector<gltf_vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		bool opened = file.open(tests::data_path(path));
+		CHECK(opened);
+		CHECK(file.get_error().empty());
+		if (!opened)
+		{
+			return false;
+		}
+
+		CHECK(file.get_vertex_count() > 0);
+		CHECK(file.get_index_count() > 0);
+		CHECK(file.get_index_count() % 3 == 0);
+		vertices.resize(file.get_vertex_count());
+		indices.resize(file.get_index_count());
+		file.read(vertices.data(), LAYOUT, indices.data());
+
+		size_t outOfRange = 0, badNormals = 0, badTangents = 0;
+		for (const gltf_primitive& primitive : file.get_primitives())
+		{
+			for (size_t i = primitive.startIndex; i < primitive.startIndex + primitive.indexCount; i++)
+			{
+				outOfRange += indices[i] < primitive.startVertex || indices[i] >= primitive.startVertex + primitive.vertexCount ? 1 : 0;
+			}
+		}
+		for (const gltf_vertex& vertex : vertices)
+		{
+			badNormals += is_unit(vertex.normal) ? 0 : 1;
+			badTangents += is_unit(vertex.tangent) ? 0 : 1;
+		}
+		CHECK(outOfRange == 0);
+		CHECK(badNormals == 0);
+		CHECK(badTangents == 0);
+		return true;
+	}
+
+	// Row-vector node to parent transform: scale, then rotate, then translate
+	void compose(const gltf_node& node, float transform[4][4])
+	{
+		float x = node.rotation[0], y = node.rotation[1], z = node.rotation[2], w = node.rotation[3];
+		const float rows[3][3] = {
+			{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) },
+			{ 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) },
+			{ 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) } };
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				transform[row][column] = rows[row][column] * node.scale[row];
+			}
+			transform[row][3] = 0.0f;
+			transform[3][row] = node.translation[row];
+		}
+		transform[3][3] = 1.0f;
+	}
+
+	void multiply(const float a[4][4], const float b[4][4], float result[4][4])
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				result[row][column] = a[row][0] * b[0][column] + a[row][1] * b[1][column] + a[row][2] * b[2][column] + a[row][3] * b[3][column];
+			}
+		}
+	}
+
+	float max_difference(const float a[4][4], const float b[4][4])
+	{
+		float difference = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			difference = std::fmax(difference, std::fabs(a[i / 4][i % 4] - b[i / 4][i % 4]));
+		}
+		return difference;
+	}
+}
+
+TEST(gltf_loads_damaged_helmet)
+{
+	gltf_file file;
+	std::vector<gltf_vertex> vertices;
+	std::vector<uint32_t> indices;
+	if (!load("Models/DamagedHelmet/DamagedHelmet.gltf", file, vertices, indices))
+	{
+		return;
+	}
+
+	CHECK(file.get_vertex_count() == 14556);
+	CHECK(file.get_index_count() == 46356);
+	CHECK(file.get_mesh_count() == 1);
+	CHECK(file.get_primitives().size() == 1);
+	CHECK(file.get_instances().size() == 1);
+
+	// No TANGENT in the file, so they come from the UVs, at right angles to the normal
+	CHECK(!file.get_primitives()[0].hasTangents);
+	CHECK(file.get_stats().generatedTangents == 1);
+	size_t skewed = 0;
+	for (const gltf_vertex& vertex : vertices)
+	{
+		skewed += std::fabs(dot(vertex.normal, vertex.tangent)) <= 1e-3f && is_unit(vertex.bitangent) ? 0 : 1;
+	}
+	CHECK(skewed == 0);
+
+	// Its one node stands the helmet up with a quarter turn about X
+	CHECK(file.get_nodes().size() == 1);
+	CHECK(file.get_instances()[0].node == 0);
+	const gltf_node& node = file.get_nodes()[0];
+	CHECK(node.parent == gltf_node::NO_PARENT);
+	CHECK(std::fabs(node.rotation[0] - 0.7071068f) <= 1e-6f && std::fabs(node.rotation[3] - 0.7071068f) <= 1e-6f);
+	CHECK(node.scale[0] == 1.0f && node.translation[0] == 0.0f);
+
+	CHECK(file.get_materials().size() == 1);
+	const gltf_material& material = file.get_materials()[0];
+	CHECK(material.baseColor == "Default_albedo.jpg");
+	CHECK(material.normal == "Default_normal.jpg");
+	CHECK(material.occlusion == "Default_AO.jpg");
+	CHECK(material.emissive == "Default_emissive.jpg");
+	CHECK(material.metallicRoughness == "Default_metalRoughness.jpg");
+	CHECK(material.alphaCutoff == 0.0f);
+
+	// Only the emissive factor is given; the rest keep glTF's defaults
+	const material_factors& factors = material.factors;
+	CHECK(factors.emissive[0] == 1.0f && factors.emissive[1] == 1.0f && factors.emissive[2] == 1.0f);
+	CHECK(factors.baseColor[0] == 1.0f && factors.baseColor[3] == 1.0f);
+	CHECK(factors.metallic == 1.0f && factors.roughness == 1.0f);
+}
+
+TEST(gltf_loads_scifi_helmet)
+{
+	gltf_file file;
+	std::vector<gltf_vertex> vertices;
+	std::vector<uint32_t> indices;
+	if (!load("Models/SciFiHelmet/SciFiHelmet.gltf", file, vertices, indices))
+	{
+		return;
+	}
+
+	// No vertex is shared; the index buffer counts up from 0
+	CHECK(file.get_vertex_count() == 70074);
+	CHECK(file.get_index_count() == 70074);
+	CHECK(indices[0] == 0 && indices.back() == 70073);
+
+	// The camera node comes first and places nothing
+	CHECK(file.get_nodes().size() == 2);
+	CHECK(file.get_instances().size() == 1 && file.get_instances()[0].node == 1);
+
+	// TANGENT is in the file and used as is
+	CHECK(file.get_primitives()[0].hasTangents);
+	CHECK(file.get_stats().generatedTangents == 0);
+
+	CHECK(file.get_materials().size() == 1);
+	CHECK(file.get_materials()[0].baseColor == "SciFiHelmet_BaseColor.png");
+	CHECK(file.get_materials()[0].normal == "SciFiHelmet_Normal.png");
+	CHECK(file.get_materials()[0].metallicRoughness == "SciFiHelmet_MetallicRoughness.png");
+}
+
+TEST(gltf_reports_missing_files)
+{
+	gltf_file file;
+	CHECK(!file.open(tests::data_path("Models/Missing/Missing.gltf")));
+	CHECK(!file.get_error().empty());
+}
+
+TEST(gltf_keeps_node_hierarchy)
+{
+	// One triangle placed by three nodes of a small tree, two of them given as matrices, one of those mirrored
+	std::filesystem::path root = std::filesystem::temp_directory_path() / "d3d11renderer_tests" / "hierarchy";
+	std::filesystem::create_directories(root);
+	const float positions[9] = { 0, 0, 0, 1, 0, 0, 0, 1, 0 };
+	std::ofstream(root / "triangle.bin", std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char*>(positions), sizeof(positions));
+	std::ofstream(root / "hierarchy.gltf", std::ios::trunc) << R"({
+		"asset": { "version": "2.0" },
+		"scene": 0,
+		"scenes": [ { "nodes": [ 0 ] } ],
+		"nodes": [
+			{ "translation": [ 1, 2, 3 ], "children": [ 1, 2 ] },
+			{ "matrix": [ 0, 0, -2, 0,  0, 2, 0, 0,  2, 0, 0, 0,  4, 0, 0, 1 ], "mesh": 0, "children": [ 3 ] },
+			{ "matrix": [ -1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 5, 0, 1 ], "mesh": 0 },
+			{ "rotation": [ 0, 0, 0.3826834, 0.9238795 ], "scale": [ 0.5, 0.5, 0.5 ], "translation": [ 0, 0, 1 ], "mesh": 0 }
+		],
+		"meshes": [ { "primitives": [ { "attributes": { "POSITION": 0 } } ] } ],
+		"accessors": [ { "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 0, 0, 0 ], "max": [ 1, 1, 0 ] } ],
+		"bufferViews": [ { "buffer": 0, "byteLength": 36 } ],
+		"buffers": [ { "uri": "triangle.bin", "byteLength": 36 } ]
+	})";
+
+	gltf_file file;
+	bool opened = file.open(root / "hierarchy.gltf");
+	CHECK(opened);
+	CHECK(file.get_error().empty());
+	if (!opened)
+	{
+		return;
+	}
+
+	// Depth first, parents before children
+	const std::vector<gltf_node>& nodes = file.get_nodes();
+	CHECK(nodes.size() == 4);
+	if (nodes.size() != 4)
+	{
+		return;
+	}
+	CHECK(nodes[0].parent == gltf_node::NO_PARENT && nodes[1].parent == 0 && nodes[2].parent == 1 && nodes[3].parent == 0);
+	CHECK(file.get_instances().size() == 3);
+
+	// The first matrix is a quarter turn about Y at scale 2; the mirror goes into the X scale
+	CHECK(std::fabs(nodes[1].scale[0] - 2.0f) <= 1e-5f && std::fabs(nodes[1].scale[2] - 2.0f) <= 1e-5f);
+	CHECK(std::fabs(std::fabs(nodes[1].rotation[1]) - 0.7071068f) <= 1e-5f && std::fabs(std::fabs(nodes[1].rotation[3]) - 0.7071068f) <= 1e-5f);
+	CHECK(nodes[1].translation[0] == 4.0f);
+	CHECK(nodes[3].scale[0] == -1.0f && nodes[3].rotation[3] == 1.0f && nodes[3].translation[1] == 5.0f);
+
+	// Through a scene graph every node lands where multiplying the file's own transforms down the tree puts it
+	float expected[4][4][4] = {
+		{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 1, 2, 3, 1 } },
+		{ { 0, 0, -2, 0 }, { 0, 2, 0, 0 }, { 2, 0, 0, 0 }, { 5, 2, 3, 1 } },
+		{},
+		{ { -1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 1, 7, 3, 1 } } };
+	float local[4][4];
+	compose(nodes[2], local);
+	multiply(local, expected[1], expected[2]);
+
+	scene_graph graph;
+	std::vector<uint32_t> ids;
+	for (const gltf_node& node : nodes)
+	{
+		uint32_t id = graph.add_node(node.parent == gltf_node::NO_PARENT ? scene_graph::ROOT : ids[node.parent]);
+		graph.set_translation(id, node.translation[0], node.translation[1], node.translation[2]);
+		graph.set_rotation(id, node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]);
+		graph.set_scale(id, node.scale[0], node.scale[1], node.scale[2]);
+		ids.push_back(id);
+	}
+	graph.update();
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		float world[4][4];
+		graph.get_world(ids[i], world);
+		CHECK(max_difference(world, expected[i]) <= 1e-5f);
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(root, error);
+}
+
+TEST(gltf_reads_material_factors)
+{
+	// Two materials on one triangle: every factor given, and none
+	std::filesystem::path root = std::filesystem::temp_directory_path() / "d3d11renderer_tests" / "factors";
+	std::filesystem::create_directories(root);
+	const float positions[9] = { 0, 0, 0, 1, 0, 0, 0, 1, 0 };
+	std::ofstream(root / "triangle.bin", std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char*>(positions), sizeof(positions));
+	std::ofstream(root / "factors.gltf", std::ios::trunc) << R"({
+		"asset": { "version": "2.0" },
+		"nodes": [ { "mesh": 0 } ],
+		"materials": [
+			{ "pbrMetallicRoughness": { "baseColorFactor": [ 0.5, 0.25, 1, 0.75 ], "metallicFactor": 0.2, "roughnessFactor": 0.6 },
+				"emissiveFactor": [ 2, 3, 4 ] },
+			{ "name": "plain" }
+		],
+		"meshes": [ { "primitives": [ { "attributes": { "POSITION": 0 }, "material": 0 } ] } ],
+		"accessors": [ { "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 0, 0, 0 ], "max": [ 1, 1, 0 ] } ],
+		"bufferViews": [ { "buffer": 0, "byteLength": 36 } ],
+		"buffers": [ { "uri": "triangle.bin", "byteLength": 36 } ]
+	})";
+
+	gltf_file file;
+	CHECK(file.open(root / "factors.gltf"));
+	CHECK(file.get_materials().size() == 2);
+	if (file.get_materials().size() == 2)
+	{
+		const material_factors& given = file.get_materials()[0].factors;
+		CHECK(given.baseColor[0] == 0.5f && given.baseColor[1] == 0.25f && given.baseColor[2] == 1.0f && given.baseColor[3] == 0.75f);
+		CHECK(given.emissive[0] == 2.0f && given.emissive[1] == 3.0f && given.emissive[2] == 4.0f);
+		CHECK(given.metallic == 0.2f && given.roughness == 0.6f);
+		CHECK(file.get_materials()[1].factors == material_factors());
+		CHECK(!(given == material_factors()));
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(root, error);
+}
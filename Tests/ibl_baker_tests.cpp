@@ -0,0 +1,270 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/ibl_baker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr float PI = 3.14159265f;
+	constexpr size_t WIDTH = 256;
+	constexpr size_t HEIGHT = 128;
+
+	struct float3
+	{
+		float x, y, z;
+	};
+
+	float dot(float3 a, float3 b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	float3 normalize(float3 v)
+	{
+		float length = std::sqrt(dot(v, v));
+		return { v.x / length, v.y / length, v.z / length };
+	}
+
+	// Direction at the centre of a lat-long texel, the inverse of the mapping in environment_map
+	float3 texel_direction(size_t x, size_t y)
+	{
+		float theta = (y + 0.5f) / HEIGHT * PI;
+		float phi = (0.5f - (x + 0.5f) / WIDTH) * 2.0f * PI;
+		return { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+	}
+
+	float texel_solid_angle(size_t y)
+	{
+		return (2.0f * PI / WIDTH) * (PI / HEIGHT) * std::sin((y + 0.5f) / HEIGHT * PI);
+	}
+
+	// A panorama with the same radiance in every channel, given per direction
+	std::vector<float> make_environment(const std::function<float(float3)>& radiance)
+	{
+		std::vector<float> texels(WIDTH * HEIGHT * 4);
+		for (size_t y = 0; y < HEIGHT; y++)
+		{
+			for (size_t x = 0; x < WIDTH; x++)
+			{
+				float value = radiance(texel_direction(x, y));
+				float* texel = &texels[(y * WIDTH + x) * 4];
+				texel[0] = texel[1] = texel[2] = value;
+				texel[3] = 1.0f;
+			}
+		}
+		return texels;
+	}
+
+	ibl_data bake(const std::vector<float>& texels)
+	{
+		ibl_settings settings;
+		settings.specularSize = 64;
+		settings.specularMips = 5;  // Roughness 0, 0.25, 0.5, 0.75 and 1
+		settings.specularSamples = 512;
+		settings.lutSize = 32;
+		settings.lutSamples = 512;
+
+		ibl_data data;
+		ibl_baker::bake({ WIDTH, HEIGHT, texels.data() }, settings, data);
+		return data;
+	}
+
+	// The diffuse term as lightps.hlsl's evaluate_irradiance reads it, red channel
+	float evaluate_irradiance(const ibl_data& data, float3 n)
+	{
+		const float basis[9] = { 0.282095f, 0.488603f * n.y, 0.488603f * n.z, 0.488603f * n.x, 1.092548f * n.x * n.y,
+			1.092548f * n.y * n.z, 0.315392f * (3.0f * n.z * n.z - 1.0f), 1.092548f * n.x * n.z, 0.546274f * (n.x * n.x - n.y * n.y) };
+		float result = 0.0f;
+		for (int k = 0; k < 9; k++)
+		{
+			result += data.irradiance[k][0] * basis[k];
+		}
+		return result;
+	}
+
+	// Texel x, y of the +X face of one specular mip, and the direction through its centre (D3D cube layout)
+	const float* specular_texel(const ibl_data& data, uint32_t mip, size_t x, size_t y, float3& direction)
+	{
+		size_t size = std::max<size_t>(1, data.specularSize >> mip);
+		float s = 2.0f * (x + 0.5f) / size - 1.0f;
+		float t = 2.0f * (y + 0.5f) / size - 1.0f;
+		direction = normalize({ 1.0f, -t, -s });
+		return data.specular.data() + ibl_baker::get_specular_offset(data, 0, mip) + (y * size + x) * 4;
+	}
+
+	float ggx(float nDotH, float alpha)
+	{
+		float denominator = nDotH * nDotH * (alpha * alpha - 1.0f) + 1.0f;
+		return alpha * alpha / (PI * denominator * denominator);
+	}
+
+	// What the prefiltered map approximates with N = V = R: radiance weighted by the GGX lobe around n and N.L
+	float prefilter_reference(const std::vector<float>& texels, float3 n, float alpha)
+	{
+		double sum = 0.0, weight = 0.0;
+		for (size_t y = 0; y < HEIGHT; y++)
+		{
+			for (size_t x = 0; x < WIDTH; x++)
+			{
+				float3 l = texel_direction(x, y);
+				float nDotL = dot(n, l);
+				if (nDotL <= 0.0f)
+				{
+					continue;
+				}
+				float3 h = normalize({ n.x + l.x, n.y + l.y, n.z + l.z });
+				double w = ggx(dot(n, h), alpha) * nDotL * texel_solid_angle(y);
+				sum += w * texels[(y * WIDTH + x) * 4];
+				weight += w;
+			}
+		}
+		return static_cast<float>(sum / weight);
+	}
+
+	// Split-sum scale and bias by quadrature over half vectors, with the same Schlick-Smith k = alpha / 2
+	void brdf_reference(float nDotV, float roughness, float& scale, float& bias)
+	{
+		float alpha = roughness * roughness;
+		float k = alpha * 0.5f;
+		float3 v = { std::sqrt(1.0f - nDotV * nDotV), 0.0f, nDotV };
+		double sums[2] = {};
+		const int thetaSteps = 2048, phiSteps = 256;
+		for (int i = 0; i < thetaSteps; i++)
+		{
+			float theta = (i + 0.5f) / thetaSteps * 0.5f * PI;
+			for (int j = 0; j < phiSteps; j++)
+			{
+				float phi = (j + 0.5f) / phiSteps * 2.0f * PI;
+				float3 h = { std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) };
+				float vDotH = dot(v, h);
+				float nDotL = 2.0f * vDotH * h.z - nDotV;
+				if (nDotL <= 0.0f)
+				{
+					continue;
+				}
+
+				// pdf of h times the estimator the baker averages, over the solid angle of this step
+				float visibility = nDotV / (nDotV * (1.0f - k) + k) * nDotL / (nDotL * (1.0f - k) + k);
+				double term = ggx(h.z, alpha) * h.z * visibility * vDotH / (h.z * nDotV) *
+					std::sin(theta) * (0.5f * PI / thetaSteps) * (2.0f * PI / phiSteps);
+				float fresnel = std::pow(1.0f - vDotH, 5.0f);
+				sums[0] += term * (1.0f - fresnel);
+				sums[1] += term * fresnel;
+			}
+		}
+		scale = static_cast<float>(sums[0]);
+		bias = static_cast<float>(sums[1]);
+	}
+}
+
+TEST(ibl_constant_environment_is_l0_only)
+{
+	ibl_data data = bake(make_environment([](float3) { return 2.0f; }));
+
+	// 2 * 4pi * Y0, and nothing in the higher bands
+	CHECK(std::fabs(data.irradiance[0][0] - 2.0f * 4.0f * PI * 0.282095f) <= 0.01f);
+	for (int k = 1; k < 9; k++)
+	{
+		CHECK(std::fabs(data.irradiance[k][0]) <= 1e-3f);
+	}
+
+	// A white Lambert surface reflects the radiance it sits in, whichever way it faces
+	for (float3 n : { float3{ 0, 1, 0 }, float3{ 0, -1, 0 }, float3{ 1, 0, 0 }, normalize({ 1, 1, -1 }) })
+	{
+		CHECK(std::fabs(evaluate_irradiance(data, n) - 2.0f) <= 0.01f);
+	}
+}
+
+TEST(ibl_cosine_sky_gives_analytic_l1)
+{
+	// Radiance 1 + d.y: irradiance over pi is 1 + 2/3 n.y, all of it in L0 and the Y coefficient of L1
+	ibl_data data = bake(make_environment([](float3 d) { return 1.0f + d.y; }));
+	CHECK(std::fabs(data.irradiance[1][0] - 0.488603f * 4.0f * PI / 3.0f * 2.0f / 3.0f) <= 0.01f);
+	CHECK(std::fabs(data.irradiance[2][0]) <= 1e-3f);
+	CHECK(std::fabs(data.irradiance[3][0]) <= 1e-3f);
+
+	for (float3 n : { float3{ 0, 1, 0 }, float3{ 0, -1, 0 }, float3{ 1, 0, 0 }, normalize({ 1, 1, -1 }) })
+	{
+		CHECK(std::fabs(evaluate_irradiance(data, n) - (1.0f + 2.0f / 3.0f * n.y)) <= 0.01f);
+	}
+}
+
+TEST(ibl_roughness_zero_reproduces_source)
+{
+	// Eight bands around the horizon, a few dozen cube texels wide; a blurred level would flatten them
+	auto radiance = [](float3 d) { return 1.0f + 0.5f * d.x + 0.5f * std::sin(8.0f * std::atan2(d.z, d.x)) * (1.0f - d.y * d.y); };
+	ibl_data data = bake(make_environment(radiance));
+
+	float worst = 0.0f;
+	for (size_t y = 0; y < data.specularSize; y += 7)
+	{
+		for (size_t x = 0; x < data.specularSize; x += 7)
+		{
+			float3 direction;
+			const float* texel = specular_texel(data, 0, x, y, direction);
+			worst = std::max(worst, std::fabs(texel[0] - radiance(direction)));
+		}
+	}
+	CHECK(worst <= 0.01f);
+}
+
+TEST(ibl_point_source_matches_ggx_lobe)
+{
+	// A 3 degree disc of light straight down +X, in the middle of the +X face
+	std::vector<float> texels = make_environment([](float3 d) { return d.x > std::cos(3.0f * PI / 180.0f) ? 100.0f : 0.0f; });
+	ibl_data data = bake(texels);
+
+	// Along the face's middle row from the centre to the edge, about 43 degrees off, for roughness 0.5 and 0.75
+	float edgeRatios[2];
+	for (uint32_t mip : { 2u, 3u })
+	{
+		float roughness = mip / 4.0f;
+		size_t size = data.specularSize >> mip;
+		float peak = prefilter_reference(texels, { 1.0f, 0.0f, 0.0f }, roughness * roughness);
+		for (size_t x = size / 2; x < size; x++)
+		{
+			float3 direction;
+			const float* texel = specular_texel(data, mip, x, size / 2, direction);
+			float reference = prefilter_reference(texels, direction, roughness * roughness);
+			CHECK(std::fabs(texel[0] - reference) <= 0.1f * peak);
+			if (x == size - 1)
+			{
+				edgeRatios[mip - 2] = texel[0] / peak;
+			}
+		}
+	}
+
+	// The rougher lobe spreads more of the light to the edge
+	CHECK(edgeRatios[1] > 2.0f * edgeRatios[0]);
+}
+
+TEST(ibl_brdf_lut_matches_split_sum)
+{
+	ibl_data data = bake(make_environment([](float3) { return 1.0f; }));
+	CHECK(data.brdfLut.size() == data.lutSize * data.lutSize * 2);
+	for (size_t i = 0; i < data.brdfLut.size(); i += 2)
+	{
+		CHECK(data.brdfLut[i] >= 0.0f && data.brdfLut[i + 1] >= 0.0f);
+		CHECK(data.brdfLut[i] + data.brdfLut[i + 1] <= 1.0f);
+	}
+
+	// The last column, N.V closest to 1. A mirror reflects all of F0 and no Fresnel bias; rougher loses some to G
+	size_t size = data.lutSize;
+	float nDotV = (size - 0.5f) / size;
+	const float* smooth = &data.brdfLut[(size - 1) * 2];
+	CHECK(std::fabs(smooth[0] - 1.0f) <= 0.02f && smooth[1] <= 0.01f);
+
+	for (size_t y : { size / 4, size / 2, size - 1 })
+	{
+		float scale, bias;
+		brdf_reference(nDotV, (y + 0.5f) / size, scale, bias);
+		const float* entry = &data.brdfLut[(y * size + size - 1) * 2];
+		CHECK(std::fabs(entry[0] - scale) <= 0.02f);
+		CHECK(std::fabs(entry[1] - bias) <= 0.01f);
+	}
+}
@@ -0,0 +1,258 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr float NEAR_Z = 0.1f;
+	constexpr float FAR_Z = 100.0f;
+
+	// What XMMatrixPerspectiveFovLH makes, row vectors
+	void make_projection(float fovY, float aspect, float projection[4][4])
+	{
+		float scaleY = 1.0f / std::tan(fovY * 0.5f);
+		float range = FAR_Z / (FAR_Z - NEAR_Z);
+		const float values[4][4] = { { scaleY / aspect, 0, 0, 0 }, { 0, scaleY, 0, 0 }, { 0, 0, range, 1 }, { 0, 0, -range * NEAR_Z, 0 } };
+		std::copy(&values[0][0], &values[0][0] + 16, &projection[0][0]);
+	}
+
+	// A camera at (2, 3, -20) turned 30 degrees about Y, as a world-to-view matrix
+	void make_view(float view[4][4])
+	{
+		float c = std::cos(0.5235988f), s = std::sin(0.5235988f);
+		float eye[3] = { 2.0f, 3.0f, -20.0f };
+		const float values[4][4] = { { c, 0, s, 0 }, { 0, 1, 0, 0 }, { -s, 0, c, 0 },
+			{ -(eye[0] * c - eye[2] * s), -eye[1], -(eye[0] * s + eye[2] * c), 1 } };
+		std::copy(&values[0][0], &values[0][0] + 16, &view[0][0]);
+	}
+
+	void to_view(const float view[4][4], float x, float y, float z, float result[3])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			result[i] = x * view[0][i] + y * view[1][i] + z * view[2][i] + view[3][i];
+		}
+	}
+
+	// One cluster's cell, worked out from the settings on its own: NDC extent and view depth
+	struct cluster_cell
+	{
+		float left, right, bottom, top, nearZ, farZ;
+	};
+
+	cluster_cell get_cell(const cluster_settings& settings, uint32_t x, uint32_t y, uint32_t slice)
+	{
+		cluster_cell cell;
+		cell.left = -1.0f + 2.0f * x / settings.tilesX;
+		cell.right = -1.0f + 2.0f * (x + 1) / settings.tilesX;
+		cell.top = 1.0f - 2.0f * y / settings.tilesY;
+		cell.bottom = 1.0f - 2.0f * (y + 1) / settings.tilesY;
+		cell.nearZ = NEAR_Z * std::pow(FAR_Z / NEAR_Z, static_cast<float>(slice) / settings.slices);
+		cell.farZ = NEAR_Z * std::pow(FAR_Z / NEAR_Z, static_cast<float>(slice + 1) / settings.slices);
+		return cell;
+	}
+
+	// Distance from a point to the cell's axis-aligned view-space box
+	double box_distance(const cluster_cell& cell, const float projection[4][4], const float p[3])
+	{
+		double minX = std::min(cell.left * cell.nearZ, cell.left * cell.farZ) / projection[0][0];
+		double maxX = std::max(cell.right * cell.nearZ, cell.right * cell.farZ) / projection[0][0];
+		double minY = std::min(cell.bottom * cell.nearZ, cell.bottom * cell.farZ) / projection[1][1];
+		double maxY = std::max(cell.top * cell.nearZ, cell.top * cell.farZ) / projection[1][1];
+		double dx = std::max({ minX - p[0], 0.0, p[0] - maxX });
+		double dy = std::max({ minY - p[1], 0.0, p[1] - maxY });
+		double dz = std::max({ static_cast<double>(cell.nearZ) - p[2], 0.0, p[2] - static_cast<double>(cell.farZ) });
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	// Distance from a point to the cell itself, the frustum piece bounded by six planes, by Dykstra's alternating
+	// projection onto them, which converges on the nearest point of their intersection
+	double cell_distance(const cluster_cell& cell, const float projection[4][4], const float p[3])
+	{
+		// a . q <= b for every q inside
+		const double sx = projection[0][0], sy = projection[1][1];
+		const double planes[6][4] = {
+			{ -sx, 0, cell.left, 0 }, { sx, 0, -cell.right, 0 },
+			{ 0, -sy, cell.bottom, 0 }, { 0, sy, -cell.top, 0 },
+			{ 0, 0, -1, -cell.nearZ }, { 0, 0, 1, cell.farZ } };
+
+		double q[3] = { p[0], p[1], p[2] };
+		double corrections[6][3] = {};
+		for (int iteration = 0; iteration < 400; iteration++)
+		{
+			double moved = 0.0;
+			for (int plane = 0; plane < 6; plane++)
+			{
+				const double* a = planes[plane];
+				double y[3] = { q[0] + corrections[plane][0], q[1] + corrections[plane][1], q[2] + corrections[plane][2] };
+				double excess = a[0] * y[0] + a[1] * y[1] + a[2] * y[2] - a[3];
+				double step = excess > 0.0 ? excess / (a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) : 0.0;
+				for (int i = 0; i < 3; i++)
+				{
+					double projected = y[i] - step * a[i];
+					corrections[plane][i] = y[i] - projected;
+					moved += std::fabs(projected - q[i]);
+					q[i] = projected;
+				}
+			}
+			if (moved < 1e-9)
+			{
+				break;
+			}
+		}
+		return std::sqrt((q[0] - p[0]) * (q[0] - p[0]) + (q[1] - p[1]) * (q[1] - p[1]) + (q[2] - p[2]) * (q[2] - p[2]));
+	}
+
+	// Clusters a light was binned into
+	std::vector<std::set<uint32_t>> get_binned(const light_clusters& clusters, size_t lightCount)
+	{
+		std::vector<std::set<uint32_t>> binned(lightCount);
+		const std::vector<cluster_range>& ranges = clusters.get_ranges();
+		const std::vector<uint32_t>& indices = clusters.get_indices();
+		for (uint32_t cluster = 0; cluster < ranges.size(); cluster++)
+		{
+			for (uint32_t i = ranges[cluster].offset; i < ranges[cluster].offset + ranges[cluster].count; i++)
+			{
+				binned[indices[i]].insert(cluster);
+			}
+		}
+		return binned;
+	}
+
+	// Lights scattered through a Sponza-sized hall in front of the camera
+	punctual_lights make_lights(size_t count, float minRange, float maxRange, uint32_t seed)
+	{
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<float> x(-15.0f, 15.0f), y(-2.0f, 12.0f), z(-25.0f, 40.0f), range(minRange, maxRange);
+		punctual_lights lights;
+		for (size_t i = 0; i < count; i++)
+		{
+			lights.add_point(x(generator), y(generator), z(generator), range(generator), 1.0f, 1.0f, 1.0f);
+		}
+		return lights;
+	}
+}
+
+TEST(clusters_match_brute_force_overlap)
+{
+	cluster_settings settings;
+	float view[4][4], projection[4][4];
+	make_view(view);
+	make_projection(1.0f, 16.0f / 9.0f, projection);
+
+	// Some lights straddle the near plane or the screen edges, a few are behind the camera
+	punctual_lights lights = make_lights(48, 0.5f, 8.0f, 7);
+	lights.add_point(2.0f, 3.0f, -19.5f, 1.0f, 1.0f, 1.0f, 1.0f);
+	lights.add_point(2.0f, 3.0f, -30.0f, 2.0f, 1.0f, 1.0f, 1.0f);
+
+	light_clusters clusters(settings);
+	clusters.build(lights, view, projection);
+	CHECK(clusters.get_stats().droppedLights == 0);
+	std::vector<std::set<uint32_t>> binned = get_binned(clusters, lights.size());
+
+	size_t missing = 0, spurious = 0, exact = 0, assigned = 0;
+	for (size_t light = 0; light < lights.size(); light++)
+	{
+		float center[3];
+		to_view(view, lights.positionX[light], lights.positionY[light], lights.positionZ[light], center);
+		float radius = lights.range[light];
+		for (uint32_t slice = 0; slice < settings.slices; slice++)
+		{
+			for (uint32_t y = 0; y < settings.tilesY; y++)
+			{
+				for (uint32_t x = 0; x < settings.tilesX; x++)
+				{
+					uint32_t cluster = (slice * settings.tilesY + y) * settings.tilesX + x;
+					bool isBinned = binned[light].count(cluster) > 0;
+					cluster_cell cell = get_cell(settings, x, y, slice);
+
+					// The box holds the cell, so a sphere clear of the box is clear of the cell
+					double boxDistance = box_distance(cell, projection, center);
+					if (boxDistance > radius * 1.0001 + 1e-4)
+					{
+						spurious += isBinned ? 1 : 0;
+						continue;
+					}
+
+					// A sphere reaching into the cell must be in the cluster's list
+					bool overlaps = cell_distance(cell, projection, center) < radius * 0.9999 - 1e-4;
+					missing += overlaps && !isBinned ? 1 : 0;
+					exact += overlaps ? 1 : 0;
+					assigned += isBinned ? 1 : 0;
+				}
+			}
+		}
+	}
+
+	std::printf("  %zu lights: %zu cluster entries, %zu where the sphere reaches the cell itself\n", lights.size(), assigned, exact);
+	CHECK(missing == 0);
+	CHECK(spurious == 0);
+	CHECK(exact > 0);
+
+	// Behind the camera is in no cluster
+	CHECK(binned.back().empty());
+}
+
+TEST(clusters_spots_stay_inside_their_sphere)
+{
+	cluster_settings settings;
+	float view[4][4], projection[4][4];
+	make_view(view);
+	make_projection(1.0f, 16.0f / 9.0f, projection);
+
+	// The same place and range as a point light and as a narrow spot pointing along the view
+	punctual_lights lights;
+	lights.add_point(0.0f, 3.0f, 0.0f, 12.0f, 1.0f, 1.0f, 1.0f);
+	float forward[3] = { view[0][2], view[1][2], view[2][2] };
+	lights.add_spot(0.0f, 3.0f, 0.0f, forward[0], forward[1], forward[2], 12.0f, 0.1f, 0.2f, 1.0f, 1.0f, 1.0f);
+
+	light_clusters clusters(settings);
+	clusters.build(lights, view, projection);
+	std::vector<std::set<uint32_t>> binned = get_binned(clusters, lights.size());
+
+	CHECK(!binned[1].empty());
+	CHECK(binned[1].size() * 4 < binned[0].size());
+	CHECK(std::includes(binned[0].begin(), binned[0].end(), binned[1].begin(), binned[1].end()));
+}
+
+TEST(clusters_binning_benchmark)
+{
+	cluster_settings settings;
+	float view[4][4], projection[4][4];
+	make_view(view);
+	make_projection(1.0f, 16.0f / 9.0f, projection);
+
+	// Ranges shrink as the count grows, as a scene keeps its lit density
+	const size_t counts[3] = { 1000, 10000, 50000 };
+	const float ranges[3] = { 3.0f, 1.5f, 0.8f };
+	for (int run = 0; run < 3; run++)
+	{
+		punctual_lights lights = make_lights(counts[run], ranges[run] * 0.5f, ranges[run], 11);
+		light_clusters clusters(settings);
+
+		// The first build also lays out the cluster bounds
+		clusters.build(lights, view, projection);
+		double milliseconds = 0.0;
+		const int iterations = 10;
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			clusters.build(lights, view, projection);
+			milliseconds += clusters.get_stats().milliseconds;
+		}
+
+		const cluster_stats& stats = clusters.get_stats();
+		std::printf("  %zu lights: %zu entries, at most %u per cluster, %zu dropped, %.3f ms\n", stats.lightCount, stats.indexCount,
+			stats.maxLightsPerCluster, stats.droppedLights, milliseconds / iterations);
+		CHECK(stats.lightCount == counts[run]);
+		CHECK(stats.droppedLights == 0);
+		CHECK(stats.indexCount == clusters.get_indices().size());
+	}
+}
@@ -0,0 +1,121 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/luminance_histogram.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	// Grey RGBA float image, every texel at the given luminance
+	std::vector<float> make_image(size_t width, size_t height, float luminance)
+	{
+		std::vector<float> rgba(width * height * 4, luminance);
+		for (size_t i = 0; i < width * height; i++)
+		{
+			rgba[i * 4 + 3] = 1.0f;
+		}
+		return rgba;
+	}
+
+	void fill_rows(std::vector<float>& rgba, size_t width, size_t firstRow, size_t rowCount, size_t firstColumn, size_t columnCount, float luminance)
+	{
+		for (size_t y = firstRow; y < firstRow + rowCount; y++)
+		{
+			for (size_t x = firstColumn; x < firstColumn + columnCount; x++)
+			{
+				for (size_t c = 0; c < 3; c++)
+				{
+					rgba[(y * width + x) * 4 + c] = luminance;
+				}
+			}
+		}
+	}
+
+	uint32_t count_samples(const luminance_histogram::bins& histogram)
+	{
+		uint32_t total = 0;
+		for (uint32_t count : histogram)
+		{
+			total += count;
+		}
+		return total;
+	}
+}
+
+TEST(luminance_bin_edges)
+{
+	exposure_settings settings;
+	CHECK(luminance_histogram::get_bin(0.0f, settings) == 0);
+	CHECK(luminance_histogram::get_bin(-1.0f, settings) == 0);
+	CHECK(luminance_histogram::get_bin(std::nanf(""), settings) == 0);
+	CHECK(luminance_histogram::get_bin(1e-6f, settings) == 0);
+
+	// [2^-10, 2^6] spans bins 1 to 255; anything brighter clamps to the last
+	CHECK(luminance_histogram::get_bin(std::exp2(settings.minLogLuminance), settings) == 1);
+	CHECK(luminance_histogram::get_bin(std::exp2(settings.maxLogLuminance), settings) == luminance_histogram::BIN_COUNT - 1);
+	CHECK(luminance_histogram::get_bin(1e9f, settings) == luminance_histogram::BIN_COUNT - 1);
+	CHECK(luminance_histogram::get_bin(std::exp2(-2.0f), settings) == 128);
+}
+
+TEST(luminance_histogram_counts_2x2_blocks)
+{
+	// Odd sizes round up, the last block repeating the edge texel
+	exposure_settings settings;
+	const size_t width = 1921, height = 1081;
+	std::vector<float> rgba = make_image(width, height, 0.5f);
+	luminance_histogram::bins histogram;
+	luminance_histogram::build(rgba.data(), width, height, settings, histogram);
+
+	CHECK(count_samples(histogram) == (width + 1) / 2 * ((height + 1) / 2));
+	CHECK(histogram[luminance_histogram::get_bin(0.5f, settings)] == count_samples(histogram));
+
+	// Bin centres are within half a bin, 1/32 of a stop, of the true luminance
+	float average = luminance_histogram::get_average_luminance(histogram, settings);
+	CHECK(std::fabs(average / 0.5f - 1.0f) <= 0.025f);
+}
+
+TEST(luminance_average_skips_percentile_extremes)
+{
+	// Half the frame bright sky at 50 and half shadow at 0.05, with 1% pure black that bin 0 drops
+	exposure_settings settings;
+	const size_t width = 256, height = 200;
+	std::vector<float> rgba = make_image(width, height, 50.0f);
+	fill_rows(rgba, width, 0, height, width / 2, width / 2, 0.05f);
+	fill_rows(rgba, width, 0, 2, 0, width, 0.0f);
+	luminance_histogram::bins histogram;
+	luminance_histogram::build(rgba.data(), width, height, settings, histogram);
+	float average = luminance_histogram::get_average_luminance(histogram, settings);
+
+	// The log average of the two halves, sqrt(50 * 0.05)
+	CHECK(std::fabs(average / std::sqrt(2.5f) - 1.0f) <= 0.05f);
+
+	// Replacing 1% at each end with far darker and brighter pixels stays inside the excluded 10%
+	fill_rows(rgba, width, 2, 2, 0, width, 1e-4f);
+	fill_rows(rgba, width, 4, 2, 0, width, 1e4f);
+	luminance_histogram::build(rgba.data(), width, height, settings, histogram);
+	float withExtremes = luminance_histogram::get_average_luminance(histogram, settings);
+	CHECK(std::fabs(withExtremes / average - 1.0f) <= 1e-4f);
+}
+
+TEST(luminance_adapts_faster_up_than_down)
+{
+	exposure_settings settings;
+	exposure_state state = luminance_histogram::adapt(exposure_state(), 0.5f, 1.0f / 60.0f, settings);
+	CHECK(state.adaptedLuminance == 0.5f);
+	CHECK(std::fabs(state.exposure - settings.keyValue / 0.5f) <= 1e-6f);
+
+	// Half a second towards a scene four stops brighter, and one four stops darker
+	exposure_state up = state, down = state;
+	for (int frame = 0; frame < 30; frame++)
+	{
+		up = luminance_histogram::adapt(up, 8.0f, 1.0f / 60.0f, settings);
+		down = luminance_histogram::adapt(down, 0.5f / 16.0f, 1.0f / 60.0f, settings);
+	}
+	float upStops = std::log2(up.adaptedLuminance / 0.5f);
+	float downStops = std::log2(0.5f / down.adaptedLuminance);
+	CHECK(std::fabs(upStops - 4.0f * (1.0f - std::exp(-0.5f * settings.speedUp))) <= 0.01f);
+	CHECK(std::fabs(downStops - 4.0f * (1.0f - std::exp(-0.5f * settings.speedDown))) <= 0.01f);
+	CHECK(upStops > downStops);
+}
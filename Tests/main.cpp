@@ -0,0 +1,73 @@
+// Unit tests for the GPU-free Core modules. Each test file registers its tests with TEST; this runs them all, prints
+// the failed checks and exits with the number of tests that failed. Tests that read the bundled models look for them
+// under the data root.
+//
+//     Tests [data root]
+//
+// The data root defaults to ../D3D11Renderer, the renderer's directory as seen from this one, which is where
+// Visual Studio starts the tests.
+
+#include "test.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	struct registered_test
+	{
+		const char* name;
+		tests::test_function function;
+	};
+
+	// Function-local so it exists before the first registration, whatever order the files initialize in
+	std::vector<registered_test>& get_tests()
+	{
+		static std::vector<registered_test> registered;
+		return registered;
+	}
+
+	std::filesystem::path dataRoot = "../D3D11Renderer";
+	size_t failedChecks = 0;
+}
+
+tests::registration::registration(const char* name, test_function function)
+{
+	get_tests().push_back({ name, function });
+}
+
+void tests::fail(const char* file, int line, const char* expression)
+{
+	std::fprintf(stderr, "  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	failedChecks++;
+}
+
+std::filesystem::path tests::data_path(const char* relative)
+{
+	return dataRoot / relative;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		dataRoot = argv[1];
+	}
+
+	int failedTests = 0;
+	for (const registered_test& test : get_tests())
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t checksBefore = failedChecks;
+		test.function();
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		bool passed = failedChecks == checksBefore;
+		std::printf("%s %s (%.1f ms)\n", passed ? "PASS" : "FAIL", test.name, milliseconds);
+		failedTests += passed ? 0 : 1;
+	}
+
+	std::printf("%zu tests, %d failed\n", get_tests().size(), failedTests);
+	return failedTests;
+}
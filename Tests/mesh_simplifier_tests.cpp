@@ -0,0 +1,222 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/gltf_file.h"
+#include "../D3D11Renderer/Core/mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	struct test_mesh
+	{
+		std::vector<float> positions;  // xyz per vertex
+		std::vector<uint32_t> indices;
+
+		size_t get_vertex_count() const { return positions.size() / 3; }
+	};
+
+	struct gltf_vertex
+	{
+		float position[3];
+		float texcoord[2];
+		float normal[3];
+		float tangent[3];
+		float bitangent[3];
+	};
+
+	// The first primitive of a bundled model, with its UV and normal seams as the renderer loads them
+	test_mesh load_mesh(const char* path)
+	{
+		test_mesh mesh;
+		gltf_file file;
+		if (!file.open(tests::data_path(path)))
+		{
+			std::printf("  %s: %s\n", path, file.get_error().c_str());
+			return mesh;
+		}
+
+		std::vector<gltf_vertex> vertices(file.get_vertex_count());
+		std::vector<uint32_t> indices(file.get_index_count());
+		gltf_vertex_layout layout = { sizeof(gltf_vertex), offsetof(gltf_vertex, position), offsetof(gltf_vertex, texcoord),
+			offsetof(gltf_vertex, normal), offsetof(gltf_vertex, tangent), offsetof(gltf_vertex, bitangent) };
+		file.read(vertices.data(), layout, indices.data());
+
+		const gltf_primitive& primitive = file.get_primitives()[0];
+		for (size_t i = primitive.startVertex; i < primitive.startVertex + primitive.vertexCount; i++)
+		{
+			mesh.positions.insert(mesh.positions.end(), vertices[i].position, vertices[i].position + 3);
+		}
+		for (size_t i = primitive.startIndex; i < primitive.startIndex + primitive.indexCount; i++)
+		{
+			mesh.indices.push_back(indices[i] - static_cast<uint32_t>(primitive.startVertex));
+		}
+		return mesh;
+	}
+
+	// A UV sphere whose first and last columns are separate vertices at the same positions, like a texture seam
+	test_mesh make_sphere(uint32_t rows, uint32_t columns)
+	{
+		test_mesh mesh;
+		for (uint32_t row = 0; row <= rows; row++)
+		{
+			for (uint32_t column = 0; column <= columns; column++)
+			{
+				float theta = 3.14159265f * row / rows;
+				float phi = 2.0f * 3.14159265f * column / columns;
+				mesh.positions.insert(mesh.positions.end(), { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) });
+			}
+		}
+		for (uint32_t row = 0; row < rows; row++)
+		{
+			for (uint32_t column = 0; column < columns; column++)
+			{
+				uint32_t a = row * (columns + 1) + column;
+				uint32_t b = a + columns + 1;
+				mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+			}
+		}
+		return mesh;
+	}
+
+	// The same id for vertices at the same position, so seams look closed
+	std::vector<uint32_t> get_position_ids(const test_mesh& mesh)
+	{
+		std::map<std::tuple<float, float, float>, uint32_t> ids;
+		std::vector<uint32_t> positionIds(mesh.get_vertex_count());
+		for (size_t i = 0; i < positionIds.size(); i++)
+		{
+			auto key = std::make_tuple(mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2]);
+			positionIds[i] = ids.emplace(key, static_cast<uint32_t>(ids.size())).first->second;
+		}
+		return positionIds;
+	}
+
+	// Edges between distinct positions used by one triangle only; a torn seam adds some
+	std::vector<std::pair<uint32_t, uint32_t>> get_open_edges(const std::vector<uint32_t>& positionIds, const std::vector<uint32_t>& indices)
+	{
+		std::map<std::pair<uint32_t, uint32_t>, int> edges;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t a = positionIds[indices[i + corner]];
+				uint32_t b = positionIds[indices[i + (corner + 1) % 3]];
+				if (a != b)
+				{
+					edges[std::minmax(a, b)]++;
+				}
+			}
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t>> open;
+		for (const auto& [edge, count] : edges)
+		{
+			if (count == 1)
+			{
+				open.push_back(edge);
+			}
+		}
+		return open;
+	}
+
+	// Simplifies to half the triangles four times, each level from the one before, as model builds its LODs, and prints
+	// the triangle counts and times. The first targetLevels levels must reach their target; past that the locked seam
+	// corners may run out of collapses first.
+	void check_lod_chain(const test_mesh& mesh, const char* name, int targetLevels)
+	{
+		std::vector<uint32_t> positionIds = get_position_ids(mesh);
+		std::set<uint32_t> borderPositions;
+		for (const auto& [a, b] : get_open_edges(positionIds, mesh.indices))
+		{
+			borderPositions.insert(a);
+			borderPositions.insert(b);
+		}
+
+		std::vector<uint32_t> source = mesh.indices, simplified;
+		for (int level = 1; level <= 4; level++)
+		{
+			size_t target = source.size() / 6 * 3;
+			simplify_stats stats;
+			mesh_simplifier::simplify(mesh.positions.data(), mesh.get_vertex_count(), sizeof(float) * 3, source.data(), source.size(),
+				target, 1e30f, simplified, stats);
+			std::printf("  %s LOD %d: %zu -> %zu triangles, error %.5f, %zu locked, %.2f ms\n", name, level,
+				stats.sourceTriangles, stats.triangles, stats.error, stats.lockedVertices, stats.milliseconds);
+
+			CHECK(simplified.size() <= target || level > targetLevels);
+			CHECK(simplified.size() < source.size());
+			CHECK(stats.triangles * 3 == simplified.size());
+			CHECK(stats.sourceTriangles * 3 == source.size());
+			CHECK(std::all_of(simplified.begin(), simplified.end(), [&](uint32_t index) { return index < mesh.get_vertex_count(); }));
+			CHECK(stats.error >= 0.0f);
+
+			// Seams stay closed: every open edge left runs along the source's own borders
+			for (const auto& [a, b] : get_open_edges(positionIds, simplified))
+			{
+				CHECK(borderPositions.count(a) && borderPositions.count(b));
+			}
+			source.swap(simplified);
+		}
+	}
+}
+
+TEST(simplifier_helmet_lods)
+{
+	test_mesh helmet = load_mesh("Models/DamagedHelmet/DamagedHelmet.gltf");
+	CHECK(!helmet.indices.empty());
+	if (!helmet.indices.empty())
+	{
+		// Its UV seams lock about a third of its vertices, which stops it near 3200 triangles
+		check_lod_chain(helmet, "DamagedHelmet", 2);
+	}
+}
+
+TEST(simplifier_sphere_lods)
+{
+	// 200k triangles, to time the simplifier on a mesh the size of a detailed scan
+	check_lod_chain(make_sphere(400, 250), "Sphere", 4);
+}
+
+TEST(simplifier_stops_at_max_error)
+{
+	test_mesh sphere = make_sphere(100, 60);
+	std::vector<uint32_t> unlimited, limited;
+	simplify_stats unlimitedStats, limitedStats;
+	mesh_simplifier::simplify(sphere.positions.data(), sphere.get_vertex_count(), sizeof(float) * 3, sphere.indices.data(), sphere.indices.size(),
+		0, 1e30f, unlimited, unlimitedStats);
+
+	float maxError = unlimitedStats.error * 0.1f;
+	mesh_simplifier::simplify(sphere.positions.data(), sphere.get_vertex_count(), sizeof(float) * 3, sphere.indices.data(), sphere.indices.size(),
+		0, maxError, limited, limitedStats);
+	CHECK(limitedStats.error <= maxError);
+	CHECK(limited.size() > unlimited.size());
+	CHECK(limited.size() < sphere.indices.size());
+}
+
+TEST(simplifier_lod_selection_hysteresis)
+{
+	lod_settings settings;
+	const float errors[4] = { 0.0f, 0.01f, 0.02f, 0.04f };
+
+	// Far away everything is under a pixel; close up only LOD 0 is
+	CHECK(mesh_simplifier::select_lod(errors, 4, 1.0f, 0, settings) == 3);
+	CHECK(mesh_simplifier::select_lod(errors, 4, 1000.0f, 3, settings) == 0);
+
+	// At 45 pixels per unit LOD 2's error covers 0.9 pixels: in range to keep, not far enough under to switch to
+	CHECK(mesh_simplifier::select_lod(errors, 4, 45.0f, 2, settings) == 2);
+	CHECK(mesh_simplifier::select_lod(errors, 4, 45.0f, 1, settings) == 1);
+
+	// Past a pixel it goes finer straight away
+	CHECK(mesh_simplifier::select_lod(errors, 4, 60.0f, 2, settings) == 1);
+
+	// Last frame's LOD from a model with more levels is clamped
+	CHECK(mesh_simplifier::select_lod(errors, 2, 1.0f, 3, settings) == 1);
+}
@@ -0,0 +1,134 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/mip_generator.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr size_t WIDTH = 256;
+	constexpr size_t HEIGHT = 128;
+
+	// Foliage-like alpha: leaf shapes of a few texels to a few dozen, cut out of the background with a hard edge. Red
+	// holds a checker and RGB a normal fanning out around the centre.
+	std::vector<uint8_t> make_image()
+	{
+		std::vector<uint8_t> pixels(WIDTH * HEIGHT * 4);
+		for (size_t y = 0; y < HEIGHT; y++)
+		{
+			for (size_t x = 0; x < WIDTH; x++)
+			{
+				uint8_t* pixel = &pixels[(y * WIDTH + x) * 4];
+				float angle = std::atan2(static_cast<float>(y) - HEIGHT / 2.0f, static_cast<float>(x) - WIDTH / 2.0f);
+				pixel[0] = ((x / 8 + y / 8) & 1) ? 255 : 0;
+				pixel[1] = 128;
+				pixel[2] = static_cast<uint8_t>(127.5f + 127.5f * std::cos(angle));
+				float leaves = std::sin(x * 0.11f) * std::cos(y * 0.17f) + 0.6f * std::sin(x * 0.31f + y * 0.23f);
+				pixel[3] = leaves > 0.5f ? 255 : 0;
+			}
+		}
+		return pixels;
+	}
+
+	Image make_source(std::vector<uint8_t>& pixels)
+	{
+		return Image{ WIDTH, HEIGHT, DXGI_FORMAT_R8G8B8A8_UNORM, WIDTH * 4, WIDTH * HEIGHT * 4, pixels.data() };
+	}
+
+	// Fraction of texels that pass an alpha test at 0.5
+	double coverage(const Image& image)
+	{
+		size_t passed = 0;
+		for (size_t i = 0; i < image.width * image.height; i++)
+		{
+			passed += image.pixels[i * 4 + 3] >= 128 ? 1 : 0;
+		}
+		return static_cast<double>(passed) / (image.width * image.height);
+	}
+}
+
+TEST(mip_chain_is_complete)
+{
+	std::vector<uint8_t> pixels = make_image();
+	ScratchImage chain;
+	CHECK(mip_generator::generate(make_source(pixels), mip_settings(), chain));
+
+	// 256x128 down to 1x1
+	CHECK(chain.GetImageCount() == 9);
+	const Image* top = chain.GetImage(0, 0, 0);
+	CHECK(top->width == WIDTH && top->height == HEIGHT);
+	CHECK(std::memcmp(top->pixels, pixels.data(), pixels.size()) == 0);
+
+	const Image* last = chain.GetImage(chain.GetImageCount() - 1, 0, 0);
+	CHECK(last->width == 1 && last->height == 1);
+}
+
+TEST(mips_keep_alpha_test_coverage)
+{
+	std::vector<uint8_t> pixels = make_image();
+	for (mip_filter filter : { mip_filter::Box, mip_filter::Kaiser, mip_filter::Lanczos })
+	{
+		mip_settings settings;
+		settings.filter = filter;
+		settings.alphaCutoff = 0.5f;
+		ScratchImage chain;
+		CHECK(mip_generator::generate(make_source(pixels), settings, chain));
+
+		// Without the alpha scale coverage falls from 23% to 7% by the 16x8 level and to nothing below it. Levels
+		// under 16 texels can only hit the target to the nearest few texels.
+		double target = coverage(*chain.GetImage(0, 0, 0));
+		for (size_t level = 1; level < chain.GetImageCount(); level++)
+		{
+			const Image* image = chain.GetImage(level, 0, 0);
+			double tolerance = image->width * image->height >= 16 ? 0.05 : 0.5;
+			CHECK(std::fabs(coverage(*image) - target) <= tolerance);
+		}
+	}
+}
+
+TEST(mips_without_cutoff_average_alpha)
+{
+	std::vector<uint8_t> pixels = make_image();
+	mip_settings settings;
+	settings.filter = mip_filter::Box;
+	ScratchImage chain;
+	CHECK(mip_generator::generate(make_source(pixels), settings, chain));
+
+	// A box filter keeps the mean, so the 1x1 level holds the image's average alpha
+	double mean = 0.0;
+	for (size_t i = 0; i < WIDTH * HEIGHT; i++)
+	{
+		mean += pixels[i * 4 + 3];
+	}
+	mean /= WIDTH * HEIGHT;
+	const Image* last = chain.GetImage(chain.GetImageCount() - 1, 0, 0);
+	CHECK(std::fabs(last->pixels[3] - mean) <= 2.0);
+}
+
+TEST(normal_mips_stay_unit_length)
+{
+	std::vector<uint8_t> pixels = make_image();
+	mip_settings settings;
+	settings.gammaSpace = false;
+	settings.normalMap = true;
+	ScratchImage chain;
+	CHECK(mip_generator::generate(make_source(pixels), settings, chain));
+
+	// Filtering shortens the vectors where the directions fan out; renormalizing restores them up to 8-bit rounding
+	for (size_t level = 1; level < chain.GetImageCount(); level++)
+	{
+		const Image* image = chain.GetImage(level, 0, 0);
+		for (size_t i = 0; i < image->width * image->height; i++)
+		{
+			const uint8_t* texel = image->pixels + i * 4;
+			float x = texel[0] / 127.5f - 1.0f;
+			float y = texel[1] / 127.5f - 1.0f;
+			float z = texel[2] / 127.5f - 1.0f;
+			CHECK(std::fabs(std::sqrt(x * x + y * y + z * z) - 1.0f) <= 0.02f);
+		}
+	}
+}
@@ -0,0 +1,207 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/scene_graph.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr size_t NODE_COUNT = 100000;
+
+	// Local transform of one node as the tests set it
+	struct node_transform
+	{
+		float translation[3];
+		float rotation[4];
+		float scale[3];
+	};
+
+	// Row-vector scale, rotate, translate; the plain scalar form of what scene_graph does four wide
+	void compose(const node_transform& node, float local[4][4])
+	{
+		float x = node.rotation[0], y = node.rotation[1], z = node.rotation[2], w = node.rotation[3];
+		const float rows[3][3] = {
+			{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) },
+			{ 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) },
+			{ 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) } };
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				local[row][column] = rows[row][column] * node.scale[row];
+			}
+			local[row][3] = 0.0f;
+			local[3][row] = node.translation[row];
+		}
+		local[3][3] = 1.0f;
+	}
+
+	// A random tree built the way application's benchmark builds it, with the transforms kept for the reference
+	struct test_tree
+	{
+		scene_graph graph;
+		std::vector<uint32_t> parents;  // By node id; every parent comes before its children
+		std::vector<node_transform> transforms;
+		std::mt19937 generator{ 1234 };
+
+		test_tree()
+			: parents(NODE_COUNT, 0), transforms(NODE_COUNT)
+		{
+			graph.reserve(NODE_COUNT);
+			for (size_t i = 1; i < NODE_COUNT; i++)
+			{
+				parents[i] = std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(i - 1))(generator);
+				graph.add_node(parents[i]);
+			}
+			for (uint32_t node = 0; node < NODE_COUNT; node++)
+			{
+				randomize(node);
+			}
+		}
+
+		// Small scales keep the worlds of the deepest nodes in a range where float error stays comparable
+		void randomize(uint32_t node)
+		{
+			std::uniform_real_distribution<float> unit(-1.0f, 1.0f), scale(0.8f, 1.25f);
+			node_transform& transform = transforms[node];
+			float length = 0.0f;
+			for (float& value : transform.rotation)
+			{
+				value = unit(generator);
+				length += value * value;
+			}
+			for (float& value : transform.rotation)
+			{
+				value /= std::sqrt(length);
+			}
+			for (int i = 0; i < 3; i++)
+			{
+				transform.translation[i] = unit(generator);
+				transform.scale[i] = scale(generator);
+			}
+			graph.set_translation(node, transform.translation[0], transform.translation[1], transform.translation[2]);
+			graph.set_rotation(node, transform.rotation[0], transform.rotation[1], transform.rotation[2], transform.rotation[3]);
+			graph.set_scale(node, transform.scale[0], transform.scale[1], transform.scale[2]);
+		}
+
+		// Every world from scratch, parents first, in double
+		std::vector<double> recompute() const
+		{
+			std::vector<double> worlds(NODE_COUNT * 16);
+			for (size_t node = 0; node < NODE_COUNT; node++)
+			{
+				float local[4][4];
+				compose(transforms[node], local);
+				double* world = &worlds[node * 16];
+				if (node == 0)
+				{
+					for (int i = 0; i < 16; i++)
+					{
+						world[i] = local[i / 4][i % 4];
+					}
+					continue;
+				}
+
+				const double* parent = &worlds[parents[node] * 16];
+				for (int row = 0; row < 4; row++)
+				{
+					for (int column = 0; column < 4; column++)
+					{
+						world[row * 4 + column] = local[row][0] * parent[column] + local[row][1] * parent[4 + column] +
+							local[row][2] * parent[8 + column] + local[row][3] * parent[12 + column];
+					}
+				}
+			}
+			return worlds;
+		}
+
+		// Largest difference from the reference, relative to the size of the value
+		float max_error(const std::vector<double>& reference) const
+		{
+			float worst = 0.0f;
+			for (uint32_t node = 0; node < NODE_COUNT; node++)
+			{
+				float world[4][4];
+				graph.get_world(node, world);
+				for (int i = 0; i < 16; i++)
+				{
+					double expected = reference[node * 16 + i];
+					worst = std::fmax(worst, static_cast<float>(std::fabs(world[i / 4][i % 4] - expected) / (1.0 + std::fabs(expected))));
+				}
+			}
+			return worst;
+		}
+	};
+}
+
+TEST(scene_graph_matches_naive_recompute)
+{
+	test_tree tree;
+	tree.graph.update();
+	CHECK(tree.graph.get_stats().updatedNodes == NODE_COUNT);
+	CHECK(tree.max_error(tree.recompute()) <= 1e-4f);
+
+	// The same fractions application's benchmark times, each checked against the whole tree recomputed from scratch
+	std::uniform_int_distribution<uint32_t> anyNode(0, static_cast<uint32_t>(NODE_COUNT - 1));
+	for (double fraction : { 0.01, 0.1, 1.0 })
+	{
+		size_t dirtyCount = static_cast<size_t>(fraction * NODE_COUNT);
+		for (size_t i = 0; i < dirtyCount; i++)
+		{
+			tree.randomize(dirtyCount == NODE_COUNT ? static_cast<uint32_t>(i) : anyNode(tree.generator));
+		}
+		tree.graph.update();
+		const scene_graph_stats& stats = tree.graph.get_stats();
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<double> reference = tree.recompute();
+		double naiveMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::printf("  %3.0f%% dirty: %zu of %zu nodes updated in %zu levels, %.3f ms; naive recompute %.3f ms\n", fraction * 100.0,
+			stats.updatedNodes, stats.nodeCount, stats.levelCount, stats.milliseconds, naiveMilliseconds);
+
+		CHECK(stats.nodeCount == NODE_COUNT);
+		CHECK(stats.updatedNodes >= dirtyCount / 2 && stats.updatedNodes <= NODE_COUNT);
+		CHECK(tree.max_error(reference) <= 1e-4f);
+	}
+}
+
+TEST(scene_graph_updates_only_dirty_subtrees)
+{
+	// A chain of four below the root with a sibling branch of two
+	scene_graph graph;
+	uint32_t a = graph.add_node();
+	uint32_t b = graph.add_node(a);
+	uint32_t c = graph.add_node(b);
+	uint32_t d = graph.add_node(c);
+	uint32_t e = graph.add_node();
+	graph.add_node(e);
+	graph.update();
+	CHECK(graph.get_stats().updatedNodes == 7);
+	CHECK(graph.get_stats().levelCount == 5);
+
+	// Nothing changed, nothing recomputed
+	graph.update();
+	CHECK(graph.get_stats().updatedNodes == 0);
+
+	// Moving b carries c and d with it and leaves the other branch alone
+	graph.set_translation(b, 1.0f, 2.0f, 3.0f);
+	graph.update();
+	CHECK(graph.get_stats().updatedNodes == 3);
+	float world[4][4];
+	graph.get_world(d, world);
+	CHECK(world[3][0] == 1.0f && world[3][1] == 2.0f && world[3][2] == 3.0f);
+	graph.get_world(e, world);
+	CHECK(world[3][0] == 0.0f && world[3][1] == 0.0f && world[3][2] == 0.0f);
+
+	// Ids still find their nodes after a later node forces the levels to be sorted again
+	uint32_t f = graph.add_node(d);
+	graph.set_scale(a, 2.0f, 2.0f, 2.0f);
+	graph.update();
+	graph.get_world(f, world);
+	CHECK(world[0][0] == 2.0f && world[3][0] == 2.0f && world[3][1] == 4.0f && world[3][2] == 6.0f);
+}
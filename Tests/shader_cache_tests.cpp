@@ -0,0 +1,267 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/shader_cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr uint64_t COMPILER_VERSION = 10;
+
+	// Stands in for D3DCompile: counts its calls per permutation and returns bytecode that names what it compiled
+	struct stub_compiler
+	{
+		std::atomic<int> calls{ 0 };
+		std::mutex mutex;
+		std::map<std::string, int> callsPerShader;
+
+		shader_compile_function get_function()
+		{
+			return [this](const shader_desc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
+			{
+				std::ifstream file(desc.path);
+				if (!file)
+				{
+					return false;
+				}
+
+				std::string name = desc.entryPoint + " " + desc.profile;
+				for (const auto& [define, value] : desc.defines)
+				{
+					name += " " + define + "=" + value;
+					if (define == "BROKEN")
+					{
+						errors = "error X3000: syntax error\n";
+						return false;
+					}
+				}
+
+				// Long enough that workers handed the same shader would overlap
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				calls++;
+				std::lock_guard<std::mutex> lock(mutex);
+				callsPerShader[name]++;
+				bytecode.assign(name.begin(), name.end());
+				return true;
+			};
+		}
+	};
+
+	// A fresh cache directory and a shader with a two-level include chain
+	struct shader_files
+	{
+		std::filesystem::path root;
+		std::filesystem::path cache;
+		std::filesystem::path shader;
+
+		explicit shader_files(const char* name)
+			: root(std::filesystem::temp_directory_path() / "d3d11renderer_tests" / name), cache(root / "cache"), shader(root / "lightps.hlsl")
+		{
+			std::filesystem::remove_all(root);
+			std::filesystem::create_directories(root);
+			write("lightps.hlsl", "#include \"common.hlsli\"\nfloat4 main() : SV_Target { return shade(); }\n");
+			write("common.hlsli", "  #  include <lighting.hlsli>\nfloat4 shade() { return light(); }\n");
+			write("lighting.hlsli", "float4 light() { return 1; }\n");
+		}
+
+		~shader_files()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(root, error);
+		}
+
+		void write(const char* name, const char* contents) const
+		{
+			std::ofstream(root / name, std::ios::binary | std::ios::trunc) << contents;
+		}
+
+		shader_desc get_desc() const
+		{
+			shader_desc desc;
+			desc.path = shader;
+			desc.profile = "ps_5_0";
+			desc.defines = { { "HAS_NORMAL_MAP", "1" } };
+			return desc;
+		}
+	};
+}
+
+TEST(shader_cache_memory_hit_skips_compiler)
+{
+	shader_files files("memory_hit");
+	stub_compiler compiler;
+	shader_cache cache(files.cache, COMPILER_VERSION, compiler.get_function());
+
+	std::vector<uint8_t> first, second;
+	std::string errors;
+	CHECK(cache.get(files.get_desc(), first, errors));
+	CHECK(cache.get(files.get_desc(), second, errors));
+	CHECK(compiler.calls == 1);
+	CHECK(first == second && !first.empty());
+	CHECK(cache.get_stats().compiles == 1);
+	CHECK(cache.get_stats().memoryHits == 1);
+}
+
+TEST(shader_cache_disk_hit_after_restart)
+{
+	shader_files files("disk_hit");
+	std::vector<uint8_t> compiled, loaded;
+	std::string errors;
+	{
+		stub_compiler compiler;
+		shader_cache cache(files.cache, COMPILER_VERSION, compiler.get_function());
+		CHECK(cache.get(files.get_desc(), compiled, errors));
+		CHECK(compiler.calls == 1);
+	}
+
+	stub_compiler compiler;
+	shader_cache cache(files.cache, COMPILER_VERSION, compiler.get_function());
+	CHECK(cache.get(files.get_desc(), loaded, errors));
+	CHECK(compiler.calls == 0);
+	CHECK(loaded == compiled);
+	CHECK(cache.get_stats().diskHits == 1);
+}
+
+TEST(shader_cache_include_edit_recompiles)
+{
+	shader_files files("include_edit");
+	stub_compiler compiler;
+	shader_cache cache(files.cache, COMPILER_VERSION, compiler.get_function());
+	uint64_t before = cache.compute_key(files.get_desc());
+
+	// Two includes down, through the angle-bracket form with odd spacing
+	files.write("lighting.hlsli", "float4 light() { return 0.5; }\n");
+	uint64_t after = cache.compute_key(files.get_desc());
+	CHECK(before != 0 && after != 0);
+	CHECK(before != after);
+
+	std::vector<uint8_t> bytecode;
+	std::string errors;
+	CHECK(cache.get(files.get_desc(), bytecode, errors));
+	files.write("common.hlsli", "#include \"lighting.hlsli\"\nfloat4 shade() { return light() * 2; }\n");
+	CHECK(cache.get(files.get_desc(), bytecode, errors));
+	CHECK(compiler.calls == 2);
+
+	// An edit to a file nothing includes changes nothing
+	uint64_t key = cache.compute_key(files.get_desc());
+	files.write("unused.hlsli", "float4 unused() { return 0; }\n");
+	CHECK(cache.compute_key(files.get_desc()) == key);
+}
+
+TEST(shader_cache_key_covers_every_input)
+{
+	shader_files files("key_inputs");
+	stub_compiler compiler;
+	shader_cache cache(files.cache, COMPILER_VERSION, compiler.get_function());
+	shader_desc desc = files.get_desc();
+	uint64_t key = cache.compute_key(desc);
+	CHECK(key == cache.compute_key(files.get_desc()));
+
+	shader_desc changed = desc;
+	changed.defines[0].second = "0";
+	CHECK(cache.compute_key(changed) != key);
+
+	changed = desc;
+	changed.defines[0].first = "HAS_EMISSIVE_MAP";
+	CHECK(cache.compute_key(changed) != key);
+
+	changed = desc;
+	changed.defines.push_back({ "ALPHA_TEST", "1" });
+	CHECK(cache.compute_key(changed) != key);
+
+	changed = desc;
+	changed.entryPoint = "main_depth";
+	CHECK(cache.compute_key(changed) != key);
+
+	changed = desc;
+	changed.profile = "ps_5_1";
+	CHECK(cache.compute_key(changed) != key);
+
+	changed = desc;
+	changed.flags = 1;
+	CHECK(cache.compute_key(changed) != key);
+
+	shader_cache newerCompiler(files.cache, COMPILER_VERSION + 1, compiler.get_function());
+	CHECK(newerCompiler.compute_key(desc) != key);
+
+	// A define name and value can't trade characters
+	changed = desc;
+	changed.defines[0] = { "HAS_NORMAL_MAP1", "" };
+	CHECK(cache.compute_key(changed) != key);
+}
+
+TEST(shader_cache_prefetch_compiles_each_permutation_once)
+{
+	shader_files files("prefetch");
+	stub_compiler compiler;
+	shader_cache cache(files.cache, COMPILER_VERSION, compiler.get_function());
+
+	// 32 permutations, each asked for three times, as submeshes sharing a feature set do
+	std::vector<shader_desc> descs;
+	for (int copy = 0; copy < 3; copy++)
+	{
+		for (int features = 0; features < 32; features++)
+		{
+			shader_desc desc = files.get_desc();
+			desc.defines = { { "FEATURES", std::to_string(features) } };
+			descs.push_back(desc);
+		}
+	}
+
+	std::string errors;
+	CHECK(cache.prefetch(descs, errors));
+	CHECK(errors.empty());
+	CHECK(compiler.calls == 32);
+	CHECK(compiler.callsPerShader.size() == 32);
+	for (const auto& [name, calls] : compiler.callsPerShader)
+	{
+		CHECK(calls == 1);
+	}
+
+	// Everything after comes from memory
+	std::vector<uint8_t> bytecode;
+	for (const shader_desc& desc : descs)
+	{
+		CHECK(cache.get(desc, bytecode, errors));
+	}
+	CHECK(compiler.calls == 32);
+	CHECK(cache.get_stats().memoryHits == descs.size());
+}
+
+TEST(shader_cache_reports_failures)
+{
+	shader_files files("failures");
+	stub_compiler compiler;
+	shader_cache cache(files.cache, COMPILER_VERSION, compiler.get_function());
+
+	shader_desc missing = files.get_desc();
+	missing.path = files.root / "missing.hlsl";
+	shader_desc broken = files.get_desc();
+	broken.defines.push_back({ "BROKEN", "1" });
+
+	std::vector<uint8_t> bytecode;
+	std::string errors;
+	CHECK(!cache.get(missing, bytecode, errors));
+	CHECK(errors.empty());
+	CHECK(!cache.get(broken, bytecode, errors));
+	CHECK(errors.find("X3000") != std::string::npos);
+
+	// Both reported together, and the good shader still compiled
+	CHECK(!cache.prefetch({ missing, broken, files.get_desc() }, errors));
+	CHECK(errors.find("Missing shader file") != std::string::npos);
+	CHECK(errors.find("X3000") != std::string::npos);
+	CHECK(compiler.calls == 1);
+
+	// Failures are not cached
+	CHECK(!cache.get(broken, bytecode, errors));
+	CHECK(!errors.empty());
+}
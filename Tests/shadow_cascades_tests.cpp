@@ -0,0 +1,234 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/shadow_cascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr float NEAR_Z = 0.1f;
+	constexpr float FAR_Z = 100.0f;
+
+	float dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// What XMMatrixPerspectiveFovLH makes, row vectors
+	void make_projection(float projection[4][4])
+	{
+		float scaleY = 1.0f / std::tan(0.5f);
+		float range = FAR_Z / (FAR_Z - NEAR_Z);
+		const float values[4][4] = { { scaleY * 9.0f / 16.0f, 0, 0, 0 }, { 0, scaleY, 0, 0 }, { 0, 0, range, 1 }, { 0, 0, -range * NEAR_Z, 0 } };
+		std::copy(&values[0][0], &values[0][0] + 16, &projection[0][0]);
+	}
+
+	// A camera at eye looking yaw about Y and pitch down, with its world-space axes kept for the tests
+	struct test_camera
+	{
+		float eye[3];
+		float axes[3][3];  // Right, up, forward
+		float view[4][4];
+
+		test_camera(float x, float y, float z, float yaw, float pitch)
+			: eye{ x, y, z }
+		{
+			float cy = std::cos(yaw), sy = std::sin(yaw), cp = std::cos(pitch), sp = std::sin(pitch);
+			const float right[3] = { cy, 0.0f, -sy };
+			const float up[3] = { sy * sp, cp, cy * sp };
+			const float forward[3] = { sy * cp, -sp, cy * cp };
+			std::copy(right, right + 3, axes[0]);
+			std::copy(up, up + 3, axes[1]);
+			std::copy(forward, forward + 3, axes[2]);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int row = 0; row < 3; row++)
+				{
+					view[row][axis] = axes[axis][row];
+				}
+				view[axis][3] = 0.0f;
+				view[3][axis] = -dot(eye, axes[axis]);
+			}
+			view[3][3] = 1.0f;
+		}
+
+		// World position of a view-space point
+		void to_world(float x, float y, float z, float result[3]) const
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] = eye[i] + x * axes[0][i] + y * axes[1][i] + z * axes[2][i];
+			}
+		}
+	};
+
+	const float LIGHT_DIRECTION[3] = { 0.3f, -1.0f, 0.4f };
+
+	void to_light_clip(const shadow_cascade& cascade, const float p[3], float result[3])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			result[i] = p[0] * cascade.viewProjection[0][i] + p[1] * cascade.viewProjection[1][i] + p[2] * cascade.viewProjection[2][i] +
+				cascade.viewProjection[3][i];
+		}
+	}
+
+	// Clip units per world unit along each light axis, from the length of each column
+	float get_axis_scale(const shadow_cascade& cascade, int axis)
+	{
+		const float column[3] = { cascade.viewProjection[0][axis], cascade.viewProjection[1][axis], cascade.viewProjection[2][axis] };
+		return std::sqrt(dot(column, column));
+	}
+
+	// Smallest sphere around the split's eight corners, found on its own: the center is on the view axis and the
+	// largest corner distance is convex along it
+	void get_slice_sphere(const test_camera& camera, const float projection[4][4], float splitNear, float splitFar, float center[3], float& radius)
+	{
+		float slopeX = 1.0f / projection[0][0], slopeY = 1.0f / projection[1][1];
+		auto farthest = [&](float z)
+		{
+			float worst = 0.0f;
+			for (float depth : { splitNear, splitFar })
+			{
+				float dx = depth * slopeX, dy = depth * slopeY, dz = depth - z;
+				worst = std::max(worst, std::sqrt(dx * dx + dy * dy + dz * dz));
+			}
+			return worst;
+		};
+
+		float low = splitNear, high = splitFar;
+		for (int i = 0; i < 200; i++)
+		{
+			float a = low + (high - low) / 3.0f, b = high - (high - low) / 3.0f;
+			if (farthest(a) < farthest(b))
+			{
+				high = b;
+			}
+			else
+			{
+				low = a;
+			}
+		}
+		float z = 0.5f * (low + high);
+		radius = farthest(z);
+		camera.to_world(0.0f, 0.0f, z, center);
+	}
+
+	std::vector<float> get_splits(float lambda, uint32_t count)
+	{
+		cascade_settings settings;
+		settings.count = count;
+		settings.splitLambda = lambda;
+		shadow_cascades cascades(settings);
+
+		float projection[4][4];
+		make_projection(projection);
+		test_camera camera(0.0f, 5.0f, 0.0f, 0.0f, 0.0f);
+		cascades.update(camera.view, projection, LIGHT_DIRECTION, nullptr, 0);
+
+		std::vector<float> splits;
+		for (uint32_t i = 0; i < cascades.get_cascade_count(); i++)
+		{
+			splits.push_back(cascades.get_cascade(i).splitDepth);
+		}
+		return splits;
+	}
+}
+
+TEST(cascade_split_lambda_endpoints)
+{
+	// maxDistance is past the far plane, so the splits run from near to far
+	for (uint32_t count : { 1u, 3u, 4u })
+	{
+		std::vector<float> uniform = get_splits(0.0f, count);
+		std::vector<float> logarithmic = get_splits(1.0f, count);
+		std::vector<float> practical = get_splits(0.5f, count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float fraction = static_cast<float>(i + 1) / count;
+			float expectedUniform = NEAR_Z + (FAR_Z - NEAR_Z) * fraction;
+			float expectedLogarithmic = NEAR_Z * std::pow(FAR_Z / NEAR_Z, fraction);
+			CHECK(std::fabs(uniform[i] - expectedUniform) <= 1e-3f * expectedUniform);
+			CHECK(std::fabs(logarithmic[i] - expectedLogarithmic) <= 1e-3f * expectedLogarithmic);
+			CHECK(std::fabs(practical[i] - 0.5f * (expectedUniform + expectedLogarithmic)) <= 1e-3f * expectedUniform);
+		}
+		CHECK(std::fabs(uniform.back() - FAR_Z) <= 1e-3f * FAR_Z && std::fabs(logarithmic.back() - FAR_Z) <= 1e-3f * FAR_Z);
+	}
+}
+
+TEST(cascade_bounds_contain_slice_sphere)
+{
+	float projection[4][4];
+	make_projection(projection);
+	shadow_cascades cascades{ cascade_settings() };
+
+	// Several cameras, with a texel's worth of snapping in every direction somewhere among them
+	for (int step = 0; step < 50; step++)
+	{
+		test_camera camera(0.37f * step, 2.0f + 0.11f * step, -0.23f * step, 0.13f * step, 0.02f * step - 0.4f);
+		cascades.update(camera.view, projection, LIGHT_DIRECTION, nullptr, 0);
+
+		float splitNear = NEAR_Z;
+		for (uint32_t i = 0; i < cascades.get_cascade_count(); i++)
+		{
+			const shadow_cascade& cascade = cascades.get_cascade(i);
+			float center[3], radius, clip[3];
+			get_slice_sphere(camera, projection, splitNear, cascade.splitDepth, center, radius);
+			to_light_clip(cascade, center, clip);
+
+			// The sphere's reach along each light axis stays inside the unit box
+			for (int axis = 0; axis < 2; axis++)
+			{
+				float reach = radius * get_axis_scale(cascade, axis);
+				CHECK(clip[axis] - reach >= -1.0f - 1e-5f && clip[axis] + reach <= 1.0f + 1e-5f);
+			}
+			float depthReach = radius * get_axis_scale(cascade, 2);
+			CHECK(clip[2] - depthReach >= -1e-5f && clip[2] + depthReach <= 1.0f + 1e-5f);
+
+			// One texel of the map covers texelSize world units
+			CHECK(std::fabs(2.0f / get_axis_scale(cascade, 0) / cascade_settings().resolution - cascade.texelSize) <= 1e-5f * cascade.texelSize);
+			splitNear = cascade.splitDepth;
+		}
+	}
+}
+
+TEST(cascade_origins_snap_to_texels)
+{
+	float projection[4][4];
+	make_projection(projection);
+	shadow_cascades cascades{ cascade_settings() };
+	test_camera start(1.0f, 3.0f, 2.0f, 0.7f, -0.2f);
+	cascades.update(start.view, projection, LIGHT_DIRECTION, nullptr, 0);
+
+	float texelSizes[cascade_settings::MAX_CASCADES], origins[cascade_settings::MAX_CASCADES][2];
+	for (uint32_t i = 0; i < cascades.get_cascade_count(); i++)
+	{
+		const shadow_cascade& cascade = cascades.get_cascade(i);
+		texelSizes[i] = cascade.texelSize;
+		origins[i][0] = -cascade.viewProjection[3][0] / get_axis_scale(cascade, 0);
+		origins[i][1] = -cascade.viewProjection[3][1] / get_axis_scale(cascade, 1);
+	}
+
+	// Steps of a few hundredths of a unit, much finer than the texels, with a turn of the head every tenth step
+	for (int step = 1; step <= 100; step++)
+	{
+		test_camera moved(1.0f + 0.013f * step, 3.0f - 0.007f * step, 2.0f + 0.021f * step, 0.7f + (step % 10 == 0 ? 0.5f : 0.0f), -0.2f);
+		cascades.update(moved.view, projection, LIGHT_DIRECTION, nullptr, 0);
+		for (uint32_t i = 0; i < cascades.get_cascade_count(); i++)
+		{
+			const shadow_cascade& cascade = cascades.get_cascade(i);
+			CHECK(std::fabs(cascade.texelSize - texelSizes[i]) <= 1e-5f * texelSizes[i]);
+
+			// The origin moves by whole texels or not at all
+			float origin[2] = { -cascade.viewProjection[3][0] / get_axis_scale(cascade, 0), -cascade.viewProjection[3][1] / get_axis_scale(cascade, 1) };
+			for (int axis = 0; axis < 2; axis++)
+			{
+				float texels = (origin[axis] - origins[i][axis]) / texelSizes[i];
+				CHECK(std::fabs(texels - std::round(texels)) <= 1e-2f);
+			}
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <filesystem>
+
+namespace tests
+{
+	using test_function = void (*)();
+
+	// Made by TEST at static initialization; main runs every registered test in turn
+	struct registration
+	{
+		registration(const char* name, test_function function);
+	};
+
+	// Records a failed CHECK against the running test and carries on
+	void fail(const char* file, int line, const char* expression);
+
+	// A file under the data root, which holds the renderer's Models directory
+	std::filesystem::path data_path(const char* relative);
+}
+
+#define TEST(name) \
+	static void name(); \
+	static tests::registration name##_registration(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do \
+	{ \
+		if (!(expression)) \
+			tests::fail(__FILE__, __LINE__, #expression); \
+	} while (false)
@@ -0,0 +1,102 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/texture_array_planner.h"
+
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	constexpr uint32_t BC1_UNORM_SRGB = 72;
+	constexpr uint32_t BC5_UNORM = 83;
+
+	array_material_desc make_material(int32_t albedo, int32_t normal, uint32_t features)
+	{
+		array_material_desc material;
+		for (int32_t& texture : material.textures)
+		{
+			texture = array_material_desc::NO_TEXTURE;
+		}
+		material.textures[0] = albedo;
+		material.textures[1] = normal;
+		material.features = features;
+		return material;
+	}
+}
+
+TEST(array_planner_groups_matching_textures)
+{
+	// Two 1K albedos, two 1K normal maps and a 512 albedo that matches nothing
+	std::vector<array_texture_desc> textures = {
+		{ 1024, 1024, 11, BC1_UNORM_SRGB },
+		{ 1024, 1024, 11, BC1_UNORM_SRGB },
+		{ 1024, 1024, 11, BC5_UNORM },
+		{ 512, 512, 10, BC1_UNORM_SRGB },
+		{ 1024, 1024, 11, BC5_UNORM },
+	};
+	std::vector<array_material_desc> materials = {
+		make_material(0, 2, 3),
+		make_material(1, 4, 3),
+		make_material(3, 2, 3),
+		make_material(1, array_material_desc::NO_TEXTURE, 1),
+	};
+	std::vector<uint16_t> drawMaterials = { 0, 0, 1, 2, 1, 3, 0 };
+
+	texture_array_planner planner;
+	planner.plan(textures, materials, drawMaterials);
+
+	const std::vector<texture_array>& arrays = planner.get_arrays();
+	CHECK(arrays.size() == 3);
+	CHECK(arrays[0].textures == std::vector<uint32_t>({ 0, 1 }));
+	CHECK(arrays[1].textures == std::vector<uint32_t>({ 2, 4 }));
+	CHECK(arrays[2].textures == std::vector<uint32_t>({ 3 }));
+
+	const std::vector<texture_slice>& slices = planner.get_slices();
+	CHECK(slices[1].array == 0 && slices[1].slice == 1);
+	CHECK(slices[4].array == 1 && slices[4].slice == 1);
+	CHECK(slices[3].array == 2 && slices[3].slice == 0);
+
+	// Materials 0 and 1 differ only in slices; 2 binds another albedo array and 3 another permutation
+	const std::vector<uint32_t>& bindings = planner.get_material_bindings();
+	CHECK(bindings[0] == bindings[1]);
+	CHECK(bindings[2] != bindings[0]);
+	CHECK(bindings[3] != bindings[0] && bindings[3] != bindings[2]);
+
+	const array_packing_report& report = planner.get_report();
+	CHECK(report.textureCount == 5);
+	CHECK(report.singleSliceArrays == 1);
+	CHECK(report.bindingCount == 3);
+	CHECK(report.draws == 7);
+	CHECK(report.materialRuns == 6);
+	CHECK(report.mergedDraws == 5);
+	CHECK(report.sortedMergedDraws == 3);
+}
+
+TEST(array_planner_splits_full_arrays)
+{
+	std::vector<array_texture_desc> textures(5000, { 4, 4, 1, BC1_UNORM_SRGB });
+	texture_array_planner planner;
+	planner.plan(textures, {}, {});
+
+	const std::vector<texture_array>& arrays = planner.get_arrays();
+	CHECK(arrays.size() == 3);
+	CHECK(arrays[0].textures.size() == texture_array_planner::MAX_SLICES);
+	CHECK(arrays[1].textures.size() == texture_array_planner::MAX_SLICES);
+	CHECK(arrays[2].textures.size() == 5000 - 2 * texture_array_planner::MAX_SLICES);
+
+	const texture_slice& last = planner.get_slices()[4999];
+	CHECK(last.array == 2 && last.slice == 4999 - 2 * texture_array_planner::MAX_SLICES);
+}
+
+TEST(array_planner_replans_from_scratch)
+{
+	texture_array_planner planner;
+	planner.plan(std::vector<array_texture_desc>(3, { 256, 256, 9, BC5_UNORM }), { make_material(0, 1, 0) }, { 0, 0 });
+	planner.plan({ { 64, 64, 7, BC1_UNORM_SRGB } }, {}, {});
+
+	CHECK(planner.get_arrays().size() == 1);
+	CHECK(planner.get_slices().size() == 1);
+	CHECK(planner.get_material_bindings().empty());
+	CHECK(planner.get_report().draws == 0);
+	CHECK(planner.get_report().sortedMergedDraws == 0);
+}
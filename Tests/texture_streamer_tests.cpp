@@ -0,0 +1,277 @@
+#include "test.h"
+#include "../D3D11Renderer/Core/texture_streamer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace d3d11renderer;
+
+namespace
+{
+	// A square BC1 texture with a full chain; block-compressed tops stop at 4x4
+	streamed_texture_desc make_desc(uint32_t size)
+	{
+		streamed_texture_desc desc;
+		desc.width = size;
+		desc.height = size;
+		for (uint32_t mip = 0; (size >> mip) > 0; mip++)
+		{
+			uint32_t blocks = std::max(1u, (size >> mip) / 4);
+			desc.mipBytes.push_back(static_cast<size_t>(blocks) * blocks * 8);
+			if ((size >> mip) >= 4)
+			{
+				desc.coarsestTopMip = mip;
+			}
+		}
+		return desc;
+	}
+
+	size_t get_range_bytes(const streamed_texture_desc& desc, uint32_t firstMip)
+	{
+		size_t bytes = 0;
+		for (size_t mip = firstMip; mip < desc.mipBytes.size(); mip++)
+		{
+			bytes += desc.mipBytes[mip];
+		}
+		return bytes;
+	}
+
+	// Close enough that every mip is wanted
+	void request_full(texture_streamer& streamer, size_t id)
+	{
+		streamer.request(id, 1.0f, 4096.0f);
+	}
+
+	// Bytes the changes upload, to check against the stats
+	size_t get_upload_bytes(const std::vector<streamed_texture_desc>& descs, const std::vector<streaming_change>& changes)
+	{
+		size_t bytes = 0;
+		for (const streaming_change& change : changes)
+		{
+			for (uint32_t mip = change.residentMip; mip < change.uploadEnd; mip++)
+			{
+				bytes += descs[change.textureId].mipBytes[mip];
+			}
+		}
+		return bytes;
+	}
+}
+
+TEST(streamer_keeps_the_budget)
+{
+	streaming_settings settings;
+	settings.budgetBytes = 4 * 1024 * 1024;
+	settings.uploadBytesPerFrame = 1024 * 1024;
+	texture_streamer streamer(settings);
+
+	// 20 1K textures want about 13.3 MB between them
+	std::vector<streamed_texture_desc> descs(20, make_desc(1024));
+	for (const streamed_texture_desc& desc : descs)
+	{
+		streamer.register_texture(desc);
+	}
+
+	// One more texture comes into view every few frames
+	std::vector<streaming_change> changes;
+	for (int frame = 0; frame < 200; frame++)
+	{
+		for (size_t id = 0; id < std::min<size_t>(descs.size(), frame / 4 + 1); id++)
+		{
+			request_full(streamer, id);
+		}
+		streamer.update(changes);
+
+		size_t allocated = 0;
+		for (size_t id = 0; id < descs.size(); id++)
+		{
+			allocated += get_range_bytes(descs[id], streamer.get_allocated_mip(id));
+		}
+		CHECK(allocated == streamer.get_stats().allocatedBytes);
+		CHECK(allocated <= settings.budgetBytes);
+	}
+
+	// Filled to within one 1K mip of the budget, with the rest still wanted
+	const streaming_stats& stats = streamer.get_stats();
+	CHECK(stats.wantedBytes == descs.size() * get_range_bytes(descs[0], 0));
+	CHECK(stats.allocatedBytes + descs[0].mipBytes[0] > settings.budgetBytes);
+	CHECK(stats.pendingBytes == 0);
+}
+
+TEST(streamer_evicts_after_keep_frames)
+{
+	streaming_settings settings;
+	settings.keepFrames = 10;
+	texture_streamer streamer(settings);
+	streamed_texture_desc desc = make_desc(1024);
+	size_t id = streamer.register_texture(desc);
+	uint32_t baseMip = texture_streamer::get_base_mip(desc);
+	CHECK(baseMip == 4);
+
+	std::vector<streaming_change> changes;
+	for (int frame = 0; frame < 20; frame++)
+	{
+		request_full(streamer, id);
+		streamer.update(changes);
+	}
+	CHECK(streamer.get_allocated_mip(id) == 0);
+	CHECK(streamer.get_resident_mip(id) == 0);
+
+	// Out of view: kept for keepFrames counting the last frame it was seen, then given back a mip per update down to the base
+	int frames = 0;
+	while (streamer.get_allocated_mip(id) == 0 && frames < 100)
+	{
+		streamer.update(changes);
+		frames++;
+	}
+	CHECK(frames == static_cast<int>(settings.keepFrames));
+	for (uint32_t mip = 1; mip < baseMip; mip++)
+	{
+		CHECK(streamer.get_allocated_mip(id) == mip);
+		streamer.update(changes);
+	}
+	CHECK(streamer.get_allocated_mip(id) == baseMip);
+	CHECK(streamer.get_resident_mip(id) == baseMip);
+	CHECK(streamer.get_stats().allocatedBytes == get_range_bytes(desc, baseMip));
+
+	// The base mips are never dropped
+	for (int frame = 0; frame < 50; frame++)
+	{
+		streamer.update(changes);
+		CHECK(changes.empty());
+	}
+}
+
+TEST(streamer_caps_uploads_per_frame)
+{
+	streaming_settings settings;
+	settings.uploadBytesPerFrame = 200 * 1024;
+	texture_streamer streamer(settings);
+	std::vector<streamed_texture_desc> descs = { make_desc(2048), make_desc(1024), make_desc(512), make_desc(256) };
+	for (const streamed_texture_desc& desc : descs)
+	{
+		streamer.register_texture(desc);
+	}
+
+	std::vector<streaming_change> changes;
+	size_t total = 0;
+	for (int frame = 0; frame < 100; frame++)
+	{
+		for (size_t id = 0; id < descs.size(); id++)
+		{
+			request_full(streamer, id);
+		}
+		streamer.update(changes);
+
+		// Over the cap only when a single mip is bigger than it, like the 2K texture's top at 2 MB
+		size_t uploaded = streamer.get_stats().uploadedBytes;
+		CHECK(uploaded == get_upload_bytes(descs, changes));
+		bool singleMip = changes.size() == 1 && changes[0].uploadEnd == changes[0].residentMip + 1;
+		CHECK(uploaded <= settings.uploadBytesPerFrame || singleMip);
+		total += uploaded;
+	}
+
+	// Everything above the base mips arrived in the end
+	for (size_t id = 0; id < descs.size(); id++)
+	{
+		CHECK(streamer.get_resident_mip(id) == 0);
+		total -= get_range_bytes(descs[id], 0) - get_range_bytes(descs[id], texture_streamer::get_base_mip(descs[id]));
+	}
+	CHECK(total == 0);
+}
+
+TEST(streamer_moves_one_mip_per_update)
+{
+	streaming_settings settings;
+	settings.keepFrames = 5;
+	texture_streamer streamer(settings);
+	std::vector<streamed_texture_desc> descs = { make_desc(2048), make_desc(1024) };
+	for (const streamed_texture_desc& desc : descs)
+	{
+		streamer.register_texture(desc);
+	}
+
+	// In view for 30 frames, out for 30, in again
+	std::vector<uint32_t> allocated = { streamer.get_allocated_mip(0), streamer.get_allocated_mip(1) };
+	std::vector<uint32_t> resident = allocated;
+	std::vector<streaming_change> changes;
+	bool grew = false, shrank = false;
+	for (int frame = 0; frame < 90; frame++)
+	{
+		if (frame < 30 || frame >= 60)
+		{
+			request_full(streamer, 0);
+			request_full(streamer, 1);
+		}
+		streamer.update(changes);
+
+		for (size_t id = 0; id < descs.size(); id++)
+		{
+			uint32_t nextAllocated = streamer.get_allocated_mip(id);
+			uint32_t nextResident = streamer.get_resident_mip(id);
+			CHECK(std::abs(static_cast<int>(nextAllocated) - static_cast<int>(allocated[id])) <= 1);
+			CHECK(std::abs(static_cast<int>(nextResident) - static_cast<int>(resident[id])) <= 1);
+			CHECK(nextResident >= nextAllocated);
+			grew |= nextAllocated < allocated[id];
+			shrank |= nextAllocated > allocated[id];
+			allocated[id] = nextAllocated;
+			resident[id] = nextResident;
+		}
+
+		// Each change says what the streamer now holds
+		for (const streaming_change& change : changes)
+		{
+			CHECK(change.allocatedMip == streamer.get_allocated_mip(change.textureId));
+			CHECK(change.residentMip == streamer.get_resident_mip(change.textureId));
+		}
+	}
+	CHECK(grew && shrank);
+	CHECK(allocated[0] == 0 && allocated[1] == 0);
+}
+
+TEST(streamer_never_reuploads_resident_mips)
+{
+	texture_streamer streamer{ streaming_settings() };
+	std::vector<streamed_texture_desc> descs(8, make_desc(1024));
+	for (const streamed_texture_desc& desc : descs)
+	{
+		streamer.register_texture(desc);
+	}
+
+	// Requested every frame with some near and some far, so no texture is ever evicted
+	std::map<std::pair<size_t, uint32_t>, int> uploads;
+	std::vector<streaming_change> changes;
+	for (int frame = 0; frame < 120; frame++)
+	{
+		for (size_t id = 0; id < descs.size(); id++)
+		{
+			streamer.request(id, 1.0f, id % 2 ? 4096.0f : 256.0f);
+		}
+		streamer.update(changes);
+		for (const streaming_change& change : changes)
+		{
+			for (uint32_t mip = change.residentMip; mip < change.uploadEnd; mip++)
+			{
+				uploads[{ change.textureId, mip }]++;
+			}
+		}
+
+		// Once settled nothing changes at all
+		if (frame >= 60)
+		{
+			CHECK(changes.empty());
+			CHECK(streamer.get_stats().uploadedBytes == 0);
+		}
+	}
+
+	for (const auto& [mip, count] : uploads)
+	{
+		CHECK(count == 1);
+	}
+
+	// Far ones stop at the requested mip, log2(1024 / 256)
+	CHECK(streamer.get_resident_mip(0) == 2);
+	CHECK(streamer.get_resident_mip(1) == 0);
+}